@@ -0,0 +1,764 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how a
+C++ program can try out several random number generators when it
+starts, pick the fastest one that is good enough, and remember its
+choice for next time.
+
+
+--------------------------
+Many Generators to Choose
+--------------------------
+
+The main tutorial used rand(), but rand() is only one of many Pseudo
+Random Number Generators (PRNGs). Some others are:
+
+    - minstd: the "minimal standard" generator from 1988, found in the
+      C++ random library as minstd_rand.
+    - Mersenne Twister: the popular mt19937 from the C++ random
+      library.
+    - xorshift and xoshiro: very small, very fast generators that use
+      only shifts and the exclusive-or (XOR) operation.
+    - SplitMix64: a generator that adds a constant and scrambles the
+      result.
+
+Each generator can also be written in more than one way (called a
+"kernel"). For example, xoshiro can produce one number at a time, or
+run four copies side by side so the processor can work on all four
+at once with vector instructions.
+
+
+---------------------------
+Quality Tiers
+---------------------------
+
+Not every generator is good enough for every job. We sort them into
+two tiers:
+
+    statistical:  the numbers look random enough for simulations,
+                  games and tests, but someone who sees a few of them
+                  could predict the rest.
+
+    crypto:       the numbers cannot be predicted even by someone who
+                  has seen many of them. Passwords and encryption
+                  keys need this tier. On Linux, the getrandom()
+                  function asks the operating system for such numbers.
+
+A crypto generator is of course also good enough for the statistical
+tier, but it is usually much slower.
+
+
+------------------------------------
+Why Not Just Pick the Fastest Once?
+------------------------------------
+
+Which generator is fastest depends on the processor. A generator that
+uses 64-bit multiplication might win on one machine and lose on an
+older one. A four-lane kernel might be twice as fast on a processor
+with wide vector instructions, and no faster elsewhere.
+
+So instead of choosing in advance, the program measures. The first
+time it runs, it lets each generator fill a buffer for a couple of
+milliseconds, counts how many numbers each one made, and chooses the
+fastest one in the requested tier. Measuring takes time, so the choice
+is written to a small file (called a "cache"), together with the name
+of the processor. The next run reads the file and skips the
+measurements -- unless the program is now running on a different
+processor.
+
+
+----------------
+Review Questions
+----------------
+
+1. Name three PRNGs other than rand().
+
+2. What is a "kernel"?
+
+3. What is the difference between the statistical and crypto tiers?
+
+4. Why should a password not be made with a statistical generator?
+
+5. Why can't we decide in advance which generator is fastest?
+
+6. Why is the choice saved in a cache file?
+
+7. Why is the name of the processor saved too?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the ifstream and ofstream types
+
+#include <fstream>
+
+
+// access the string and vector types
+
+#include <string>
+#include <vector>
+
+
+// access the minstd_rand and mt19937 generators
+
+#include <random>
+
+
+// access the getrandom() function
+
+#include <sys/random.h>
+
+
+// constant used to control how many sample random numbers are
+// generated
+
+const int REPETITIONS = 10;
+
+
+// constant used to control how many numbers are made per call to a
+// kernel (a multiple of 4, for the four-lane kernel)
+
+const int BUFFER_SIZE = 4096;
+
+
+// constant used to control how long each kernel is measured, in
+// seconds
+
+const double MEASURE_TIME = 0.002;
+
+
+// constant used to name the cache file
+
+const char* const CACHE_FILE = ".auto_engine_cache";
+
+
+// the quality tiers
+
+enum Tier { STATISTICAL, CRYPTO };
+
+
+// a generator kernel: its name, its tier, a function to seed it, and
+// a function to fill a buffer with n random 32-bit numbers
+
+struct Engine {
+    const char* name;
+    Tier tier;
+    void (*seed)(unsigned long long seed);
+    void (*fill)(unsigned int* out, int n);
+};
+
+
+// the state of each kernel; only one copy of each kernel is used, so
+// plain global variables are enough
+
+minstd_rand minstd_state;
+mt19937 mt_state;
+mt19937_64 mt64_state;
+unsigned long long splitmix_state;
+unsigned long long xoshiro_state[4];
+unsigned long long xoshiro_x4_state[4][4];
+
+
+// prototype for a function to make the next SplitMix64 number, used
+// both as a kernel and to seed the other kernels
+
+unsigned long long splitmix_next(unsigned long long& state);
+
+
+// prototypes for the kernels, each a seed function and a fill function
+
+void seed_rand(unsigned long long seed);
+void fill_rand(unsigned int* out, int n);
+void seed_minstd(unsigned long long seed);
+void fill_minstd(unsigned int* out, int n);
+void seed_mt(unsigned long long seed);
+void fill_mt(unsigned int* out, int n);
+void seed_mt64(unsigned long long seed);
+void fill_mt64(unsigned int* out, int n);
+void seed_splitmix(unsigned long long seed);
+void fill_splitmix(unsigned int* out, int n);
+void seed_xoshiro(unsigned long long seed);
+void fill_xoshiro(unsigned int* out, int n);
+void seed_xoshiro_x4(unsigned long long seed);
+void fill_xoshiro_x4(unsigned int* out, int n);
+void seed_getrandom(unsigned long long seed);
+void fill_getrandom(unsigned int* out, int n);
+
+
+// the list of all kernels
+
+const Engine ENGINES[] = {
+    { "rand",        STATISTICAL, seed_rand,       fill_rand },
+    { "minstd",      STATISTICAL, seed_minstd,     fill_minstd },
+    { "mt19937",     STATISTICAL, seed_mt,         fill_mt },
+    { "mt19937_64",  STATISTICAL, seed_mt64,       fill_mt64 },
+    { "splitmix64",  STATISTICAL, seed_splitmix,   fill_splitmix },
+    { "xoshiro256+", STATISTICAL, seed_xoshiro,    fill_xoshiro },
+    { "xoshiro256+x4", STATISTICAL, seed_xoshiro_x4, fill_xoshiro_x4 },
+    { "getrandom",   CRYPTO,      seed_getrandom,  fill_getrandom }
+};
+
+const int ENGINE_COUNT = sizeof(ENGINES) / sizeof(ENGINES[0]);
+
+
+// prototype for a function to find the name of the processor
+
+string cpu_name();
+
+
+// prototype for a function to measure how many numbers per second a
+// kernel makes
+
+double measure(const Engine& engine);
+
+
+// prototype for a function to choose the fastest kernel in a tier,
+// using the cache file when it holds a choice for this processor
+
+const Engine* auto_engine(Tier tier, bool& from_cache);
+
+
+// prototype for a function to generate a random number within a
+// specified range, using a chosen kernel
+
+int rand_range_auto(const Engine& engine, int low, int high);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    const Engine* engine;       // used to hold the chosen kernel
+    bool from_cache;            // used to hold whether it was cached
+    int low;                    // used to hold a sample low value
+    int high;                   // used to hold a sample high value
+
+    // choose the fastest statistical kernel, and tell the user
+    engine = auto_engine(STATISTICAL, from_cache);
+
+    cout << endl
+         << "Chose " << engine->name << " for the statistical tier "
+         << (from_cache ? "(from the cache)" : "(measured)") << endl;
+
+    // seed the chosen kernel by using the number of seconds since the
+    // Unix Epoch
+    engine->seed((unsigned long long) time(0));
+
+    low = 200;
+    high = 300;
+
+    // tell the user that several ranged random numbers will be
+    // displayed
+    cout << endl
+         << "Displaying "
+         << REPETITIONS
+         << " random numbers between "
+         << low
+         << " and "
+         << high
+         << endl;
+
+    for (int i = 1; i <= REPETITIONS; i++) {
+        cout << rand_range_auto(*engine, low, high) << endl;
+    }
+
+    // the crypto tier needs no seed, since the operating system
+    // provides the randomness
+    engine = auto_engine(CRYPTO, from_cache);
+
+    cout << endl
+         << "Chose " << engine->name << " for the crypto tier "
+         << (from_cache ? "(from the cache)" : "(measured)") << endl
+         << "A random PIN: ";
+    for (int i = 1; i <= 4; i++) {
+        cout << rand_range_auto(*engine, 0, 9);
+    }
+    cout << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long splitmix_next(unsigned long long& state) {
+
+    // PRE:  none
+    //
+    // POST: the next SplitMix64 number has been returned, and state
+    //       has moved on
+
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void seed_rand(unsigned long long seed) {
+
+    // PRE:  none
+    //
+    // POST: rand() has been seeded with seed
+
+    srand((unsigned int) seed);
+}
+
+
+void fill_rand(unsigned int* out, int n) {
+
+    // PRE:  out has room for n numbers
+    //
+    // POST: out holds n random 32-bit numbers made by rand()
+
+    // rand() gives only 31 bits, so two calls make one number
+    for (int i = 0; i < n; i++) {
+        out[i] = ((unsigned int) rand() << 16) ^ (unsigned int) rand();
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void seed_minstd(unsigned long long seed) {
+
+    // PRE:  none
+    //
+    // POST: the minstd kernel has been seeded with seed
+
+    minstd_state.seed((unsigned int) (seed % 2147483646ULL) + 1);
+}
+
+
+void fill_minstd(unsigned int* out, int n) {
+
+    // PRE:  out has room for n numbers
+    //
+    // POST: out holds n random 32-bit numbers made by minstd
+
+    // minstd also gives only 31 bits
+    for (int i = 0; i < n; i++) {
+        out[i] = ((unsigned int) minstd_state() << 16)
+                 ^ (unsigned int) minstd_state();
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void seed_mt(unsigned long long seed) {
+
+    // PRE:  none
+    //
+    // POST: the mt19937 kernel has been seeded with seed
+
+    mt_state.seed((unsigned int) seed);
+}
+
+
+void fill_mt(unsigned int* out, int n) {
+
+    // PRE:  out has room for n numbers
+    //
+    // POST: out holds n random 32-bit numbers made by mt19937
+
+    for (int i = 0; i < n; i++) {
+        out[i] = (unsigned int) mt_state();
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void seed_mt64(unsigned long long seed) {
+
+    // PRE:  none
+    //
+    // POST: the mt19937_64 kernel has been seeded with seed
+
+    mt64_state.seed(seed);
+}
+
+
+void fill_mt64(unsigned int* out, int n) {
+
+    // PRE:  out has room for n numbers
+    //
+    // POST: out holds n random 32-bit numbers made by mt19937_64
+
+    // each 64-bit number gives two 32-bit numbers
+    int i = 0;
+
+    for (; i + 1 < n; i += 2) {
+        unsigned long long r = mt64_state();
+        out[i] = (unsigned int) r;
+        out[i + 1] = (unsigned int) (r >> 32);
+    }
+    if (i < n) {
+        out[i] = (unsigned int) mt64_state();
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void seed_splitmix(unsigned long long seed) {
+
+    // PRE:  none
+    //
+    // POST: the SplitMix64 kernel has been seeded with seed
+
+    splitmix_state = seed;
+}
+
+
+void fill_splitmix(unsigned int* out, int n) {
+
+    // PRE:  out has room for n numbers
+    //
+    // POST: out holds n random 32-bit numbers made by SplitMix64
+
+    int i = 0;
+
+    for (; i + 1 < n; i += 2) {
+        unsigned long long r = splitmix_next(splitmix_state);
+        out[i] = (unsigned int) r;
+        out[i + 1] = (unsigned int) (r >> 32);
+    }
+    if (i < n) {
+        out[i] = (unsigned int) splitmix_next(splitmix_state);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void seed_xoshiro(unsigned long long seed) {
+
+    // PRE:  none
+    //
+    // POST: the xoshiro256+ kernel has been seeded with seed
+
+    // the four words of state are filled with SplitMix64, which never
+    // leaves them all zero
+    for (int w = 0; w < 4; w++) {
+        xoshiro_state[w] = splitmix_next(seed);
+    }
+}
+
+
+void fill_xoshiro(unsigned int* out, int n) {
+
+    // PRE:  out has room for n numbers
+    //
+    // POST: out holds n random 32-bit numbers made by xoshiro256+
+
+    unsigned long long* s = xoshiro_state;
+
+    for (int i = 0; i < n; i++) {
+
+        unsigned long long result = s[0] + s[3];
+        unsigned long long t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = (s[3] << 45) | (s[3] >> 19);
+
+        // the upper bits of xoshiro256+ are the best ones
+        out[i] = (unsigned int) (result >> 32);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void seed_xoshiro_x4(unsigned long long seed) {
+
+    // PRE:  none
+    //
+    // POST: the four lanes of the xoshiro256+x4 kernel have been
+    //       seeded with seed, each lane differently
+
+    for (int w = 0; w < 4; w++) {
+        for (int lane = 0; lane < 4; lane++) {
+            xoshiro_x4_state[w][lane] = splitmix_next(seed);
+        }
+    }
+}
+
+
+void fill_xoshiro_x4(unsigned int* out, int n) {
+
+    // PRE:  out has room for n numbers, and n is a multiple of 4
+    //
+    // POST: out holds n random 32-bit numbers made by four
+    //       xoshiro256+ generators side by side
+
+    unsigned long long (*s)[4] = xoshiro_x4_state;
+
+    for (int i = 0; i < n; i += 4) {
+
+        // the same steps on all four lanes; the compiler can do each
+        // step for all lanes with a single vector instruction
+        for (int lane = 0; lane < 4; lane++) {
+
+            unsigned long long result = s[0][lane] + s[3][lane];
+            unsigned long long t = s[1][lane] << 17;
+
+            s[2][lane] ^= s[0][lane];
+            s[3][lane] ^= s[1][lane];
+            s[1][lane] ^= s[2][lane];
+            s[0][lane] ^= s[3][lane];
+            s[2][lane] ^= t;
+            s[3][lane] = (s[3][lane] << 45) | (s[3][lane] >> 19);
+
+            out[i + lane] = (unsigned int) (result >> 32);
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void seed_getrandom(unsigned long long seed) {
+
+    // PRE:  none
+    //
+    // POST: nothing has happened; the operating system seeds itself
+
+    (void) seed;
+}
+
+
+void fill_getrandom(unsigned int* out, int n) {
+
+    // PRE:  out has room for n numbers
+    //
+    // POST: out holds n unpredictable 32-bit numbers from the operating
+    //       system
+
+    char* position = (char*) out;
+    size_t remaining = size_t(n) * sizeof(unsigned int);
+
+    // getrandom() may return fewer bytes than asked for, so keep
+    // asking until the buffer is full
+    while (remaining > 0) {
+        ssize_t got = getrandom(position, remaining, 0);
+        if (got > 0) {
+            position += got;
+            remaining -= size_t(got);
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+string cpu_name() {
+
+    // PRE:  none
+    //
+    // POST: the processor's model name has been returned, or "unknown"
+    //       if it could not be found
+
+    ifstream in("/proc/cpuinfo");
+    string line;
+
+    while (getline(in, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            return line.substr(line.find(':') + 2);
+        }
+    }
+
+    return "unknown";
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double measure(const Engine& engine) {
+
+    // PRE:  none
+    //
+    // POST: the number of random numbers per second that engine made
+    //       while filling buffers for about MEASURE_TIME seconds has
+    //       been returned
+
+    vector<unsigned int> buffer(BUFFER_SIZE);
+    volatile unsigned int sink = 0;     // stops the compiler from
+                                        // skipping unused work
+    long long made = 0;
+    double start;
+    double elapsed;
+
+    engine.seed(12345);
+
+    // one warm-up call, so the first measured call isn't slowed down
+    // by loading code and data
+    engine.fill(&buffer[0], BUFFER_SIZE);
+
+    start = now();
+    do {
+        engine.fill(&buffer[0], BUFFER_SIZE);
+        sink = sink + buffer[BUFFER_SIZE - 1];
+        made += BUFFER_SIZE;
+        elapsed = now() - start;
+    } while (elapsed < MEASURE_TIME);
+
+    return double(made) / elapsed;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+const Engine* auto_engine(Tier tier, bool& from_cache) {
+
+    // PRE:  none
+    //
+    // POST: the fastest kernel of at least the given tier on this
+    //       processor has been returned; from_cache says whether the
+    //       choice was read from CACHE_FILE
+
+    string cpu = cpu_name();
+    string line;
+    const Engine* best = 0;
+    double best_speed = 0;
+
+    // the cache holds one line per tier:  processor <TAB> tier <TAB> name
+    ifstream in(CACHE_FILE);
+    while (getline(in, line)) {
+
+        size_t first = line.find('\t');
+        size_t second = line.find('\t', first + 1);
+
+        if (first == string::npos || second == string::npos) {
+            continue;
+        }
+        if (line.substr(0, first) != cpu
+                || atoi(line.substr(first + 1, second - first - 1).c_str())
+                   != int(tier)) {
+            continue;
+        }
+
+        for (int e = 0; e < ENGINE_COUNT; e++) {
+            if (line.substr(second + 1) == ENGINES[e].name
+                    && ENGINES[e].tier >= tier) {
+                from_cache = true;
+                return &ENGINES[e];
+            }
+        }
+    }
+    in.close();
+
+    // nothing usable in the cache, so measure every kernel that is
+    // good enough
+    for (int e = 0; e < ENGINE_COUNT; e++) {
+        if (ENGINES[e].tier >= tier) {
+            double speed = measure(ENGINES[e]);
+            if (speed > best_speed) {
+                best_speed = speed;
+                best = &ENGINES[e];
+            }
+        }
+    }
+
+    // add the choice to the cache for next time
+    ofstream out(CACHE_FILE, ios::app);
+    out << cpu << '\t' << int(tier) << '\t' << best->name << '\n';
+
+    from_cache = false;
+    return best;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int rand_range_auto(const Engine& engine, int low, int high) {
+
+    // PRE:  low and high are valid integers with low <= high, and
+    //       engine has been seeded
+    //
+    // POST: a random number between low and high (inclusive) has
+    //       been returned
+
+    // numbers are made a whole buffer at a time, and handed out one
+    // by one; the buffer starts over when a different kernel is used
+    static unsigned int buffer[BUFFER_SIZE];
+    static int position = BUFFER_SIZE;
+    static const Engine* filled_by = 0;
+
+    if (position == BUFFER_SIZE || filled_by != &engine) {
+        engine.fill(buffer, BUFFER_SIZE);
+        position = 0;
+        filled_by = &engine;
+    }
+
+    // multiply the 32-bit number by the range and keep the top 32
+    // bits; like the mod operator, this very slightly favors some
+    // values over others
+    return int(((unsigned long long) buffer[position++]
+                * (unsigned long long) (high - low + 1)) >> 32) + low;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
@@ -0,0 +1,785 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+fill a whole array with random numbers that each have their own range,
+quickly and without bias, and how to use it to shuffle, in C++.
+
+
+--------------------------
+Different Ranges per Item
+--------------------------
+
+rand_range(low, high) gives one random number in one range. But many
+programs need a whole list of random numbers, each with its own range.
+The best known example is shuffling a list of n items (the
+"Fisher-Yates shuffle"):
+
+        for i = n - 1 down to 1:
+            j = rand_range(0, i)
+            swap item i and item j
+
+Here the ranges are i + 1 = n, n - 1, n - 2, ..., 2. Building random
+trees, and many sampling methods, are similar.
+
+Calling a function once per number, with a division inside each call,
+is slow. Instead we write one function that fills a whole array:
+
+        fill_bounded(bounds, out, n)
+
+puts a random number from 0 to bounds[i] - 1 in out[i], for every i.
+
+
+---------------------------
+Multiply, Don't Divide
+---------------------------
+
+rand() % bound is biased (some numbers come up more often) and needs a
+slow division. Lemire's method is both faster and fair:
+
+    1. Take a random 32-bit number r.
+    2. Multiply: m = r * bound, a 64-bit number.
+    3. The top 32 bits of m are the answer: a number from 0 to
+       bound - 1.
+
+This is very nearly fair. To make it exactly fair, a few values of r
+must be thrown away, and they are exactly the ones where the bottom 32
+bits of m are below (2^32 mod bound). Since that remainder is less
+than bound, we only need to work it out -- with a division -- when
+the bottom 32 bits are below bound, which is rare.
+
+
+-----------------------------
+Many Items at Once
+-----------------------------
+
+Instead of one generator, we run 16 copies side by side ("lanes"), and
+handle the items a block of 256 at a time. Stepping all 16 generators,
+and the multiply for each item, is the same arithmetic on every lane,
+so the compiler can use vector instructions that do many lanes with a
+single instruction. The rare "maybe throw it away" items are just
+noted in that loop, and handled one at a time afterwards.
+
+The vector instructions can only multiply two 32-bit numbers into a
+64-bit one, so the bounds and the random numbers are copied into
+arrays of 32-bit numbers first (if they were 64-bit, the compiler
+would have to build a 64 x 64-bit multiply out of three smaller ones):
+
+    - Bounds below 2^20: each 64-bit random number is split into two
+      32-bit ones, and one 32 x 32 = 64-bit multiply is used per item.
+    - Bounds below 2^32: a 64-bit random number times the bound, built
+      from two 32 x 32 = 64-bit multiplies.
+    - Bigger bounds need a 64 x 64 = 128-bit multiply, which vector
+      instructions cannot do, so those items go one at a time.
+
+(Why 16 lanes and not 8? With 8, g++ -O3 unrolls the loop over the
+lanes completely before it tries to vectorize it, and then fails to;
+a loop over 16 lanes is too big to unroll, so it stays a loop and is
+vectorized.)
+
+Vector instructions wide enough to pay off are only used when the
+compiler is allowed to, e.g.:
+
+        g++ -O2 -march=native bounded_fill.cpp
+
+This is fill_bounded_lanes(). Measured against the plain loop that
+calls bounded() once per item (10 million bounds, best of several
+runs, on one Xeon core with AVX-512):
+
+                                bounds below 2^31   bounds below 1000
+                                plain     lanes     plain     lanes
+        -O2                     0.013 s   0.028 s   0.016 s   0.020 s
+        -O2 -march=native       0.013 s   0.011 s   0.012 s   0.007 s
+        -O3 -march=native       0.012 s   0.008 s   0.012 s   0.007 s
+
+Without wide vector instructions, a single xoshiro step and multiply
+per item is so little work that copying the bounds and redrawing the
+suspect items costs more than the 2-lane vectors of plain x86-64 save.
+So fill_bounded() itself is the plain loop, and fill_bounded_lanes()
+is the one to use when compiling for AVX-512.
+
+
+-------------------------------
+Shuffling: Several per Number
+-------------------------------
+
+A shuffle's bounds count down: n, n - 1, n - 2, ... When the bounds
+are small, one 64-bit random number holds enough randomness for two,
+three or four of them. Brackett-Rozinsky and Lemire showed how to get
+them all fairly:
+
+    1. Multiply the random number by the first bound: the top 64 bits
+       are the first answer; keep the bottom 64 bits.
+    2. Multiply the bottom 64 bits by the next bound, and so on.
+    3. At the end, throw the whole batch away only if the last bottom
+       part is below (2^64 mod (the product of the bounds)).
+
+So a shuffle of a million items needs about half a million random
+numbers instead of a million. Each multiply in a batch has to wait for
+the one before, so this pays off when random numbers are slow to make;
+with a generator as quick as xoshiro, most of the gain in a big
+shuffle comes from making a block of choices first and then doing the
+swaps, so the memory reads of many swaps can overlap.
+
+That gain only exists while the items do not fit in the processor's
+cache. Once they do, the swaps are quick anyway and the waiting
+between multiplies makes the batches about a quarter slower than one
+bounded() call per item (measured on arrays of 1000 up to a million
+items). So shuffle_fast() uses batches only while more than about a
+million items (4 MB) are left to shuffle, and finishes with one call
+per item.
+
+
+----------------
+Review Questions
+----------------
+
+1. What are the bounds used by the Fisher-Yates shuffle?
+
+2. Why is rand() % bound biased?
+
+3. In Lemire's method, when do we need a division?
+
+4. Why can the compiler use vector instructions in
+   fill_bounded_lanes()?
+
+5. How many bounds of about 1000 can share one 64-bit random number?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the vector type
+
+#include <vector>
+
+
+// constants used to control how many generators run side by side, how
+// many items are handled in each block, and below which bound 32-bit
+// random numbers are enough
+
+const int LANES = 16;
+const int BLOCK = 256;
+const unsigned long long SMALL_BOUND = 1ULL << 20;
+
+
+// constant used to control how many items must be left for a shuffle
+// to use fill_descending(); fewer fit in the cache, where one call per
+// item is quicker
+
+const long long SHUFFLE_CUTOFF = 1LL << 20;
+
+
+// LANES xoshiro256+ generators side by side, state[word][lane], and
+// one more for numbers needed one at a time
+
+struct Rng {
+    unsigned long long state[4][LANES];
+    unsigned long long single[4];
+};
+
+
+// prototypes for functions to seed the generators and get one random
+// number
+
+void seed_rng(Rng& rng, unsigned long long seed);
+unsigned long long next_random(Rng& rng);
+
+
+// prototype for a function to step every lane at once
+
+inline void step_lanes(unsigned long long (*s)[LANES], unsigned long long* r);
+
+
+// prototype for a function to give one bounded number at a time, for
+// comparison and for redrawing thrown-away items
+
+unsigned long long bounded(Rng& rng, unsigned long long bound);
+
+
+// prototypes for functions to fill out[i] with a random number from 0
+// to bounds[i] - 1: one at a time, and with the lanes side by side
+
+void fill_bounded(Rng& rng, const unsigned long long* bounds,
+                  unsigned long long* out, long long n);
+void fill_bounded_lanes(Rng& rng, const unsigned long long* bounds,
+                        unsigned long long* out, long long n);
+
+
+// prototype for a function to fill out[i] with a random number from 0
+// to first - i - 1, several at a time
+
+void fill_descending(Rng& rng, unsigned long long first,
+                     unsigned long long* out, long long n);
+
+
+// prototypes for functions to shuffle an array, one at a time and with
+// fill_descending()
+
+void shuffle_simple(Rng& rng, int* items, long long n);
+void shuffle_fast(Rng& rng, int* items, long long n);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    Rng rng;                            // used to hold the generators
+    vector<unsigned long long> bounds;  // used to hold the bounds
+    vector<unsigned long long> out;     // used to hold the results
+    vector<int> items;                  // used to hold items to shuffle
+    unsigned long long seed;            // used to hold the main seed
+    unsigned long long sum = 0;         // used to hold a total of results
+    double start;                       // used to hold the starting time
+    const long long COUNT = 10000000;
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = ((unsigned long long) rand() << 31) | rand();
+    seed_rng(rng, seed);
+
+    // check fairness on each kind of bound: small ones, one below 2^32
+    // (results grouped in thirds), and one above (grouped in halves)
+    unsigned long long small[3] = { 3, 5, 6 };
+    unsigned long long big[2] = { 3ULL << 30, (1ULL << 40) + 1 };
+    long long counts[6] = { 0 };
+
+    bounds.resize(1200000);
+    out.resize(bounds.size());
+
+    cout << endl << "Shares of each result (each should be equal):" << endl;
+    for (int b = 0; b < 5; b++) {
+
+        unsigned long long bound = (b < 3) ? small[b] : big[b - 3];
+        unsigned long long groups = (b < 3) ? bound : (b == 3) ? 3 : 2;
+
+        for (size_t i = 0; i < bounds.size(); i++) {
+            bounds[i] = bound;
+        }
+        fill_bounded_lanes(rng, &bounds[0], &out[0], (long long) bounds.size());
+
+        for (unsigned long long v = 0; v < groups; v++) {
+            counts[v] = 0;
+        }
+        for (size_t i = 0; i < bounds.size(); i++) {
+            counts[(unsigned __int128) out[i] * groups / bound]++;
+        }
+
+        cout << "    bound " << bound << ":";
+        for (unsigned long long v = 0; v < groups; v++) {
+            cout << " " << counts[v] / double(bounds.size());
+        }
+        cout << endl;
+    }
+
+    // check the shuffle: each order of 3 items should be equally likely
+    // (a shuffle this small does not use fill_descending(), so its
+    // batches are checked by doing the swaps here)
+    long long orders[27] = { 0 };
+    int three[3];
+    unsigned long long picks[2];
+    for (int s = 0; s < 600000; s++) {
+        three[0] = 0;
+        three[1] = 1;
+        three[2] = 2;
+        fill_descending(rng, 3, picks, 2);
+        for (int j = 0; j < 2; j++) {
+            int temp = three[2 - j];
+            three[2 - j] = three[picks[j]];
+            three[picks[j]] = temp;
+        }
+        orders[three[0] * 9 + three[1] * 3 + three[2]]++;
+    }
+    cout << endl << "Shares of the 6 orders of 3 shuffled items:";
+    for (int o = 0; o < 27; o++) {
+        if (orders[o] > 0) {
+            cout << " " << orders[o] / 600000.0;
+        }
+    }
+    cout << endl;
+
+    // speed: bounds below 2^31, and below 1000, using a small array
+    // many times so the memory speed does not hide the arithmetic
+    const long long SMALL_COUNT = 4096;
+    bounds.resize(SMALL_COUNT);
+    out.resize(COUNT);
+
+    for (int size = 0; size < 2; size++) {
+
+        unsigned long long limit = (size == 0) ? (1ULL << 31) : 1000;
+
+        for (long long i = 0; i < SMALL_COUNT; i++) {
+            bounds[i] = 1 + (next_random(rng) >> 33) % limit;
+        }
+
+        cout << endl << COUNT << " numbers with different bounds below "
+             << (size == 0 ? "2^31" : "1000") << ":" << endl;
+
+        start = now();
+        for (long long k = 0; k < COUNT; k += SMALL_COUNT) {
+            for (long long i = 0; i < SMALL_COUNT; i++) {
+                out[i] = rand() % bounds[i];
+            }
+        }
+        cout << "    rand() % bound:       " << now() - start << " seconds" << endl;
+
+        start = now();
+        for (long long k = 0; k < COUNT; k += SMALL_COUNT) {
+            fill_bounded(rng, &bounds[0], &out[0], SMALL_COUNT);
+            sum += out[0];
+        }
+        cout << "    fill_bounded():       " << now() - start << " seconds" << endl;
+
+        start = now();
+        for (long long k = 0; k < COUNT; k += SMALL_COUNT) {
+            fill_bounded_lanes(rng, &bounds[0], &out[0], SMALL_COUNT);
+            sum += out[0];
+        }
+        cout << "    fill_bounded_lanes(): " << now() - start << " seconds" << endl;
+    }
+
+    // speed: shuffling
+    items.resize(COUNT);
+    for (long long i = 0; i < COUNT; i++) {
+        items[i] = int(i);
+    }
+
+    cout << endl << "Shuffling " << COUNT << " items:" << endl;
+
+    start = now();
+    shuffle_simple(rng, &items[0], COUNT);
+    cout << "    one call per item:    " << now() - start << " seconds" << endl;
+
+    start = now();
+    shuffle_fast(rng, &items[0], COUNT);
+    cout << "    fill_descending():    " << now() - start << " seconds" << endl;
+
+    // shuffling small arrays, where several bounds share a number
+    const int SMALL = 1000;
+    start = now();
+    for (long long s = 0; s < COUNT / SMALL; s++) {
+        shuffle_simple(rng, &items[s * SMALL], SMALL);
+    }
+    cout << "    " << COUNT / SMALL << " arrays of " << SMALL
+         << ", one call per item: " << now() - start << " seconds" << endl;
+
+    start = now();
+    for (long long s = 0; s < COUNT / SMALL; s++) {
+        shuffle_fast(rng, &items[s * SMALL], SMALL);
+    }
+    cout << "    " << COUNT / SMALL << " arrays of " << SMALL
+         << ", fill_descending(): " << now() - start << " seconds" << endl;
+
+    cout << "(check: " << sum + items[0] << ")" << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void seed_rng(Rng& rng, unsigned long long seed) {
+
+    // PRE:  none
+    //
+    // POST: the generators have been seeded from seed with
+    //       SplitMix64, each differently
+
+    for (int w = 0; w < 4; w++) {
+        for (int lane = 0; lane <= LANES; lane++) {
+            unsigned long long z = (seed += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            if (lane < LANES) {
+                rng.state[w][lane] = z ^ (z >> 31);
+            } else {
+                rng.single[w] = z ^ (z >> 31);
+            }
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long next_random(Rng& rng) {
+
+    // PRE:  none
+    //
+    // POST: one random 64-bit number has been returned, from the single
+    //       generator
+
+    unsigned long long* s = rng.single;
+    unsigned long long result = s[0] + s[3];
+    unsigned long long t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+
+    return result;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+inline void step_lanes(unsigned long long (*s)[LANES], unsigned long long* r) {
+
+    // PRE:  s holds generator states, and r has room for LANES numbers
+    //
+    // POST: r holds one random 64-bit number from every lane, and every
+    //       lane has moved on; the same steps on every lane, which the
+    //       compiler can do with vector instructions
+
+    for (int lane = 0; lane < LANES; lane++) {
+
+        unsigned long long t = s[1][lane] << 17;
+
+        r[lane] = s[0][lane] + s[3][lane];
+        s[2][lane] ^= s[0][lane];
+        s[3][lane] ^= s[1][lane];
+        s[1][lane] ^= s[2][lane];
+        s[0][lane] ^= s[3][lane];
+        s[2][lane] ^= t;
+        s[3][lane] = (s[3][lane] << 45) | (s[3][lane] >> 19);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long bounded(Rng& rng, unsigned long long bound) {
+
+    // PRE:  bound >= 1
+    //
+    // POST: a random number from 0 to bound - 1 has been returned, each
+    //       exactly equally likely (Lemire's method)
+
+    unsigned __int128 product = (unsigned __int128) next_random(rng) * bound;
+    unsigned long long low = (unsigned long long) product;
+
+    if (low < bound) {
+        unsigned long long threshold = (0 - bound) % bound;
+        while (low < threshold) {
+            product = (unsigned __int128) next_random(rng) * bound;
+            low = (unsigned long long) product;
+        }
+    }
+
+    return (unsigned long long) (product >> 64);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void fill_bounded(Rng& rng, const unsigned long long* bounds,
+                  unsigned long long* out, long long n) {
+
+    // PRE:  every bounds[i] >= 1, and out has room for n numbers
+    //
+    // POST: out[i] holds a random number from 0 to bounds[i] - 1, each
+    //       exactly equally likely, for every i
+
+    for (long long i = 0; i < n; i++) {
+        out[i] = bounded(rng, bounds[i]);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void fill_bounded_lanes(Rng& rng, const unsigned long long* bounds,
+                        unsigned long long* out, long long n) {
+
+    // PRE:  every bounds[i] >= 1, and out has room for n numbers
+    //
+    // POST: out[i] holds a random number from 0 to bounds[i] - 1, each
+    //       exactly equally likely, for every i, using the lanes
+
+    unsigned long long s[4][LANES];
+    unsigned int b[BLOCK];              // the block's bounds, 32 bits
+    unsigned int half[BLOCK];           // 32-bit random numbers
+    unsigned long long r[BLOCK];        // 64-bit random numbers
+    unsigned long long low[BLOCK];      // the part that decides a redraw
+    unsigned long long o[BLOCK];        // the block's results
+    long long start;
+
+    // work on a local copy of the generators, so the compiler knows
+    // nothing else can change them and can keep them in registers
+    for (int w = 0; w < 4; w++) {
+        for (int lane = 0; lane < LANES; lane++) {
+            s[w][lane] = rng.state[w][lane];
+        }
+    }
+
+    // whole blocks, where every loop has the same fixed length, and
+    // does the same arithmetic on every item, which the compiler can do
+    // with vector instructions
+    for (start = 0; start + BLOCK <= n; start += BLOCK) {
+
+        unsigned long long wide = 0;
+        int suspect = 0;
+
+        for (int i = 0; i < BLOCK; i++) {
+            wide |= bounds[start + i];
+        }
+
+        // big bounds: 64 x 64 = 128-bit products, which vector
+        // instructions cannot do, so one item at a time
+        if ((wide >> 32) != 0) {
+            for (int i = 0; i < BLOCK; i++) {
+                out[start + i] = bounded(rng, bounds[start + i]);
+            }
+            continue;
+        }
+
+        // 32-bit copies of the bounds, so every product below is a
+        // 32 x 32 = 64-bit multiply
+        for (int i = 0; i < BLOCK; i++) {
+            b[i] = (unsigned int) bounds[start + i];
+        }
+
+        if (wide < SMALL_BOUND) {
+
+            // small bounds: each random number gives two 32-bit ones
+            for (int k = 0; k < BLOCK / 2; k += LANES) {
+                step_lanes(s, &r[k]);
+            }
+            for (int k = 0; k < BLOCK / 2; k++) {
+                half[k] = (unsigned int) r[k];
+                half[k + BLOCK / 2] = (unsigned int) (r[k] >> 32);
+            }
+            for (int i = 0; i < BLOCK; i++) {
+                unsigned long long product = (unsigned long long) half[i] * b[i];
+                o[i] = product >> 32;
+                low[i] = product & 0xFFFFFFFFULL;
+                suspect |= (low[i] < b[i]);
+            }
+
+            // the rare items that might need throwing away: redraw them
+            // one at a time, with 32 random bits again
+            for (int i = 0; suspect && i < BLOCK; i++) {
+                if (low[i] < b[i]) {
+                    unsigned long long threshold = (0x100000000ULL - b[i]) % b[i];
+                    while (low[i] < threshold) {
+                        unsigned long long product = (next_random(rng) >> 32) * b[i];
+                        o[i] = product >> 32;
+                        low[i] = product & 0xFFFFFFFFULL;
+                    }
+                }
+            }
+
+        } else {
+
+            // 32-bit bounds: the 96-bit product of a 64-bit random
+            // number and the bound, built from two 32 x 32 = 64-bit
+            // products of its halves
+            for (int k = 0; k < BLOCK; k += LANES) {
+                step_lanes(s, &r[k]);
+            }
+            for (int i = 0; i < BLOCK; i++) {
+                unsigned long long high = (unsigned long long) (unsigned int) (r[i] >> 32) * b[i];
+                unsigned long long part = (unsigned long long) (unsigned int) r[i] * b[i];
+                unsigned long long sum = high + (part >> 32);
+                o[i] = sum >> 32;
+                low[i] = (sum << 32) | (part & 0xFFFFFFFFULL);
+                suspect |= (low[i] < b[i]);
+            }
+
+            // the rare items that might need throwing away: redraw them
+            // one at a time, with 64 random bits again
+            for (int i = 0; suspect && i < BLOCK; i++) {
+                if (low[i] < b[i]) {
+                    unsigned long long bound = b[i];
+                    unsigned long long threshold = (0 - bound) % bound;
+                    while (low[i] < threshold) {
+                        unsigned __int128 product = (unsigned __int128) next_random(rng) * bound;
+                        o[i] = (unsigned long long) (product >> 64);
+                        low[i] = (unsigned long long) product;
+                    }
+                }
+            }
+        }
+
+        for (int i = 0; i < BLOCK; i++) {
+            out[start + i] = o[i];
+        }
+    }
+
+    // the last few items, one at a time
+    for (long long i = start; i < n; i++) {
+        out[i] = bounded(rng, bounds[i]);
+    }
+
+    for (int w = 0; w < 4; w++) {
+        for (int lane = 0; lane < LANES; lane++) {
+            rng.state[w][lane] = s[w][lane];
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void fill_descending(Rng& rng, unsigned long long first,
+                     unsigned long long* out, long long n) {
+
+    // PRE:  first >= n >= 0, and out has room for n numbers
+    //
+    // POST: out[i] holds a random number from 0 to first - i - 1, each
+    //       exactly equally likely, for every i
+
+    long long i = 0;
+
+    while (i < n) {
+
+        unsigned long long bound = first - i;
+        int k;
+
+        // how many bounds, counting down from bound, fit together in
+        // 64 bits (their product must be below 2^64)
+        if (bound < (1ULL << 16)) {
+            k = 4;
+        } else if (bound <= (1ULL << 21)) {
+            k = 3;
+        } else if (bound <= (1ULL << 32)) {
+            k = 2;
+        } else {
+            k = 1;
+        }
+        if (k > n - i) {
+            k = int(n - i);
+        }
+
+        unsigned long long product = bound;
+        for (int j = 1; j < k; j++) {
+            product *= bound - j;
+        }
+
+        unsigned long long r;
+        do {
+            r = next_random(rng);
+            for (int j = 0; j < k; j++) {
+                unsigned __int128 m = (unsigned __int128) r * (bound - j);
+                out[i + j] = (unsigned long long) (m >> 64);
+                r = (unsigned long long) m;
+            }
+
+            // redo the batch only if the leftover is one of the
+            // (2^64 mod product) values that would make it unfair
+        } while (r < product && r < (0 - product) % product);
+
+        i += k;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void shuffle_simple(Rng& rng, int* items, long long n) {
+
+    // PRE:  items holds n items
+    //
+    // POST: items have been put in a random order, every order equally
+    //       likely, with one bounded() call per item
+
+    // work on a local copy of the generators, so the compiler knows the
+    // swaps cannot change them and can keep them in registers
+    Rng local = rng;
+
+    for (long long i = n - 1; i > 0; i--) {
+        long long j = (long long) bounded(local, (unsigned long long) i + 1);
+        int temp = items[i];
+        items[i] = items[j];
+        items[j] = temp;
+    }
+
+    rng = local;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void shuffle_fast(Rng& rng, int* items, long long n) {
+
+    // PRE:  items holds n items
+    //
+    // POST: items have been put in a random order, every order equally
+    //       likely, using fill_descending() a block at a time while the
+    //       items left do not fit in the cache, and one bounded() call
+    //       per item after that
+
+    unsigned long long picks[BLOCK];
+    long long i = n - 1;
+
+    while (i >= SHUFFLE_CUTOFF) {
+
+        long long count = (i < BLOCK) ? i : BLOCK;
+
+        // bounds i + 1, i, ..., i + 2 - count
+        fill_descending(rng, (unsigned long long) i + 1, picks, count);
+
+        for (long long j = 0; j < count; j++, i--) {
+            long long k = (long long) picks[j];
+            int temp = items[i];
+            items[i] = items[k];
+            items[k] = temp;
+        }
+    }
+
+    shuffle_simple(rng, items, i + 1);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
@@ -0,0 +1,850 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+choose one of a billion categories at random, each with its own
+chance, using a table small enough to fit in memory.
+
+
+----------------------
+The Alias Method
+----------------------
+
+Suppose we have n categories, and category i should be chosen with
+chance p[i]. Scanning a running total (as in k-means++) takes time
+proportional to n for every choice, which is far too slow for a
+billion categories.
+
+The alias method, invented by A. J. Walker in 1974, makes every
+choice take the same small amount of time. It builds a table with n
+"buckets". Each bucket i holds two things:
+
+    - a threshold, prob[i], between 0 and 1
+    - another category, alias[i]
+
+To choose a category:
+
+    1. Pick a bucket i with rand_range(0, n - 1).
+    2. Pick a random number u between 0 and 1.
+    3. If u < prob[i], choose category i; otherwise choose alias[i].
+
+Building the table (Vose's version): multiply every p[i] by n, so
+that the average is 1. Categories below 1 are "small", those above 1
+are "large". Repeatedly take one small category s and one large
+category l; bucket s gets prob[s] = (s's value) and alias[s] = l, and
+l gives away the rest of the bucket, so l's value drops by
+(1 - s's value). If l drops below 1, it becomes small.
+
+
+------------
+Two Levels
+------------
+
+Vose's method keeps lists of the small and large categories that are
+still waiting to be paired. If the weights arrive in a bad order --
+sorted from smallest to largest, say -- every small category waits
+until the large ones finally turn up, and the list grows to hold
+nearly all n categories. For a billion categories, that is 16
+gigabytes of waiting list.
+
+So we use two levels. The categories are split into groups of 65536
+neighbours:
+
+    1. A small alias table over the groups, where each group's weight
+       is the sum of its categories' weights, chooses a group.
+    2. Each group has its own alias table over just its 65536
+       categories, which chooses a category inside the group.
+
+Each group's table is built from that group's weights alone, so the
+waiting lists never hold more than 65536 categories, whatever order
+the weights come in. A billion categories make only 15,259 groups,
+so the top table is tiny.
+
+
+--------------------
+Making the Table Small
+--------------------
+
+A plain alias table stores prob[i] as an 8-byte double and alias[i]
+as an 8-byte number: 16 bytes per category, or 16 gigabytes for a
+billion categories. We can do much better:
+
+    - prob[i] does not need 53 bits of precision. We round it to a
+      16-bit whole number q[i] between 0 and 65535, meaning
+      q[i] / 65536. (The step of comparing u < prob[i] then becomes
+      comparing a 16-bit random number with q[i].)
+
+    - alias[i] is a category in the same group, so it only needs as
+      many bits as the group has categories -- 16 bits, not 64, even
+      for a billion categories. (With fewer than 65536 categories,
+      even fewer bits do.) We "pack" the bits of all entries one after
+      another, with no wasted bits in between.
+
+Each bucket now takes 16 + 16 = 32 bits, 4 bytes, instead of 16
+bytes.
+
+
+-----------------------
+How Much Did We Lose?
+-----------------------
+
+Rounding prob[i] changes the chances a little. Because we know exactly
+how every bucket was rounded, we can work out the exact chance that
+each category is now chosen, compare it with the chance we wanted,
+and report the biggest difference. Rounding to the nearest 1/65536
+moves each bucket's share of its group by at most 1 / (2 * 65536 *
+the group's size). (The top table's thresholds are rounded to 1/2^32,
+which matters far less.) We do this one group at a time too, so we
+never need a list of all n chances.
+
+
+-----------------------------
+Reading the Weights in Pieces
+-----------------------------
+
+A billion weights are 8 gigabytes, so we don't read them all into
+memory at once. The weights are stored in a file as doubles, and we
+read it three times, one group's weights (a "chunk") at a time:
+
+    1. The first read adds up the weights of each group.
+    2. The second read builds each group's alias table.
+    3. The third read compares the chances in the finished table with
+       the weights, to measure how much the rounding cost.
+
+The first two reads are shared among several threads. For the second,
+each thread opens the file for itself and builds a run of neighbouring
+groups. Since a group has 65536 buckets, a multiple of 8, every group
+starts on a whole byte of the packed table, and as long as writing a
+bucket only touches the bytes that hold it, two threads never write
+the same byte.
+
+
+----------------
+Review Questions
+----------------
+
+1. Why is scanning a running total too slow for a billion categories?
+
+2. What two things does each bucket of an alias table hold?
+
+3. What are the three steps of choosing a category?
+
+4. In Vose's method, what makes a category "small" or "large"?
+
+5. How many bits does a packed alias need for 1,000 categories?
+For a billion?
+
+6. Why can we report the exact change in each category's chance?
+
+7. Why is the weights file read three times?
+
+8. What order of weights makes Vose's waiting lists long, and how do
+the two levels keep them short?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() function
+
+#include <ctime>
+
+
+// access the memcpy() function
+
+#include <cstring>
+
+
+// access the fabs() and floor() functions
+
+#include <cmath>
+
+
+// access the FILE type and the fopen(), fread() and fwrite() functions
+
+#include <cstdio>
+
+
+// access the vector and thread types
+
+#include <vector>
+#include <thread>
+
+
+// constant used to control how many categories the sample has
+
+const long long CATEGORIES = 1000000;
+
+
+// constant used to control how many categories are in a group, which
+// is also how many weights are read from the file at once
+
+const int GROUP_SIZE = 1 << 16;
+
+
+// constant used to control how many sample categories are chosen
+
+const long long REPETITIONS = 10000000;
+
+
+// constant used to name the sample weights file
+
+const char* const WEIGHTS_FILE = "compact_alias_weights.bin";
+
+
+// a two-level compact alias table: group j is kept with chance
+// group_threshold[j] / 2^32, or else group_alias[j] is used (always
+// kept if the alias is j itself); then bucket i, counting from 0 over
+// all the groups, holds q | (alias << 16) in entry_bits bits, starting
+// at bit i * entry_bits of packed, where alias is a category within
+// the same group
+
+struct CompactAlias {
+    long long n;
+    long long groups;
+    vector<unsigned int> group_threshold;
+    vector<unsigned int> group_alias;
+    int alias_bits;
+    int entry_bits;
+    vector<unsigned char> packed;
+    double max_error;
+    double total_variation;
+};
+
+
+// prototypes for functions to write and read a bucket of the table
+
+void put_entry(CompactAlias& table, long long i, unsigned long long value);
+unsigned long long get_entry(const CompactAlias& table, long long i);
+
+
+// prototype for a function to add up the weights of each group in a
+// file, on several threads
+
+double sum_weights(const char* file_name, long long n, int threads,
+                   vector<double>& group_totals);
+
+
+// prototype for a function to build a compact alias table from a file
+// of n weights, on several threads
+
+bool build_compact_alias(const char* file_name, long long n, int threads,
+                         CompactAlias& table);
+
+
+// prototypes for functions to build the table over the groups, and the
+// table inside one group
+
+void build_group_table(CompactAlias& table, const vector<double>& group_totals,
+                       double total);
+void build_group(CompactAlias& table, long long group, const double* weights,
+                 int count, double group_total);
+
+
+// prototype for a function to work out the chance of each group under
+// the rounded top table
+
+void group_chances(const CompactAlias& table, vector<double>& chance);
+
+
+// prototype for a function to work out the exact chance of every
+// category under the rounded table, and compare it with the weights,
+// returning false if the file could not be read
+
+bool measure_error(const char* file_name, double total, CompactAlias& table);
+
+
+// prototype for a function to make a random 64-bit number
+
+unsigned long long next64(unsigned long long& state);
+
+
+// prototype for a function to choose a category
+
+long long sample(const CompactAlias& table, unsigned long long& state);
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    CompactAlias table;         // used to hold the table
+    FILE* file;                 // used to write the sample weights
+    unsigned long long state;   // used to hold the generator state
+    int threads;                // used to hold how many threads to use
+    vector<long long> counts(5, 0);     // used to count the top five
+    double harmonic = 0;        // used to hold the sum of the weights
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    state = ((unsigned long long) rand() << 31) | rand();
+
+    threads = int(thread::hardware_concurrency());
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    // write a sample weights file, where category i has weight
+    // 1 / (i + 1) (a "Zipf" distribution)
+    file = fopen(WEIGHTS_FILE, "wb");
+    if (file == 0) {
+        cout << "Unable to create " << WEIGHTS_FILE << endl;
+        return 1;
+    }
+    for (long long i = 0; i < CATEGORIES; i++) {
+        double w = 1.0 / double(i + 1);
+        harmonic += w;
+        fwrite(&w, sizeof(w), 1, file);
+    }
+    fclose(file);
+
+    if (!build_compact_alias(WEIGHTS_FILE, CATEGORIES, threads, table)) {
+        cout << "Unable to read " << WEIGHTS_FILE << endl;
+        return 1;
+    }
+
+    cout << endl
+         << "Compact alias table for " << CATEGORIES << " categories" << endl
+         << "    groups:            " << table.groups << endl
+         << "    bits per bucket:   " << table.entry_bits
+         << " (16 for the threshold, " << table.alias_bits
+         << " for the alias)" << endl
+         << "    table size:        " << table.packed.size()
+            + table.groups * 8 << " bytes" << endl
+         << "    plain table size:  " << CATEGORIES * 16 << " bytes" << endl
+         << "    largest error in any category's chance: "
+         << table.max_error << endl
+         << "    total variation distance:              "
+         << table.total_variation << endl;
+
+    // choose many categories, and count how often the first five came up
+    for (long long r = 0; r < REPETITIONS; r++) {
+        long long c = sample(table, state);
+        if (c < 5) {
+            counts[c]++;
+        }
+    }
+
+    cout << endl
+         << "Chance of the first five categories, wanted and seen:" << endl;
+    for (int c = 0; c < 5; c++) {
+        cout << "    " << c << ": " << 1.0 / (c + 1) / harmonic << "  "
+             << double(counts[c]) / REPETITIONS << endl;
+    }
+
+    remove(WEIGHTS_FILE);
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void put_entry(CompactAlias& table, long long i, unsigned long long value) {
+
+    // PRE:  0 <= i < table.n, and value fits in table.entry_bits bits
+    //
+    // POST: bucket i holds value, and no byte outside it has been
+    //       written
+
+    unsigned long long bit = (unsigned long long) i * table.entry_bits;
+    unsigned long long word = 0;
+    unsigned long long mask = ((1ULL << table.entry_bits) - 1) << (bit & 7);
+    size_t bytes = ((bit & 7) + table.entry_bits + 7) / 8;
+
+    // read the bytes holding the entry, change its bits, and write
+    // them back; entries are at most 32 bits, so with the shift they
+    // always fit in 5 bytes, and the neighbouring bytes (which may
+    // belong to another thread's group) are left alone
+    memcpy(&word, &table.packed[bit >> 3], bytes);
+    word = (word & ~mask) | (value << (bit & 7));
+    memcpy(&table.packed[bit >> 3], &word, bytes);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long get_entry(const CompactAlias& table, long long i) {
+
+    // PRE:  0 <= i < table.n
+    //
+    // POST: the value of bucket i has been returned
+
+    unsigned long long bit = (unsigned long long) i * table.entry_bits;
+    unsigned long long word;
+
+    memcpy(&word, &table.packed[bit >> 3], sizeof(word));
+
+    return (word >> (bit & 7)) & ((1ULL << table.entry_bits) - 1);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double sum_weights(const char* file_name, long long n, int threads,
+                   vector<double>& group_totals) {
+
+    // PRE:  file_name holds at least n doubles, and threads >= 1
+    //
+    // POST: group_totals[j] holds the sum of the weights in group j,
+    //       and the sum of the first n weights has been returned, or -1
+    //       if the file could not be read
+
+    long long groups = (n + GROUP_SIZE - 1) / GROUP_SIZE;
+    vector<char> ok(threads, 1);
+    vector<thread> workers;
+    double total = 0;
+
+    group_totals.assign(groups, 0.0);
+
+    // each thread opens the file for itself and adds up its own share
+    // of the groups
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&, t]() {
+
+            FILE* file = fopen(file_name, "rb");
+            vector<double> chunk(GROUP_SIZE);
+
+            if (file == 0) {
+                ok[t] = 0;
+                return;
+            }
+
+            for (long long g = t; g < groups; g += threads) {
+
+                long long start = g * GROUP_SIZE;
+                long long count = (n - start < GROUP_SIZE) ? n - start : GROUP_SIZE;
+
+                fseek(file, long(start * sizeof(double)), SEEK_SET);
+                if ((long long) fread(&chunk[0], sizeof(double), count, file) != count) {
+                    ok[t] = 0;
+                    break;
+                }
+                for (long long i = 0; i < count; i++) {
+                    group_totals[g] += chunk[i];
+                }
+            }
+
+            fclose(file);
+        }));
+    }
+
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+    for (int t = 0; t < threads; t++) {
+        if (!ok[t]) {
+            return -1;
+        }
+    }
+    for (long long g = 0; g < groups; g++) {
+        total += group_totals[g];
+    }
+
+    return total;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+bool build_compact_alias(const char* file_name, long long n, int threads,
+                         CompactAlias& table) {
+
+    // PRE:  file_name holds at least n weights, each at least 0, and
+    //       not all 0; 1 <= n <= 2^32
+    //
+    // POST: table is a compact alias table for the weights, with its
+    //       errors measured, and true has been returned; or false has
+    //       been returned if the file could not be read
+
+    vector<double> group_totals;
+    vector<char> ok(threads, 1);
+    vector<thread> workers;
+    double total;
+
+    total = sum_weights(file_name, n, threads, group_totals);
+    if (total <= 0) {
+        return false;
+    }
+
+    table.n = n;
+    table.groups = (long long) group_totals.size();
+    build_group_table(table, group_totals, total);
+
+    // aliases only point inside a group, so they need as many bits as
+    // the largest group has categories
+    long long largest = (n < GROUP_SIZE) ? n : GROUP_SIZE;
+    table.alias_bits = 1;
+    while ((1LL << table.alias_bits) < largest) {
+        table.alias_bits++;
+    }
+    table.entry_bits = 16 + table.alias_bits;
+
+    // 8 extra bytes, so reading 8 bytes at the last entry is safe
+    table.packed.assign((size_t) ((n * table.entry_bits + 7) / 8 + 8), 0);
+
+    // each thread reads its own run of neighbouring groups from the
+    // file and builds their tables; every group starts on a whole byte
+    // of the packed table, so the threads never share a byte
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&, t]() {
+
+            long long begin = table.groups * t / threads;
+            long long end = table.groups * (t + 1) / threads;
+            FILE* file = fopen(file_name, "rb");
+            vector<double> chunk(GROUP_SIZE);
+
+            if (file == 0) {
+                ok[t] = 0;
+                return;
+            }
+
+            fseek(file, long(begin * GROUP_SIZE * sizeof(double)), SEEK_SET);
+
+            for (long long g = begin; g < end; g++) {
+
+                long long start = g * GROUP_SIZE;
+                long long count = (n - start < GROUP_SIZE) ? n - start : GROUP_SIZE;
+
+                if ((long long) fread(&chunk[0], sizeof(double), count, file) != count) {
+                    ok[t] = 0;
+                    break;
+                }
+
+                build_group(table, g, &chunk[0], int(count), group_totals[g]);
+            }
+
+            fclose(file);
+        }));
+    }
+
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+    for (int t = 0; t < threads; t++) {
+        if (!ok[t]) {
+            return false;
+        }
+    }
+
+    return measure_error(file_name, total, table);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void build_group_table(CompactAlias& table, const vector<double>& group_totals,
+                       double total) {
+
+    // PRE:  group_totals holds table.groups sums, adding up to total > 0
+    //
+    // POST: table.group_threshold and table.group_alias hold an alias
+    //       table choosing each group with chance (its sum / total),
+    //       with the thresholds rounded to 1/2^32
+
+    long long groups = table.groups;
+    vector<long long> small;    // used to hold small groups
+    vector<long long> large;    // used to hold large groups
+    vector<double> value(groups);
+
+    table.group_threshold.assign(groups, 0);
+    table.group_alias.resize(groups);
+
+    for (long long j = 0; j < groups; j++) {
+        table.group_alias[j] = (unsigned int) j;
+        value[j] = group_totals[j] * double(groups) / total;
+        if (value[j] < 1.0) {
+            small.push_back(j);
+        } else {
+            large.push_back(j);
+        }
+    }
+
+    while (!small.empty() && !large.empty()) {
+
+        long long s = small.back();
+        long long l = large.back();
+        double q = floor(value[s] * 4294967296.0 + 0.5);
+
+        small.pop_back();
+
+        // a threshold that rounds up to 2^32 means "always keep this
+        // group"
+        if (q < 4294967296.0) {
+            table.group_threshold[s] = (unsigned int) q;
+            table.group_alias[s] = (unsigned int) l;
+        }
+
+        value[l] -= 1.0 - value[s];
+        if (value[l] < 1.0) {
+            small.push_back(l);
+            large.pop_back();
+        }
+    }
+
+    // whatever is left over is within rounding of 1, so it keeps its
+    // whole bucket (its alias is still itself)
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void build_group(CompactAlias& table, long long group, const double* weights,
+                 int count, double group_total) {
+
+    // PRE:  weights holds the count weights of the given group, adding
+    //       up to group_total
+    //
+    // POST: the group's buckets hold an alias table choosing each of
+    //       its categories with chance (its weight / group_total)
+
+    // a category waiting to be paired, with its scaled weight
+    struct Waiting {
+        int index;
+        double value;
+    };
+
+    vector<Waiting> small;      // used to hold small categories
+    vector<Waiting> large;      // used to hold large categories
+    long long first = group * GROUP_SIZE;
+
+    // a group with no weight is never chosen, so any table will do
+    if (group_total <= 0) {
+        for (int k = 0; k < count; k++) {
+            put_entry(table, first + k, 65535ULL | ((unsigned long long) k << 16));
+        }
+        return;
+    }
+
+    small.reserve(count);
+    large.reserve(count);
+
+    for (int k = 0; k < count; k++) {
+
+        Waiting item;
+
+        item.index = k;
+        item.value = weights[k] * double(count) / group_total;
+
+        if (item.value < 1.0) {
+            small.push_back(item);
+        } else {
+            large.push_back(item);
+        }
+    }
+
+    // the lists only ever hold this group's categories
+    while (!small.empty() && !large.empty()) {
+
+        Waiting s = small.back();
+        Waiting& l = large.back();
+        long long q = (long long) (s.value * 65536.0 + 0.5);
+
+        small.pop_back();
+
+        // a threshold that rounds up to 65536 means "always choose this
+        // bucket's own category"
+        if (q >= 65536) {
+            put_entry(table, first + s.index, 65535ULL
+                      | ((unsigned long long) s.index << 16));
+        } else {
+            put_entry(table, first + s.index, (unsigned long long) q
+                      | ((unsigned long long) l.index << 16));
+        }
+
+        l.value -= 1.0 - s.value;
+        if (l.value < 1.0) {
+            small.push_back(l);
+            large.pop_back();
+        }
+    }
+
+    // whatever is left over is within rounding of 1, so it keeps its
+    // whole bucket
+    for (int i = 0; i < int(small.size()); i++) {
+        put_entry(table, first + small[i].index,
+                  65535ULL | ((unsigned long long) small[i].index << 16));
+    }
+    for (int i = 0; i < int(large.size()); i++) {
+        put_entry(table, first + large[i].index,
+                  65535ULL | ((unsigned long long) large[i].index << 16));
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void group_chances(const CompactAlias& table, vector<double>& chance) {
+
+    // PRE:  table.group_threshold and table.group_alias have been built
+    //
+    // POST: chance[j] holds the exact chance that group j is chosen
+
+    double groups = double(table.groups);
+
+    chance.assign(table.groups, 0.0);
+
+    for (long long j = 0; j < table.groups; j++) {
+
+        long long alias = table.group_alias[j];
+        double own = double(table.group_threshold[j]) / 4294967296.0;
+
+        if (alias == j) {
+            own = 1.0;
+        }
+        chance[j] += own / groups;
+        chance[alias] += (1.0 - own) / groups;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+bool measure_error(const char* file_name, double total, CompactAlias& table) {
+
+    // PRE:  table was built from the weights in file_name, which add up
+    //       to total
+    //
+    // POST: table.max_error holds the largest difference between the
+    //       wanted and actual chance of any category,
+    //       table.total_variation holds half the sum of all the
+    //       differences, and true has been returned; or false has been
+    //       returned if the file could not be read
+
+    vector<double> chance;      // used to hold the chance of each group
+    vector<double> actual(GROUP_SIZE);
+    vector<double> chunk(GROUP_SIZE);
+    FILE* file = fopen(file_name, "rb");
+
+    if (file == 0) {
+        return false;
+    }
+
+    group_chances(table, chance);
+
+    table.max_error = 0;
+    table.total_variation = 0;
+
+    // one group at a time: the own category of bucket i gets q / 65536
+    // of the bucket, or all of it when the alias is itself; the alias
+    // gets the rest
+    for (long long g = 0; g < table.groups; g++) {
+
+        long long first = g * GROUP_SIZE;
+        long long count = (table.n - first < GROUP_SIZE)
+                          ? table.n - first : GROUP_SIZE;
+        double bucket = chance[g] / double(count);
+
+        if ((long long) fread(&chunk[0], sizeof(double), count, file) != count) {
+            fclose(file);
+            return false;
+        }
+
+        actual.assign(count, 0.0);
+        for (long long k = 0; k < count; k++) {
+
+            unsigned long long entry = get_entry(table, first + k);
+            long long alias = (long long) (entry >> 16);
+            double own = double(entry & 0xFFFF) / 65536.0;
+
+            if (alias == k) {
+                own = 1.0;
+            }
+            actual[k] += own * bucket;
+            actual[alias] += (1.0 - own) * bucket;
+        }
+
+        for (long long k = 0; k < count; k++) {
+            double error = fabs(actual[k] - chunk[k] / total);
+            if (error > table.max_error) {
+                table.max_error = error;
+            }
+            table.total_variation += error / 2.0;
+        }
+    }
+
+    fclose(file);
+
+    return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long next64(unsigned long long& state) {
+
+    // PRE:  none
+    //
+    // POST: a random 64-bit number (SplitMix64) has been returned, and
+    //       state has moved on
+
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+long long sample(const CompactAlias& table, unsigned long long& state) {
+
+    // PRE:  table was built by build_compact_alias()
+    //
+    // POST: a category, chosen with (very nearly) its wanted chance,
+    //       has been returned
+
+    unsigned long long r = next64(state);
+
+    // the top 32 bits choose the group's bucket, and the low 32 bits
+    // are compared with its threshold
+    long long g = (long long) (((r >> 32) * (unsigned long long) table.groups) >> 32);
+
+    if ((r & 0xFFFFFFFF) >= table.group_threshold[g]
+            && table.group_alias[g] != g) {
+        g = table.group_alias[g];
+    }
+
+    // then the same again inside the group, with a 16-bit threshold
+    long long first = g * GROUP_SIZE;
+    unsigned long long size = (unsigned long long)
+        ((table.n - first < GROUP_SIZE) ? table.n - first : GROUP_SIZE);
+
+    r = next64(state);
+
+    long long i = (long long) (((r >> 32) * size) >> 32);
+    unsigned long long entry = get_entry(table, first + i);
+    long long alias = (long long) (entry >> 16);
+
+    if ((r & 0xFFFF) < (entry & 0xFFFF) || alias == i) {
+        return first + i;
+    }
+
+    return first + alias;
+}
@@ -0,0 +1,575 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+generate test data for storage systems that compresses and
+"deduplicates" by chosen amounts, in C++.
+
+
+-----------------------------
+Why Not Just Random Bytes?
+-----------------------------
+
+Many storage arrays compress the data written to them, and also notice
+when a block is an exact copy of one they already hold ("dedupe") and
+store it only once. Testing such an array with the output of a fast
+random number generator is misleading: random bytes never compress
+and never repeat, so the array does far more work than it would with
+real data. Testing with all zeros is just as misleading the other
+way. Instead we want data with a chosen
+
+    - compression ratio: bytes written / bytes after compression, and
+    - dedupe ratio: blocks written / different blocks.
+
+For example, a compression ratio of 2 and a dedupe ratio of 3 means
+that 6 TB written should take up about 1 TB.
+
+
+-----------------------------
+Dedupe: Unique and Shared Blocks
+-----------------------------
+
+The volume is split into BLOCK-sized blocks (4 KB, the usual unit of
+dedupe). Each block is either UNIQUE (its contents appear nowhere
+else) or a copy of one of S SHARED contents. For a dedupe ratio D, the
+N blocks must hold N / D different blocks. We let a fraction SHARED of
+those be shared contents, and the rest unique blocks, so a block is
+unique with chance
+
+        u = (1 - SHARED) / D
+
+Which kind each block is, and which shared content a copy uses, is
+decided by random numbers made from the seed and the block number.
+The M = (1 - u) * N copies each pick one of the S contents at random,
+so some contents are never picked: on average only
+
+        S * (1 - exp(-M / S))
+
+of them are used. (When copies are plentiful, that is almost all of
+S; but with SHARED = 0.9 and D = 1.1, taking S = SHARED * N / D would
+give a dedupe ratio of about 1.56.) So we choose S, by bisection, so
+that the number USED is SHARED * N / D.
+
+
+-----------------------------
+Compression: Random and Filler Pieces
+-----------------------------
+
+Each block's contents are split into 16 pieces. A fraction 1 / C of
+them is filled with random bytes, which can't be compressed; the rest
+is filled with an 8-byte pattern repeated over and over, which a
+compressor shrinks to almost nothing. So the block compresses by
+about C. (The pattern depends on the block, so the filler is not all
+zeros, which some arrays skip as "empty" blocks.) Which pieces are
+random is chosen at random too, and when 16 / C is not a whole number,
+a coin decides whether the block gets one more random piece, so the
+average comes out right.
+
+To check the ratio, we estimate how well a simple LZ77 compressor (the
+idea behind gzip, LZ4 and Zstandard) would do: every run of at least
+4 bytes seen before in the block costs 3 bytes (a "match"), and every
+other byte costs 1 byte (a "literal").
+
+
+-----------------------------
+Reproducibility and Speed
+-----------------------------
+
+Every block is made from nothing but the seed and its block number, so
+any block can be made again on its own -- for example to check data
+read back from the array -- and threads can make different blocks at
+the same time without talking to each other.
+
+The random bytes are made 8 at a time with the SplitMix64 mixing
+function of a counter. Each 8 bytes depends only on the counter, not
+on the bytes before, so the processor can make many at once. Compiled
+with -O3 -march=native on a processor with AVX-512, the compiler makes
+8 of them with each vector instruction, and one core makes about 5 GB
+per second of data like the demonstration's; plain -O2 gives about
+3.5. A few cores are enough to keep up with most storage arrays.
+
+
+----------------
+Review Questions
+----------------
+
+1. Why is the output of a random number generator a poor test of a
+   storage array that compresses and dedupes?
+
+2. What fraction of blocks must be unique for a dedupe ratio of 4, if
+   no blocks are shared?
+
+3. Why does a block with a quarter of its pieces random compress by
+   about 4?
+
+4. Why is the filler not simply zeros?
+
+5. Why does making each block from the seed and block number let many
+   threads share the work?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the expm1() function
+
+#include <cmath>
+
+
+// access the memcpy() and memcmp() functions
+
+#include <cstring>
+
+
+// access the vector, unordered_set and thread types and the sort()
+// function
+
+#include <vector>
+#include <unordered_set>
+#include <thread>
+#include <algorithm>
+
+
+// constants used to control the size of a block and of its pieces
+
+const int BLOCK = 4096;
+const int PIECES = 16;
+const int PIECE = BLOCK / PIECES;
+
+
+// constants used to control the demonstration's volume and ratios
+
+const long long VOLUME_BLOCKS = 262144;         // 1 GB
+const double DEDUPE_RATIO = 3.0;
+const double COMPRESS_RATIO = 2.0;
+const double SHARED = 0.1;
+
+
+// constant used to control how much the demonstration generates to
+// time the generator
+
+const long long TIMED_BYTES = 8LL << 30;
+
+
+// constant used to step the counter-based generator
+
+const unsigned long long GOLDEN = 0x9E3779B97F4A7C15ULL;
+
+
+// everything that decides the data in a volume
+
+struct DataSettings {
+    unsigned long long seed;
+    long long blocks;                   // in the volume
+    double compress;                    // wanted compression ratio
+    double dedupe;                      // wanted dedupe ratio
+    double unique;                      // chance a block is unique
+    long long shared;                   // number of shared contents
+    double random_pieces;               // random pieces per block
+};
+
+
+// prototype for a function to set up the settings for a volume
+
+void init_settings(DataSettings& settings, unsigned long long seed, long long blocks,
+                   double compress, double dedupe, double shared);
+
+
+// prototypes for functions to make blocks
+
+unsigned long long content_of(const DataSettings& settings, long long index);
+void make_block(const DataSettings& settings, long long index, unsigned char* out);
+void make_blocks(const DataSettings& settings, long long first, long long count,
+                 unsigned char* out, int threads);
+
+
+// prototypes for functions to check the ratios
+
+double measure_dedupe(const unsigned char* data, long long blocks);
+long long lz_estimate(const unsigned char* data, int size);
+
+
+// prototype for the SplitMix64 mixing function
+
+unsigned long long mix64(unsigned long long z);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    DataSettings settings;              // used to hold the volume's settings
+    vector<unsigned char> data;         // used to hold generated blocks
+    vector<unsigned char> block;        // used to hold one block made again
+    unsigned long long seed;            // used to hold the main seed
+    int threads;                        // used to hold the number of threads
+    double start;                       // used to hold the starting time
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = ((unsigned long long) rand() << 31) | rand();
+
+    threads = int(thread::hardware_concurrency());
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    init_settings(settings, seed, VOLUME_BLOCKS, COMPRESS_RATIO, DEDUPE_RATIO, SHARED);
+    cout << endl << "Volume of " << VOLUME_BLOCKS << " blocks of " << BLOCK
+         << " bytes, compression " << COMPRESS_RATIO << ", dedupe "
+         << DEDUPE_RATIO << ":" << endl
+         << "    " << settings.unique * 100 << "% of blocks unique, the rest copies of "
+         << settings.shared << " shared contents; " << settings.random_pieces
+         << " of " << PIECES << " pieces random" << endl;
+
+    // make the whole volume, and check its ratios
+    data.resize((size_t) VOLUME_BLOCKS * BLOCK);
+    make_blocks(settings, 0, VOLUME_BLOCKS, data.data(), threads);
+
+    cout << endl << "Measured on the whole volume:" << endl;
+    double dedupe = measure_dedupe(data.data(), VOLUME_BLOCKS);
+    cout << "    dedupe ratio:      " << dedupe << endl;
+
+    // compression of the different blocks, with the simple LZ estimate
+    unordered_set<unsigned long long> seen;
+    long long raw = 0;
+    long long packed = 0;
+    for (long long b = 0; b < VOLUME_BLOCKS && raw < (256LL << 20); b++) {
+        if (seen.insert(content_of(settings, b)).second) {
+            raw += BLOCK;
+            packed += lz_estimate(&data[(size_t) b * BLOCK], BLOCK);
+        }
+    }
+    cout << "    compression ratio: " << double(raw) / packed
+         << " (LZ77 estimate, " << raw / BLOCK << " different blocks)" << endl;
+    cout << "    total reduction:   " << dedupe * double(raw) / packed
+         << " (wanted " << DEDUPE_RATIO * COMPRESS_RATIO << ")" << endl;
+
+    // any block can be made again on its own
+    block.resize(BLOCK);
+    bool same = true;
+    for (long long b = 0; b < VOLUME_BLOCKS; b += 9973) {
+        make_block(settings, b, block.data());
+        same = same && memcmp(block.data(), &data[(size_t) b * BLOCK], BLOCK) == 0;
+    }
+    cout << "    blocks made again on their own are "
+         << (same ? "the same" : "DIFFERENT") << endl;
+
+    // speed: make the volume over and over
+    long long rounds = TIMED_BYTES / ((long long) VOLUME_BLOCKS * BLOCK);
+    start = now();
+    for (long long r = 0; r < rounds; r++) {
+        make_blocks(settings, 0, VOLUME_BLOCKS, data.data(), threads);
+    }
+    double seconds = now() - start;
+    cout << endl << "Speed, " << threads << " thread(s): "
+         << rounds * VOLUME_BLOCKS * BLOCK / seconds / 1e9 << " GB per second ("
+         << rounds * VOLUME_BLOCKS * BLOCK / seconds / 1e9 / threads
+         << " per thread)" << endl;
+
+    // the extremes: random bytes, and nothing but filler
+    DataSettings extreme;
+    init_settings(extreme, seed, VOLUME_BLOCKS, 1.0, 1.0, 0.0);
+    start = now();
+    make_blocks(extreme, 0, VOLUME_BLOCKS, data.data(), threads);
+    cout << "    all random:        " << VOLUME_BLOCKS * BLOCK / (now() - start) / 1e9
+         << " GB per second" << endl;
+    init_settings(extreme, seed, VOLUME_BLOCKS, 1e9, 1.0, 0.0);
+    start = now();
+    make_blocks(extreme, 0, VOLUME_BLOCKS, data.data(), threads);
+    cout << "    all filler:        " << VOLUME_BLOCKS * BLOCK / (now() - start) / 1e9
+         << " GB per second" << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void init_settings(DataSettings& settings, unsigned long long seed, long long blocks,
+                   double compress, double dedupe, double shared) {
+
+    // PRE:  blocks > 0, compress >= 1, dedupe >= 1, 0 <= shared < 1
+    //
+    // POST: settings describes a volume of blocks blocks with (about)
+    //       the given compression and dedupe ratios, with a fraction
+    //       shared of its different blocks used many times
+
+    settings.seed = seed;
+    settings.blocks = blocks;
+    settings.compress = compress;
+    settings.dedupe = dedupe;
+
+    // u = (1 - shared) / D, and enough shared contents S that the M
+    // copies use shared * N / D of them, on average
+    settings.unique = (1.0 - shared) / dedupe;
+    settings.shared = 0;
+    if (dedupe <= 1.0 || shared <= 0.0) {
+        settings.unique = 1.0;
+    } else {
+        double copies = (1.0 - settings.unique) * blocks;
+        double used = shared * blocks / dedupe;
+        double low = used;
+        double high = used;
+
+        // S * (1 - exp(-M / S)) grows with S, towards M
+        while (high * -expm1(-copies / high) < used) {
+            high *= 2;
+        }
+        for (int step = 0; step < 100; step++) {
+            double middle = (low + high) / 2;
+            if (middle * -expm1(-copies / middle) < used) {
+                low = middle;
+            } else {
+                high = middle;
+            }
+        }
+        settings.shared = (long long) (high + 0.5);
+    }
+
+    settings.random_pieces = PIECES / compress;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long content_of(const DataSettings& settings, long long index) {
+
+    // PRE:  0 <= index < settings.blocks
+    //
+    // POST: a number naming the contents of the block has been
+    //       returned: the same for two blocks exactly when they hold the
+    //       same data (a unique block's number is its own index; a
+    //       shared content's has the top bit set)
+
+    unsigned long long r = mix64(settings.seed ^ mix64((unsigned long long) index));
+
+    if (settings.shared == 0 || double(r >> 11) * (1.0 / 9007199254740992.0) < settings.unique) {
+        return (unsigned long long) index;
+    }
+
+    // which shared content: the low 32 bits, scaled to the number of
+    // contents
+    unsigned long long which = ((r & 0xFFFFFFFFULL) * (unsigned long long) settings.shared) >> 32;
+
+    return (1ULL << 63) | which;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void make_block(const DataSettings& settings, long long index, unsigned char* out) {
+
+    // PRE:  0 <= index < settings.blocks; out has room for BLOCK bytes
+    //
+    // POST: out holds the block's data, which depends only on the
+    //       settings and index
+
+    unsigned long long content = content_of(settings, index);
+    unsigned long long state = mix64(settings.seed + mix64(content ^ GOLDEN));
+    unsigned long long filler = mix64(state ^ GOLDEN);
+    int order[PIECES];
+
+    // how many pieces are random: the whole part of random_pieces, and
+    // one more with chance its fraction
+    int whole = int(settings.random_pieces);
+    double fraction = settings.random_pieces - whole;
+    int count = whole + (double((state += GOLDEN, mix64(state)) >> 11)
+                         * (1.0 / 9007199254740992.0) < fraction);
+    if (count > PIECES) {
+        count = PIECES;
+    }
+
+    // which pieces: the first count of a random order (Fisher-Yates)
+    for (int p = 0; p < PIECES; p++) {
+        order[p] = p;
+    }
+    for (int p = 0; p < count; p++) {
+        unsigned long long r = mix64(state += GOLDEN);
+        int q = p + int(((r >> 32) * (unsigned long long) (PIECES - p)) >> 32);
+        int swap = order[p];
+        order[p] = order[q];
+        order[q] = swap;
+    }
+
+    // all filler, and then the random pieces over the top
+    for (int j = 0; j < BLOCK; j += 8) {
+        memcpy(out + j, &filler, 8);
+    }
+    for (int p = 0; p < count; p++) {
+        unsigned char* piece = out + order[p] * PIECE;
+        unsigned long long counter = mix64(state += GOLDEN);
+        for (int j = 0; j < PIECE; j += 8) {
+            unsigned long long value = mix64(counter + (unsigned long long) j * GOLDEN);
+            memcpy(piece + j, &value, 8);
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void make_blocks(const DataSettings& settings, long long first, long long count,
+                 unsigned char* out, int threads) {
+
+    // PRE:  out has room for count blocks
+    //
+    // POST: out holds blocks first to first + count - 1; the data is the
+    //       same for any number of threads
+
+    vector<thread> workers;
+
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&, t]() {
+            long long from = count * t / threads;
+            long long to = count * (t + 1) / threads;
+            for (long long b = from; b < to; b++) {
+                make_block(settings, first + b, out + (size_t) b * BLOCK);
+            }
+        }));
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double measure_dedupe(const unsigned char* data, long long blocks) {
+
+    // PRE:  data holds blocks blocks
+    //
+    // POST: blocks / (the number of different blocks) has been returned;
+    //       blocks are told apart by a 128-bit hash of their bytes
+
+    vector<pair<unsigned long long, unsigned long long> > hashes(blocks);
+
+    for (long long b = 0; b < blocks; b++) {
+        unsigned long long h1 = 0;
+        unsigned long long h2 = GOLDEN;
+        for (int j = 0; j < BLOCK; j += 8) {
+            unsigned long long word;
+            memcpy(&word, data + (size_t) b * BLOCK + j, 8);
+            h1 = mix64(h1 ^ word);
+            h2 = mix64(h2 + word);
+        }
+        hashes[b] = make_pair(h1, h2);
+    }
+
+    sort(hashes.begin(), hashes.end());
+    long long different = 0;
+    for (long long b = 0; b < blocks; b++) {
+        different += (b == 0 || hashes[b] != hashes[b - 1]);
+    }
+
+    return double(blocks) / different;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+long long lz_estimate(const unsigned char* data, int size) {
+
+    // PRE:  none
+    //
+    // POST: an estimate of the compressed size of data with a simple
+    //       LZ77 compressor has been returned: 3 bytes for each repeat
+    //       of at least 4 earlier bytes, and 1 byte for each other byte
+
+    const int HASH_BITS = 12;
+    vector<int> last(1 << HASH_BITS, -1);
+    long long cost = 0;
+    int i = 0;
+
+    while (i + 4 <= size) {
+        unsigned int four;
+        memcpy(&four, data + i, 4);
+        unsigned int h = (four * 2654435761U) >> (32 - HASH_BITS);
+        int candidate = last[h];
+        last[h] = i;
+
+        unsigned int earlier = 0;
+        if (candidate >= 0) {
+            memcpy(&earlier, data + candidate, 4);
+        }
+        if (candidate >= 0 && earlier == four) {
+            int length = 4;
+            while (i + length < size && data[candidate + length] == data[i + length]) {
+                length++;
+            }
+            cost += 3;
+            i += length;
+        } else {
+            cost++;
+            i++;
+        }
+    }
+
+    return cost + (size - i);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long mix64(unsigned long long z) {
+
+    // PRE:  none
+    //
+    // POST: z has been scrambled with the SplitMix64 mixing function
+    //       and the result returned
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
@@ -0,0 +1,641 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+generate Gaussian random fields and fractional Brownian motion with
+the fast Fourier transform, in C++.
+
+
+------------------------
+Gaussian Random Fields
+------------------------
+
+A Gaussian random field is a grid of normal random numbers that are
+not independent: values close together tend to be alike, and values
+far apart are unrelated. They are used to model things like rainfall
+over a region, the roughness of a surface, or the porosity of rock.
+
+How alike two values are is given by a "covariance function" C(d) of
+the distance d between them. For example, with
+
+        C(d) = exp(-d / L)
+
+values about L apart are still noticeably alike, and values 5 L apart
+are almost independent. L is called the "correlation length".
+
+
+------------------------
+The Slow Way: Cholesky
+------------------------
+
+Put the covariance of every pair of the n grid points in an n by n
+table (a matrix). A standard piece of linear algebra, the Cholesky
+factorization, finds a matrix L with L times L-transposed equal to
+the table. Multiplying L by n independent normal random numbers then
+gives a field with exactly the right covariance.
+
+But the factorization takes about n^3 steps. A 100 by 100 grid has
+n = 10,000 points, and n^3 is a trillion; a 1000 by 1000 grid is
+hopeless.
+
+
+----------------------------
+Circulant Embedding
+----------------------------
+
+There is a much faster way when the covariance only depends on the
+distance between points (a "stationary" field on an even grid).
+
+First imagine the grid wrapped around into a circle (or, in 2D, a
+doughnut), at least twice as long as the grid we want, so the wrap
+doesn't bring any of our points closer together. On a wrapped grid,
+the covariance table becomes "circulant": every row is the row above
+shifted by one place. That is the "embedding".
+
+Circulant tables have a wonderful property: the discrete Fourier
+transform turns them into plain lists of numbers, called
+"eigenvalues". So to make a random field on the wrapped grid we:
+
+    1. Transform the first row of the table (the covariance of point
+       0 with every other point) to get the eigenvalues, once.
+    2. Make one complex normal random number per grid point, and
+       multiply each by the square root of its eigenvalue.
+    3. Transform the result.
+
+The real parts of the answer form one field with exactly the right
+covariance, and the imaginary parts form a second, independent one --
+two fields for the price of one transform. We then keep just the part
+of the wrapped grid we wanted.
+
+The fast Fourier transform (FFT) takes about n log n steps instead of
+n^3. A transform in 2D or 3D is just 1D transforms along every row,
+then every column (then every "pillar"), and those lines are
+independent, so they are shared out among threads.
+
+For some covariance functions, a few eigenvalues come out slightly
+negative. A negative number has no real square root, so we set them to
+0 and report how much was lost; making the wrapped grid bigger shrinks
+the loss.
+
+
+-----------------------------
+Fractional Brownian Motion
+-----------------------------
+
+Brownian motion is the random path made by adding up independent
+normal steps. Fractional Brownian motion, with a "Hurst" number H
+between 0 and 1, is a path whose steps are related to each other:
+
+    - H = 0.5 is ordinary Brownian motion.
+    - H above 0.5 gives steps that tend to keep going the same way, so
+      the path is smoother and trends last longer.
+    - H below 0.5 gives steps that tend to reverse, so the path is
+      rougher.
+
+The steps ("fractional Gaussian noise") have the covariance
+
+        C(k) = 0.5 * (|k + 1|^2H - 2 |k|^2H + |k - 1|^2H)
+
+between steps k apart. This is a stationary 1D field, so we make the
+steps with circulant embedding and add them up. This is called the
+Davies-Harte method, and for this covariance the eigenvalues are
+never negative, so it is exact.
+
+
+----------------
+Review Questions
+----------------
+
+1. What does a covariance function describe?
+
+2. Why is the Cholesky way too slow for a big grid?
+
+3. What does "circulant" mean?
+
+4. Why is the wrapped grid at least twice as long as the grid we want?
+
+5. How many fields does one transform give?
+
+6. How is a 2D Fourier transform made from 1D transforms?
+
+7. What kind of path does fractional Brownian motion with H = 0.8
+make?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the exp(), log(), sqrt(), pow(), cos() and sin() functions
+
+#include <cmath>
+
+
+// access the complex, vector and thread types
+
+#include <complex>
+#include <vector>
+#include <thread>
+
+
+// constant used to control the number pi
+
+const double PI = 3.14159265358979323846;
+
+
+// the covariance functions this program knows
+
+enum CovarianceKind { EXPONENTIAL, MATERN_3_2, FRACTIONAL_NOISE };
+
+
+// a covariance function and its settings
+
+struct CovarianceModel {
+    CovarianceKind kind;
+    double length;              // correlation length
+    double hurst;               // for FRACTIONAL_NOISE only
+};
+
+
+// a wrapped grid, and the square roots of its eigenvalues
+
+struct Embedding {
+    int n[3];                   // size of the grid we want
+    int m[3];                   // size of the wrapped grid
+    long long total;            // m[0] * m[1] * m[2]
+    vector<double> root;        // sqrt(eigenvalue / total), per point
+    double clamped;             // share of eigenvalues set to 0
+};
+
+
+// prototype for a function to give the covariance at a distance
+
+double covariance(const CovarianceModel& model, double distance);
+
+
+// prototype for a function to scramble a 64-bit number
+
+unsigned long long mix64(unsigned long long z);
+
+
+// prototypes for functions to do the fast Fourier transform of a line,
+// and of a whole 1D, 2D or 3D grid
+
+void fft(complex<double>* a, int n);
+void fft_grid(vector<complex<double> >& grid, const int m[3], int threads);
+
+
+// prototype for a function to set up the wrapped grid for a field
+
+void build_embedding(const CovarianceModel& model, int nx, int ny, int nz,
+                     double spacing, int threads, Embedding& embedding);
+
+
+// prototype for a function to make two independent fields
+
+void generate_fields(const Embedding& embedding, unsigned long long seed,
+                     int threads, vector<double>& first,
+                     vector<double>& second);
+
+
+// prototype for a function to make a fractional Brownian motion path
+
+void fractional_brownian_motion(double hurst, int steps,
+                                unsigned long long seed, int threads,
+                                vector<double>& path);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    Embedding embedding;        // used to hold a wrapped grid
+    CovarianceModel model;      // used to hold the covariance function
+    vector<double> first;       // used to hold the first field
+    vector<double> second;      // used to hold the second field
+    vector<double> path;        // used to hold an fBm path
+    unsigned long long seed;    // used to hold the main seed
+    int threads;                // used to hold how many threads to use
+    double start;               // used to hold the starting time
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = ((unsigned long long) rand() << 31) | rand();
+
+    threads = int(thread::hardware_concurrency());
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    // a 2D field, and its measured covariance at a few distances
+    const int SIDE = 512;
+    int lags[4] = { 0, 1, 4, 16 };
+
+    model.kind = EXPONENTIAL;
+    model.length = 8.0;
+
+    start = now();
+    build_embedding(model, SIDE, SIDE, 1, 1.0, threads, embedding);
+    generate_fields(embedding, seed, threads, first, second);
+
+    cout << endl
+         << "Two " << SIDE << " x " << SIDE << " fields with covariance "
+         << "exp(-d / 8), on a " << embedding.m[0] << " x " << embedding.m[1]
+         << " wrapped grid, in " << now() - start << " seconds" << endl
+         << "(share of eigenvalues clamped: " << embedding.clamped << ")"
+         << endl;
+
+    for (int i = 0; i < 4; i++) {
+        double sum = 0;
+        long long pairs = 0;
+        for (int y = 0; y < SIDE; y++) {
+            for (int x = 0; x + lags[i] < SIDE; x++) {
+                sum += first[y * SIDE + x] * first[y * SIDE + x + lags[i]]
+                     + second[y * SIDE + x] * second[y * SIDE + x + lags[i]];
+                pairs += 2;
+            }
+        }
+        cout << "    distance " << lags[i] << ": measured " << sum / pairs
+             << ", expected " << covariance(model, lags[i]) << endl;
+    }
+
+    // a 3D field
+    model.kind = MATERN_3_2;
+    model.length = 4.0;
+
+    start = now();
+    build_embedding(model, 64, 64, 64, 1.0, threads, embedding);
+    generate_fields(embedding, seed + 1, threads, first, second);
+
+    cout << endl
+         << "Two 64 x 64 x 64 fields with a Matern covariance in "
+         << now() - start << " seconds" << endl
+         << "(share of eigenvalues clamped: " << embedding.clamped << ")"
+         << endl;
+
+    // fractional Brownian motion: the spread of B(t + k) - B(t) grows
+    // like k^H
+    cout << endl << "Fractional Brownian motion, 2^20 steps:" << endl;
+
+    double hursts[3] = { 0.3, 0.5, 0.8 };
+    for (int h = 0; h < 3; h++) {
+        fractional_brownian_motion(hursts[h], 1 << 20, seed + 2 + h, threads,
+                                   path);
+
+        double spread[2];
+        int gaps[2] = { 16, 1024 };
+        for (int g = 0; g < 2; g++) {
+            double sum = 0;
+            long long count = 0;
+            for (long long t = 0; t + gaps[g] < (long long) path.size(); t++) {
+                double step = path[t + gaps[g]] - path[t];
+                sum += step * step;
+                count++;
+            }
+            spread[g] = sqrt(sum / count);
+        }
+
+        cout << "    H = " << hursts[h] << ": measured H "
+             << log(spread[1] / spread[0]) / log(1024.0 / 16.0) << endl;
+    }
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double covariance(const CovarianceModel& model, double distance) {
+
+    // PRE:  distance >= 0
+    //
+    // POST: the covariance of two values distance apart has been
+    //       returned; for FRACTIONAL_NOISE, distance counts steps
+
+    double r = distance / model.length;
+    double two_h = 2.0 * model.hurst;
+
+    if (model.kind == EXPONENTIAL) {
+        return exp(-r);
+    }
+
+    if (model.kind == MATERN_3_2) {
+        return (1.0 + sqrt(3.0) * r) * exp(-sqrt(3.0) * r);
+    }
+
+    return 0.5 * (pow(distance + 1.0, two_h) - 2.0 * pow(distance, two_h)
+                  + pow(fabs(distance - 1.0), two_h));
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long mix64(unsigned long long z) {
+
+    // PRE:  none
+    //
+    // POST: z has been scrambled with the SplitMix64 mixing function
+    //       and returned
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void fft(complex<double>* a, int n) {
+
+    // PRE:  n is a power of 2
+    //
+    // POST: a has been replaced by its discrete Fourier transform
+
+    // put the numbers in "bit-reversed" order
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        while (j & bit) {
+            j ^= bit;
+            bit >>= 1;
+        }
+        j ^= bit;
+        if (i < j) {
+            swap(a[i], a[j]);
+        }
+    }
+
+    // combine pairs of transforms of length half into transforms of
+    // length 2 * half
+    for (int half = 1; half < n; half *= 2) {
+
+        complex<double> turn(cos(-PI / half), sin(-PI / half));
+
+        for (int i = 0; i < n; i += 2 * half) {
+            complex<double> w(1.0, 0.0);
+            for (int k = 0; k < half; k++) {
+                complex<double> u = a[i + k];
+                complex<double> v = a[i + k + half] * w;
+                a[i + k] = u + v;
+                a[i + k + half] = u - v;
+                w *= turn;
+            }
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void fft_grid(vector<complex<double> >& grid, const int m[3], int threads) {
+
+    // PRE:  grid holds m[0] * m[1] * m[2] numbers, x changing fastest,
+    //       each m[d] is a power of 2, and threads >= 1
+    //
+    // POST: grid has been replaced by its discrete Fourier transform
+
+    long long stride = 1;
+
+    for (int d = 0; d < 3; d++) {
+
+        long long lines = (long long) grid.size() / m[d];
+        vector<thread> workers;
+
+        if (m[d] == 1) {
+            continue;
+        }
+
+        // every line along direction d is transformed on its own,
+        // copied into a buffer so the transform reads memory in order
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(thread([&, t, d, stride, lines]() {
+                vector<complex<double> > line(m[d]);
+                for (long long l = t; l < lines; l += threads) {
+                    long long first = (l / stride) * stride * m[d] + l % stride;
+                    for (int k = 0; k < m[d]; k++) {
+                        line[k] = grid[first + k * stride];
+                    }
+                    fft(&line[0], m[d]);
+                    for (int k = 0; k < m[d]; k++) {
+                        grid[first + k * stride] = line[k];
+                    }
+                }
+            }));
+        }
+
+        for (int t = 0; t < threads; t++) {
+            workers[t].join();
+        }
+
+        stride *= m[d];
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void build_embedding(const CovarianceModel& model, int nx, int ny, int nz,
+                     double spacing, int threads, Embedding& embedding) {
+
+    // PRE:  nx, ny, nz >= 1 (use 1 for unused directions), spacing > 0,
+    //       and threads >= 1
+    //
+    // POST: embedding holds a wrapped grid at least twice the size of
+    //       the nx by ny by nz grid in each used direction, and the
+    //       square roots of its eigenvalues, with any negative
+    //       eigenvalues set to 0
+
+    vector<complex<double> > row;
+    long long negative = 0;
+
+    embedding.n[0] = nx;
+    embedding.n[1] = ny;
+    embedding.n[2] = nz;
+    embedding.total = 1;
+
+    for (int d = 0; d < 3; d++) {
+        int m = 1;
+        while (embedding.n[d] > 1 && m < 2 * (embedding.n[d] - 1)) {
+            m *= 2;
+        }
+        embedding.m[d] = m;
+        embedding.total *= m;
+    }
+
+    // the covariance of the wrapped grid's first point with every
+    // other point, measuring distances the short way round
+    row.resize(embedding.total);
+    for (long long i = 0; i < embedding.total; i++) {
+        long long rest = i;
+        double squared = 0;
+        for (int d = 0; d < 3; d++) {
+            int k = int(rest % embedding.m[d]);
+            rest /= embedding.m[d];
+            k = (k < embedding.m[d] - k) ? k : embedding.m[d] - k;
+            squared += (k * spacing) * (k * spacing);
+        }
+        row[i] = covariance(model, sqrt(squared));
+    }
+
+    fft_grid(row, embedding.m, threads);
+
+    // the transform of a symmetric row is real: those are the
+    // eigenvalues
+    embedding.root.resize(embedding.total);
+    for (long long i = 0; i < embedding.total; i++) {
+        double eigenvalue = row[i].real();
+        if (eigenvalue < 0) {
+            eigenvalue = 0;
+            negative++;
+        }
+        embedding.root[i] = sqrt(eigenvalue / embedding.total);
+    }
+
+    embedding.clamped = double(negative) / embedding.total;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void generate_fields(const Embedding& embedding, unsigned long long seed,
+                     int threads, vector<double>& first,
+                     vector<double>& second) {
+
+    // PRE:  embedding has been set up by build_embedding(), and
+    //       threads >= 1
+    //
+    // POST: first and second hold two independent fields of n[0] *
+    //       n[1] * n[2] values, x changing fastest, with the
+    //       embedding's covariance; the same seed gives the same fields
+    //       for any number of threads
+
+    vector<complex<double> > grid(embedding.total);
+    vector<thread> workers;
+    const int* n = embedding.n;
+    const int* m = embedding.m;
+
+    // one complex normal random number per point, made directly from
+    // the seed and the point's number, times the eigenvalue's root
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&, t]() {
+            long long chunk = (embedding.total + threads - 1) / threads;
+            long long last = (t + 1) * chunk;
+            last = (last < embedding.total) ? last : embedding.total;
+
+            for (long long i = t * chunk; i < last; i++) {
+                unsigned long long a = mix64(seed + (2 * i + 1) * 0x9E3779B97F4A7C15ULL);
+                unsigned long long b = mix64(seed + (2 * i + 2) * 0x9E3779B97F4A7C15ULL);
+                double u = (double(a >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+                double v = double(b >> 11) * (2.0 * PI / 9007199254740992.0);
+                double r = sqrt(-2.0 * log(u)) * embedding.root[i];
+
+                grid[i] = complex<double>(r * cos(v), r * sin(v));
+            }
+        }));
+    }
+
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+
+    fft_grid(grid, m, threads);
+
+    // keep the corner we wanted: real parts in one field, imaginary
+    // parts in the other
+    first.resize((long long) n[0] * n[1] * n[2]);
+    second.resize(first.size());
+
+    for (int z = 0; z < n[2]; z++) {
+        for (int y = 0; y < n[1]; y++) {
+            for (int x = 0; x < n[0]; x++) {
+                long long from = ((long long) z * m[1] + y) * m[0] + x;
+                long long to = ((long long) z * n[1] + y) * n[0] + x;
+                first[to] = grid[from].real();
+                second[to] = grid[from].imag();
+            }
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void fractional_brownian_motion(double hurst, int steps,
+                                unsigned long long seed, int threads,
+                                vector<double>& path) {
+
+    // PRE:  0 < hurst < 1, steps >= 2, and threads >= 1
+    //
+    // POST: path holds steps + 1 values of fractional Brownian motion
+    //       with the given Hurst number at times 0, 1/steps, ..., 1,
+    //       starting from path[0] = 0
+
+    CovarianceModel model;
+    Embedding embedding;
+    vector<double> noise;
+    vector<double> unused;
+    double scale = pow(1.0 / steps, hurst);
+
+    model.kind = FRACTIONAL_NOISE;
+    model.length = 1.0;
+    model.hurst = hurst;
+
+    // the steps are fractional Gaussian noise, made by circulant
+    // embedding (Davies-Harte); the second field is not needed here
+    build_embedding(model, steps, 1, 1, 1.0, threads, embedding);
+    generate_fields(embedding, seed, threads, noise, unused);
+
+    path.resize(steps + 1);
+    path[0] = 0;
+    for (int t = 0; t < steps; t++) {
+        path[t + 1] = path[t] + scale * noise[t];
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
@@ -0,0 +1,755 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+keep a small random sample of the records for EACH key in a very fast
+stream -- for example a few sample events per customer -- in a fixed
+amount of memory, in C++.
+
+
+-----------------------
+Reservoir Sampling
+-----------------------
+
+To keep a random sample of k records from a stream whose length we
+don't know, we use a "reservoir" of k places:
+
+    - The first k records go straight into the reservoir.
+    - Record number n (n > k) replaces a random place in the reservoir
+      with chance k / n.
+
+At every moment, the reservoir is a fair sample of k of the records so
+far: every record is equally likely to be in it. This is "Algorithm R"
+and it needs one random number for every record.
+
+
+-------------------------------
+Skipping: Algorithm L
+-------------------------------
+
+Late in a long stream, k / n is tiny and almost every record is
+skipped. Li's "Algorithm L" works out directly how many records to skip
+before the next one that goes into the reservoir, using a few random
+numbers and logarithms. In between, a record costs only one counter
+decrement:
+
+        if (--skip > 0) nothing to do
+        else            replace a random place, and draw a new skip
+
+So a stream of n records needs only about k * (1 + log(n / k)) random
+draws instead of n.
+
+
+----------------------------
+One Reservoir per Key
+----------------------------
+
+For a sample per customer, we keep a hash table from each key to its
+reservoir and its skip counter. Each record is looked up by its key
+and offered to that key's reservoir.
+
+The table has a fixed size, so memory is bounded. When a new key
+arrives and the table is full, an old key is "evicted": its reservoir
+(with how many records it has seen) is handed on to a function that
+stores it somewhere else, and its place is reused. We pick the victim
+by looking at a few random keys and taking the one with the fewest
+records, so the big groups stay in the table and the many small ones
+pass through it.
+
+
+------------------
+Merging
+------------------
+
+If an evicted key comes back, it starts a new reservoir. Two reservoirs
+of the same key -- a sample of k from n1 records, and a sample of k
+from n2 different records -- can be merged into a fair sample of k from
+all n1 + n2:
+
+    For each of the k places, take a record from the first reservoir
+    with chance (first records left) / (all records left), otherwise
+    from the second, counting down as we go. Then take that many
+    records, chosen at random, from each reservoir.
+
+The same merge joins reservoirs built by different threads, each on
+its own part of the stream.
+
+
+----------------
+Review Questions
+----------------
+
+1. In Algorithm R, with what chance does record n go into the
+   reservoir?
+
+2. What does a record cost in Algorithm L when it is skipped?
+
+3. Why does the hash table have a fixed size?
+
+4. What does an evicted key hand on, and why is its count needed?
+
+5. Why can't we merge two reservoirs by just taking k / 2 records from
+   each?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand(), srand() and time() functions
+
+#include <cstdlib>
+#include <ctime>
+
+
+// access the log(), log1p(), exp() and floor() functions
+
+#include <cmath>
+
+
+// access the vector and map types
+
+#include <vector>
+#include <unordered_map>
+
+
+// access the lower_bound() and swap() functions
+
+#include <algorithm>
+
+
+// constants used to control the demonstration's stream
+
+const int PER_KEY = 8;
+const int CUSTOMERS = 200000;
+const long long EVENTS = 50000000;
+const int KEY_BLOCK = 1 << 22;
+
+
+// a function that receives an evicted key's reservoir: the key, how
+// many records it saw, and its sample
+
+typedef void (*EvictCallback)(unsigned long long key, long long seen,
+                              const unsigned long long* records, int count,
+                              void* user);
+
+
+// one place in the hash table: a key and its reservoir's state
+
+struct GroupSlot {
+    unsigned long long key;
+    long long seen;         // records seen for this key
+    long long skip;         // records until the next replacement
+    long long block;        // which reservoir block, -1 if empty
+};
+
+
+// a hash table of reservoirs, using a fixed amount of memory
+
+struct GroupTable {
+    int per_key;                        // reservoir size k
+    int max_groups;                     // most keys held at once
+    int groups;                         // keys held now
+    unsigned long long mask;            // table size - 1
+    vector<GroupSlot> slots;            // the hash table
+    vector<unsigned long long> records; // max_groups reservoirs of k
+    vector<double> w;                   // Algorithm L's value per block
+    vector<int> free_blocks;            // reservoirs not in use
+    unsigned long long state;           // random number state
+    long long draws;                    // random numbers drawn so far
+    long long evictions;                // keys evicted so far
+    EvictCallback evicted;              // where evicted keys go
+    void* user;                         // passed on to evicted
+};
+
+
+// a merged sample of one key, kept outside the table
+
+struct KeySample {
+    long long seen;
+    vector<unsigned long long> records;
+};
+
+
+// the merged samples of evicted keys, their size, and the state used
+// to merge them
+
+struct Sink {
+    unordered_map<unsigned long long, KeySample> samples;
+    int size;
+    unsigned long long state;
+};
+
+
+// prototypes for functions to make random numbers
+
+unsigned long long next64(unsigned long long& state);
+double uniform(unsigned long long& state);
+unsigned long long below(unsigned long long& state, unsigned long long limit);
+unsigned long long mix64(unsigned long long z);
+
+
+// prototypes for functions to set up, use and empty a table
+
+void init_table(GroupTable& table, int per_key, int max_groups,
+                unsigned long long seed, EvictCallback evicted, void* user);
+void offer(GroupTable& table, unsigned long long key, unsigned long long record);
+void offer_simple(GroupTable& table, unsigned long long key,
+                  unsigned long long record);
+void flush_table(GroupTable& table);
+
+
+// prototypes for functions used inside the table
+
+int find_group(GroupTable& table, unsigned long long key);
+void evict_one(GroupTable& table);
+void remove_slot(GroupTable& table, unsigned long long index);
+
+
+// prototype for a function to merge a reservoir into a key's sample
+
+void merge_sample(KeySample& into, long long seen,
+                  const unsigned long long* records, int count, int size,
+                  unsigned long long& state);
+
+
+// the eviction callback used by the demonstration: merge into a map
+
+void merge_evicted(unsigned long long key, long long seen,
+                   const unsigned long long* records, int count, void* user);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    GroupTable table;                   // used to hold the reservoirs
+    Sink sink;                          // used to hold evicted samples
+    vector<unsigned long long> keys;    // used to hold a block of keys
+    vector<double> chance;              // used to pick customers
+    unsigned long long seed;            // used to hold the main seed
+    unsigned long long state;           // used to make the keys
+    double start;                       // used to hold the starting time
+    double time_r;                      // used to hold Algorithm R's time
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = ((unsigned long long) rand() << 31) | rand();
+
+    // fairness: 4 keys of 100 records each, interleaved, with room for
+    // only 2 keys so there are many evictions and merges; each record
+    // of key 0 should end up in its sample with chance 10 / 100
+    vector<long long> hits(100, 0);
+    long long evictions = 0;
+    sink.size = 10;
+    for (int s = 0; s < 20000; s++) {
+
+        int left[4] = { 100, 100, 100, 100 };
+        unsigned long long order = mix64(seed + 3 * s);
+
+        sink.samples.clear();
+        sink.state = mix64(seed + 3 * s + 1);
+        init_table(table, 10, 2, mix64(seed + 3 * s + 2), merge_evicted, &sink);
+
+        // the 400 records in a random order, key by key in runs
+        for (int r = 0; r < 400; r++) {
+            int key = int(below(order, 4));
+            while (left[key] == 0) {
+                key = (key + 1) % 4;
+            }
+            offer(table, key, 100 - left[key]);
+            left[key]--;
+        }
+
+        evictions += table.evictions;
+        flush_table(table);
+        KeySample& sample = sink.samples[0];
+        for (size_t k = 0; k < sample.records.size(); k++) {
+            hits[sample.records[k]]++;
+        }
+    }
+
+    double lowest = 1;
+    double highest = 0;
+    for (int r = 0; r < 100; r++) {
+        lowest = (hits[r] / 20000.0 < lowest) ? hits[r] / 20000.0 : lowest;
+        highest = (hits[r] / 20000.0 > highest) ? hits[r] / 20000.0 : highest;
+    }
+    cout << endl << "Fairness with evictions and merges ("
+         << evictions / 20000.0 << " evictions per run):" << endl
+         << "    each record's chance to be in the sample: from " << lowest
+         << " to " << highest << " (expected 0.1)" << endl;
+
+    // a fast stream: customers picked with Zipf-like chances, far more
+    // customers than the table holds
+    keys.resize(KEY_BLOCK);
+    chance.resize(CUSTOMERS);
+    double total = 0;
+    for (int c = 0; c < CUSTOMERS; c++) {
+        total += 1.0 / pow(c + 1.0, 1.1);
+        chance[c] = total;
+    }
+    state = seed;
+    for (int i = 0; i < KEY_BLOCK; i++) {
+        double u = uniform(state) * total;
+        int c = int(lower_bound(chance.begin(), chance.end(), u) - chance.begin());
+        keys[i] = mix64((unsigned long long) c + 1);
+    }
+
+    // room for every customer, then room for only a third of them
+    int rooms[2] = { CUSTOMERS, CUSTOMERS / 3 };
+    sink.size = PER_KEY;
+
+    for (int run = 0; run < 2; run++) {
+
+        cout << endl << EVENTS << " events over " << CUSTOMERS
+             << " customers, " << PER_KEY << " per customer, room for "
+             << rooms[run] << ":" << endl;
+
+        sink.samples.clear();
+        init_table(table, PER_KEY, rooms[run], seed, merge_evicted, &sink);
+        start = now();
+        for (long long e = 0; e < EVENTS; e++) {
+            offer_simple(table, keys[e & (KEY_BLOCK - 1)], (unsigned long long) e);
+        }
+        time_r = now() - start;
+        cout << "    Algorithm R (a random number per event): "
+             << EVENTS / time_r / 1e6 << " million events per second, "
+             << double(table.draws) / EVENTS << " draws per event" << endl;
+
+        sink.samples.clear();
+        init_table(table, PER_KEY, rooms[run], seed, merge_evicted, &sink);
+        start = now();
+        for (long long e = 0; e < EVENTS; e++) {
+            offer(table, keys[e & (KEY_BLOCK - 1)], (unsigned long long) e);
+        }
+        cout << "    Algorithm L (skip counters):             "
+             << EVENTS / (now() - start) / 1e6 << " million events per second, "
+             << double(table.draws) / EVENTS << " draws per event" << endl;
+
+        long long kept = table.groups;
+        flush_table(table);
+        cout << "    " << table.evictions - kept << " evictions while running, "
+             << sink.samples.size() << " customers sampled in all" << endl;
+    }
+
+    // the busiest customer's sample should be spread over the stream
+    KeySample& busiest = sink.samples[mix64(1)];
+    cout << "    busiest customer: " << busiest.seen << " events, sample at";
+    for (size_t k = 0; k < busiest.records.size(); k++) {
+        cout << " " << (busiest.records[k] * 100 / EVENTS) << "%";
+    }
+    cout << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long next64(unsigned long long& state) {
+
+    // PRE:  none
+    //
+    // POST: state has moved on, and a random 64-bit number has been
+    //       returned (SplitMix64)
+
+    return mix64(state += 0x9E3779B97F4A7C15ULL);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long mix64(unsigned long long z) {
+
+    // PRE:  none
+    //
+    // POST: z has been scrambled with the SplitMix64 mixing function
+    //       and the result returned
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double uniform(unsigned long long& state) {
+
+    // PRE:  none
+    //
+    // POST: a random number strictly between 0 and 1 has been returned
+
+    return ((next64(state) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long below(unsigned long long& state, unsigned long long limit) {
+
+    // PRE:  limit >= 1
+    //
+    // POST: a random number from 0 to limit - 1 has been returned, each
+    //       exactly equally likely (Lemire's method)
+
+    unsigned __int128 product = (unsigned __int128) next64(state) * limit;
+
+    if ((unsigned long long) product < limit) {
+        unsigned long long threshold = (0 - limit) % limit;
+        while ((unsigned long long) product < threshold) {
+            product = (unsigned __int128) next64(state) * limit;
+        }
+    }
+
+    return (unsigned long long) (product >> 64);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void init_table(GroupTable& table, int per_key, int max_groups,
+                unsigned long long seed, EvictCallback evicted, void* user) {
+
+    // PRE:  per_key >= 1 and max_groups >= 1
+    //
+    // POST: table is empty, with room for max_groups keys of per_key
+    //       records each; evicted keys will be handed to evicted
+
+    unsigned long long size = 2;
+
+    // at least twice as many places as keys, so lookups stay short
+    while (size < 2ULL * max_groups) {
+        size *= 2;
+    }
+
+    table.per_key = per_key;
+    table.max_groups = max_groups;
+    table.groups = 0;
+    table.mask = size - 1;
+    table.slots.assign(size, GroupSlot());
+    for (unsigned long long i = 0; i < size; i++) {
+        table.slots[i].block = -1;
+    }
+    table.records.assign((size_t) max_groups * per_key, 0);
+    table.w.assign(max_groups, 0);
+    table.free_blocks.clear();
+    for (int b = max_groups - 1; b >= 0; b--) {
+        table.free_blocks.push_back(b);
+    }
+    table.state = seed;
+    table.draws = 0;
+    table.evictions = 0;
+    table.evicted = evicted;
+    table.user = user;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int find_group(GroupTable& table, unsigned long long key) {
+
+    // PRE:  table has been set up by init_table()
+    //
+    // POST: the index of key's place has been returned; if key was
+    //       not in the table it has been added, with an empty
+    //       reservoir, evicting another key if the table was full
+
+    unsigned long long i = mix64(key) & table.mask;
+
+    while (table.slots[i].block >= 0) {
+        if (table.slots[i].key == key) {
+            return int(i);
+        }
+        i = (i + 1) & table.mask;
+    }
+
+    if (table.groups == table.max_groups) {
+
+        evict_one(table);
+
+        // the eviction may have moved keys, so find the free place again
+        i = mix64(key) & table.mask;
+        while (table.slots[i].block >= 0) {
+            i = (i + 1) & table.mask;
+        }
+    }
+
+    GroupSlot& slot = table.slots[i];
+    slot.key = key;
+    slot.seen = 0;
+    slot.skip = 0;
+    slot.block = table.free_blocks.back();
+    table.free_blocks.pop_back();
+    table.groups++;
+
+    return int(i);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void offer(GroupTable& table, unsigned long long key, unsigned long long record) {
+
+    // PRE:  table has been set up by init_table()
+    //
+    // POST: record has been offered to key's reservoir, using Algorithm
+    //       L: most records only count down the skip counter
+
+    GroupSlot& slot = table.slots[find_group(table, key)];
+
+    slot.seen++;
+    if (--slot.skip > 0) {
+        return;
+    }
+
+    unsigned long long* reservoir = &table.records[slot.block * table.per_key];
+    double& w = table.w[slot.block];
+
+    if (slot.seen <= table.per_key) {
+
+        // still filling the reservoir: skip stays at 0 until it is full
+        reservoir[slot.seen - 1] = record;
+        if (slot.seen < table.per_key) {
+            return;
+        }
+        w = exp(log(uniform(table.state)) / table.per_key);
+
+    } else {
+
+        reservoir[below(table.state, table.per_key)] = record;
+        w *= exp(log(uniform(table.state)) / table.per_key);
+        table.draws++;
+    }
+
+    // how many more records until the next one that goes into the
+    // reservoir (counting that one); a huge skip (a tiny w) is the same
+    // as never
+    double skip = floor(log(uniform(table.state)) / log1p(-w)) + 1;
+    slot.skip = (skip < 4e18) ? (long long) skip : 4000000000000000000LL;
+    table.draws += 2;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void offer_simple(GroupTable& table, unsigned long long key,
+                  unsigned long long record) {
+
+    // PRE:  table has been set up by init_table()
+    //
+    // POST: record has been offered to key's reservoir, using Algorithm
+    //       R: one random number for every record
+
+    GroupSlot& slot = table.slots[find_group(table, key)];
+    unsigned long long* reservoir = &table.records[slot.block * table.per_key];
+
+    if (slot.seen < table.per_key) {
+        reservoir[slot.seen++] = record;
+    } else {
+        unsigned long long place = below(table.state, (unsigned long long) ++slot.seen);
+        if (place < (unsigned long long) table.per_key) {
+            reservoir[place] = record;
+        }
+        table.draws++;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void evict_one(GroupTable& table) {
+
+    // PRE:  table holds at least one key
+    //
+    // POST: of a few keys picked at random, the one with the fewest
+    //       records has been handed to the eviction callback and
+    //       removed
+
+    unsigned long long victim = 0;
+    long long fewest = -1;
+
+    for (int found = 0; found < 8; ) {
+        unsigned long long i = next64(table.state) & table.mask;
+        if (table.slots[i].block >= 0) {
+            if (fewest < 0 || table.slots[i].seen < fewest) {
+                victim = i;
+                fewest = table.slots[i].seen;
+            }
+            found++;
+        }
+    }
+
+    remove_slot(table, victim);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void remove_slot(GroupTable& table, unsigned long long index) {
+
+    // PRE:  the place at index holds a key
+    //
+    // POST: its reservoir has been handed to the eviction callback, and
+    //       the key removed; later keys have been shifted back so that
+    //       every key can still be found
+
+    GroupSlot& slot = table.slots[index];
+    int count = (slot.seen < table.per_key) ? int(slot.seen) : table.per_key;
+
+    if (table.evicted != NULL) {
+        table.evicted(slot.key, slot.seen,
+                      &table.records[slot.block * table.per_key],
+                      count, table.user);
+    }
+
+    table.free_blocks.push_back(slot.block);
+    table.groups--;
+    table.evictions++;
+
+    // backward shift: move up any later key whose home is at or before
+    // the hole, so no search stops early at the hole
+    unsigned long long hole = index;
+    unsigned long long i = (index + 1) & table.mask;
+
+    while (table.slots[i].block >= 0) {
+        unsigned long long home = mix64(table.slots[i].key) & table.mask;
+        if (((i - home) & table.mask) >= ((i - hole) & table.mask)) {
+            table.slots[hole] = table.slots[i];
+            hole = i;
+        }
+        i = (i + 1) & table.mask;
+    }
+    table.slots[hole].block = -1;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void flush_table(GroupTable& table) {
+
+    // PRE:  table has been set up by init_table()
+    //
+    // POST: every key has been handed to the eviction callback, and the
+    //       table is empty
+
+    for (unsigned long long i = 0; i <= table.mask; ) {
+        if (table.slots[i].block >= 0) {
+            remove_slot(table, i);      // may shift another key into i
+        } else {
+            i++;
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void merge_sample(KeySample& into, long long seen,
+                  const unsigned long long* records, int count, int size,
+                  unsigned long long& state) {
+
+    // PRE:  into is a fair sample of min(size, into.seen) of its
+    //       records, and records is a fair sample of count =
+    //       min(size, seen) of seen other records
+    //
+    // POST: into is a fair sample of min(size, into.seen + seen) of all
+    //       of them
+
+    vector<unsigned long long> mine = into.records;
+    vector<unsigned long long> theirs(records, records + count);
+    long long left_mine = into.seen;
+    long long left_theirs = seen;
+    long long total = into.seen + seen;
+    int places = (total < size) ? int(total) : size;
+    int from_mine = 0;
+
+    // how many places come from each side: each place picks a side with
+    // chance in proportion to the records that side has left
+    for (int p = 0; p < places; p++) {
+        if ((long long) below(state, left_mine + left_theirs) < left_mine) {
+            from_mine++;
+            left_mine--;
+        } else {
+            left_theirs--;
+        }
+    }
+
+    // then that many records, picked at random, from each side
+    into.records.clear();
+    for (int p = 0; p < from_mine; p++) {
+        int j = p + int(below(state, mine.size() - p));
+        swap(mine[p], mine[j]);
+        into.records.push_back(mine[p]);
+    }
+    for (int p = 0; p < places - from_mine; p++) {
+        int j = p + int(below(state, theirs.size() - p));
+        swap(theirs[p], theirs[j]);
+        into.records.push_back(theirs[p]);
+    }
+
+    into.seen = total;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void merge_evicted(unsigned long long key, long long seen,
+                   const unsigned long long* records, int count, void* user) {
+
+    // PRE:  user points to a Sink
+    //
+    // POST: the evicted reservoir has been merged into the key's sample
+    //       in the sink
+
+    Sink* sink = (Sink*) user;
+    KeySample& sample = sink->samples[key];     // starts with seen = 0
+
+    merge_sample(sample, seen, records, count, sink->size, sink->state);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
@@ -0,0 +1,633 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+generate random disk offsets for storage benchmarks -- uniform, "hot
+and cold", or every block exactly once -- quickly enough that the
+generator never slows the benchmark down, in C++.
+
+
+-------------------------
+Storage Benchmarks
+-------------------------
+
+A storage benchmark measures how many reads and writes ("I/Os") per
+second a disk can do. Each I/O reads or writes a few kilobytes at some
+"offset" (a position, in bytes) on the disk. Fast modern disks can do
+millions of I/Os per second, so choosing the next offset must take only
+a few nanoseconds, and must never allocate memory.
+
+Offsets usually have to be "aligned": a multiple of some size, often
+4096 bytes, because the disk works in whole sectors. So instead of
+choosing a byte, we choose a "slot" number s, and the offset is
+
+        offset = s * alignment
+
+
+-------------------
+Three Patterns
+-------------------
+
+1. Uniform: every slot is equally likely. Using
+
+        slot = rand_range(0, slots - 1)
+
+   is biased when slots doesn't divide evenly into RAND_MAX + 1, and
+   RAND_MAX may be only 32767. Instead, we multiply a random 64-bit
+   number by the number of slots and keep the top 64 bits of the
+   128-bit product (Lemire's method), throwing away the rare few
+   numbers that would make the result uneven.
+
+2. Zipf ("hot and cold"): real disks see some blocks used far more
+   than others. The block of rank r is chosen with chance in
+   proportion to 1 / r^s, using rejection-inversion (see
+   memory_trace.cpp), which needs no tables.
+
+3. Each block exactly once: to read a whole disk in random order, we
+   need a random "permutation" of the slots -- a shuffle. Keeping a
+   table of a billion shuffled slot numbers would take 8 GB, and
+   keeping a set of "already used" slots and retrying makes each
+   choice slower and slower as the disk fills up.
+
+
+--------------------------
+A Keyed Feistel Network
+--------------------------
+
+A "Feistel network" scrambles a number in a way that can always be
+undone, so no two inputs ever give the same output. Split the number
+into a left and a right half, and repeat a few "rounds" of:
+
+        new left  = right
+        new right = left XOR F(key, right)
+
+where F is any scrambling function and each round has its own random
+key. Whatever F is, the step can be undone, so this is a permutation
+of all numbers with that many bits.
+
+To get a permutation of 0 to slots - 1, we use the smallest even
+number of bits that covers slots, and if the output is too large, we
+scramble it again ("cycle walking") until it fits. Since the range is
+less than 4 times too large, this takes less than 4 tries on average.
+
+Then the i-th I/O simply uses slot permute(i): no table, no "already
+used" set, and the same time for every I/O. A new key gives a new
+order for the next pass over the disk.
+
+The same trick scatters Zipf's hot ranks around the disk, so rank 1,
+2, 3, ... are not next to each other.
+
+
+-------------------
+Reads and Writes
+-------------------
+
+Each I/O is a write with a chosen chance, say 30%. We compare one
+random 64-bit number with 0.3 * 2^64, which is a single comparison.
+
+
+----------------------
+Submitting the I/Os
+----------------------
+
+The demonstration simply does the I/Os one at a time with pread() and
+pwrite(). A real benchmark keeps many I/Os in flight at once through
+an asynchronous queue such as Linux's io_uring; each queue entry needs
+exactly what next_io() returns -- offset, length, read or write -- and
+since next_io() never allocates, it can be called right inside the
+loop that fills the queue.
+
+
+----------------
+Review Questions
+----------------
+
+1. Why must offsets often be multiples of 4096?
+
+2. Why is rand_range(0, slots - 1) a poor way to choose a slot?
+
+3. Why does a "retry if already used" method get slower over time?
+
+4. Why can a Feistel network always be undone?
+
+5. What is cycle walking?
+
+6. How is the read or write decision made with one comparison?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the pow(), log() and exp() functions
+
+#include <cmath>
+
+
+// access the vector type and the nth_element() function
+
+#include <vector>
+#include <algorithm>
+
+
+// access the open(), pread(), pwrite(), close() and unlink() functions
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+// constant used to control how many rounds the Feistel network has
+
+const int ROUNDS = 6;
+
+
+// constant used to control the file used by the demonstration I/O loop
+
+const char TEST_FILE[] = "io_offsets_test.bin";
+
+
+// the ways of choosing slots
+
+enum Pattern { UNIFORM, ZIPF, EACH_ONCE };
+
+
+// one I/O; this is everything an asynchronous submission queue (such
+// as Linux's io_uring) needs, apart from the buffer
+
+struct IoRequest {
+    unsigned long long offset;
+    unsigned int length;
+    bool write;
+};
+
+
+// an I/O generator; it is set up once, and then next_io() only reads
+// and updates these fields
+
+struct IoGenerator {
+    Pattern pattern;
+    unsigned long long slots;
+    unsigned long long alignment;
+    unsigned int length;
+    unsigned long long write_limit;
+    unsigned long long state[4];            // xoshiro256** state
+    unsigned long long seed;                // for new permutation keys
+
+    // the keyed Feistel permutation
+    int half_bits;
+    unsigned long long half_mask;
+    unsigned long long keys[ROUNDS];
+    unsigned long long counter;             // I/Os so far in this pass
+    unsigned long long pass;
+
+    // rejection-inversion for Zipf ranks
+    double zipf_exponent;
+    double zipf_low;
+    double zipf_high;
+    double zipf_squeeze;
+};
+
+
+// prototypes for functions to scramble numbers and make random numbers
+
+unsigned long long mix64(unsigned long long z);
+unsigned long long next64(unsigned long long* s);
+unsigned long long bounded(unsigned long long* s, unsigned long long range);
+
+
+// prototypes for functions to work with the keyed permutation
+
+void set_keys(IoGenerator& gen);
+unsigned long long permute(const IoGenerator& gen, unsigned long long i);
+
+
+// prototypes for functions to choose a Zipf rank by rejection-inversion
+
+double zipf_area(double x, double s);
+double zipf_inverse(double area, double s);
+unsigned long long zipf_draw(IoGenerator& gen);
+
+
+// prototype for a function to set up an I/O generator
+
+void init_io(IoGenerator& gen, Pattern pattern, unsigned long long device_bytes,
+             unsigned int length, unsigned long long alignment,
+             double write_share, double zipf_exponent,
+             unsigned long long seed);
+
+
+// prototype for a function to make the next I/O
+
+IoRequest next_io(IoGenerator& gen);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    IoGenerator gen;            // used to hold the generator
+    IoRequest request;          // used to hold one I/O
+    unsigned long long seed;    // used to hold the main seed
+    unsigned long long sum = 0; // used to hold a total of the offsets
+    double start;               // used to hold the starting time
+    const long long SPEED_COUNT = 50000000;
+    const unsigned long long DEVICE = 1ULL << 40;      // 1 TB
+    const char* names[3] = { "uniform", "Zipf", "each once" };
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = ((unsigned long long) rand() << 31) | rand();
+
+    // how fast is each pattern, on a 1 TB device with 4 KB I/Os?
+    cout << endl << "I/Os made per second, 1 TB device, 4 KB I/Os:" << endl;
+    for (int p = 0; p < 3; p++) {
+        init_io(gen, Pattern(p), DEVICE, 4096, 4096, 0.3, 1.1, seed);
+        start = now();
+        for (long long i = 0; i < SPEED_COUNT; i++) {
+            request = next_io(gen);
+            sum += request.offset + request.write;
+        }
+        cout << "    " << names[p] << ": "
+             << SPEED_COUNT / (now() - start) / 1e6 << " million" << endl;
+    }
+    cout << "(total of all offsets: " << sum << ")" << endl;
+
+    // each once really is each once
+    const unsigned long long SLOTS = 10000000;
+    vector<unsigned char> seen(SLOTS, 0);
+    long long repeats = 0;
+
+    init_io(gen, EACH_ONCE, SLOTS * 4096, 4096, 4096, 0.0, 1.0, seed);
+    for (unsigned long long i = 0; i < SLOTS; i++) {
+        request = next_io(gen);
+        if (seen[request.offset / 4096]++) {
+            repeats++;
+        }
+    }
+    cout << endl
+         << "Each once, " << SLOTS << " slots: " << repeats
+         << " slots used twice in the first pass" << endl;
+
+    // how hot are the hottest blocks under Zipf?
+    vector<unsigned int> hits(SLOTS, 0);
+    vector<unsigned int> sorted;
+
+    init_io(gen, ZIPF, SLOTS * 4096, 4096, 4096, 0.0, 1.1, seed);
+    for (unsigned long long i = 0; i < SLOTS; i++) {
+        hits[next_io(gen).offset / 4096]++;
+    }
+    // the hottest 1% of blocks, found without a full sort
+    long long hottest = 0;
+    sorted.assign(hits.begin(), hits.end());
+    nth_element(sorted.begin(), sorted.begin() + SLOTS / 100, sorted.end(),
+                greater<unsigned int>());
+    for (unsigned long long s = 0; s < SLOTS / 100; s++) {
+        hottest += sorted[s];
+    }
+    cout << endl
+         << "Zipf, exponent 1.1: the hottest 1% of blocks got "
+         << 100.0 * hottest / SLOTS << "% of the I/Os" << endl;
+
+    // a simple submission loop, doing the I/Os one at a time with
+    // pread() and pwrite() on a 64 MB test file
+    const int LOOP_COUNT = 100000;
+    const unsigned long long FILE_BYTES = 64ULL << 20;
+    static char buffer[4096];
+    int file = open(TEST_FILE, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (file < 0 || ftruncate(file, FILE_BYTES) != 0) {
+        cout << "Could not create " << TEST_FILE << endl;
+        return 1;
+    }
+
+    init_io(gen, UNIFORM, FILE_BYTES, 4096, 4096, 0.3, 1.0, seed);
+    start = now();
+    for (int i = 0; i < LOOP_COUNT; i++) {
+        request = next_io(gen);
+        ssize_t done = request.write
+            ? pwrite(file, buffer, request.length, request.offset)
+            : pread(file, buffer, request.length, request.offset);
+        if (done != ssize_t(request.length)) {
+            cout << "I/O failed at offset " << request.offset << endl;
+            break;
+        }
+    }
+    cout << endl
+         << "Random 4 KB I/Os, 30% writes, on a 64 MB file (mostly in memory): "
+         << LOOP_COUNT / (now() - start) << " per second" << endl;
+
+    close(file);
+    unlink(TEST_FILE);
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long mix64(unsigned long long z) {
+
+    // PRE:  none
+    //
+    // POST: z has been scrambled with the SplitMix64 mixing function
+    //       and returned
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long next64(unsigned long long* s) {
+
+    // PRE:  s holds a xoshiro256** state, not all 0
+    //
+    // POST: a random 64-bit number has been returned, and s has moved on
+
+    unsigned long long x = s[1] * 5;
+    unsigned long long result = ((x << 7) | (x >> 57)) * 9;
+    unsigned long long t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+
+    return result;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long bounded(unsigned long long* s, unsigned long long range) {
+
+    // PRE:  range >= 1
+    //
+    // POST: a random number from 0 to range - 1 has been returned, each
+    //       exactly equally likely (Lemire's multiply-shift method)
+
+    unsigned __int128 product = (unsigned __int128) next64(s) * range;
+    unsigned long long low = (unsigned long long) product;
+
+    // the low half is below range only rarely; only then is the
+    // (slow) remainder needed to decide whether to try again
+    if (low < range) {
+        unsigned long long threshold = (0 - range) % range;
+        while (low < threshold) {
+            product = (unsigned __int128) next64(s) * range;
+            low = (unsigned long long) product;
+        }
+    }
+
+    return (unsigned long long) (product >> 64);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void set_keys(IoGenerator& gen) {
+
+    // PRE:  gen.seed and gen.pass have been set
+    //
+    // POST: gen.keys hold the round keys for this pass
+
+    for (int r = 0; r < ROUNDS; r++) {
+        gen.keys[r] = mix64(gen.seed + gen.pass * 0x9E3779B97F4A7C15ULL
+                            + (unsigned long long) (r + 1) * 0xD1B54A32D192ED03ULL);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long permute(const IoGenerator& gen, unsigned long long i) {
+
+    // PRE:  i < gen.slots
+    //
+    // POST: the slot at position i of the keyed permutation of 0 to
+    //       gen.slots - 1 has been returned
+
+    do {
+        unsigned long long left = i >> gen.half_bits;
+        unsigned long long right = i & gen.half_mask;
+
+        for (int r = 0; r < ROUNDS; r++) {
+            unsigned long long next = left ^ (mix64(right ^ gen.keys[r])
+                                              & gen.half_mask);
+            left = right;
+            right = next;
+        }
+
+        i = (left << gen.half_bits) | right;
+
+    // too large: walk on until the number fits
+    } while (i >= gen.slots);
+
+    return i;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double zipf_area(double x, double s) {
+
+    // PRE:  x > 0
+    //
+    // POST: the area under the curve 1 / x^s from 1 to x (shifted by a
+    //       constant) has been returned
+
+    if (fabs(1.0 - s) < 1e-9) {
+        return log(x);
+    }
+
+    return (pow(x, 1.0 - s) - 1.0) / (1.0 - s);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double zipf_inverse(double area, double s) {
+
+    // PRE:  area is a value zipf_area() can return
+    //
+    // POST: the x with zipf_area(x, s) == area has been returned
+
+    if (fabs(1.0 - s) < 1e-9) {
+        return exp(area);
+    }
+
+    return pow(1.0 + (1.0 - s) * area, 1.0 / (1.0 - s));
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long zipf_draw(IoGenerator& gen) {
+
+    // PRE:  gen has been set up by init_io()
+    //
+    // POST: a rank from 1 to gen.slots has been returned, rank r with
+    //       chance proportional to 1 / r^s (Hormann and Derflinger's
+    //       rejection-inversion)
+
+    double s = gen.zipf_exponent;
+
+    while (true) {
+        double u = double(next64(gen.state) >> 11) * (1.0 / 9007199254740992.0);
+        double area = gen.zipf_high + u * (gen.zipf_low - gen.zipf_high);
+        double x = zipf_inverse(area, s);
+        double k = floor(x + 0.5);
+
+        k = (k < 1) ? 1 : (k > double(gen.slots) ? double(gen.slots) : k);
+
+        // the point is kept if it is close enough to k, or under k's
+        // share of the area
+        if (k - x <= gen.zipf_squeeze
+            || area >= zipf_area(k + 0.5, s) - pow(k, -s)) {
+            return (unsigned long long) k;
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void init_io(IoGenerator& gen, Pattern pattern, unsigned long long device_bytes,
+             unsigned int length, unsigned long long alignment,
+             double write_share, double zipf_exponent,
+             unsigned long long seed) {
+
+    // PRE:  alignment >= 1, and device_bytes >= length
+    //
+    // POST: gen is ready to make I/Os of length bytes at offsets that
+    //       are multiples of alignment and end inside the device; a
+    //       write_share of them are writes, and the same seed always
+    //       gives the same I/Os
+
+    int bits = 0;
+
+    gen.pattern = pattern;
+    gen.slots = (device_bytes - length) / alignment + 1;
+    gen.alignment = alignment;
+    gen.length = length;
+    gen.seed = seed;
+
+    if (write_share >= 1.0) {
+        gen.write_limit = ~0ULL;
+    } else if (write_share <= 0.0) {
+        gen.write_limit = 0;
+    } else {
+        gen.write_limit = (unsigned long long) (write_share * 18446744073709551616.0);
+    }
+
+    for (int w = 0; w < 4; w++) {
+        gen.state[w] = mix64(seed + (unsigned long long) (w + 1) * 0x9E3779B97F4A7C15ULL);
+    }
+
+    // the permutation works on an even number of bits covering slots
+    while (bits < 64 && (1ULL << bits) < gen.slots) {
+        bits++;
+    }
+    bits += bits & 1;
+    gen.half_bits = (bits < 2) ? 1 : bits / 2;
+    gen.half_mask = (1ULL << gen.half_bits) - 1;
+    gen.counter = 0;
+    gen.pass = 0;
+    set_keys(gen);
+
+    gen.zipf_exponent = zipf_exponent;
+    gen.zipf_low = zipf_area(1.5, zipf_exponent) - 1.0;
+    gen.zipf_high = zipf_area(double(gen.slots) + 0.5, zipf_exponent);
+    gen.zipf_squeeze = 2.0 - zipf_inverse(zipf_area(2.5, zipf_exponent)
+                                          - pow(2.0, -zipf_exponent),
+                                          zipf_exponent);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+IoRequest next_io(IoGenerator& gen) {
+
+    // PRE:  gen has been set up by init_io()
+    //
+    // POST: the next I/O has been returned; nothing has been allocated
+
+    IoRequest request;
+    unsigned long long slot;
+
+    if (gen.pattern == UNIFORM) {
+        slot = bounded(gen.state, gen.slots);
+    } else if (gen.pattern == ZIPF) {
+        slot = permute(gen, zipf_draw(gen) - 1);
+    } else {
+        // after a whole pass, start a new one in a new order
+        if (gen.counter == gen.slots) {
+            gen.counter = 0;
+            gen.pass++;
+            set_keys(gen);
+        }
+        slot = permute(gen, gen.counter++);
+    }
+
+    request.offset = slot * gen.alignment;
+    request.length = gen.length;
+    request.write = (next64(gen.state) < gen.write_limit);
+
+    return request;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
@@ -0,0 +1,601 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+use random numbers to choose good starting points for k-means
+clustering in C++, and how to do it on several cores at once.
+
+
+--------
+k-means
+--------
+
+Clustering means splitting a large set of points into k groups, so
+that points in the same group are close together. The k-means method
+does this by keeping k "centers" and repeating two steps:
+
+    1. Give each point to its nearest center.
+    2. Move each center to the average of its points.
+
+k-means needs k centers to start with, and the final result depends
+a lot on how those first centers are chosen. Choosing them completely
+at random with rand_range() often puts two centers in the same group
+and none in another.
+
+
+--------------------
+k-means++ Seeding
+--------------------
+
+A much better way, called k-means++, chooses the first center at
+random, and then chooses every following center at random too -- but
+not with equal chances. A point that is far away from all the
+centers chosen so far should be more likely to be chosen than a point
+that sits right next to a center.
+
+Let D(x) be the distance from point x to its nearest chosen center.
+k-means++ chooses point x with a chance proportional to D(x)^2 (D
+squared). This is called "D-squared weighting".
+
+Choosing with unequal chances (called "weighted selection") works
+like this. Suppose there are four points with weights 1, 4, 0 and 5:
+
+        point:      0    1    2    3
+        weight:     1    4    0    5
+        running
+        total:      1    5    5   10
+
+We pick a random number r between 0 and 10 (the total), and choose
+the first point whose running total is larger than r. Point 1 covers
+the numbers from 1 up to 5, so it is chosen 4 times out of 10.
+
+After each new center is chosen, every point's D(x)^2 may get
+smaller, so we update it:
+
+        D(x)^2 = smaller of (old D(x)^2, squared distance to new center)
+
+This update is the same simple arithmetic on every point, one after
+another in memory, which the compiler can turn into fast vector
+instructions that handle several points at once.
+
+
+---------------------
+Scalable k-means++
+---------------------
+
+k-means++ has one problem: it chooses the k centers one after
+another, and each choice needs a full pass over all the points. For
+a billion points and a thousand centers, that is a trillion distance
+calculations done in a strict order.
+
+A variant called k-means|| ("k-means parallel") needs only a handful
+of passes:
+
+    1. Choose one center at random.
+    2. Repeat a few times (say 5 "rounds"):
+           For every point x, independently, add x to the candidate
+           centers with chance  L * D(x)^2 / (sum of all D^2),
+           where L is usually about 2k.
+    3. Give each candidate a weight: the number of points that are
+       nearest to it.
+    4. Run ordinary k-means++ on the (few) weighted candidates to
+       choose the final k centers.
+
+In step 2, every point makes its own decision, so the points can be
+split into chunks and handed to different threads.
+
+
+--------------------------------
+Same Seed, Same Answer, Any Cores
+--------------------------------
+
+When several threads draw random numbers, the answer usually depends
+on how many threads there were and which one ran first. That makes
+bugs impossible to reproduce. To avoid this, we split the points into
+chunks of a fixed size, and give every chunk its own random number
+stream (called a "substream"). The seed of each substream is made by
+mixing the main seed, the round number and the chunk number. No matter
+which thread handles a chunk, the chunk draws exactly the same random
+numbers.
+
+
+----------------
+Review Questions
+----------------
+
+1. What do the two steps of k-means do?
+
+2. Why are completely random starting centers often a poor choice?
+
+3. What does D(x) mean?
+
+4. With weights 2, 3 and 5, how often is the third point chosen?
+
+5. Why does k-means++ need a full pass over the points for each center?
+
+6. Why can k-means|| use several threads?
+
+7. What is a substream, and why does each chunk get its own?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand_r() function
+
+#include <cstdlib>
+
+
+// access the time() function
+
+#include <ctime>
+
+
+// access the vector and thread types
+
+#include <vector>
+#include <thread>
+
+
+// constant used to control how many sample points are generated
+
+const int POINTS = 1000000;
+
+
+// constant used to control how many numbers describe each point
+
+const int DIMENSIONS = 4;
+
+
+// constant used to control how many centers are chosen
+
+const int CLUSTERS = 20;
+
+
+// constant used to control how many rounds k-means|| makes
+
+const int ROUNDS = 5;
+
+
+// constant used to control how many points make up one chunk; every
+// chunk has its own random number substream
+
+const int CHUNK_SIZE = 65536;
+
+
+// prototype for a function to make the seed of one substream
+
+unsigned int substream_seed(unsigned int seed, unsigned int round,
+                            unsigned int chunk);
+
+
+// prototype for a function to generate a random number between 0
+// (inclusive) and 1 (exclusive)
+
+double uniform_r(unsigned int* seed);
+
+
+// prototype for a function to choose an index with a chance
+// proportional to its weight
+
+int weighted_select(const vector<double>& weights, double total,
+                    unsigned int* seed);
+
+
+// prototype for a function to lower each point's D^2 using a new
+// center, over a range of points
+
+void update_distances(const double* points, int first, int last,
+                      const double* center, double* distances,
+                      int* closest, int center_index);
+
+
+// prototype for a function to choose k centers with k-means++
+
+vector<int> kmeans_plus_plus(const vector<double>& points,
+                             const vector<double>& weights, int k,
+                             unsigned int seed);
+
+
+// prototype for a function to choose k centers with k-means||
+
+vector<int> kmeans_parallel(const vector<double>& points, int k,
+                            unsigned int seed, int threads);
+
+
+// prototype for a function to work out the sum of D^2 of every point
+// to a list of centers
+
+double seeding_cost(const vector<double>& points,
+                    const vector<int>& centers);
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    vector<double> points;      // used to hold the sample points
+    vector<double> ones;        // used to hold a weight of 1 per point
+    vector<int> centers;        // used to hold the chosen centers
+    unsigned int seed;          // used to hold the main seed
+    int threads;                // used to hold how many threads to use
+
+    // set the main seed by using the number of seconds since the Unix
+    // Epoch
+    seed = (unsigned int) time(0);
+
+    threads = int(thread::hardware_concurrency());
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    // make sample points around CLUSTERS hidden centers, each number
+    // of a hidden center between 0 and 100, and each point within 1 of
+    // its hidden center
+    vector<double> hidden(CLUSTERS * DIMENSIONS);
+    for (int i = 0; i < CLUSTERS * DIMENSIONS; i++) {
+        hidden[i] = 100.0 * uniform_r(&seed);
+    }
+
+    points.resize((long long) POINTS * DIMENSIONS);
+    for (int p = 0; p < POINTS; p++) {
+        int h = int(uniform_r(&seed) * CLUSTERS);
+        for (int d = 0; d < DIMENSIONS; d++) {
+            points[(long long) p * DIMENSIONS + d] =
+                hidden[h * DIMENSIONS + d] + 2.0 * uniform_r(&seed) - 1.0;
+        }
+    }
+
+    cout << endl
+         << "Choosing " << CLUSTERS << " centers for " << POINTS
+         << " points with " << DIMENSIONS << " numbers each" << endl
+         << endl;
+
+    // choose centers at random, for comparison
+    for (int c = 0; c < CLUSTERS; c++) {
+        centers.push_back(int(uniform_r(&seed) * POINTS));
+    }
+    cout << "Random centers:   cost " << seeding_cost(points, centers) << endl;
+
+    // choose centers with k-means++
+    ones.assign(POINTS, 1.0);
+    centers = kmeans_plus_plus(points, ones, CLUSTERS, seed);
+    cout << "k-means++:        cost " << seeding_cost(points, centers) << endl;
+
+    // choose centers with k-means||
+    centers = kmeans_parallel(points, CLUSTERS, seed, threads);
+    cout << "k-means||:        cost " << seeding_cost(points, centers)
+         << " (" << threads << " threads)" << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned int substream_seed(unsigned int seed, unsigned int round,
+                            unsigned int chunk) {
+
+    // PRE:  none
+    //
+    // POST: a seed that depends on all of seed, round and chunk, and
+    //       looks unrelated to the seed of any other round or chunk,
+    //       has been returned
+
+    unsigned long long z;   // used to hold the value being mixed
+
+    // the "SplitMix64" mixing steps scramble every input bit into
+    // every output bit
+    z = ((unsigned long long) seed << 32)
+        ^ ((unsigned long long) round << 24) ^ chunk;
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+
+    return (unsigned int) z;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double uniform_r(unsigned int* seed) {
+
+    // PRE:  seed points to a seed of its own
+    //
+    // POST: a random number between 0 (inclusive) and 1 (exclusive)
+    //       has been returned, and *seed has been updated
+
+    // combine two calls to rand_r() so that even a billion points
+    // can all be reached
+    double high = double(rand_r(seed)) / (double(RAND_MAX) + 1.0);
+    double low = double(rand_r(seed)) / (double(RAND_MAX) + 1.0);
+
+    return high + low / (double(RAND_MAX) + 1.0);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int weighted_select(const vector<double>& weights, double total,
+                    unsigned int* seed) {
+
+    // PRE:  every weight is at least 0, total is their sum, and
+    //       total > 0
+    //
+    // POST: an index i has been returned, chosen with a chance of
+    //       weights[i] / total
+
+    double r = uniform_r(seed) * total;
+    double running = 0;
+
+    for (int i = 0; i < int(weights.size()); i++) {
+        running += weights[i];
+        if (r < running) {
+            return i;
+        }
+    }
+
+    // rounding can leave r just above the final running total, so
+    // fall back to the last index with a weight
+    for (int i = int(weights.size()) - 1; i > 0; i--) {
+        if (weights[i] > 0) {
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void update_distances(const double* points, int first, int last,
+                      const double* center, double* distances,
+                      int* closest, int center_index) {
+
+    // PRE:  points holds DIMENSIONS numbers per point, and first <= last
+    //
+    // POST: for every point from first up to (last - 1), distances
+    //       holds the smaller of its old value and the squared
+    //       distance to center, and closest holds center_index if
+    //       center is now the nearest
+
+    for (int p = first; p < last; p++) {
+
+        const double* x = points + (long long) p * DIMENSIONS;
+        double d2 = 0;
+
+        for (int d = 0; d < DIMENSIONS; d++) {
+            double diff = x[d] - center[d];
+            d2 += diff * diff;
+        }
+
+        if (d2 < distances[p]) {
+            distances[p] = d2;
+            closest[p] = center_index;
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+vector<int> kmeans_plus_plus(const vector<double>& points,
+                             const vector<double>& weights, int k,
+                             unsigned int seed) {
+
+    // PRE:  points holds DIMENSIONS numbers per point, weights holds
+    //       one weight of at least 0 per point, and 1 <= k <= the
+    //       number of points
+    //
+    // POST: the indexes of k centers, chosen by weighted k-means++,
+    //       have been returned
+
+    int n = int(weights.size());
+    vector<int> centers;            // used to hold the chosen centers
+    vector<double> distances(n);    // used to hold each point's D^2
+    vector<int> closest(n);         // used to hold each nearest center
+    vector<double> chances(n);      // used to hold weight * D^2
+    double total = 0;               // used to hold the sum of chances
+
+    // the first center is chosen with a chance proportional to its
+    // weight alone
+    for (int p = 0; p < n; p++) {
+        total += weights[p];
+    }
+    centers.push_back(weighted_select(weights, total, &seed));
+
+    for (int p = 0; p < n; p++) {
+        distances[p] = 1e300;
+    }
+    update_distances(&points[0], 0, n,
+                     &points[(long long) centers[0] * DIMENSIONS],
+                     &distances[0], &closest[0], 0);
+
+    while (int(centers.size()) < k) {
+
+        total = 0;
+        for (int p = 0; p < n; p++) {
+            chances[p] = weights[p] * distances[p];
+            total += chances[p];
+        }
+
+        // every point already sits on a center
+        if (total <= 0) {
+            break;
+        }
+
+        centers.push_back(weighted_select(chances, total, &seed));
+        update_distances(&points[0], 0, n,
+                         &points[(long long) centers.back() * DIMENSIONS],
+                         &distances[0], &closest[0], int(centers.size()) - 1);
+    }
+
+    return centers;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+vector<int> kmeans_parallel(const vector<double>& points, int k,
+                            unsigned int seed, int threads) {
+
+    // PRE:  points holds DIMENSIONS numbers per point, k >= 1, and
+    //       threads >= 1
+    //
+    // POST: the indexes of k centers, chosen by k-means||, have been
+    //       returned; the same seed always gives the same centers, no
+    //       matter how many threads are used
+
+    int n = int(points.size() / DIMENSIONS);
+    int chunks = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    double oversampling = 2.0 * k;
+    vector<int> candidates;         // used to hold the candidate centers
+    vector<double> distances(n);    // used to hold each point's D^2
+    vector<int> closest(n);         // used to hold each nearest candidate
+    double psi;                     // used to hold the sum of all D^2
+
+    unsigned int first_seed = substream_seed(seed, 0, 0);
+    candidates.push_back(int(uniform_r(&first_seed) * n));
+
+    for (int p = 0; p < n; p++) {
+        distances[p] = 1e300;
+    }
+    update_distances(&points[0], 0, n,
+                     &points[(long long) candidates[0] * DIMENSIONS],
+                     &distances[0], &closest[0], 0);
+
+    for (int round = 1; round <= ROUNDS; round++) {
+
+        vector<vector<int> > picked(chunks);    // used to hold each
+                                                // chunk's new candidates
+        vector<thread> workers;
+
+        psi = 0;
+        for (int p = 0; p < n; p++) {
+            psi += distances[p];
+        }
+        if (psi <= 0) {
+            break;
+        }
+
+        // every chunk decides, point by point, which points become
+        // candidates, using its own substream
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(thread([&, t, round]() {
+                for (int c = t; c < chunks; c += threads) {
+                    unsigned int s = substream_seed(seed, round, c);
+                    int last = (c + 1) * CHUNK_SIZE < n
+                               ? (c + 1) * CHUNK_SIZE : n;
+                    for (int p = c * CHUNK_SIZE; p < last; p++) {
+                        if (uniform_r(&s) * psi < oversampling * distances[p]) {
+                            picked[c].push_back(p);
+                        }
+                    }
+                }
+            }));
+        }
+        for (int t = 0; t < threads; t++) {
+            workers[t].join();
+        }
+        workers.clear();
+
+        // add the new candidates in chunk order, then lower every
+        // point's D^2, each thread taking its own chunks
+        int first_new = int(candidates.size());
+        for (int c = 0; c < chunks; c++) {
+            candidates.insert(candidates.end(), picked[c].begin(),
+                              picked[c].end());
+        }
+
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(thread([&, t, first_new]() {
+                for (int c = t; c < chunks; c += threads) {
+                    int last = (c + 1) * CHUNK_SIZE < n
+                               ? (c + 1) * CHUNK_SIZE : n;
+                    for (int i = first_new; i < int(candidates.size()); i++) {
+                        update_distances(&points[0], c * CHUNK_SIZE, last,
+                                         &points[(long long) candidates[i]
+                                                 * DIMENSIONS],
+                                         &distances[0], &closest[0], i);
+                    }
+                }
+            }));
+        }
+        for (int t = 0; t < threads; t++) {
+            workers[t].join();
+        }
+    }
+
+    // weight each candidate by the number of points nearest to it
+    vector<double> weights(candidates.size(), 0.0);
+    for (int p = 0; p < n; p++) {
+        weights[closest[p]] += 1.0;
+    }
+
+    // a few candidates are chosen as the final centers by k-means++
+    vector<double> candidate_points(candidates.size() * DIMENSIONS);
+    for (int i = 0; i < int(candidates.size()); i++) {
+        for (int d = 0; d < DIMENSIONS; d++) {
+            candidate_points[i * DIMENSIONS + d] =
+                points[(long long) candidates[i] * DIMENSIONS + d];
+        }
+    }
+
+    vector<int> chosen = kmeans_plus_plus(candidate_points, weights,
+                                          k < int(candidates.size())
+                                          ? k : int(candidates.size()),
+                                          substream_seed(seed, ROUNDS + 1, 0));
+
+    for (int i = 0; i < int(chosen.size()); i++) {
+        chosen[i] = candidates[chosen[i]];
+    }
+
+    return chosen;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double seeding_cost(const vector<double>& points,
+                    const vector<int>& centers) {
+
+    // PRE:  points holds DIMENSIONS numbers per point, and centers is
+    //       not empty
+    //
+    // POST: the sum over all points of the squared distance to the
+    //       nearest center has been returned
+
+    int n = int(points.size() / DIMENSIONS);
+    vector<double> distances(n, 1e300);
+    vector<int> closest(n);
+    double cost = 0;
+
+    for (int i = 0; i < int(centers.size()); i++) {
+        update_distances(&points[0], 0, n,
+                         &points[(long long) centers[i] * DIMENSIONS],
+                         &distances[0], &closest[0], i);
+    }
+
+    for (int p = 0; p < n; p++) {
+        cost += distances[p];
+    }
+
+    return cost;
+}
@@ -0,0 +1,1166 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+generate fake memory-access "traces" with chosen random properties,
+for testing cache designs, in C++.
+
+
+---------------------------
+Memory Traces and Caches
+---------------------------
+
+A cache is a small, fast memory that keeps copies of recently used
+parts of a big, slow one. Whether a cache design is any good depends
+on the order in which a program touches memory. A list of the
+addresses a program touches, in order, is called a "trace".
+
+Real traces are huge and hard to share, so cache designers often use
+random traces that imitate the important properties of real ones.
+Memory is handled by caches in "lines" of 64 bytes, so the properties
+are about lines:
+
+- Working set: how many different lines the program uses.
+
+- Reuse distance (or "stack distance"): when a line is touched again,
+  how many *different* lines were touched since its last use. A cache
+  that keeps the L most recently used lines hits exactly when the
+  reuse distance is less than L, so the histogram of reuse distances
+  tells us the hit rate of every cache size at once.
+
+- Strides: programs walking through arrays touch addresses a fixed
+  step (the "stride") apart, like 8 bytes for an array of doubles, or
+  4096 bytes for a column of a big table.
+
+- Hotness: a few lines are used far more than the rest. A Zipf
+  distribution, where the line of rank r is used in proportion to
+  1 / r^s, is a good model.
+
+
+---------------------------------
+Choosing a Reuse Distance
+---------------------------------
+
+To make a trace with a given reuse-distance histogram, we keep the
+lines in "most recently used" order, like a stack of cards where each
+used card is moved to the top. For each access we:
+
+    1. Choose a distance d at random from the histogram, using an
+       alias table (see compact_alias_table.cpp).
+    2. Touch the line d places down the stack, and move it to the top.
+
+A line that has never been touched has an "infinite" distance; a
+"cold" draw touches a brand new line, until the working set is full.
+
+Moving a card from the middle of a stack of a million cards is slow
+if the stack is a list. Instead, we give every access a time number
+and remember the time each line was last touched. The line d places
+down the stack is the one with the (d + 1)-th latest time. A
+"Fenwick tree" (or "binary indexed tree") over the time numbers can
+count how many lines were touched in any range of times, and find
+the line with the k-th latest time, in about log2(n) steps.
+
+
+-----------------------
+Strides and Hot Lines
+-----------------------
+
+The other two kinds of access are much cheaper:
+
+- A stride access advances one of a few "streams" by a stride chosen
+  from a list of strides and their chances. The working set is a power
+  of 2 lines, so its size in bytes is a power of 2 too, and a stream
+  wraps around its end with a single AND, however big the stride.
+
+- A hot access picks a rank with the Zipf chances, and turns the rank
+  into a line by multiplying it by a large odd number, so the hot
+  lines are scattered around the working set instead of sitting next
+  to each other. An alias table over a million ranks would be 12 MB,
+  and reading it at random would miss the cache on almost every
+  access, so instead ranks are chosen by "rejection-inversion": a
+  smooth curve that is easy to invert sits just above the Zipf
+  chances, a point is chosen under the curve, and it is kept if it is
+  also under the Zipf chances. Almost every point is kept, and only a
+  few calculations and no tables are needed.
+
+Each access is one of the three kinds, chosen at random with given
+shares, and is a write instead of a read with a given chance. One
+64-bit random number decides both: its top 32 bits choose the kind
+(and, for a stride access, the stream), and its low 32 bits decide
+whether it is a write.
+
+
+------------------------------------
+Why Not Just Use rand_range()?
+------------------------------------
+
+rand_range() in the main tutorial is built on rand(), and so is
+rand_r() in rand_range_histogram.cpp. Neither fits a generator that
+should make a hundred million addresses a second:
+
+- rand() keeps one hidden state for the whole program, guarded by a
+  lock, so threads would take turns instead of working at once.
+- Each call gives only 31 bits, so a 64-bit choice needs three calls.
+- rand() % n favours the small values a little, which shows up in a
+  histogram of billions of accesses.
+
+So the generator uses the same ideas with an engine of its own:
+xoshiro256**, a few shifts and XORs that give 64 good bits a call,
+with its state inside the generator, so every thread has its own. In
+place of the % a number is chosen from 0 to n - 1 by multiplying a
+random 32-bit number by n and keeping the top 32 bits of the product.
+
+
+---------------------
+Many Cores
+---------------------
+
+A reuse access has to look through the Fenwick tree, and for a
+working set of a million lines that is a few cache misses per access,
+so one core makes only a few million reuse accesses a second. Faster
+than that needs more cores. The trace is split into "shards", one per
+thread, and each shard is a trace of its own, like the accesses of one
+core of a many-core chip: it has its own generator, its own recently
+used stack and its own seed, and its reuse distances follow the
+histogram within the shard. Each shard hands its blocks to the
+callback with a user pointer of its own, so the callback needs no
+locks.
+
+
+---------------------
+Saving the Trace
+---------------------
+
+A trace of a billion 8-byte addresses would take 8 GB. Neighbouring
+addresses are often close together, so we save the *difference* from
+the previous address instead, in a "variable length" format where
+small numbers take a single byte. The write flag is kept in the
+lowest bit, since addresses are multiples of 8.
+
+The generator can also hand each block of addresses straight to a
+function (a "callback"), so a cache simulator can use them without
+any file at all.
+
+
+----------------
+Review Questions
+----------------
+
+1. What is a trace?
+
+2. What is the reuse distance of an access?
+
+3. Why does the reuse-distance histogram tell us the hit rate of every
+cache size?
+
+4. What does a Fenwick tree let us do quickly?
+
+5. Why are hot lines multiplied by a large odd number?
+
+6. Why is the difference from the previous address saved, instead of
+the address itself?
+
+7. Why is each shard's trace a trace of its own, instead of the shards
+taking turns adding to one trace?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the pow(), log() and exp() functions
+
+#include <cmath>
+
+
+// access the fopen(), fwrite(), getc() and remove() functions
+
+#include <cstdio>
+
+
+// access the vector and thread types
+
+#include <vector>
+#include <thread>
+
+
+// constant used to control how many bytes are in a cache line
+
+const int LINE_BYTES = 64;
+
+
+// constant used to control how many streams the stride accesses use
+
+const int STREAMS = 4;
+
+
+// constant used to control how many addresses are made at once
+
+const int BLOCK = 4096;
+
+
+// constant used to control the file the demonstration trace is saved in
+
+const char TRACE_FILE[] = "memory_trace.bin";
+
+
+// an alias table for choosing among a few outcomes with given chances
+
+struct AliasTable {
+    vector<double> chance;
+    vector<int> alias;
+};
+
+
+// one bucket of the reuse-distance histogram: distances from the
+// previous bucket's limit up to (but not including) limit
+
+struct ReuseBucket {
+    long long limit;
+    double weight;
+};
+
+
+// the properties of a trace
+
+struct TraceSettings {
+    long long working_set;              // lines; rounded up to a power of 2
+    vector<ReuseBucket> reuse;          // reuse-distance histogram
+    double cold_weight;                 // weight of "never touched" draws
+    vector<long long> strides;          // stride sizes, in bytes
+    vector<double> stride_weights;
+    double zipf_exponent;
+    double reuse_share;                 // shares of the three kinds
+    double stride_share;
+    double hot_share;
+    double write_share;
+};
+
+
+// a trace generator and everything it needs to remember
+
+struct TraceGenerator {
+    long long lines;                    // working set, a power of 2
+    unsigned long long state[4];        // xoshiro256** state
+    AliasTable reuse_table;             // over buckets, then "cold"
+    vector<long long> bucket_low;
+    vector<long long> bucket_high;
+    AliasTable stride_table;
+    vector<long long> strides;
+    double zipf_exponent;               // for rejection-inversion
+    double zipf_low;
+    double zipf_high;
+    double zipf_squeeze;
+    long long stream[STREAMS];          // each stream's byte offset
+    unsigned long long kind_limit[2];   // 32-bit thresholds for the kinds
+    unsigned long long write_limit;     // 32-bit threshold for writes
+
+    // the recently-used stack, kept as a Fenwick tree over time numbers
+    bool track_stack;
+    long long capacity;                 // time numbers before renumbering
+    long long clock;                    // the next time number
+    long long live;                     // lines touched so far
+    long long fresh;                    // next never-touched line
+    vector<int> tree;                   // Fenwick tree of times in use
+    vector<int> last_time;              // per line, -1 if never touched
+    vector<int> owner;                  // per time number, its line
+};
+
+
+// prototype for a function to build an alias table
+
+void build_alias(const vector<double>& weights, AliasTable& table);
+
+
+// prototype for a function to turn a share into a threshold for random
+// 32-bit numbers
+
+unsigned long long share_limit(double share);
+
+
+// prototypes for functions to make random numbers
+
+unsigned long long next64(unsigned long long* s);
+int alias_draw(const AliasTable& table, unsigned long long* s);
+
+
+// prototypes for functions to choose a Zipf rank by rejection-inversion
+
+double zipf_area(double x, double s);
+double zipf_inverse(double area, double s);
+long long zipf_draw(TraceGenerator& gen);
+
+
+// prototypes for functions to work with the Fenwick tree
+
+void tree_add(vector<int>& tree, long long i, int amount);
+long long tree_find(const vector<int>& tree, long long k);
+
+
+// prototype for a function to set up a trace generator
+
+void init_trace(TraceGenerator& gen, const TraceSettings& settings,
+                unsigned long long seed);
+
+
+// prototypes for functions to make the next addresses
+
+void touch_line(TraceGenerator& gen, long long line);
+long long reuse_line(TraceGenerator& gen);
+void next_accesses(TraceGenerator& gen, unsigned long long* out, int count);
+
+
+// a function that receives a block of addresses; the lowest bit of
+// each address is 1 for a write
+
+typedef void (*TraceCallback)(const unsigned long long* addresses, int count,
+                              void* user);
+
+
+// prototypes for functions to hand a trace to a callback (from one
+// thread, or from one thread per shard), or save it
+
+void run_trace(TraceGenerator& gen, long long count, TraceCallback callback,
+               void* user);
+void run_trace_shards(const TraceSettings& settings, unsigned long long seed,
+                      long long count, int shards, TraceCallback callback,
+                      void* const* users);
+long long write_trace(TraceGenerator& gen, long long count,
+                      const char* file_name);
+long long read_trace(const char* file_name, unsigned long long* out,
+                     long long most);
+
+
+// prototype for a function to measure the reuse distances of a trace the
+// slow, simple way, for checking
+
+void measure_reuse(const unsigned long long* addresses, long long count,
+                   const vector<ReuseBucket>& buckets,
+                   vector<long long>& counts);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+// the callback used to time the generator: it adds up the addresses
+// so the work can't be skipped
+
+void sum_addresses(const unsigned long long* addresses, int count,
+                   void* user) {
+
+    unsigned long long* sum = (unsigned long long*) user;
+
+    for (int i = 0; i < count; i++) {
+        *sum += addresses[i];
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    TraceSettings settings;         // used to hold the trace properties
+    TraceGenerator gen;             // used to hold the generator
+    unsigned long long seed;        // used to hold the main seed
+    unsigned long long sum = 0;     // used to hold the callback's total
+    int threads;                    // used to hold how many shards to run
+    vector<unsigned long long> trace;   // used to hold a short trace
+    vector<unsigned long long> saved;   // used to hold it read back
+    vector<long long> counts;       // used to hold a measured histogram
+    long long bytes;                // used to hold the trace file's size
+    double start;                   // used to hold the starting time
+    const long long CHECK_LENGTH = 200000;
+    const long long SPEED_LENGTH = 20000000;
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = ((unsigned long long) rand() << 31) | rand();
+
+    threads = int(thread::hardware_concurrency());
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    // a small working set, reuse accesses only, to check the histogram
+    ReuseBucket buckets[4] = { { 1, 0.3 }, { 16, 0.3 }, { 256, 0.2 },
+                               { 4096, 0.15 } };
+
+    settings.working_set = 4096;
+    settings.reuse.assign(buckets, buckets + 4);
+    settings.cold_weight = 0.05;
+    settings.strides.push_back(8);
+    settings.strides.push_back(64);
+    settings.strides.push_back(4096);
+    settings.stride_weights.push_back(0.6);
+    settings.stride_weights.push_back(0.3);
+    settings.stride_weights.push_back(0.1);
+    settings.zipf_exponent = 1.0;
+    settings.reuse_share = 1.0;
+    settings.stride_share = 0.0;
+    settings.hot_share = 0.0;
+    settings.write_share = 0.3;
+
+    init_trace(gen, settings, seed);
+    trace.resize(CHECK_LENGTH);
+    next_accesses(gen, &trace[0], int(CHECK_LENGTH));
+    measure_reuse(&trace[CHECK_LENGTH / 2], CHECK_LENGTH / 2, settings.reuse,
+                  counts);
+
+    cout << endl
+         << "Reuse distances of the second half of a " << CHECK_LENGTH
+         << "-access trace (4096 lines):" << endl;
+    double total_weight = settings.cold_weight;
+    for (int b = 0; b < 4; b++) {
+        total_weight += buckets[b].weight;
+    }
+    for (int b = 0; b < 4; b++) {
+        cout << "    under " << buckets[b].limit << ": measured "
+             << double(counts[b]) / (CHECK_LENGTH / 2) << ", asked for "
+             << buckets[b].weight / total_weight << endl;
+    }
+    cout << "    (once the working set is full, cold draws reuse the least "
+         << "recently used line)" << endl;
+
+    // save a trace, and read it back
+    init_trace(gen, settings, seed);
+    bytes = write_trace(gen, CHECK_LENGTH, TRACE_FILE);
+    saved.resize(CHECK_LENGTH);
+    bool same = (read_trace(TRACE_FILE, &saved[0], CHECK_LENGTH) == CHECK_LENGTH);
+    for (long long i = 0; same && i < CHECK_LENGTH; i++) {
+        same = (saved[i] == trace[i]);
+    }
+    cout << endl
+         << "Saved trace: " << double(bytes) / CHECK_LENGTH
+         << " bytes per access, read back "
+         << (same ? "correctly" : "INCORRECTLY") << endl;
+    remove(TRACE_FILE);
+
+    // speed, with a million-line working set
+    settings.working_set = 1 << 20;
+    ReuseBucket big[3] = { { 64, 0.5 }, { 4096, 0.3 }, { 1 << 20, 0.15 } };
+    settings.reuse.assign(big, big + 3);
+
+    double shares[3][3] = { { 0.0, 0.5, 0.5 }, { 0.2, 0.4, 0.4 },
+                            { 1.0, 0.0, 0.0 } };
+    vector<unsigned long long> sums(threads, 0);    // one per shard
+    vector<void*> users(threads);
+    for (int t = 0; t < threads; t++) {
+        users[t] = &sums[t];
+    }
+    cout << endl << "Speed, 1,048,576-line working set, in millions of "
+         << "accesses per second:" << endl;
+
+    for (int s = 0; s < 3; s++) {
+        settings.reuse_share = shares[s][0];
+        settings.stride_share = shares[s][1];
+        settings.hot_share = shares[s][2];
+
+        init_trace(gen, settings, seed);
+        start = now();
+        run_trace(gen, SPEED_LENGTH, sum_addresses, &sum);
+        double one = SPEED_LENGTH / (now() - start) / 1e6;
+
+        start = now();
+        run_trace_shards(settings, seed, SPEED_LENGTH * threads, threads,
+                         sum_addresses, &users[0]);
+        double all = SPEED_LENGTH * threads / (now() - start) / 1e6;
+
+        cout << "    reuse " << shares[s][0] << ", stride " << shares[s][1]
+             << ", hot " << shares[s][2] << ": " << one << " on one thread, "
+             << all << " in " << threads << " shards" << endl;
+    }
+
+    for (int t = 0; t < threads; t++) {
+        sum += sums[t];
+    }
+    cout << "(total of all addresses: " << sum << ")" << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void build_alias(const vector<double>& weights, AliasTable& table) {
+
+    // PRE:  weights holds at least one weight, all >= 0, not all 0
+    //
+    // POST: table can choose outcome i with chance weights[i] / (sum
+    //       of weights), using Vose's method
+
+    int n = int(weights.size());
+    double total = 0;
+    vector<double> scaled(n);
+    vector<int> small;
+    vector<int> large;
+
+    for (int i = 0; i < n; i++) {
+        total += weights[i];
+    }
+
+    table.chance.assign(n, 1.0);
+    table.alias.resize(n);
+
+    for (int i = 0; i < n; i++) {
+        scaled[i] = weights[i] * n / total;
+        table.alias[i] = i;
+        if (scaled[i] < 1.0) {
+            small.push_back(i);
+        } else {
+            large.push_back(i);
+        }
+    }
+
+    while (!small.empty() && !large.empty()) {
+        int s = small.back();
+        int l = large.back();
+
+        small.pop_back();
+        table.chance[s] = scaled[s];
+        table.alias[s] = l;
+
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long share_limit(double share) {
+
+    // PRE:  none
+    //
+    // POST: a number has been returned that a random 32-bit number is
+    //       below with chance share (always, if share >= 1)
+
+    if (share >= 1.0) {
+        return 1ULL << 32;
+    }
+    if (share <= 0.0) {
+        return 0;
+    }
+
+    return (unsigned long long) (share * 4294967296.0);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long next64(unsigned long long* s) {
+
+    // PRE:  s holds a xoshiro256** state, not all 0
+    //
+    // POST: a random 64-bit number has been returned, and s has moved on
+
+    unsigned long long x = s[1] * 5;
+    unsigned long long result = ((x << 7) | (x >> 57)) * 9;
+    unsigned long long t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+
+    return result;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int alias_draw(const AliasTable& table, unsigned long long* s) {
+
+    // PRE:  table has been built by build_alias()
+    //
+    // POST: an outcome has been returned, chosen with its chance
+
+    unsigned long long r = next64(s);
+
+    // the high 32 bits choose the column, the low 32 bits the coin
+    int i = int(((r >> 32) * (unsigned long long) table.chance.size()) >> 32);
+    double coin = double(r & 0xFFFFFFFFULL) * (1.0 / 4294967296.0);
+
+    return (coin < table.chance[i]) ? i : table.alias[i];
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double zipf_area(double x, double s) {
+
+    // PRE:  x > 0
+    //
+    // POST: the area under the curve 1 / x^s from 1 to x (shifted by a
+    //       constant) has been returned
+
+    if (fabs(1.0 - s) < 1e-9) {
+        return log(x);
+    }
+
+    return (pow(x, 1.0 - s) - 1.0) / (1.0 - s);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double zipf_inverse(double area, double s) {
+
+    // PRE:  area is a value zipf_area() can return
+    //
+    // POST: the x with zipf_area(x, s) == area has been returned
+
+    if (fabs(1.0 - s) < 1e-9) {
+        return exp(area);
+    }
+
+    return pow(1.0 + (1.0 - s) * area, 1.0 / (1.0 - s));
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+long long zipf_draw(TraceGenerator& gen) {
+
+    // PRE:  gen has been set up by init_trace()
+    //
+    // POST: a rank from 1 to gen.lines has been returned, rank r with
+    //       chance proportional to 1 / r^s (Hormann and Derflinger's
+    //       rejection-inversion)
+
+    double s = gen.zipf_exponent;
+
+    while (true) {
+        double u = double(next64(gen.state) >> 11) * (1.0 / 9007199254740992.0);
+        double area = gen.zipf_high + u * (gen.zipf_low - gen.zipf_high);
+        double x = zipf_inverse(area, s);
+        long long k = (long long) (x + 0.5);
+
+        k = (k < 1) ? 1 : (k > gen.lines ? gen.lines : k);
+
+        // the point is kept if it is close enough to k, or under k's
+        // share of the area
+        if (k - x <= gen.zipf_squeeze
+            || area >= zipf_area(k + 0.5, s) - pow(double(k), -s)) {
+            return k;
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void tree_add(vector<int>& tree, long long i, int amount) {
+
+    // PRE:  0 <= i < tree.size() - 1
+    //
+    // POST: amount has been added to the count at time i
+
+    for (i++; i < (long long) tree.size(); i += i & -i) {
+        tree[i] += amount;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+long long tree_find(const vector<int>& tree, long long k) {
+
+    // PRE:  1 <= k <= the total of all counts, and tree.size() - 1 is a
+    //       power of 2
+    //
+    // POST: the earliest time whose count, added to the counts of all
+    //       earlier times, reaches k has been returned
+
+    long long position = 0;
+
+    for (long long step = (long long) tree.size() - 1; step > 0; step /= 2) {
+        if (position + step < (long long) tree.size()
+            && tree[position + step] < k) {
+            position += step;
+            k -= tree[position];
+        }
+    }
+
+    return position;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void init_trace(TraceGenerator& gen, const TraceSettings& settings,
+                unsigned long long seed) {
+
+    // PRE:  settings.working_set >= 1, the histogram limits go up, the
+    //       stride lists are the same length and not empty, strides are
+    //       multiples of 8, and the shares add up to 1
+    //
+    // POST: gen is ready to make the trace described by settings; the
+    //       same seed always gives the same trace
+
+    vector<double> weights;
+    long long low = 0;
+
+    gen.lines = 1;
+    while (gen.lines < settings.working_set) {
+        gen.lines *= 2;
+    }
+
+    // seed xoshiro256** from SplitMix64
+    for (int w = 0; w < 4; w++) {
+        unsigned long long z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        gen.state[w] = z ^ (z >> 31);
+    }
+
+    // the reuse histogram, with "cold" as the last outcome
+    gen.bucket_low.clear();
+    gen.bucket_high.clear();
+    for (int b = 0; b < int(settings.reuse.size()); b++) {
+        weights.push_back(settings.reuse[b].weight);
+        gen.bucket_low.push_back(low);
+        gen.bucket_high.push_back(settings.reuse[b].limit);
+        low = settings.reuse[b].limit;
+    }
+    weights.push_back(settings.cold_weight);
+    build_alias(weights, gen.reuse_table);
+
+    gen.strides = settings.strides;
+    build_alias(settings.stride_weights, gen.stride_table);
+
+    // rejection-inversion chooses a point between zipf_low and
+    // zipf_high under the curve's area function
+    gen.zipf_exponent = settings.zipf_exponent;
+    gen.zipf_low = zipf_area(1.5, gen.zipf_exponent) - 1.0;
+    gen.zipf_high = zipf_area(gen.lines + 0.5, gen.zipf_exponent);
+    gen.zipf_squeeze = 2.0 - zipf_inverse(zipf_area(2.5, gen.zipf_exponent)
+                                          - pow(2.0, -gen.zipf_exponent),
+                                          gen.zipf_exponent);
+
+    for (int s = 0; s < STREAMS; s++) {
+        gen.stream[s] = (long long) (next64(gen.state) % gen.lines) * LINE_BYTES;
+    }
+
+    // the kinds and the write flag are chosen by comparing the two
+    // halves of a random 64-bit number with thresholds
+    gen.kind_limit[0] = share_limit(settings.reuse_share);
+    gen.kind_limit[1] = share_limit(settings.reuse_share + settings.stride_share);
+    gen.write_limit = share_limit(settings.write_share);
+
+    // the stack is only needed if reuse accesses are asked for; each
+    // line's time is renumbered when the time numbers run out
+    gen.track_stack = (settings.reuse_share > 0);
+    gen.capacity = 2 * gen.lines;
+    gen.clock = 0;
+    gen.live = 0;
+    gen.fresh = 0;
+    if (gen.track_stack) {
+        gen.tree.assign(gen.capacity + 1, 0);
+        gen.last_time.assign(gen.lines, -1);
+        gen.owner.assign(gen.capacity, -1);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void touch_line(TraceGenerator& gen, long long line) {
+
+    // PRE:  0 <= line < gen.lines, and gen.track_stack is true
+    //
+    // POST: line has moved to the top of the recently-used stack
+
+    if (gen.clock == gen.capacity) {
+
+        // out of time numbers: renumber the lines in use 0, 1, 2, ...
+        // keeping their order, and rebuild the tree
+        long long next = 0;
+
+        for (long long t = 0; t < gen.capacity; t++) {
+            long long owner = gen.owner[t];
+            gen.owner[t] = -1;
+            if (owner >= 0 && gen.last_time[owner] == t) {
+                gen.last_time[owner] = next;
+                gen.owner[next] = owner;
+                next++;
+            }
+        }
+
+        gen.tree.assign(gen.capacity + 1, 0);
+        for (long long t = 1; t <= gen.capacity; t++) {
+            gen.tree[t] += (t <= next) ? 1 : 0;
+            long long parent = t + (t & -t);
+            if (parent <= gen.capacity) {
+                gen.tree[parent] += gen.tree[t];
+            }
+        }
+        gen.clock = next;
+    }
+
+    if (gen.last_time[line] >= 0) {
+        tree_add(gen.tree, gen.last_time[line], -1);
+    } else {
+        gen.live++;
+    }
+
+    gen.last_time[line] = gen.clock;
+    gen.owner[gen.clock] = line;
+    tree_add(gen.tree, gen.clock, 1);
+    gen.clock++;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+long long reuse_line(TraceGenerator& gen) {
+
+    // PRE:  gen.track_stack is true
+    //
+    // POST: a line has been returned whose reuse distance was chosen
+    //       from the histogram (it has not been touched yet)
+
+    int bucket = alias_draw(gen.reuse_table, gen.state);
+    long long distance;
+
+    if (bucket == int(gen.bucket_low.size())) {
+
+        // a cold draw: a new line while there are any left, then the
+        // least recently used one
+        if (gen.fresh < gen.lines) {
+            long long line = (gen.fresh * 0x9E3779B97F4A7C15LL) & (gen.lines - 1);
+            while (gen.last_time[line] >= 0 && gen.fresh < gen.lines) {
+                gen.fresh++;
+                line = (gen.fresh * 0x9E3779B97F4A7C15LL) & (gen.lines - 1);
+            }
+            if (gen.fresh < gen.lines) {
+                gen.fresh++;
+                return line;
+            }
+        }
+        distance = gen.live - 1;
+    } else {
+        long long low = gen.bucket_low[bucket];
+        long long width = gen.bucket_high[bucket] - low;
+        distance = low + (long long) ((next64(gen.state) >> 32) * (unsigned long long) width >> 32);
+    }
+
+    // too deep for the lines touched so far: use the deepest
+    if (distance >= gen.live) {
+        if (gen.live == 0) {
+            gen.fresh++;
+            return 0;
+        }
+        distance = gen.live - 1;
+    }
+
+    // the line d places down has the (live - d)-th earliest time
+    return gen.owner[tree_find(gen.tree, gen.live - distance)];
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void next_accesses(TraceGenerator& gen, unsigned long long* out, int count) {
+
+    // PRE:  gen has been set up by init_trace(), and out has room for
+    //       count addresses
+    //
+    // POST: out holds the next count byte addresses of the trace, with
+    //       the lowest bit set for writes
+
+    long long mask = gen.lines - 1;
+    long long byte_mask = gen.lines * LINE_BYTES - 1;
+
+    for (int i = 0; i < count; i++) {
+
+        // the top half chooses the kind, the bottom half the write flag
+        unsigned long long r = next64(gen.state);
+        unsigned long long kind = r >> 32;
+        unsigned long long address;
+
+        if (kind < gen.kind_limit[0]) {
+            address = (unsigned long long) reuse_line(gen) * LINE_BYTES;
+        } else if (kind < gen.kind_limit[1]) {
+            int s = int(kind & (STREAMS - 1));
+            gen.stream[s] = (gen.stream[s]
+                             + gen.strides[alias_draw(gen.stride_table, gen.state)])
+                          & byte_mask;
+            address = gen.stream[s];
+        } else {
+            long long rank = zipf_draw(gen) - 1;
+            address = (unsigned long long) ((rank * 0x9E3779B97F4A7C15LL) & mask)
+                    * LINE_BYTES;
+        }
+
+        if (gen.track_stack) {
+            touch_line(gen, (long long) (address / LINE_BYTES));
+        }
+
+        out[i] = address | ((r & 0xFFFFFFFFULL) < gen.write_limit ? 1 : 0);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void run_trace(TraceGenerator& gen, long long count, TraceCallback callback,
+               void* user) {
+
+    // PRE:  gen has been set up by init_trace()
+    //
+    // POST: the next count addresses have been handed to callback, a
+    //       block at a time
+
+    unsigned long long block[BLOCK];
+
+    while (count > 0) {
+        int n = (count < BLOCK) ? int(count) : BLOCK;
+        next_accesses(gen, block, n);
+        callback(block, n, user);
+        count -= n;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void run_trace_shards(const TraceSettings& settings, unsigned long long seed,
+                      long long count, int shards, TraceCallback callback,
+                      void* const* users) {
+
+    // PRE:  settings are as init_trace() needs, shards >= 1, users
+    //       holds shards pointers, and callback may run on several
+    //       threads at once as long as each has its own user pointer
+    //
+    // POST: count accesses have been made in shards shards, one thread
+    //       each; shard t's trace went to callback with users[t], a
+    //       block at a time, and is the same for the same seed
+
+    vector<thread> workers;
+
+    for (int t = 0; t < shards; t++) {
+        workers.push_back(thread([&, t]() {
+            TraceGenerator gen;
+            long long first = count * t / shards;
+            long long last = count * (t + 1) / shards;
+
+            // init_trace() seeds with the next 4 SplitMix64 numbers
+            // after its seed, so this seed starts each shard just after
+            // the numbers the shard before it used
+            init_trace(gen, settings, seed + 4ULL * t * 0x9E3779B97F4A7C15ULL);
+            run_trace(gen, last - first, callback, users[t]);
+        }));
+    }
+    for (int t = 0; t < shards; t++) {
+        workers[t].join();
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+long long write_trace(TraceGenerator& gen, long long count,
+                      const char* file_name) {
+
+    // PRE:  gen has been set up by init_trace()
+    //
+    // POST: the next count accesses have been saved in file_name, and
+    //       the file's size in bytes has been returned (-1 if it could
+    //       not be written); each access is the difference from the
+    //       previous address, in 8-byte units, "zigzag" coded so small
+    //       negative numbers are small too, shifted up one bit to make
+    //       room for the write flag, and saved 7 bits per byte with the
+    //       top bit meaning "more bytes follow"
+
+    unsigned long long block[BLOCK];
+    unsigned char buffer[BLOCK * 10];
+    long long previous = 0;
+    long long bytes = 0;
+    FILE* file = fopen(file_name, "wb");
+
+    if (file == NULL) {
+        return -1;
+    }
+
+    while (count > 0) {
+        int n = (count < BLOCK) ? int(count) : BLOCK;
+        int used = 0;
+
+        next_accesses(gen, block, n);
+
+        for (int i = 0; i < n; i++) {
+            long long address = (long long) (block[i] >> 3);
+            long long difference = address - previous;
+            unsigned long long code = ((unsigned long long) difference << 1)
+                                    ^ (unsigned long long) (difference >> 63);
+
+            code = (code << 1) | (block[i] & 1);
+            previous = address;
+
+            while (code >= 0x80) {
+                buffer[used++] = (unsigned char) (code | 0x80);
+                code >>= 7;
+            }
+            buffer[used++] = (unsigned char) code;
+        }
+
+        fwrite(buffer, 1, used, file);
+        bytes += used;
+        count -= n;
+    }
+
+    fclose(file);
+
+    return bytes;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+long long read_trace(const char* file_name, unsigned long long* out,
+                     long long most) {
+
+    // PRE:  file_name was saved by write_trace(), and out has room for
+    //       most addresses
+    //
+    // POST: up to most addresses have been read into out, and how many
+    //       has been returned (-1 if the file could not be opened)
+
+    FILE* file = fopen(file_name, "rb");
+    long long previous = 0;
+    long long count = 0;
+    unsigned long long code = 0;
+    int shift = 0;
+    int c;
+
+    if (file == NULL) {
+        return -1;
+    }
+
+    while (count < most && (c = getc(file)) != EOF) {
+        code |= (unsigned long long) (c & 0x7F) << shift;
+        shift += 7;
+        if (c & 0x80) {
+            continue;
+        }
+
+        unsigned long long write = code & 1;
+        unsigned long long zigzag = code >> 1;
+        long long difference = (long long) (zigzag >> 1) ^ -(long long) (zigzag & 1);
+
+        previous += difference;
+        out[count++] = ((unsigned long long) previous << 3) | write;
+        code = 0;
+        shift = 0;
+    }
+
+    fclose(file);
+
+    return count;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void measure_reuse(const unsigned long long* addresses, long long count,
+                   const vector<ReuseBucket>& buckets,
+                   vector<long long>& counts) {
+
+    // PRE:  the histogram limits go up
+    //
+    // POST: counts[b] holds how many of the accesses had a reuse
+    //       distance in bucket b, found by keeping the recently-used
+    //       stack as a plain list (slow, but simple); accesses to lines
+    //       not seen before, or deeper than the last bucket, are not
+    //       counted
+
+    vector<unsigned long long> stack;   // most recent line first
+
+    counts.assign(buckets.size(), 0);
+
+    for (long long i = 0; i < count; i++) {
+
+        unsigned long long line = (addresses[i] & ~1ULL) / LINE_BYTES;
+        long long depth = 0;
+
+        while (depth < (long long) stack.size() && stack[depth] != line) {
+            depth++;
+        }
+
+        if (depth < (long long) stack.size()) {
+            for (int b = 0; b < int(buckets.size()); b++) {
+                if (depth < buckets[b].limit) {
+                    counts[b]++;
+                    break;
+                }
+            }
+            stack.erase(stack.begin() + depth);
+        }
+        stack.insert(stack.begin(), line);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
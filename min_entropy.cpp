@@ -0,0 +1,1231 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+estimate how unpredictable a source of random numbers really is, using
+the "non-IID" tests of NIST's SP 800-90B standard, in C++.
+
+
+--------------------
+How Random Is It?
+--------------------
+
+Everything random in a computer eventually comes from an "entropy
+source": a bit of hardware noise, the timing of key presses, or, in
+the simplest programs, the clock, as in
+
+        srand(int(time(0)));
+
+Before trusting a source, we want to know how hard its output is to
+guess. The measure used is "min-entropy". If the best possible guess
+of the next sample is right with chance p, the min-entropy of a sample
+is
+
+        H = -log2(p)
+
+bits. A perfectly random byte has p = 1/256 and H = 8. A byte that is
+0 half the time has H = 1, no matter how random the other half is,
+because an attacker would just guess 0.
+
+The seconds-since-1970 clock used by srand() above changes once a
+second, so someone who knows roughly when a program started can try
+every likely second: a few thousand guesses.
+
+
+-------------------------------
+Estimating From Samples
+-------------------------------
+
+We can't see p directly; we can only collect a big file of samples
+from the source and look for patterns. SP 800-90B describes a set of
+"estimators", each looking for a different kind of pattern, each
+giving an estimate of H. To be safe, each estimate uses a pessimistic
+"upper confidence bound" on p (99% sure p is no larger), and the
+final answer is the smallest estimate of all.
+
+- Most Common Value: p is the share of samples equal to the most
+  common value.
+
+- Collision (for bits): how many samples does it take until two are
+  equal? The more predictable the bits, the sooner it happens. With
+  bits, a repeat always comes within 3 samples, and the average wait
+  is 3 - p^2 - (1 - p)^2, which we solve for p.
+
+- Markov (for bits): each bit may depend on the one before. From the
+  chances of 0 -> 0, 0 -> 1, 1 -> 0 and 1 -> 1, find the most likely
+  128-bit sequence.
+
+- Compression (for bits): group the bits into 6-bit symbols and
+  measure how far back each symbol was last seen. Predictable data
+  repeats itself sooner, just like a compressor would notice.
+
+- t-Tuple: count how often the most common run of t samples appears,
+  for every t up to where the most common run appears at least 35
+  times.
+
+- Longest Repeated Substring (LRS): for longer runs, too rare to
+  count well, look at how often two positions in the data start the
+  same run.
+
+For data with more than one bit per sample, the bit-only estimators
+are run on the samples written out as bits, and their estimate per
+bit is multiplied by the bits per sample. The bits are packed 64 to a
+word, so writing them out takes no more memory than the samples.
+
+The suffix array below numbers the samples with int, so a file can
+hold at most 2^30 samples -- 1 GiB, one byte per sample (the doubling
+steps stay below 2^31 too). Larger files must be split and estimated
+in parts.
+
+
+-------------------
+The Suffix Array
+-------------------
+
+The t-tuple and LRS estimators need to count every repeated run, of
+every length, in a file of billions of samples. Checking every pair of
+positions would take forever.
+
+A "suffix" is the data from some position to the end. Sort all the
+suffixes (as if they were words in a dictionary), and keep only their
+starting positions: that is the "suffix array". Runs that repeat now
+sit next to each other, because suffixes starting with the same run
+sort together. For each neighbouring pair we also keep how many
+samples they have in common at the start (the "LCP", longest common
+prefix).
+
+Then, for any length W, the groups of suffixes that share their first
+W samples are the stretches of the suffix array where every LCP is at
+least W. A single pass over the LCP numbers with a stack finds all
+these stretches, for all W at once.
+
+The suffix array is built by "prefix doubling": sort by the first
+sample, then use that order to sort by the first 2 samples, then 4,
+then 8, ... Each round is one stable "radix sort" of the positions by
+the rank of their first half. With one thread this is a single
+counting sort on the whole rank, as many counters as there are
+positions. With T threads each thread needs counters of its own, so
+to keep the total the same each thread gets n / T of them, and the
+rank is sorted as two (or more) digits: the low bits, then the high.
+
+
+---------------------
+Many Cores
+---------------------
+
+The estimators don't depend on each other, so each one runs on its own
+thread, and the slow suffix array work overlaps with all the others.
+
+The suffix array is by far the most work, so it is shared among
+threads as well. Every pass of the radix sort splits the positions
+into one piece per thread: each thread counts the digits in its piece,
+the counts are added up (which tells every thread exactly where each
+of its positions goes), and then each thread moves its own piece. The
+new ranks and the LCP numbers are split up the same way.
+
+
+----------------
+Review Questions
+----------------
+
+1. What is the min-entropy of a byte that is 0 half the time?
+
+2. Why is srand(int(time(0))) a weak seed?
+
+3. Why does each estimate use a pessimistic bound on p?
+
+4. What pattern does the Markov estimator look for?
+
+5. Why do repeated runs sit next to each other in a suffix array?
+
+6. How many rounds of prefix doubling are needed if the longest
+repeated run is 100 samples long?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand(), rand_r(), srand() and atoi() functions
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the log2(), sqrt() and pow() functions
+
+#include <cmath>
+
+
+// access the fopen(), fread() and fclose() functions
+
+#include <cstdio>
+
+
+// access the vector and thread types
+
+#include <vector>
+#include <thread>
+
+
+// constant used to control the confidence bound (99%, one-sided)
+
+const double Z_99 = 2.576;
+
+
+// constant used to control how often a run must appear to be counted
+// by the t-tuple estimator
+
+const int TUPLE_CUTOFF = 35;
+
+
+// constants used to control the compression estimator
+
+const int COMPRESSION_BITS = 6;
+const int DICTIONARY_START = 1000;
+
+
+// constant used to control the fewest bits of a rank each pass of the
+// suffix array's radix sort handles, however small the input
+
+const int RADIX_BITS = 11;
+
+
+// constant used to control how many distances the compression
+// estimator keeps the weights of, rather than working them out again
+
+const long long WEIGHT_TABLE = 1LL << 22;
+
+
+// constant used to control the most samples a file may hold (1 GiB),
+// so positions (and the suffix array's doubling steps) fit in an int
+
+const long long MAX_SAMPLES = 1LL << 30;
+
+
+// constant used to control how many samples the demonstration uses
+
+const int DEMO_SAMPLES = 1000000;
+
+
+// the results of all the estimators, in bits per sample; a negative
+// number means the estimator could not be used on this data
+
+struct Estimates {
+    double most_common;
+    double collision;
+    double markov;
+    double compression;
+    double tuple;
+    double lrs;
+};
+
+
+// the samples written out as bits, highest bit of each sample first,
+// packed 64 to a word
+
+struct BitString {
+    vector<unsigned long long> words;
+    long long size;                     // the number of bits
+};
+
+
+// prototype for a function to bound p from above at 99% confidence
+
+double upper_bound(double p, double n);
+
+
+// prototypes for the estimators
+
+double most_common_value(const vector<unsigned char>& s, int symbols);
+double collision_estimate(const BitString& bits);
+double markov_estimate(const BitString& bits);
+double compression_estimate(const BitString& bits);
+double compression_g(double z, long long d, long long length,
+                     const vector<double>& log_later,
+                     const vector<double>& log_first);
+void tuple_and_lrs(const vector<unsigned char>& s, int symbols, int threads,
+                   double& tuple, double& lrs);
+
+
+// prototypes for functions to build the suffix array and LCP numbers
+// on several threads
+
+void radix_sort(vector<int>& items, vector<int>& keys, int limit,
+                int threads, vector<int>& spare_items,
+                vector<int>& spare_keys);
+void suffix_array(const vector<unsigned char>& s, int symbols, int threads,
+                  vector<int>& sa);
+void lcp_array(const vector<unsigned char>& s, const vector<int>& sa,
+               int threads, vector<int>& lcp);
+
+
+// prototypes for functions to write the samples out as bits, and to
+// read one bit back
+
+void pack_bits(const vector<unsigned char>& s, int bits, BitString& b);
+int bit_at(const BitString& b, long long k);
+
+
+// prototype for a function to run every estimator, each on its own
+// thread, with the suffix array shared among threads threads
+
+void estimate_all(const vector<unsigned char>& s, int bits, int threads,
+                  Estimates& e);
+
+
+// prototype for a function to print the estimates
+
+void print_estimates(const char* name, int bits, const Estimates& e);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main(int argc, char* argv[]) {
+
+    vector<unsigned char> samples;  // used to hold the samples
+    Estimates estimates;            // used to hold the results
+    int bits;                       // used to hold the bits per sample
+    int threads;                    // used to hold how many threads to use
+    double start;                   // used to hold the starting time
+
+    threads = int(thread::hardware_concurrency());
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    // with a file name, estimate that file: one sample per byte, using
+    // the lowest BITS bits (8 if not given)
+    if (argc >= 2) {
+        FILE* file = fopen(argv[1], "rb");
+        unsigned char buffer[65536];
+        size_t got;
+
+        bits = (argc >= 3) ? atoi(argv[2]) : 8;
+        if (file == NULL || bits < 1 || bits > 8) {
+            cout << "Usage: " << argv[0] << " [FILE [BITS]]" << endl
+                 << "    FILE holds one sample per byte, at most "
+                 << MAX_SAMPLES << " (1 GiB)" << endl;
+            return 1;
+        }
+        while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            if ((long long) (samples.size() + got) > MAX_SAMPLES) {
+                cout << argv[1] << " holds more than " << MAX_SAMPLES
+                     << " samples (1 GiB); split it and estimate the parts"
+                     << endl;
+                fclose(file);
+                return 1;
+            }
+            for (size_t i = 0; i < got; i++) {
+                samples.push_back((unsigned char) (buffer[i] & ((1 << bits) - 1)));
+            }
+        }
+        fclose(file);
+
+        start = now();
+        estimate_all(samples, bits, threads, estimates);
+        print_estimates(argv[1], bits, estimates);
+        cout << "(" << samples.size() << " samples, " << now() - start
+             << " seconds)" << endl;
+        return 0;
+    }
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+
+    samples.resize(DEMO_SAMPLES);
+
+    // 1. bytes from rand()
+    for (int i = 0; i < DEMO_SAMPLES; i++) {
+        samples[i] = (unsigned char) (rand() >> 8);
+    }
+    start = now();
+    estimate_all(samples, 8, threads, estimates);
+    print_estimates("bytes from rand()", 8, estimates);
+    cout << "(" << now() - start << " seconds)" << endl;
+
+    // 2. a random walk: each byte is the last one plus -1, 0 or 1
+    samples[0] = 128;
+    for (int i = 1; i < DEMO_SAMPLES; i++) {
+        samples[i] = (unsigned char) (samples[i - 1] + rand() % 3 - 1);
+    }
+    estimate_all(samples, 8, threads, estimates);
+    print_estimates("a random walk of bytes", 8, estimates);
+
+    // 3. bits that are 1 80% of the time: H = -log2(0.8) = 0.32
+    for (int i = 0; i < DEMO_SAMPLES; i++) {
+        samples[i] = (rand() % 10 < 8) ? 1 : 0;
+    }
+    estimate_all(samples, 1, threads, estimates);
+    print_estimates("bits that are 1 80% of the time", 1, estimates);
+
+    // 4. the first rand() byte after srand() with the time, for program
+    // starts spread over one hour (the start times are chosen with
+    // rand_r(), since srand() resets rand() itself)
+    unsigned int picker = (unsigned int) time(0);
+    int base = int(time(0));
+    for (int i = 0; i < DEMO_SAMPLES; i++) {
+        srand(base + rand_r(&picker) % 3600);
+        samples[i] = (unsigned char) (rand() >> 8);
+    }
+    estimate_all(samples, 8, threads, estimates);
+    print_estimates("first byte after srand(time), starts within an hour", 8,
+                    estimates);
+    cout << "(the bytes look fine; the weakness is that there are only "
+         << "3600 possible seeds, which no test of the bytes can see)" << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double upper_bound(double p, double n) {
+
+    // PRE:  0 <= p <= 1 and n > 1
+    //
+    // POST: the 99% upper confidence bound on a chance measured as p
+    //       from n samples has been returned (at most 1)
+
+    double bound = p + Z_99 * sqrt(p * (1.0 - p) / (n - 1.0));
+
+    return (bound < 1.0) ? bound : 1.0;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double most_common_value(const vector<unsigned char>& s, int symbols) {
+
+    // PRE:  s holds at least 2 samples, each less than symbols
+    //
+    // POST: the most common value estimate has been returned, in bits
+    //       per sample
+
+    vector<long long> counts(symbols, 0);
+    long long most = 0;
+
+    for (size_t i = 0; i < s.size(); i++) {
+        counts[s[i]]++;
+    }
+    for (int v = 0; v < symbols; v++) {
+        most = (counts[v] > most) ? counts[v] : most;
+    }
+
+    return -log2(upper_bound(double(most) / s.size(), double(s.size())));
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double collision_estimate(const BitString& bits) {
+
+    // PRE:  bits holds at least 4 bits
+    //
+    // POST: the collision estimate has been returned, in bits per bit
+
+    long long n = bits.size;
+    long long v = 0;
+    double sum = 0;
+    double squares = 0;
+    long long i = 0;
+
+    // the wait until a repeat is 2 if the next bit matches, else 3
+    while (i + 2 < n) {
+        int wait = (bit_at(bits, i) == bit_at(bits, i + 1)) ? 2 : 3;
+        sum += wait;
+        squares += double(wait) * wait;
+        v++;
+        i += wait;
+    }
+
+    if (v < 2) {
+        return -1;
+    }
+
+    double mean = sum / v;
+    double sigma = sqrt((squares - v * mean * mean) / (v - 1));
+    double bound = mean - Z_99 * sigma / sqrt(double(v));
+
+    // solve 3 - p^2 - (1 - p)^2 = bound for p between 0.5 and 1
+    double same = 3.0 - bound;          // p^2 + (1 - p)^2
+    double p;
+
+    if (same <= 0.5) {
+        p = 0.5;
+    } else if (same >= 1.0) {
+        p = 1.0;
+    } else {
+        p = 0.5 * (1.0 + sqrt(2.0 * same - 1.0));
+    }
+
+    return -log2(p);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double markov_estimate(const BitString& bits) {
+
+    // PRE:  bits holds at least 2 bits
+    //
+    // POST: the Markov estimate has been returned, in bits per bit
+
+    long long n = bits.size;
+    long long ones = 0;
+    long long pairs[2][2] = { { 0, 0 }, { 0, 0 } };
+
+    for (long long i = 0; i < n; i++) {
+        int bit = bit_at(bits, i);
+        ones += bit;
+        if (i + 1 < n) {
+            pairs[bit][bit_at(bits, i + 1)]++;
+        }
+    }
+
+    // logs of the chances; log2(0) is minus infinity, which is fine
+    double p[2] = { log2(double(n - ones) / n), log2(double(ones) / n) };
+    double t[2][2];
+
+    for (int a = 0; a < 2; a++) {
+        long long from = pairs[a][0] + pairs[a][1];
+        for (int b = 0; b < 2; b++) {
+            t[a][b] = (from > 0) ? log2(double(pairs[a][b]) / from) : -INFINITY;
+        }
+    }
+
+    // the six candidates for the most likely 128-bit sequence
+    double candidates[6] = {
+        p[0] + 127 * t[0][0],                   // 000...0
+        p[0] + 64 * t[0][1] + 63 * t[1][0],     // 0101...
+        p[0] + t[0][1] + 126 * t[1][1],         // 0111...1
+        p[1] + t[1][0] + 126 * t[0][0],         // 1000...0
+        p[1] + 64 * t[1][0] + 63 * t[0][1],     // 1010...
+        p[1] + 127 * t[1][1]                    // 111...1
+    };
+    double best = candidates[0];
+
+    for (int c = 1; c < 6; c++) {
+        best = (candidates[c] > best) ? candidates[c] : best;
+    }
+
+    double h = -best / 128.0;
+
+    return (h < 1.0) ? h : 1.0;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double compression_g(double z, long long d, long long length,
+                     const vector<double>& log_later,
+                     const vector<double>& log_first) {
+
+    // PRE:  0 < z <= 1, d < length, and log_later[u] and log_first[u]
+    //       hold the weights of distance u described in
+    //       compression_estimate() for every u below their size
+    //
+    // POST: one symbol's part of the expected total of log2(distance)
+    //       in the compression estimator has been returned, when that
+    //       symbol has chance z, the dictionary starts with d symbols,
+    //       and there are length symbols in all
+
+    double sum = 0;
+    double stay = 1.0;      // (1 - z)^(u - 1)
+    long long kept = (long long) log_later.size();
+
+    for (long long u = 1; u <= length; u++) {
+
+        // symbol last seen u back, for every later test position, and
+        // first time seen at all, at test position u; the weights of
+        // distances past the table are worked out here
+        if (u < kept) {
+            sum += (z * z * log_later[u] + z * log_first[u]) * stay;
+        } else {
+            double lg = log2(double(u));
+            long long later = length - ((u > d) ? u : d);
+            if (later > 0) {
+                sum += lg * z * z * stay * later;
+            }
+            if (u > d) {
+                sum += lg * z * stay;
+            }
+        }
+
+        stay *= 1.0 - z;
+        if (stay < 1e-20) {
+            break;
+        }
+    }
+
+    return sum;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double compression_estimate(const BitString& bits) {
+
+    // PRE:  none
+    //
+    // POST: the compression estimate has been returned, in bits per bit
+    //       (-1 if there are too few bits)
+
+    const int SYMBOLS = 1 << COMPRESSION_BITS;
+    long long length = bits.size / COMPRESSION_BITS;
+    long long v = length - DICTIONARY_START;
+    long long last_seen[SYMBOLS] = { 0 };
+    double sum = 0;
+    double squares = 0;
+
+    if (v < 2) {
+        return -1;
+    }
+
+    for (long long i = 1; i <= length; i++) {
+
+        int symbol = 0;
+        for (int b = 0; b < COMPRESSION_BITS; b++) {
+            symbol = 2 * symbol + bit_at(bits, (i - 1) * COMPRESSION_BITS + b);
+        }
+
+        if (i > DICTIONARY_START) {
+            double distance = (last_seen[symbol] != 0)
+                            ? double(i - last_seen[symbol]) : double(i);
+            double lg = log2(distance);
+            sum += lg;
+            squares += lg * lg;
+        }
+        last_seen[symbol] = i;
+    }
+
+    double mean = sum / v;
+    double sigma = 0.5907 * sqrt(squares / (v - 1) - mean * mean);
+    double bound = mean - Z_99 * sigma / sqrt(double(v));
+
+    // the weights of each distance u in the expected total do not
+    // depend on p, so they are worked out once, not in every step of
+    // the search: log2(u) times the number of later test positions
+    // that can see the symbol u back, and log2(u) if a symbol first
+    // seen at test position u counts (kept for the first
+    // WEIGHT_TABLE distances)
+    vector<double> log_later(1, 0.0);
+    vector<double> log_first(1, 0.0);
+
+    // binary search for the p whose expected average equals the bound;
+    // the expected average goes down as p goes up
+    double low = 1.0 / SYMBOLS;
+    double high = 1.0;
+    double p = low;
+
+    for (int step = 0; step < 40; step++) {
+        double middle = 0.5 * (low + high);
+        double q = (1.0 - middle) / (SYMBOLS - 1);
+
+        // the smaller chance decays slowest, so it needs the most
+        // distances (until (1 - q)^u < 1e-20); add the ones not worked
+        // out yet
+        long long needed = (long long) (46.1 / q) + 2;
+        needed = (needed < length) ? needed : length;
+        needed = (needed < WEIGHT_TABLE) ? needed : WEIGHT_TABLE;
+        for (long long u = (long long) log_later.size(); u <= needed; u++) {
+            double lg = log2(double(u));
+            long long later = length - ((u > DICTIONARY_START)
+                                        ? u : DICTIONARY_START);
+            log_later.push_back((later > 0) ? lg * double(later) : 0.0);
+            log_first.push_back((u > DICTIONARY_START) ? lg : 0.0);
+        }
+
+        double expected = (compression_g(middle, DICTIONARY_START, length,
+                                         log_later, log_first)
+                           + (SYMBOLS - 1) * compression_g(q, DICTIONARY_START,
+                                                           length, log_later,
+                                                           log_first)) / v;
+        if (expected > bound) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+        p = middle;
+    }
+
+    return -log2(p) / COMPRESSION_BITS;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void radix_sort(vector<int>& items, vector<int>& keys, int limit,
+                int threads, vector<int>& spare_items,
+                vector<int>& spare_keys) {
+
+    // PRE:  items and keys have the same size, every key is from 0 to
+    //       limit - 1, the spares are as large, and threads >= 1
+    //
+    // POST: items (with their keys) have been sorted by key, keeping
+    //       items with equal keys in the same order; the spares hold
+    //       nothing useful
+
+    int n = int(items.size());
+    long long budget = n / threads;     // used to hold how many counters
+                                        // each thread may have
+    int digit_bits = 0;                 // used to hold the bits per pass
+    int key_bits = 1;                   // used to hold the bits of a key
+    int bins;                           // used to hold the counters per
+                                        // thread
+    int mask;                           // used to pick a digit out of a key
+
+    if (budget < (1 << RADIX_BITS)) {
+        budget = 1 << RADIX_BITS;
+    }
+    while (((long long) (limit - 1) >> key_bits) > 0) {
+        key_bits++;
+    }
+
+    if (limit <= budget) {
+
+        // the whole key is one digit
+        digit_bits = key_bits;
+        bins = limit;
+        mask = -1;
+    } else {
+
+        // as few passes as fit the budget, with the bits shared evenly
+        int most = 0;
+        while ((2LL << most) <= budget) {
+            most++;
+        }
+        int passes = (key_bits + most - 1) / most;
+        digit_bits = (key_bits + passes - 1) / passes;
+        bins = 1 << digit_bits;
+        mask = bins - 1;
+    }
+
+    vector<int> counts((long long) threads * bins);    // counts[t * bins + d]
+
+    // one pass for every digit_bits bits that limit - 1 needs
+    for (int shift = 0; shift < key_bits; shift += digit_bits) {
+
+        vector<thread> workers;
+
+        // each thread counts the digits in its own piece
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(thread([&, t]() {
+                int* count = &counts[(long long) t * bins];
+                int first = int((long long) n * t / threads);
+                int last = int((long long) n * (t + 1) / threads);
+
+                for (int d = 0; d < bins; d++) {
+                    count[d] = 0;
+                }
+                for (int i = first; i < last; i++) {
+                    count[(keys[i] >> shift) & mask]++;
+                }
+            }));
+        }
+        for (int t = 0; t < threads; t++) {
+            workers[t].join();
+        }
+        workers.clear();
+
+        // turn the counts into where each thread's first item with
+        // each digit goes: after every smaller digit, and after the
+        // same digit in the pieces before it
+        int place = 0;
+        for (int d = 0; d < bins; d++) {
+            for (int t = 0; t < threads; t++) {
+                int count = counts[(long long) t * bins + d];
+                counts[(long long) t * bins + d] = place;
+                place += count;
+            }
+        }
+
+        // each thread moves its own piece, in order
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(thread([&, t]() {
+                int* where = &counts[(long long) t * bins];
+                int first = int((long long) n * t / threads);
+                int last = int((long long) n * (t + 1) / threads);
+
+                for (int i = first; i < last; i++) {
+                    int to = where[(keys[i] >> shift) & mask]++;
+                    spare_items[to] = items[i];
+                    spare_keys[to] = keys[i];
+                }
+            }));
+        }
+        for (int t = 0; t < threads; t++) {
+            workers[t].join();
+        }
+
+        items.swap(spare_items);
+        keys.swap(spare_keys);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void suffix_array(const vector<unsigned char>& s, int symbols, int threads,
+                  vector<int>& sa) {
+
+    // PRE:  every sample in s is less than symbols, s holds at most
+    //       MAX_SAMPLES samples, and threads >= 1
+    //
+    // POST: sa holds the starting positions of the suffixes of s, in
+    //       sorted order, built by prefix doubling with radix sort on
+    //       threads threads
+
+    int n = int(s.size());
+    vector<int> rank(n);
+    vector<int> next(n);
+    vector<int> keys(n);
+    vector<int> spare_keys(n);
+    vector<int> counted(threads);       // used to hold what each piece
+                                        // adds up to
+    vector<int> pieces(threads + 1);    // used to hold where each
+                                        // piece's part of the total
+                                        // starts
+    vector<thread> workers;
+    int classes;
+
+    // runs work(t, first, last) on each thread t's piece of 0 .. n - 1,
+    // then sets pieces from the counts they returned
+    auto split = [&](auto work) {
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(thread([&, t]() {
+                int first = int((long long) n * t / threads);
+                int last = int((long long) n * (t + 1) / threads);
+                counted[t] = work(t, first, last);
+            }));
+        }
+        for (int t = 0; t < threads; t++) {
+            workers[t].join();
+        }
+        workers.clear();
+
+        pieces[0] = 0;
+        for (int t = 0; t < threads; t++) {
+            pieces[t + 1] = pieces[t] + counted[t];
+        }
+    };
+
+    // a position in sa whose suffix differs from the one before it in
+    // the first 2h samples (1 when h is 0) starts a new class; each
+    // thread marks and counts these in its piece, then numbers its
+    // piece from where the pieces before it ended
+    auto number_classes = [&](int h) {
+        split([&](int, int first, int last) {
+            int count = 0;
+            for (int i = (first > 0 ? first : 1); i < last; i++) {
+
+                // keys still holds the rank of each one's first half
+                int differs = (keys[i - 1] != keys[i]);
+                if (!differs && h > 0) {
+                    int a = sa[i - 1] + h;
+                    int b = sa[i] + h;
+                    differs = (a < n ? rank[a] : -1) != (b < n ? rank[b] : -1);
+                }
+                spare_keys[i] = differs;
+                count += differs;
+            }
+            return count;
+        });
+        classes = pieces[threads] + 1;
+
+        split([&](int t, int first, int last) {
+            int number = pieces[t];
+            for (int i = first; i < last; i++) {
+                if (i > 0) {
+                    number += spare_keys[i];
+                }
+                next[sa[i]] = number;
+            }
+            return 0;
+        });
+        rank.swap(next);
+    };
+
+    sa.resize(n);
+    if (n == 0) {
+        return;
+    }
+
+    // sort by the first sample
+    split([&](int, int first, int last) {
+        for (int i = first; i < last; i++) {
+            sa[i] = i;
+            keys[i] = s[i];
+        }
+        return 0;
+    });
+    radix_sort(sa, keys, symbols, threads, next, spare_keys);
+    number_classes(0);
+
+    for (int h = 1; classes < n; h *= 2) {
+
+        // order by the second half: suffixes too short for one come
+        // first, then the rest in the order of their second half; each
+        // thread counts the ones in its piece of sa that have a second
+        // half, to know where its part of the order starts
+        split([&](int, int first, int last) {
+            int count = 0;
+            for (int i = first; i < last; i++) {
+                count += (sa[i] >= h);
+            }
+            return count;
+        });
+        split([&](int t, int first, int last) {
+            int k = h + pieces[t];
+            for (int i = first; i < last; i++) {
+                if (sa[i] >= h) {
+                    keys[k++] = sa[i] - h;
+                }
+            }
+            for (int i = first; i < last && i < h; i++) {
+                keys[i] = n - h + i;
+            }
+            return 0;
+        });
+        sa.swap(keys);
+
+        // then a stable sort by the first half
+        split([&](int, int first, int last) {
+            for (int i = first; i < last; i++) {
+                keys[i] = rank[sa[i]];
+            }
+            return 0;
+        });
+        radix_sort(sa, keys, classes, threads, next, spare_keys);
+
+        // new ranks, for the first 2h samples
+        number_classes(h);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void lcp_array(const vector<unsigned char>& s, const vector<int>& sa,
+               int threads, vector<int>& lcp) {
+
+    // PRE:  sa is the suffix array of s, and threads >= 1
+    //
+    // POST: lcp[i] holds how many samples the suffixes sa[i - 1] and
+    //       sa[i] have in common at the start (lcp[0] = 0), found with
+    //       Kasai's method on threads threads
+
+    int n = int(s.size());
+    vector<int> where(n);
+    vector<thread> workers;
+
+    lcp.assign(n, 0);
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&, t]() {
+            int first = int((long long) n * t / threads);
+            int last = int((long long) n * (t + 1) / threads);
+            for (int i = first; i < last; i++) {
+                where[sa[i]] = i;
+            }
+        }));
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+    workers.clear();
+
+    // going through the suffixes from longest to shortest, the common
+    // part shrinks by at most one each time; each thread takes its own
+    // run of suffixes, starting again from nothing in common
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&, t]() {
+            int first = int((long long) n * t / threads);
+            int last = int((long long) n * (t + 1) / threads);
+            int common = 0;
+
+            for (int i = first; i < last; i++) {
+                if (where[i] == 0) {
+                    common = 0;
+                    continue;
+                }
+                int j = sa[where[i] - 1];
+                while (i + common < n && j + common < n
+                        && s[i + common] == s[j + common]) {
+                    common++;
+                }
+                lcp[where[i]] = common;
+                if (common > 0) {
+                    common--;
+                }
+            }
+        }));
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void tuple_and_lrs(const vector<unsigned char>& s, int symbols, int threads,
+                   double& tuple, double& lrs) {
+
+    // PRE:  s holds at least 2 samples, each less than symbols, and
+    //       threads >= 1
+    //
+    // POST: tuple and lrs hold the t-tuple and LRS estimates, in bits
+    //       per sample (-1 if the data has no runs common enough)
+
+    vector<int> sa;
+    vector<int> lcp;
+    int n = int(s.size());
+    int longest = 0;
+
+    suffix_array(s, symbols, threads, sa);
+    lcp_array(s, sa, threads, lcp);
+
+    for (int i = 0; i < n; i++) {
+        longest = (lcp[i] > longest) ? lcp[i] : longest;
+    }
+
+    // most[W]: the largest group sharing the first W samples, and
+    // pairs[W]: how many pairs of positions share the first W samples
+    vector<long long> most(longest + 2, 1);
+    vector<double> pairs(longest + 2, 0.0);
+
+    // each stretch of the suffix array whose LCPs are all at least L,
+    // inside a stretch whose LCPs are at least P < L, is one group of
+    // "size" suffixes sharing their first W samples for W = P + 1 .. L
+    vector<int> stack_lcp(1, 0);
+    vector<int> stack_start(1, 0);
+
+    for (int i = 1; i <= n; i++) {
+        int current = (i < n) ? lcp[i] : 0;
+        int start = i - 1;
+
+        while (current < stack_lcp.back()) {
+            int l = stack_lcp.back();
+            start = stack_start.back();
+            stack_lcp.pop_back();
+            stack_start.pop_back();
+
+            int parent = (current > stack_lcp.back()) ? current : stack_lcp.back();
+            long long size = i - start;
+            double group_pairs = 0.5 * double(size) * double(size - 1);
+
+            most[l] = (size > most[l]) ? size : most[l];
+            pairs[parent + 1] += group_pairs;
+            pairs[l + 1] -= group_pairs;
+        }
+
+        if (current > stack_lcp.back()) {
+            stack_lcp.push_back(current);
+            stack_start.push_back(start);
+        }
+    }
+
+    // a group for length L is also a group for every shorter length
+    for (int w = longest - 1; w >= 1; w--) {
+        most[w] = (most[w + 1] > most[w]) ? most[w + 1] : most[w];
+    }
+    for (int w = 1; w <= longest + 1; w++) {
+        pairs[w] += pairs[w - 1];
+    }
+
+    // single samples can be common without repeating as pairs, so the
+    // t = 1 count comes straight from the counts
+    vector<long long> counts(symbols, 0);
+    for (int i = 0; i < n; i++) {
+        counts[s[i]]++;
+    }
+    most[0] = 0;
+    for (int v = 0; v < symbols; v++) {
+        most[0] = (counts[v] > most[0]) ? counts[v] : most[0];
+    }
+    if (longest >= 1) {
+        most[1] = (most[0] > most[1]) ? most[0] : most[1];
+    }
+
+    // t-tuple: every t whose most common run appears at least 35 times
+    double best = 0;
+    int t = 0;
+    while (t + 1 <= longest && most[t + 1] >= TUPLE_CUTOFF) {
+        t++;
+        double p = pow(double(most[t]) / (n - t + 1), 1.0 / t);
+        best = (p > best) ? p : best;
+    }
+    if (t == 0) {
+        best = double(most[0]) / n;
+        t = 1;
+    }
+    tuple = -log2(upper_bound(best, n));
+
+    // LRS: the longer lengths, up to the longest repeat
+    best = 0;
+    for (int w = t + 1; w <= longest; w++) {
+        double total = 0.5 * double(n - w + 1) * double(n - w);
+        double p = pow(pairs[w] / total, 1.0 / w);
+        best = (p > best) ? p : best;
+    }
+    lrs = (t + 1 <= longest) ? -log2(upper_bound(best, n)) : -1;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void estimate_all(const vector<unsigned char>& s, int bits, int threads,
+                  Estimates& e) {
+
+    // PRE:  s holds at least 2 samples, each using the lowest bits bits,
+    //       and threads >= 1
+    //
+    // POST: e holds every estimate, in bits per sample
+
+    BitString bitstring;
+    vector<thread> workers;
+    double collision = -1;
+    double markov = -1;
+    double compression = -1;
+
+    // the bit-only estimators use the samples written out as bits
+    pack_bits(s, bits, bitstring);
+
+    workers.push_back(thread([&]() {
+        e.most_common = most_common_value(s, 1 << bits);
+    }));
+    workers.push_back(thread([&]() {
+        collision = collision_estimate(bitstring);
+    }));
+    workers.push_back(thread([&]() {
+        markov = markov_estimate(bitstring);
+    }));
+    workers.push_back(thread([&]() {
+        compression = compression_estimate(bitstring);
+    }));
+    workers.push_back(thread([&]() {
+        tuple_and_lrs(s, 1 << bits, threads, e.tuple, e.lrs);
+    }));
+
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+
+    e.collision = (collision < 0) ? -1 : collision * bits;
+    e.markov = (markov < 0) ? -1 : markov * bits;
+    e.compression = (compression < 0) ? -1 : compression * bits;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void pack_bits(const vector<unsigned char>& s, int bits, BitString& b) {
+
+    // PRE:  each sample in s uses only its lowest bits bits
+    //
+    // POST: b holds the samples written out as bits, highest bit of
+    //       each sample first, bit k of the string in bit k % 64 of
+    //       word k / 64
+
+    b.size = (long long) s.size() * bits;
+    b.words.assign((b.size + 63) / 64, 0);
+
+    long long k = 0;
+    for (size_t i = 0; i < s.size(); i++) {
+        for (int j = bits - 1; j >= 0; j--) {
+            b.words[k >> 6] |= (unsigned long long) ((s[i] >> j) & 1) << (k & 63);
+            k++;
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+inline int bit_at(const BitString& b, long long k) {
+
+    // PRE:  0 <= k < b.size
+    //
+    // POST: bit k of the string has been returned
+
+    return int(b.words[k >> 6] >> (k & 63)) & 1;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void print_estimates(const char* name, int bits, const Estimates& e) {
+
+    // PRE:  e has been filled by estimate_all()
+    //
+    // POST: each estimate, and the smallest, has been printed
+
+    const char* names[6] = { "most common value", "collision", "Markov",
+                             "compression", "t-tuple", "LRS" };
+    double values[6] = { e.most_common, e.collision, e.markov,
+                         e.compression, e.tuple, e.lrs };
+    double smallest = bits;
+
+    cout << endl << name << " (" << bits << " bits per sample):" << endl;
+
+    for (int i = 0; i < 6; i++) {
+        cout << "    " << names[i] << ": ";
+        if (values[i] < 0) {
+            cout << "not enough data" << endl;
+            continue;
+        }
+        cout << values[i] + 0.0 << endl;
+        smallest = (values[i] < smallest) ? values[i] : smallest;
+    }
+
+    cout << "    min-entropy: " << smallest + 0.0 << " bits per sample" << endl;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
@@ -0,0 +1,917 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+draw random samples from a complicated distribution with Markov chain
+Monte Carlo (MCMC), running many chains on several cores at once, in
+C++.
+
+
+-----------------------
+Why Random Walks?
+-----------------------
+
+Sometimes we know the shape of a distribution -- a formula that says
+how likely each point x is, up to a constant -- but there is no simple
+way to draw random numbers from it like rand_range() does. This
+happens all the time in statistics, when "fitting" a model to data.
+
+MCMC solves this by taking a random walk. The walker's position is
+called the "state" of the "chain". The rules of the walk are chosen so
+that, after enough steps, the walker spends time at each point in
+proportion to how likely that point is. The positions it visits are
+then our samples.
+
+We work with log p(x), the logarithm of the likelihood, because the
+likelihoods themselves are often too tiny for a double.
+
+
+------------------------------
+Random-Walk Metropolis
+------------------------------
+
+The simplest rule is the Metropolis rule. From the current state x:
+
+    1. Propose a new state y = x + (a small random step).
+    2. If y is more likely than x, move to y.
+    3. Otherwise move to y with chance p(y) / p(x), and stay at x
+       the rest of the time.
+
+The size of the step matters. Too small, and the walker crawls.
+Too large, and almost every proposal is rejected. A common target is
+to accept about 1 step in 4; during a "warm-up" period we adjust each
+chain's step size to get close to that.
+
+
+----------------
+Slice Sampling
+----------------
+
+Slice sampling needs no step size tuning. To update one coordinate of
+x:
+
+    1. Draw a random height under p(x), between 0 and p(x).
+    2. The "slice" is every value of the coordinate where p is above
+       that height. Find an interval that covers it by "stepping out"
+       from x a fixed width at a time.
+    3. Choose a random point in the interval. If it is in the slice,
+       move there. If not, shrink the interval towards x and try
+       again.
+
+
+------------------------
+Parallel Tempering
+------------------------
+
+Both rules have trouble when the distribution has two or more "modes"
+(peaks) with unlikely country between them: a walker that starts near
+one peak may never cross to the other.
+
+Parallel tempering runs a "ladder" of chains on flattened versions of
+the distribution, p(x)^beta, with beta going from 1 (the real
+distribution) down to a small number (nearly flat, so crossing is
+easy). Every so often, two neighbouring chains on the ladder try to
+swap states, with chance
+
+        exp((beta_a - beta_b) * (log p(x_b) - log p(x_a)))
+
+(or always, if that is above 1). States found by the hot chains
+drift down the ladder, and the beta = 1 chain, whose states are the
+samples we keep, visits every peak.
+
+
+-------------------------
+Many Chains, Many Cores
+-------------------------
+
+Running hundreds of chains helps twice: they can run on every core at
+once, and comparing chains tells us whether they have converged. For
+this to work:
+
+- Each chain needs its own random number stream, made from one main
+  seed and the chain number, so a run can be repeated exactly no
+  matter how the chains are shared between threads.
+
+- Chains on one ladder swap states with each other, so a whole
+  ladder is always run by the same thread, and swaps need no locks.
+
+- The states are stored "structure of arrays" style: all the chains'
+  first coordinates, then all their second coordinates, and so on.
+  Each chain's step size, random stream and log p are also in their
+  own arrays.
+
+
+------------------------------
+When Have We Run Long Enough?
+------------------------------
+
+Two numbers are kept up to date as the chains run:
+
+- R-hat compares the spread within each chain to the spread between
+  the chains' averages. If the chains are all sampling the same
+  distribution, R-hat is close to 1 (say below 1.01). A chain stuck on
+  one peak pushes R-hat up.
+
+- The "effective sample size" (ESS). Neighbouring steps of a random
+  walk are alike, so 1000 steps are worth fewer than 1000 independent
+  samples. We estimate how many by grouping each chain's samples into
+  batches of 50: the more the batch averages vary, compared to single
+  samples, the fewer independent samples we really have. The batch
+  averages' spread is pooled over all the chains, so chains that
+  disagree (and so have different averages) count as few samples, not
+  as many samples each, even if each chain on its own mixes well.
+
+Sampling stops as soon as R-hat is small enough and the ESS is large
+enough, instead of running for a fixed, guessed number of steps.
+
+
+----------------
+Review Questions
+----------------
+
+1. Why do we work with log p(x) instead of p(x)?
+
+2. In the Metropolis rule, when is a proposed step always accepted?
+
+3. What goes wrong when the step size is too large? Too small?
+
+4. What are the two steps for finding the interval in slice
+sampling?
+
+5. Why does parallel tempering help with a distribution that has two
+peaks?
+
+6. Why is a whole ladder run by the same thread?
+
+7. What does an R-hat well above 1 tell us?
+
+8. Why is the effective sample size smaller than the number of steps?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the exp(), log() and sqrt() functions
+
+#include <cmath>
+
+
+// access the vector and thread types, and the swap() function
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+
+// constant used to control how many coordinates each state has
+
+const int DIMENSIONS = 4;
+
+
+// constant used to control where the two peaks of the example
+// distribution are: at (3, 3, 3, 3) and (-3, -3, -3, -3)
+
+const double PEAK = 3.0;
+
+
+// constant used to control how many ladders of chains are run
+
+const int LADDERS = 32;
+
+
+// constants used to control the largest and smallest beta on a ladder
+
+const double COLDEST_BETA = 1.0;
+const double HOTTEST_BETA = 0.05;
+
+
+// constants used to control how many sweeps are run between checks,
+// and how many checks are spent warming up
+
+const int SWEEPS_PER_CHECK = 200;
+const int WARMUP_CHECKS = 3;
+const int MAX_CHECKS = 100;
+
+
+// constants used to control when sampling stops
+
+const double RHAT_TARGET = 1.01;
+const double ESS_TARGET = 4000.0;
+
+
+// constant used to control how many samples are in each batch when
+// estimating the effective sample size
+
+const int BATCH_LENGTH = 50;
+
+
+// constants used to control slice sampling's stepping out
+
+const double SLICE_WIDTH = 2.0;
+const int SLICE_MAX_STEPS = 20;
+
+
+// the update rule each chain uses
+
+enum Method { METROPOLIS, SLICE };
+
+
+// all the chains' states, stored structure of arrays style; chain
+// number c is temperature c % temperatures of ladder c / temperatures
+
+struct Chains {
+    int ladders;
+    int temperatures;
+    int count;                          // ladders * temperatures
+    vector<double> x;                   // x[d * count + c] is chain c's
+                                        // coordinate d
+    vector<double> logp;                // log p(x) (not tempered)
+    vector<double> beta;
+    vector<double> step;
+    vector<unsigned long long> rng;
+    vector<long long> accepted;
+    vector<long long> tried;
+    vector<long long> swaps_accepted;   // per ladder
+    vector<long long> swaps_tried;
+};
+
+
+// running totals for the beta = 1 chain of each ladder, used to work
+// out R-hat and the effective sample size
+
+struct Diagnostics {
+    long long n;                        // samples per chain so far
+    vector<double> mean;                // [ladder * DIMENSIONS + d]
+    vector<double> m2;
+    vector<double> batch_sum;
+    long long batches;                  // full batches per chain
+    vector<double> batch_mean;          // average of batch averages
+    vector<double> batch_m2;
+};
+
+
+// prototype for a function giving log p(x) for the example distribution
+
+double log_density(const double* x);
+
+
+// prototypes for functions to make random numbers from a chain's
+// stream
+
+unsigned long long next64(unsigned long long& state);
+double uniform(unsigned long long& state);
+double normal(unsigned long long& state);
+
+
+// prototype for a function to make one chain's seed from the main seed
+
+unsigned long long substream_seed(unsigned long long seed, int chain);
+
+
+// prototype for a function to set up the chains
+
+void init_chains(Chains& chains, int ladders, int temperatures,
+                 unsigned long long seed);
+
+
+// prototypes for functions to update one chain
+
+void metropolis_step(Chains& chains, int c);
+void slice_step(Chains& chains, int c);
+
+
+// prototype for a function to try swapping neighbouring states on a
+// ladder
+
+void tempering_swaps(Chains& chains, int ladder);
+
+
+// prototypes for functions to keep and read the diagnostics
+
+void reset_diagnostics(Diagnostics& diag, int ladders);
+void record_sample(Diagnostics& diag, const Chains& chains, int ladder,
+                   long long index);
+void convergence(const Diagnostics& diag, int ladders, double& rhat,
+                 double& ess);
+
+
+// prototype for a function to run chains until they converge
+
+int run_chains(Chains& chains, Method method, int threads, double& rhat,
+               double& ess, double& upper_peak);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    Chains chains;              // used to hold the chains
+    unsigned long long seed;    // used to hold the main seed
+    int threads;                // used to hold how many threads to use
+    int checks;                 // used to hold how many checks were run
+    double rhat;                // used to hold the final R-hat
+    double ess;                 // used to hold the final sample size
+    double upper_peak;          // used to hold the share of samples near
+                                // the upper peak
+    double start;               // used to hold the starting time
+    const char* names[3] = { "Metropolis, no tempering",
+                             "Metropolis, 6 temperatures",
+                             "slice sampling, 6 temperatures" };
+    Method methods[3] = { METROPOLIS, METROPOLIS, SLICE };
+    int temperatures[3] = { 1, 6, 6 };
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = ((unsigned long long) rand() << 31) | rand();
+
+    threads = int(thread::hardware_concurrency());
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    cout << endl
+         << "Sampling a " << DIMENSIONS << "-dimensional distribution with "
+         << "two peaks, using " << LADDERS << " ladders on " << threads
+         << " threads" << endl
+         << "(a well-mixed run has about half its samples near each peak)"
+         << endl << endl;
+
+    for (int r = 0; r < 3; r++) {
+        init_chains(chains, LADDERS, temperatures[r], seed);
+
+        start = now();
+        checks = run_chains(chains, methods[r], threads, rhat, ess,
+                            upper_peak);
+
+        long long swaps = 0;
+        long long swap_tries = 0;
+        for (int l = 0; l < LADDERS; l++) {
+            swaps += chains.swaps_accepted[l];
+            swap_tries += chains.swaps_tried[l];
+        }
+
+        cout << names[r] << ":" << endl
+             << "    " << checks * SWEEPS_PER_CHECK << " sweeps of "
+             << chains.count << " chains in " << now() - start
+             << " seconds" << (checks == MAX_CHECKS ? " (gave up)" : "")
+             << endl
+             << "    R-hat " << rhat << ", effective samples " << ess
+             << ", near upper peak " << upper_peak << endl;
+        if (swap_tries > 0) {
+            cout << "    swaps accepted " << double(swaps) / swap_tries
+                 << endl;
+        }
+        cout << endl;
+    }
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double log_density(const double* x) {
+
+    // PRE:  x holds DIMENSIONS numbers
+    //
+    // POST: log p(x) has been returned, up to a constant, for an equal
+    //       mix of two normal distributions centered on (PEAK, ...)
+    //       and (-PEAK, ...)
+
+    double upper = 0;
+    double lower = 0;
+
+    for (int d = 0; d < DIMENSIONS; d++) {
+        upper += (x[d] - PEAK) * (x[d] - PEAK);
+        lower += (x[d] + PEAK) * (x[d] + PEAK);
+    }
+
+    upper *= -0.5;
+    lower *= -0.5;
+
+    // log(exp(a) + exp(b)) without overflowing
+    if (upper > lower) {
+        return upper + log1p(exp(lower - upper));
+    }
+    return lower + log1p(exp(upper - lower));
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long next64(unsigned long long& state) {
+
+    // PRE:  none
+    //
+    // POST: a random 64-bit number (SplitMix64) has been returned, and
+    //       state has moved on
+
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double uniform(unsigned long long& state) {
+
+    // PRE:  none
+    //
+    // POST: a random number greater than 0 and less than 1 has been
+    //       returned
+
+    return (double(next64(state) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double normal(unsigned long long& state) {
+
+    // PRE:  none
+    //
+    // POST: a random number from the standard normal distribution has
+    //       been returned (Box-Muller)
+
+    double u = uniform(state);
+    double v = uniform(state);
+
+    return sqrt(-2.0 * log(u)) * cos(6.283185307179586 * v);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long substream_seed(unsigned long long seed, int chain) {
+
+    // PRE:  none
+    //
+    // POST: a seed for chain's own random number stream has been
+    //       returned; different chains get unrelated streams
+
+    unsigned long long z = seed ^ ((unsigned long long) chain << 32);
+
+    return next64(z);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void init_chains(Chains& chains, int ladders, int temperatures,
+                 unsigned long long seed) {
+
+    // PRE:  ladders >= 1 and temperatures >= 1
+    //
+    // POST: chains holds ladders * temperatures chains, each with its
+    //       own stream, a random starting state, and betas spaced
+    //       evenly on a log scale from COLDEST_BETA to HOTTEST_BETA
+
+    int count = ladders * temperatures;
+    double state[DIMENSIONS];
+
+    chains.ladders = ladders;
+    chains.temperatures = temperatures;
+    chains.count = count;
+    chains.x.assign((long long) DIMENSIONS * count, 0.0);
+    chains.logp.assign(count, 0.0);
+    chains.beta.assign(count, 1.0);
+    chains.step.assign(count, 1.0);
+    chains.rng.assign(count, 0);
+    chains.accepted.assign(count, 0);
+    chains.tried.assign(count, 0);
+    chains.swaps_accepted.assign(ladders, 0);
+    chains.swaps_tried.assign(ladders, 0);
+
+    for (int c = 0; c < count; c++) {
+        int t = c % temperatures;
+
+        chains.rng[c] = substream_seed(seed, c);
+
+        if (temperatures > 1) {
+            chains.beta[c] = COLDEST_BETA
+                * pow(HOTTEST_BETA / COLDEST_BETA,
+                      double(t) / (temperatures - 1));
+        }
+
+        // start spread widely, so chains begin near different peaks
+        for (int d = 0; d < DIMENSIONS; d++) {
+            state[d] = 10.0 * uniform(chains.rng[c]) - 5.0;
+            chains.x[(long long) d * count + c] = state[d];
+        }
+        chains.logp[c] = log_density(state);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void metropolis_step(Chains& chains, int c) {
+
+    // PRE:  c is a chain number
+    //
+    // POST: chain c has taken one random-walk Metropolis step on
+    //       p(x)^beta
+
+    int count = chains.count;
+    double proposal[DIMENSIONS];
+    double logp;
+
+    for (int d = 0; d < DIMENSIONS; d++) {
+        proposal[d] = chains.x[(long long) d * count + c]
+                    + chains.step[c] * normal(chains.rng[c]);
+    }
+
+    logp = log_density(proposal);
+    chains.tried[c]++;
+
+    // accept with chance p(y)^beta / p(x)^beta, compared as logs
+    if (log(uniform(chains.rng[c])) < chains.beta[c] * (logp - chains.logp[c])) {
+        for (int d = 0; d < DIMENSIONS; d++) {
+            chains.x[(long long) d * count + c] = proposal[d];
+        }
+        chains.logp[c] = logp;
+        chains.accepted[c]++;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void slice_step(Chains& chains, int c) {
+
+    // PRE:  c is a chain number
+    //
+    // POST: each coordinate of chain c has been updated once by slice
+    //       sampling on p(x)^beta, with stepping out and shrinking
+
+    int count = chains.count;
+    double beta = chains.beta[c];
+    double state[DIMENSIONS];
+
+    for (int d = 0; d < DIMENSIONS; d++) {
+        state[d] = chains.x[(long long) d * count + c];
+    }
+
+    for (int d = 0; d < DIMENSIONS; d++) {
+
+        double old = state[d];
+
+        // the slice is everywhere beta * log p is above this height
+        double height = beta * chains.logp[c] + log(uniform(chains.rng[c]));
+
+        // step out from a randomly placed interval
+        double left = old - SLICE_WIDTH * uniform(chains.rng[c]);
+        double right = left + SLICE_WIDTH;
+
+        for (int s = 0; s < SLICE_MAX_STEPS; s++) {
+            state[d] = left;
+            if (beta * log_density(state) <= height) {
+                break;
+            }
+            left -= SLICE_WIDTH;
+        }
+        for (int s = 0; s < SLICE_MAX_STEPS; s++) {
+            state[d] = right;
+            if (beta * log_density(state) <= height) {
+                break;
+            }
+            right += SLICE_WIDTH;
+        }
+
+        // choose points in the interval, shrinking it towards the old
+        // value after each miss
+        while (true) {
+            double logp;
+
+            state[d] = left + (right - left) * uniform(chains.rng[c]);
+            logp = log_density(state);
+            chains.tried[c]++;
+
+            if (beta * logp > height) {
+                chains.logp[c] = logp;
+                chains.accepted[c]++;
+                break;
+            }
+
+            if (state[d] < old) {
+                left = state[d];
+            } else {
+                right = state[d];
+            }
+        }
+    }
+
+    for (int d = 0; d < DIMENSIONS; d++) {
+        chains.x[(long long) d * count + c] = state[d];
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void tempering_swaps(Chains& chains, int ladder) {
+
+    // PRE:  ladder is a ladder number
+    //
+    // POST: each neighbouring pair of chains on the ladder has tried
+    //       once to swap states
+
+    int first = ladder * chains.temperatures;
+    int count = chains.count;
+    unsigned long long& rng = chains.rng[first];
+
+    for (int t = 0; t + 1 < chains.temperatures; t++) {
+
+        int a = first + t;
+        int b = a + 1;
+        double chance = (chains.beta[a] - chains.beta[b])
+                      * (chains.logp[b] - chains.logp[a]);
+
+        chains.swaps_tried[ladder]++;
+
+        if (log(uniform(rng)) < chance) {
+            for (int d = 0; d < DIMENSIONS; d++) {
+                swap(chains.x[(long long) d * count + a],
+                     chains.x[(long long) d * count + b]);
+            }
+            swap(chains.logp[a], chains.logp[b]);
+            chains.swaps_accepted[ladder]++;
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void reset_diagnostics(Diagnostics& diag, int ladders) {
+
+    // PRE:  ladders >= 1
+    //
+    // POST: diag holds no samples
+
+    diag.n = 0;
+    diag.mean.assign((long long) ladders * DIMENSIONS, 0.0);
+    diag.m2.assign((long long) ladders * DIMENSIONS, 0.0);
+    diag.batch_sum.assign((long long) ladders * DIMENSIONS, 0.0);
+    diag.batches = 0;
+    diag.batch_mean.assign((long long) ladders * DIMENSIONS, 0.0);
+    diag.batch_m2.assign((long long) ladders * DIMENSIONS, 0.0);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void record_sample(Diagnostics& diag, const Chains& chains, int ladder,
+                   long long index) {
+
+    // PRE:  index is the number of samples the ladder has already
+    //       recorded, counting from diag.n
+    //
+    // POST: the state of the ladder's beta = 1 chain has been added to
+    //       its running totals, and if that filled a batch, the batch
+    //       average has been added to the batch totals; only this
+    //       ladder's totals are touched, so ladders can be recorded on
+    //       different threads
+
+    int c = ladder * chains.temperatures;
+    double n = double(index + 1);
+    bool batch_full = ((index + 1) % BATCH_LENGTH == 0);
+    double batches = double((index + 1) / BATCH_LENGTH);
+
+    for (int d = 0; d < DIMENSIONS; d++) {
+
+        int i = ladder * DIMENSIONS + d;
+        double value = chains.x[(long long) d * chains.count + c];
+        double delta = value - diag.mean[i];
+
+        // Welford's running mean and sum of squared differences
+        diag.mean[i] += delta / n;
+        diag.m2[i] += delta * (value - diag.mean[i]);
+        diag.batch_sum[i] += value;
+
+        if (batch_full) {
+            value = diag.batch_sum[i] / BATCH_LENGTH;
+            delta = value - diag.batch_mean[i];
+            diag.batch_mean[i] += delta / batches;
+            diag.batch_m2[i] += delta * (value - diag.batch_mean[i]);
+            diag.batch_sum[i] = 0;
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void convergence(const Diagnostics& diag, int ladders, double& rhat,
+                 double& ess) {
+
+    // PRE:  at least two batches have been recorded, and ladders >= 2
+    //
+    // POST: rhat holds the largest R-hat over the coordinates, and ess
+    //       the smallest effective sample size, both using the beta = 1
+    //       chain of each ladder
+
+    double n = double(diag.n);
+
+    rhat = 0;
+    ess = 1e300;
+
+    for (int d = 0; d < DIMENSIONS; d++) {
+
+        double within = 0;      // average variance inside a chain
+        double grand = 0;       // average of the chain averages
+        double between = 0;     // variance of the chain averages
+        double within_batch = 0;    // average batch variance in a chain
+
+        for (int l = 0; l < ladders; l++) {
+            grand += diag.mean[l * DIMENSIONS + d];
+        }
+        grand /= ladders;
+
+        for (int l = 0; l < ladders; l++) {
+            int i = l * DIMENSIONS + d;
+            double variance = diag.m2[i] / (n - 1);
+            double batch_variance = diag.batch_m2[i] / (diag.batches - 1);
+
+            within += variance;
+            within_batch += batch_variance;
+            between += (diag.mean[i] - grand) * (diag.mean[i] - grand);
+        }
+        within /= ladders;
+        within_batch /= ladders;
+        between /= (ladders - 1);
+
+        double pooled = (n - 1) / n * within + between;
+        double r = sqrt(pooled / within);
+
+        // the batch averages' variance, pooled over the chains like the
+        // samples' variance above, so disagreeing chains inflate it
+        double batches = double(diag.batches);
+        double pooled_batch = (batches - 1) / batches * within_batch + between;
+
+        // m chains of n samples are worth m * n * variance /
+        // (BATCH_LENGTH * pooled batch variance) independent ones
+        double sample_size = 0;
+        if (pooled_batch > 0) {
+            sample_size = ladders * n * within / (BATCH_LENGTH * pooled_batch);
+        }
+
+        rhat = (r > rhat) ? r : rhat;
+        ess = (sample_size < ess) ? sample_size : ess;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int run_chains(Chains& chains, Method method, int threads, double& rhat,
+               double& ess, double& upper_peak) {
+
+    // PRE:  chains has been set up by init_chains(), with at least two
+    //       ladders, and threads >= 1
+    //
+    // POST: the chains have been run, SWEEPS_PER_CHECK sweeps at a
+    //       time, until R-hat is below RHAT_TARGET and the effective
+    //       sample size is above ESS_TARGET, or MAX_CHECKS checks have
+    //       been run; the number of checks has been returned, with the
+    //       final R-hat, effective sample size, and share of kept
+    //       samples near the upper peak
+
+    Diagnostics diag;
+    vector<long long> upper(chains.ladders, 0);
+    int checks = 0;
+
+    reset_diagnostics(diag, chains.ladders);
+
+    while (checks < MAX_CHECKS) {
+
+        bool warming = (checks < WARMUP_CHECKS);
+        vector<thread> workers;
+
+        // every ladder's chains run SWEEPS_PER_CHECK sweeps; a whole
+        // ladder always belongs to one thread, so its swaps and its
+        // diagnostics need no locks
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(thread([&, t]() {
+                for (int l = t; l < chains.ladders; l += threads) {
+                    for (int s = 0; s < SWEEPS_PER_CHECK; s++) {
+                        for (int c = l * chains.temperatures;
+                             c < (l + 1) * chains.temperatures; c++) {
+                            if (method == METROPOLIS) {
+                                metropolis_step(chains, c);
+                            } else {
+                                slice_step(chains, c);
+                            }
+                        }
+                        tempering_swaps(chains, l);
+
+                        if (!warming) {
+                            record_sample(diag, chains, l, diag.n + s);
+                            if (chains.x[l * chains.temperatures] > 0) {
+                                upper[l]++;
+                            }
+                        }
+                    }
+                }
+            }));
+        }
+
+        for (int t = 0; t < threads; t++) {
+            workers[t].join();
+        }
+
+        checks++;
+
+        if (warming) {
+
+            // adjust each Metropolis chain's step size towards 1 in 4
+            // accepted, then forget the warm-up statistics
+            for (int c = 0; c < chains.count; c++) {
+                if (method == METROPOLIS && chains.tried[c] > 0) {
+                    double rate = double(chains.accepted[c]) / chains.tried[c];
+                    chains.step[c] *= exp(2.0 * (rate - 0.25));
+                }
+                chains.accepted[c] = 0;
+                chains.tried[c] = 0;
+            }
+            continue;
+        }
+
+        diag.n += SWEEPS_PER_CHECK;
+        diag.batches = diag.n / BATCH_LENGTH;
+
+        if (diag.batches >= 2) {
+            convergence(diag, chains.ladders, rhat, ess);
+            if (rhat < RHAT_TARGET && ess > ESS_TARGET) {
+                break;
+            }
+        }
+    }
+
+    long long total = 0;
+    for (int l = 0; l < chains.ladders; l++) {
+        total += upper[l];
+    }
+    upper_peak = double(total) / (double(diag.n) * chains.ladders);
+
+    return checks;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
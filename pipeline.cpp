@@ -0,0 +1,780 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+split the work of making and printing random numbers into stages that
+each run on their own processor core, in C++.
+
+
+-----------------------------
+One Number at a Time Is Slow
+-----------------------------
+
+The main tutorial makes a random number, turns it into the range we
+want, and prints it, one number at a time:
+
+        for (...) {
+            cout << low + rand() % (high - low + 1) << endl;
+        }
+
+Every number pays for a trip through the output library, and the
+processor keeps switching between four quite different jobs, so none
+of them runs at full speed. When we need billions of numbers (to fill
+a test file, say), we do better to give each job to its own core:
+
+    +----------+    +-----------+    +--------+    +-------+
+    | generate |--->| transform |--->| format |--->| write |
+    +----------+    +-----------+    +--------+    +-------+
+         ^                                             |
+         |                                             |
+         +---------------- empty blocks ---------------+
+
+    - generate:  fill a block with raw 64-bit random numbers
+    - transform: map each one into the range low to high
+    - format:    turn the numbers into lines of decimal text
+    - write:     hand the text to the operating system
+
+Each stage works on a whole BLOCK of tens of thousands of numbers at a
+time, so the cost of passing work along is shared by all of them. The
+whole pipeline then runs at the speed of its slowest stage, rather
+than at the speed of all four added together.
+
+
+-----------------------------
+Lock-Free Single-Producer,
+Single-Consumer Queues
+-----------------------------
+
+Neighbouring stages are joined by a "ring buffer": an array of slots
+with a head (the next slot to read) and a tail (the next slot to
+write). Only one thread ever writes to a given queue and only one
+ever reads from it, so no lock is needed. The writer fills a slot and
+then moves the tail on; the reader sees the new tail, reads the slot,
+and then moves the head on. "release" and "acquire" memory ordering
+make sure the slot's contents are visible before the tail or head that
+announces them.
+
+Head and tail live on separate cache lines, so that the two threads do
+not fight over one line (false sharing). Each side also keeps its own
+copy of the other side's counter, and only re-reads the real one when
+its copy says the queue is full (or empty).
+
+The queues hold pointers to blocks, never the blocks themselves. A
+fixed number of blocks goes round and round the loop, and the writer
+hands empty blocks back to the generator.
+
+
+-----------------------------
+Backpressure
+-----------------------------
+
+If the writer is slow, the queues in front of it fill up, and the
+stages before it have to wait for room. And because there are only so
+many blocks, the generator can never get more than that many blocks
+ahead of the writer. Memory use stays fixed however unequal the
+stages are.
+
+While a stage waits, it gives up its core to other threads (yield).
+We count how long each stage spends waiting for input and waiting for
+room. A stage that is almost never waiting for input is the
+bottleneck: that is the one worth making faster, or splitting across
+more cores. (When stages share a core, waiting also includes the time
+the other stages spend running on it.)
+
+
+-----------------------------
+Stopping Early
+-----------------------------
+
+A write can fail, for instance when the disk is full. The writer then
+sets a shared flag and drops the blocks still on their way to it. The
+generator checks the flag before each block, and once it is set sends
+the end-of-stream block at once, so every stage finishes the usual
+way, and main() reports how many numbers were written.
+
+
+-----------------------------
+Pinning Threads to Cores
+-----------------------------
+
+By default the operating system moves threads from core to core, and
+each move throws away the data in that core's caches. On Linux,
+pthread_setaffinity_np() "pins" a thread to one core. Each stage gets
+its own core, where possible. (With fewer cores than stages, some
+stages share, and the pipeline can go no faster than the work on the
+busiest core.)
+
+
+-----------------------------
+Reproducibility
+-----------------------------
+
+Number j of the whole stream is mix64(seed + j * GOLDEN) -- the
+SplitMix64 mixing function applied to a counter -- so the output
+depends only on the seed, never on how the blocks were timed. The
+transform maps a 64-bit number x into the range with
+
+        low + (x * (high - low + 1)) / 2^64
+
+using a 128-bit product. With a 64-bit x, the unevenness this leaves
+(at most range / 2^64) is far too small to ever measure, so no
+numbers need to be thrown away and drawn again.
+
+
+----------------
+Review Questions
+----------------
+
+1. Why does a pipeline of stages run at the speed of its slowest
+   stage?
+
+2. Why do the head and tail of a ring buffer go on separate cache
+   lines?
+
+3. Why is no lock needed when one thread writes to a queue and one
+   thread reads from it?
+
+4. How does a fixed number of blocks stop the generator from running
+   too far ahead?
+
+5. How can the waiting times tell us which stage is the bottleneck?
+
+6. Why does the generator stop the pipeline after a failed write,
+   rather than the writer simply quitting?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the fopen(), printf(), fprintf(), fwrite(), ferror() and fclose()
+// functions
+
+#include <cstdio>
+
+
+// access the atomic, thread and vector types and the ref() function
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <functional>
+
+
+// access the pthread_setaffinity_np() function
+
+#include <pthread.h>
+#include <sched.h>
+
+
+// constants used to control the size and number of blocks, and the
+// number of blocks each queue between stages can hold
+
+const int BLOCK_VALUES = 32768;
+const int BLOCKS = 16;
+const int QUEUE_SLOTS = 4;
+
+
+// the most text one number can turn into: 20 digits and a newline
+
+const int MAX_LINE = 21;
+
+
+// constants used to control how many numbers are made, and their range
+
+const long long TOTAL = 200000000;
+const long long LOW = 1;
+const long long HIGH = 1000000;
+
+
+// constant used to control where the output goes
+
+const char OUTPUT[] = "/dev/null";
+
+
+// constant used to step the counter-based generator
+
+const unsigned long long GOLDEN = 0x9E3779B97F4A7C15ULL;
+
+
+// one block of work, as it goes round the pipeline
+
+struct Block {
+    long long first;                    // number of its first value
+    int count;                          // 0 = the end of the stream
+    vector<unsigned long long> values;
+    vector<char> text;
+    size_t bytes;                       // length of the text
+};
+
+
+// a lock-free queue of blocks with one writer and one reader
+
+struct Ring {
+    alignas(64) atomic<size_t> head;    // written only by the reader
+    alignas(64) atomic<size_t> tail;    // written only by the writer
+    alignas(64) size_t seen_head;       // the writer's copy of head
+    alignas(64) size_t seen_tail;       // the reader's copy of tail
+    vector<Block*> slots;
+    size_t mask;
+};
+
+
+// the work a stage does to one block
+
+typedef void (*StageWork)(Block& block, void* user);
+
+
+// one stage, with its queues and its timings
+
+struct Stage {
+    const char* name;
+    StageWork work;
+    void* user;
+    Ring* in;
+    Ring* out;
+    int core;
+    bool pinned;
+    long long values;
+    double busy;                        // seconds of work
+    double starved;                     // seconds waiting for input
+    double blocked;                     // seconds waiting for room
+    double elapsed;
+};
+
+
+// what the generator and transform stages need to know
+
+struct Source {
+    unsigned long long seed;
+    long long next;                     // number of the next value
+    long long total;
+    const atomic<bool>* failed;         // set if a write has failed
+};
+
+struct Range {
+    long long low;
+    long long high;
+};
+
+
+// where the writer stage puts the text, and whether that has failed
+
+struct Sink {
+    FILE* file;
+    atomic<bool> failed;
+    long long written;                  // numbers written so far
+};
+
+
+// prototypes for functions to use a ring buffer
+
+void init_ring(Ring& ring, int slots);
+bool try_push(Ring& ring, Block* block);
+bool try_pop(Ring& ring, Block*& block);
+
+
+// prototype for the loop run by every stage's thread
+
+void run_stage(Stage& stage);
+
+
+// prototypes for the work of each stage
+
+void generate_block(Block& block, void* user);
+void transform_block(Block& block, void* user);
+void format_block(Block& block, void* user);
+void write_block(Block& block, void* user);
+
+
+// prototype for a function to turn a number into decimal text
+
+char* format_number(char* out, unsigned long long value);
+
+
+// prototype for the SplitMix64 mixing function
+
+unsigned long long mix64(unsigned long long z);
+
+
+// prototype for a function to pin a thread to a core
+
+bool pin_thread(thread& worker, int core);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    vector<Ring> rings(4);              // used to hold the queues
+    vector<Block> blocks(BLOCKS);       // used to hold the blocks
+    vector<Stage> stages(4);            // used to hold the stages
+    vector<thread> workers;             // used to hold the running threads
+    Source source;                      // used to hold the generator
+    Range range;                        // used to hold the output range
+    Sink sink;                          // used to hold the output
+    unsigned long long seed;            // used to hold the main seed
+    FILE* file;                         // used to hold the output file
+    int cores;                          // used to hold the number of cores
+    double start;                       // used to hold the starting time
+    double interleaved;                 // used to hold the one-at-a-time rate
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = ((unsigned long long) rand() << 31) | rand();
+
+    cores = int(thread::hardware_concurrency());
+    if (cores < 1) {
+        cores = 1;
+    }
+
+    range.low = LOW;
+    range.high = HIGH;
+
+    file = fopen(OUTPUT, "wb");
+    if (file == NULL) {
+        cout << "Could not open " << OUTPUT << endl;
+        return 1;
+    }
+
+    // the old way: one number at a time, all in one thread
+    const long long ONE_AT_A_TIME = TOTAL / 20;
+    unsigned long long width = (unsigned long long) (HIGH - LOW + 1);
+    start = now();
+    for (long long j = 0; j < ONE_AT_A_TIME; j++) {
+        unsigned long long x = mix64(seed + (unsigned long long) j * GOLDEN);
+        long long value = LOW + (long long) (((unsigned __int128) x * width) >> 64);
+        fprintf(file, "%lld\n", value);
+    }
+    interleaved = ONE_AT_A_TIME / (now() - start);
+    if (ferror(file)) {
+        cout << "Could not write to " << OUTPUT << endl;
+        fclose(file);
+        return 1;
+    }
+
+    // the pipeline: every block starts out empty, waiting for the
+    // generator; the last queue takes them back from the writer
+    source.seed = seed;
+    source.next = 0;
+    source.total = TOTAL;
+    source.failed = &sink.failed;
+
+    sink.file = file;
+    sink.failed.store(false);
+    sink.written = 0;
+
+    for (int r = 0; r < 4; r++) {
+        init_ring(rings[r], (r == 0) ? BLOCKS : QUEUE_SLOTS);
+    }
+    for (int b = 0; b < BLOCKS; b++) {
+        blocks[b].values.resize(BLOCK_VALUES);
+        blocks[b].text.resize((size_t) BLOCK_VALUES * MAX_LINE);
+        blocks[b].count = 0;
+        blocks[b].bytes = 0;
+        try_push(rings[0], &blocks[b]);
+    }
+
+    const char* names[4] = { "generate", "transform", "format", "write" };
+    StageWork work[4] = { generate_block, transform_block, format_block, write_block };
+    void* user[4] = { &source, &range, NULL, &sink };
+    for (int s = 0; s < 4; s++) {
+        stages[s].name = names[s];
+        stages[s].work = work[s];
+        stages[s].user = user[s];
+        stages[s].in = &rings[s];
+        stages[s].out = &rings[(s + 1) % 4];
+        stages[s].core = s % cores;
+        stages[s].values = 0;
+        stages[s].busy = 0;
+        stages[s].starved = 0;
+        stages[s].blocked = 0;
+        stages[s].elapsed = 0;
+    }
+
+    start = now();
+    for (int s = 0; s < 4; s++) {
+        workers.push_back(thread(run_stage, ref(stages[s])));
+        stages[s].pinned = pin_thread(workers[s], stages[s].core);
+    }
+    for (int s = 0; s < 4; s++) {
+        workers[s].join();
+    }
+    double seconds = now() - start;
+    if (fclose(file) != 0) {
+        sink.failed.store(true);
+    }
+
+    if (sink.failed.load()) {
+        cout << "Could not write to " << OUTPUT << "; stopped after "
+             << sink.written << " of " << TOTAL << " numbers" << endl;
+        return 1;
+    }
+
+    cout << endl << TOTAL << " numbers from " << LOW << " to " << HIGH
+         << ", written to " << OUTPUT << ", " << cores << " core(s):"
+         << endl << endl;
+    cout << "    one at a time:  " << interleaved / 1e6
+         << " million numbers per second" << endl;
+    cout << "    pipeline:       " << TOTAL / seconds / 1e6
+         << " million numbers per second" << endl << endl;
+
+    cout << "    stage       core  own rate (M/s)   busy   waiting for input"
+         << "   waiting for room" << endl;
+    for (int s = 0; s < 4; s++) {
+        Stage& stage = stages[s];
+        printf("    %-10s %4d%s %12.1f %9.0f%% %14.0f%% %18.0f%%\n",
+               stage.name, stage.core, stage.pinned ? " " : "?",
+               stage.values / stage.busy / 1e6,
+               100 * stage.busy / stage.elapsed,
+               100 * stage.starved / stage.elapsed,
+               100 * stage.blocked / stage.elapsed);
+    }
+    cout << endl << "    (own rate: numbers per second of the stage's own work; "
+         << "? = could not pin)" << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void init_ring(Ring& ring, int slots) {
+
+    // PRE:  slots is a power of 2
+    //
+    // POST: the ring is empty and can hold slots blocks
+
+    ring.slots.assign(slots, NULL);
+    ring.mask = slots - 1;
+    ring.head.store(0);
+    ring.tail.store(0);
+    ring.seen_head = 0;
+    ring.seen_tail = 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+bool try_push(Ring& ring, Block* block) {
+
+    // PRE:  only one thread ever pushes to this ring
+    //
+    // POST: if there was room, the block has been added and true
+    //       returned; otherwise false has been returned
+
+    size_t tail = ring.tail.load(memory_order_relaxed);
+
+    if (tail - ring.seen_head > ring.mask) {
+        ring.seen_head = ring.head.load(memory_order_acquire);
+        if (tail - ring.seen_head > ring.mask) {
+            return false;
+        }
+    }
+
+    ring.slots[tail & ring.mask] = block;
+    ring.tail.store(tail + 1, memory_order_release);
+
+    return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+bool try_pop(Ring& ring, Block*& block) {
+
+    // PRE:  only one thread ever pops from this ring
+    //
+    // POST: if the ring was not empty, its oldest block has been
+    //       removed into block and true returned; otherwise false has
+    //       been returned
+
+    size_t head = ring.head.load(memory_order_relaxed);
+
+    if (head == ring.seen_tail) {
+        ring.seen_tail = ring.tail.load(memory_order_acquire);
+        if (head == ring.seen_tail) {
+            return false;
+        }
+    }
+
+    block = ring.slots[head & ring.mask];
+    ring.head.store(head + 1, memory_order_release);
+
+    return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void run_stage(Stage& stage) {
+
+    // PRE:  the stage's queues have been set up
+    //
+    // POST: the stage has worked on blocks until the end of the stream
+    //       (a block with count 0) went through it
+
+    Block* block = NULL;
+    double start = now();
+    double mark;
+
+    while (true) {
+
+        // wait for input, spinning briefly before giving up the core
+        mark = now();
+        for (int spins = 0; !try_pop(*stage.in, block); spins++) {
+            if (spins >= 64) {
+                this_thread::yield();
+            }
+        }
+        stage.starved += now() - mark;
+
+        mark = now();
+        stage.work(*block, stage.user);
+        stage.busy += now() - mark;
+        stage.values += block->count;
+
+        // wait for room in the next queue
+        mark = now();
+        for (int spins = 0; !try_push(*stage.out, block); spins++) {
+            if (spins >= 64) {
+                this_thread::yield();
+            }
+        }
+        stage.blocked += now() - mark;
+
+        if (block->count == 0) {
+            break;
+        }
+    }
+
+    stage.elapsed = now() - start;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void generate_block(Block& block, void* user) {
+
+    // PRE:  user points to a Source
+    //
+    // POST: the block holds the next raw random numbers of the stream,
+    //       or has count 0 if the stream has ended or a write has failed
+
+    Source& source = *(Source*) user;
+    long long left = source.total - source.next;
+
+    if (source.failed->load(memory_order_relaxed)) {
+        left = 0;
+    }
+
+    unsigned long long* values = block.values.data();
+    unsigned long long counter = source.seed + (unsigned long long) source.next * GOLDEN;
+
+    block.first = source.next;
+    block.count = (left < BLOCK_VALUES) ? int(left) : BLOCK_VALUES;
+    block.bytes = 0;
+
+    for (int j = 0; j < block.count; j++) {
+        values[j] = mix64(counter + (unsigned long long) j * GOLDEN);
+    }
+
+    source.next += block.count;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void transform_block(Block& block, void* user) {
+
+    // PRE:  user points to a Range; the block holds raw random numbers
+    //
+    // POST: each number has been mapped into the range low to high
+
+    Range& range = *(Range*) user;
+    unsigned long long width = (unsigned long long) (range.high - range.low + 1);
+    unsigned long long low = (unsigned long long) range.low;
+    unsigned long long* values = block.values.data();
+
+    for (int j = 0; j < block.count; j++) {
+        values[j] = low + (unsigned long long) (((unsigned __int128) values[j] * width) >> 64);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void format_block(Block& block, void* user) {
+
+    // PRE:  the block holds numbers (user is not used)
+    //
+    // POST: the block's text holds the numbers, one per line
+
+    (void) user;
+
+    char* out = block.text.data();
+    const unsigned long long* values = block.values.data();
+
+    for (int j = 0; j < block.count; j++) {
+        out = format_number(out, values[j]);
+        *out++ = '\n';
+    }
+
+    block.bytes = out - block.text.data();
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void write_block(Block& block, void* user) {
+
+    // PRE:  user points to a Sink with an open file
+    //
+    // POST: the block's text has been written, unless this or an
+    //       earlier write came up short, which has set sink.failed
+
+    Sink& sink = *(Sink*) user;
+
+    if (block.bytes == 0 || sink.failed.load(memory_order_relaxed)) {
+        return;
+    }
+
+    if (fwrite(block.text.data(), 1, block.bytes, sink.file) != block.bytes) {
+        sink.failed.store(true, memory_order_relaxed);
+        return;
+    }
+    sink.written += block.count;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+char* format_number(char* out, unsigned long long value) {
+
+    // PRE:  out has room for 20 characters
+    //
+    // POST: value has been written to out in decimal, and a pointer just
+    //       past its last digit returned
+
+    // the digits of 00 to 99, so each division makes two digits
+    static const char PAIRS[] =
+        "00010203040506070809101112131415161718192021222324"
+        "25262728293031323334353637383940414243444546474849"
+        "50515253545556575859606162636465666768697071727374"
+        "75767778798081828384858687888990919293949596979899";
+
+    char digits[20];
+    int n = 20;
+
+    while (value >= 100) {
+        int pair = int(value % 100);
+        value /= 100;
+        digits[--n] = PAIRS[2 * pair + 1];
+        digits[--n] = PAIRS[2 * pair];
+    }
+    if (value >= 10) {
+        digits[--n] = PAIRS[2 * value + 1];
+        digits[--n] = PAIRS[2 * value];
+    } else {
+        digits[--n] = char('0' + value);
+    }
+
+    for (int j = n; j < 20; j++) {
+        *out++ = digits[j];
+    }
+
+    return out;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long mix64(unsigned long long z) {
+
+    // PRE:  none
+    //
+    // POST: z has been scrambled with the SplitMix64 mixing function
+    //       and the result returned
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+bool pin_thread(thread& worker, int core) {
+
+    // PRE:  worker is running
+    //
+    // POST: on Linux, the thread has been allowed to run only on the
+    //       given core; true has been returned if that worked
+
+#ifdef __linux__
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+
+    return pthread_setaffinity_np(worker.native_handle(), sizeof(set), &set) == 0;
+#else
+    (void) worker;
+    (void) core;
+
+    return false;
+#endif
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
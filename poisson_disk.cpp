@@ -0,0 +1,868 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+scatter random points over an area (or a volume) in C++ so that no two
+points are too close together. Such points are called a "Poisson-disk"
+or "blue-noise" sample.
+
+
+------------------------------------
+Why Not Just Use rand_range()?
+------------------------------------
+
+The easy way to scatter points is to pick each coordinate with
+rand_range() (or a random decimal number). The trouble is that truly
+independent random points clump: some end up almost on top of each
+other, while elsewhere there are large empty gaps. If the points are
+trees in a forest, or the places where a renderer looks at a scene,
+clumps and gaps look wrong.
+
+A Poisson-disk sample adds one rule: no two points may be closer than
+a minimum distance r. The points still look random, but they are
+spread out evenly, like the cells on the back of your eye (which is
+where the idea came from).
+
+
+---------------------
+Bridson's Algorithm
+---------------------
+
+A simple way to get such a sample is "dart throwing": keep picking
+random points, and throw away any that are too close to a point we
+already have. This gets very slow once the area starts to fill up,
+because almost every dart is thrown away.
+
+In 2007, Robert Bridson described a much faster method:
+
+    1. Pick one random point, and put it in the "active list".
+    2. While the active list is not empty:
+           Pick a random point p from the active list.
+           Try up to k (say 30) random candidates in the ring
+           (called an "annulus") between distance r and 2r around p.
+           If a candidate is at least r away from every point so far,
+           keep it and add it to the active list.
+           If none of the k candidates was kept, remove p from the
+           active list -- the area around p is full.
+
+Picking a candidate in the ring needs a little care. If we chose the
+distance from p uniformly between r and 2r, points would bunch up
+near the inside of the ring, which is smaller. Instead, we choose the
+distance as
+
+        distance = sqrt(r^2 + u * ((2r)^2 - r^2))
+
+where u is a random number between 0 and 1, so that every part of
+the ring is equally likely. In 3D, the ring becomes a hollow ball (a
+"spherical shell"), and the square root becomes a cube root.
+
+
+---------------------
+The Background Grid
+---------------------
+
+To check a candidate quickly, we lay a grid of square cells over the
+area, small enough that each cell can hold at most one point. In 2D,
+a cell whose diagonal is r has sides r / sqrt(2). Now we only need to
+look at the few cells around the candidate, instead of every point.
+
+
+-------------------------
+Different Radius in Places
+-------------------------
+
+Sometimes points should be dense in some places and sparse in others
+(say, trees thinning out near a clearing). We then give the minimum
+distance as a function r(x, y) instead of a single number. Two points
+p and q may not be closer than the larger of r(p) and r(q). The grid
+cells are sized for the smallest radius, and a candidate looks further
+out, far enough to cover the largest radius.
+
+
+-------------------------
+Splitting Into Tiles
+-------------------------
+
+To use several cores on a huge area, we cut it into square tiles at
+least as wide as the largest radius, and color the tiles like a
+checkerboard with four colors:
+
+        0 1 0 1 0 1
+        2 3 2 3 2 3
+        0 1 0 1 0 1
+
+Two tiles of the same color are always at least one whole tile apart,
+so points placed in one of them can never be too close to points
+placed in another at the same time. We fill all tiles of color 0 in
+parallel, then all tiles of color 1, and so on. Each tile uses its own
+random number seed, made from the main seed and the tile number, so
+the answer is the same no matter how many threads are used.
+
+
+----------------------------
+Storing the Points
+----------------------------
+
+The points are returned as one array of x coordinates and one array
+of y coordinates (and z in 3D), instead of one array of (x, y) pairs.
+This "structure of arrays" layout lets later code that works on all
+the x coordinates at once read them one after another in memory.
+
+
+----------------
+Review Questions
+----------------
+
+1. Why do independent random points form clumps and gaps?
+
+2. What rule does a Poisson-disk sample follow?
+
+3. Why is dart throwing slow once the area fills up?
+
+4. When is a point removed from the active list?
+
+5. Why isn't the candidate's distance chosen uniformly between r and
+2r?
+
+6. How big is each cell of the background grid in 2D, and why?
+
+7. Why can tiles of the same color be filled at the same time?
+
+8. What is the "structure of arrays" layout?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand_r() function
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the sqrt(), cbrt(), cos(), sin() and ceil() functions
+
+#include <cmath>
+
+
+// access the vector and thread types
+
+#include <vector>
+#include <thread>
+
+
+// constant used to control how many candidates are tried around each
+// active point
+
+const int CANDIDATES = 30;
+
+
+// constant used to hold the value of pi
+
+const double PI = 3.14159265358979323846;
+
+
+// points stored as a structure of arrays
+
+struct Points {
+    vector<double> x;
+    vector<double> y;
+    vector<double> z;
+};
+
+
+// a 2D background grid; each cell holds the index of its point in
+// cell_point, or -1, and the points themselves are kept in points
+
+struct Grid2d {
+    double width;
+    double height;
+    double cell;
+    int columns;
+    int rows;
+    vector<int> cell_point;
+    Points points;
+};
+
+
+// a function giving the minimum distance at a place, or 0 for a
+// constant minimum distance
+
+typedef double (*RadiusFunction)(double x, double y);
+
+
+// prototypes for functions to generate random numbers between 0
+// (inclusive) and 1 (exclusive), and to make a tile's seed
+
+double uniform_r(unsigned int* seed);
+unsigned int tile_seed(unsigned int seed, int tile);
+
+
+// prototypes for functions to pick a random point in a ring (2D) or
+// a spherical shell (3D) between distance r and 2r from the origin
+
+void sample_annulus(double r, unsigned int* seed, double& dx, double& dy);
+void sample_shell(double r, unsigned int* seed, double& dx, double& dy,
+                  double& dz);
+
+
+// prototype for a function to set up an empty 2D grid
+
+void init_grid(Grid2d& grid, double width, double height, double r_min);
+
+
+// prototype for a function to fill one rectangle of a 2D grid with
+// Bridson's algorithm; new points are returned in added, and only
+// grid cells inside the rectangle are written
+
+void fill_region(const Grid2d& grid, vector<int>& cell_point, double x0,
+                 double y0, double x1, double y1, double r_min,
+                 double r_max, RadiusFunction radius, unsigned int seed,
+                 Points& added);
+
+
+// prototype for a function to check whether a 2D candidate is far
+// enough from every point already in the grid
+
+bool point_fits(const Grid2d& grid, const vector<int>& cell_point,
+                const Points& added, double cx, double cy, double r_min,
+                int reach, RadiusFunction radius);
+
+
+// prototypes for functions to make a 2D sample on one core, or on
+// several cores using tiles
+
+void poisson_disk_2d(double width, double height, double r_min,
+                     double r_max, RadiusFunction radius, unsigned int seed,
+                     Points& out);
+void poisson_disk_2d_tiled(double width, double height, double r_min,
+                           double r_max, RadiusFunction radius,
+                           unsigned int seed, int threads, Points& out);
+
+
+// prototype for a function to make a 3D sample with a constant radius
+
+void poisson_disk_3d(double width, double height, double depth, double r,
+                     unsigned int seed, Points& out);
+
+
+// prototype for a function to find the smallest distance between any
+// two 2D points, compared with the allowed distance
+
+double worst_spacing_2d(const Points& points, double r_min, double r_max,
+                        RadiusFunction radius);
+
+
+// a sample radius function: points thin out towards the right
+
+double growing_radius(double x, double y);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    Points points;              // used to hold a sample
+    unsigned int seed;          // used to hold the main seed
+    int threads;                // used to hold how many threads to use
+    double start;               // used to hold the starting time
+
+    // set the main seed by using the number of seconds since the Unix
+    // Epoch
+    seed = (unsigned int) time(0);
+
+    threads = int(thread::hardware_concurrency());
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    cout << endl;
+
+    // a 2D sample with a constant radius, on one core
+    start = now();
+    poisson_disk_2d(500.0, 500.0, 1.0, 1.0, 0, seed, points);
+    cout << "2D, r = 1, 500 x 500, one core:    " << points.x.size()
+         << " points in " << now() - start << " seconds, spacing ratio "
+         << worst_spacing_2d(points, 1.0, 1.0, 0) << endl;
+
+    // the same, using tiles
+    start = now();
+    poisson_disk_2d_tiled(500.0, 500.0, 1.0, 1.0, 0, seed, threads, points);
+    cout << "2D, r = 1, 500 x 500, " << threads << " threads:    "
+         << points.x.size() << " points in " << now() - start
+         << " seconds, spacing ratio "
+         << worst_spacing_2d(points, 1.0, 1.0, 0) << endl;
+
+    // a 2D sample whose radius grows from 1 to 5 across the area
+    start = now();
+    poisson_disk_2d_tiled(500.0, 500.0, 1.0, 5.0, growing_radius, seed,
+                          threads, points);
+    cout << "2D, r = 1 to 5, 500 x 500:        " << points.x.size()
+         << " points in " << now() - start << " seconds, spacing ratio "
+         << worst_spacing_2d(points, 1.0, 5.0, growing_radius) << endl;
+
+    // a 3D sample
+    start = now();
+    poisson_disk_3d(40.0, 40.0, 40.0, 1.0, seed, points);
+    cout << "3D, r = 1, 40 x 40 x 40:          " << points.x.size()
+         << " points in " << now() - start << " seconds" << endl;
+
+    cout << endl
+         << "(a spacing ratio of at least 1 means no two points are too"
+         << " close)" << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double uniform_r(unsigned int* seed) {
+
+    // PRE:  seed points to a seed of its own
+    //
+    // POST: a random number between 0 (inclusive) and 1 (exclusive)
+    //       has been returned, and *seed has been updated
+
+    return double(rand_r(seed)) / (double(RAND_MAX) + 1.0);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned int tile_seed(unsigned int seed, int tile) {
+
+    // PRE:  none
+    //
+    // POST: a seed for the given tile, unrelated to the seed of any
+    //       other tile, has been returned
+
+    unsigned int h = seed ^ ((unsigned int) tile * 0x9E3779B9u);
+
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+
+    return h;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void sample_annulus(double r, unsigned int* seed, double& dx, double& dy) {
+
+    // PRE:  r > 0
+    //
+    // POST: (dx, dy) is a random point in the ring between distance r
+    //       and 2r from the origin, with every part of the ring
+    //       equally likely
+
+    double distance = sqrt(r * r + uniform_r(seed) * 3.0 * r * r);
+    double angle = 2.0 * PI * uniform_r(seed);
+
+    dx = distance * cos(angle);
+    dy = distance * sin(angle);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void sample_shell(double r, unsigned int* seed, double& dx, double& dy,
+                  double& dz) {
+
+    // PRE:  r > 0
+    //
+    // POST: (dx, dy, dz) is a random point in the spherical shell
+    //       between distance r and 2r from the origin, with every part
+    //       of the shell equally likely
+
+    double distance = cbrt(r * r * r + uniform_r(seed) * 7.0 * r * r * r);
+
+    // a uniform height and angle give a uniform direction (Archimedes'
+    // hat-box theorem)
+    double height = 2.0 * uniform_r(seed) - 1.0;
+    double angle = 2.0 * PI * uniform_r(seed);
+    double across = sqrt(1.0 - height * height);
+
+    dx = distance * across * cos(angle);
+    dy = distance * across * sin(angle);
+    dz = distance * height;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void init_grid(Grid2d& grid, double width, double height, double r_min) {
+
+    // PRE:  width, height and r_min are all > 0
+    //
+    // POST: grid is empty, with cells small enough to hold at most one
+    //       point each
+
+    grid.width = width;
+    grid.height = height;
+    grid.cell = r_min / sqrt(2.0);
+    grid.columns = int(ceil(width / grid.cell));
+    grid.rows = int(ceil(height / grid.cell));
+    grid.cell_point.assign((long long) grid.columns * grid.rows, -1);
+    grid.points.x.clear();
+    grid.points.y.clear();
+    grid.points.z.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void fill_region(const Grid2d& grid, vector<int>& cell_point, double x0,
+                 double y0, double x1, double y1, double r_min,
+                 double r_max, RadiusFunction radius, unsigned int seed,
+                 Points& added) {
+
+    // PRE:  grid was set up by init_grid() with r_min, and cell_point
+    //       is the cell array being filled; existing points are in
+    //       grid.points, and a cell holding -2 - i refers to
+    //       added point i
+    //
+    // POST: the rectangle from (x0, y0) to (x1, y1) has been filled
+    //       with new points, returned in added, none of them too close
+    //       to another point
+
+    vector<int> active;         // used to hold the active list
+    int reach;                  // used to hold how many cells to check
+
+    reach = int(ceil(r_max / grid.cell));
+
+    added.x.clear();
+    added.y.clear();
+
+    // the first point is the first of a few random tries that fits
+    for (int attempt = 0; attempt < CANDIDATES && active.empty(); attempt++) {
+
+        double cx = x0 + uniform_r(&seed) * (x1 - x0);
+        double cy = y0 + uniform_r(&seed) * (y1 - y0);
+        int gx = int(cx / grid.cell), gy = int(cy / grid.cell);
+        bool fits = point_fits(grid, cell_point, added, cx, cy, r_min, reach,
+                               radius);
+
+        if (fits) {
+            cell_point[(long long) gy * grid.columns + gx] = -2 - int(added.x.size());
+            added.x.push_back(cx);
+            added.y.push_back(cy);
+            active.push_back(int(added.x.size()) - 1);
+        }
+    }
+
+    while (!active.empty()) {
+
+        // pick a random active point
+        int a = int(uniform_r(&seed) * active.size());
+        double ax = added.x[active[a]], ay = added.y[active[a]];
+        double ra = radius ? radius(ax, ay) : r_min;
+        bool kept = false;
+
+        for (int attempt = 0; attempt < CANDIDATES; attempt++) {
+
+            double dx, dy;
+
+            sample_annulus(ra, &seed, dx, dy);
+
+            double cx = ax + dx, cy = ay + dy;
+
+            // candidates must stay inside this region
+            if (cx < x0 || cy < y0 || cx >= x1 || cy >= y1) {
+                continue;
+            }
+
+            int gx = int(cx / grid.cell), gy = int(cy / grid.cell);
+            bool fits = point_fits(grid, cell_point, added, cx, cy, r_min,
+                                   reach, radius);
+
+            if (fits) {
+                cell_point[(long long) gy * grid.columns + gx] =
+                    -2 - int(added.x.size());
+                added.x.push_back(cx);
+                added.y.push_back(cy);
+                active.push_back(int(added.x.size()) - 1);
+                kept = true;
+                break;
+            }
+        }
+
+        // the area around this point is full; remove it by moving the
+        // last active point into its place
+        if (!kept) {
+            active[a] = active.back();
+            active.pop_back();
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+bool point_fits(const Grid2d& grid, const vector<int>& cell_point,
+                const Points& added, double cx, double cy, double r_min,
+                int reach, RadiusFunction radius) {
+
+    // PRE:  as for fill_region(), and reach is the number of cells
+    //       that covers the largest radius
+    //
+    // POST: true has been returned if (cx, cy) is at least the allowed
+    //       distance from every point within reach cells; otherwise
+    //       false has been returned
+
+    int gx = int(cx / grid.cell), gy = int(cy / grid.cell);
+    double rc = radius ? radius(cx, cy) : r_min;
+
+    for (int j = gy - reach; j <= gy + reach; j++) {
+        for (int i = gx - reach; i <= gx + reach; i++) {
+
+            if (i < 0 || j < 0 || i >= grid.columns || j >= grid.rows) {
+                continue;
+            }
+
+            int p = cell_point[(long long) j * grid.columns + i];
+            if (p == -1) {
+                continue;
+            }
+
+            // cells hold -2 - i for points added by the current region
+            double px = (p >= 0) ? grid.points.x[p] : added.x[-2 - p];
+            double py = (p >= 0) ? grid.points.y[p] : added.y[-2 - p];
+            double rp = radius ? radius(px, py) : r_min;
+            double limit = (rp > rc) ? rp : rc;
+
+            if ((px - cx) * (px - cx) + (py - cy) * (py - cy) < limit * limit) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void poisson_disk_2d(double width, double height, double r_min,
+                     double r_max, RadiusFunction radius, unsigned int seed,
+                     Points& out) {
+
+    // PRE:  width and height are > 0, 0 < r_min <= r_max, and radius
+    //       is 0 (meaning r_min everywhere) or stays between r_min and
+    //       r_max
+    //
+    // POST: out holds a Poisson-disk sample of the rectangle from
+    //       (0, 0) to (width, height)
+
+    Grid2d grid;
+
+    init_grid(grid, width, height, r_min);
+    fill_region(grid, grid.cell_point, 0.0, 0.0, width, height, r_min, r_max,
+                radius, seed, out);
+    out.z.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void poisson_disk_2d_tiled(double width, double height, double r_min,
+                           double r_max, RadiusFunction radius,
+                           unsigned int seed, int threads, Points& out) {
+
+    // PRE:  as for poisson_disk_2d(), and threads >= 1
+    //
+    // POST: out holds a Poisson-disk sample of the rectangle from
+    //       (0, 0) to (width, height); the same seed always gives the
+    //       same sample, no matter how many threads are used
+
+    Grid2d grid;
+    double tile;            // used to hold the width of a tile
+    int tile_columns;       // used to hold the number of tiles across
+    int tile_rows;          // used to hold the number of tiles down
+
+    init_grid(grid, width, height, r_min);
+
+    // tiles are a whole number of cells wide, and at least as wide as
+    // the largest radius plus one cell, so that same colored tiles
+    // never see each other's new points
+    tile = grid.cell * ceil((r_max + grid.cell) / grid.cell);
+    if (tile < 32.0 * grid.cell) {
+        tile = 32.0 * grid.cell;
+    }
+    tile_columns = int(ceil(width / tile));
+    tile_rows = int(ceil(height / tile));
+
+    for (int color = 0; color < 4; color++) {
+
+        vector<int> tiles;          // used to hold this color's tiles
+        vector<Points> added;       // used to hold each tile's points
+        vector<thread> workers;
+
+        for (int ty = color / 2; ty < tile_rows; ty += 2) {
+            for (int tx = color % 2; tx < tile_columns; tx += 2) {
+                tiles.push_back(ty * tile_columns + tx);
+            }
+        }
+        added.resize(tiles.size());
+
+        // each thread fills every threads-th tile of this color; no two
+        // of them write the same grid cell
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(thread([&, t]() {
+                for (int k = t; k < int(tiles.size()); k += threads) {
+
+                    int tx = tiles[k] % tile_columns, ty = tiles[k] / tile_columns;
+                    double x1 = (tx + 1) * tile, y1 = (ty + 1) * tile;
+
+                    fill_region(grid, grid.cell_point, tx * tile, ty * tile,
+                                (x1 < width) ? x1 : width,
+                                (y1 < height) ? y1 : height, r_min, r_max,
+                                radius, tile_seed(seed, tiles[k]), added[k]);
+                }
+            }));
+        }
+        for (int t = 0; t < threads; t++) {
+            workers[t].join();
+        }
+
+        // move the new points into the grid's list, in tile order, and
+        // point their cells at their final positions
+        for (int k = 0; k < int(tiles.size()); k++) {
+            for (int p = 0; p < int(added[k].x.size()); p++) {
+
+                int gx = int(added[k].x[p] / grid.cell);
+                int gy = int(added[k].y[p] / grid.cell);
+
+                grid.cell_point[(long long) gy * grid.columns + gx] =
+                    int(grid.points.x.size());
+                grid.points.x.push_back(added[k].x[p]);
+                grid.points.y.push_back(added[k].y[p]);
+            }
+        }
+    }
+
+    out = grid.points;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void poisson_disk_3d(double width, double height, double depth, double r,
+                     unsigned int seed, Points& out) {
+
+    // PRE:  width, height, depth and r are all > 0
+    //
+    // POST: out holds a Poisson-disk sample of the box from (0, 0, 0)
+    //       to (width, height, depth)
+
+    double cell = r / sqrt(3.0);
+    int nx = int(ceil(width / cell));
+    int ny = int(ceil(height / cell));
+    int nz = int(ceil(depth / cell));
+    vector<int> cell_point((long long) nx * ny * nz, -1);
+    vector<int> active;
+
+    out.x.clear();
+    out.y.clear();
+    out.z.clear();
+
+    // the first point goes anywhere in the box
+    out.x.push_back(uniform_r(&seed) * width);
+    out.y.push_back(uniform_r(&seed) * height);
+    out.z.push_back(uniform_r(&seed) * depth);
+    cell_point[((long long) int(out.z[0] / cell) * ny + int(out.y[0] / cell)) * nx
+               + int(out.x[0] / cell)] = 0;
+    active.push_back(0);
+
+    while (!active.empty()) {
+
+        int a = int(uniform_r(&seed) * active.size());
+        bool kept = false;
+
+        for (int attempt = 0; attempt < CANDIDATES && !kept; attempt++) {
+
+            double dx, dy, dz;
+
+            sample_shell(r, &seed, dx, dy, dz);
+
+            double cx = out.x[active[a]] + dx;
+            double cy = out.y[active[a]] + dy;
+            double cz = out.z[active[a]] + dz;
+
+            if (cx < 0 || cy < 0 || cz < 0 || cx >= width || cy >= height
+                    || cz >= depth) {
+                continue;
+            }
+
+            int gx = int(cx / cell), gy = int(cy / cell), gz = int(cz / cell);
+            bool fits = true;
+
+            // with cells r / sqrt(3) wide, points within r are at most 2
+            // cells away in each direction
+            for (int k = gz - 2; k <= gz + 2 && fits; k++) {
+                for (int j = gy - 2; j <= gy + 2 && fits; j++) {
+                    for (int i = gx - 2; i <= gx + 2 && fits; i++) {
+
+                        if (i < 0 || j < 0 || k < 0 || i >= nx || j >= ny
+                                || k >= nz) {
+                            continue;
+                        }
+
+                        int p = cell_point[((long long) k * ny + j) * nx + i];
+                        if (p >= 0) {
+                            double ex = out.x[p] - cx;
+                            double ey = out.y[p] - cy;
+                            double ez = out.z[p] - cz;
+                            if (ex * ex + ey * ey + ez * ez < r * r) {
+                                fits = false;
+                            }
+                        }
+                    }
+                }
+            }
+
+            if (fits) {
+                cell_point[((long long) gz * ny + gy) * nx + gx] =
+                    int(out.x.size());
+                out.x.push_back(cx);
+                out.y.push_back(cy);
+                out.z.push_back(cz);
+                active.push_back(int(out.x.size()) - 1);
+                kept = true;
+            }
+        }
+
+        if (!kept) {
+            active[a] = active.back();
+            active.pop_back();
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double worst_spacing_2d(const Points& points, double r_min, double r_max,
+                        RadiusFunction radius) {
+
+    // PRE:  every point lies in a rectangle starting at (0, 0), and
+    //       0 < r_min <= r_max
+    //
+    // POST: the smallest value, over all pairs of points closer than
+    //       r_max, of (distance / allowed distance) has been returned;
+    //       a value of at least 1 means the sample is valid
+
+    double worst = 1e300;
+    double size_x = 0, size_y = 0;
+    Grid2d grid;
+
+    for (int p = 0; p < int(points.x.size()); p++) {
+        size_x = (points.x[p] > size_x) ? points.x[p] : size_x;
+        size_y = (points.y[p] > size_y) ? points.y[p] : size_y;
+    }
+
+    // put every point in a grid again, so only nearby pairs are checked
+    init_grid(grid, size_x + r_min, size_y + r_min, r_min);
+    for (int p = 0; p < int(points.x.size()); p++) {
+        grid.cell_point[(long long) int(points.y[p] / grid.cell) * grid.columns
+                        + int(points.x[p] / grid.cell)] = p;
+    }
+
+    int reach = int(ceil(r_max / grid.cell));
+
+    for (int p = 0; p < int(points.x.size()); p++) {
+
+        int gx = int(points.x[p] / grid.cell), gy = int(points.y[p] / grid.cell);
+        double rp = radius ? radius(points.x[p], points.y[p]) : r_min;
+
+        for (int j = gy - reach; j <= gy + reach; j++) {
+            for (int i = gx - reach; i <= gx + reach; i++) {
+
+                if (i < 0 || j < 0 || i >= grid.columns || j >= grid.rows) {
+                    continue;
+                }
+
+                int q = grid.cell_point[(long long) j * grid.columns + i];
+                if (q < 0 || q == p) {
+                    continue;
+                }
+
+                double rq = radius ? radius(points.x[q], points.y[q]) : r_min;
+                double limit = (rp > rq) ? rp : rq;
+                double d = sqrt((points.x[p] - points.x[q]) * (points.x[p] - points.x[q])
+                                + (points.y[p] - points.y[q]) * (points.y[p] - points.y[q]));
+
+                if (d / limit < worst) {
+                    worst = d / limit;
+                }
+            }
+        }
+    }
+
+    return worst;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double growing_radius(double x, double y) {
+
+    // PRE:  0 <= x <= 500
+    //
+    // POST: a radius growing from 1 at x = 0 to 5 at x = 500 has been
+    //       returned
+
+    (void) y;
+
+    return 1.0 + 4.0 * x / 500.0;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
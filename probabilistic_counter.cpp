@@ -0,0 +1,433 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+use random numbers to count things approximately, so that many
+threads can share one counter without slowing each other down.
+
+
+-----------------------------
+The Trouble With Shared Counters
+-----------------------------
+
+Suppose a busy program counts how many requests it has handled, and
+that several threads handle requests at the same time. Every thread
+adds 1 to the same counter. To keep the threads from losing each
+other's updates, the counter must be "atomic", which means the
+processor makes sure only one thread changes it at a time.
+
+Atomic counters are correct, but they can be very slow. Each core has
+its own small, fast memory (called a "cache"). When one core changes
+the counter, the counter has to be moved out of every other core's
+cache and into its own. If all cores update the counter millions of
+times per second, the counter spends its whole life travelling back
+and forth between cores. This is sometimes called "ping-pong".
+
+
+------------------
+Counting by Coins
+------------------
+
+Often we don't need the exact count -- "about 3.2 million requests"
+is just as useful as "3,214,775 requests". So here is the idea: each
+time a thread wants to add 1, it first flips a coin. Only if the coin
+comes up heads does it add 1 to the shared counter. At the end, we
+double the shared counter to get an estimate of the true count.
+
+With a fair coin, only about half of the updates touch the shared
+counter. We can go much further by using an unfair coin that comes
+up heads only once in 2^c flips (for example, once in 1024 flips when
+c is 10). At the end we multiply the shared counter by 2^c. Now only
+about one update in 1024 touches the shared counter.
+
+This idea was first described by Robert Morris in 1978, who used it
+to count large numbers of events in a tiny 8-bit counter.
+
+
+----------------------
+Skipping the Coin Flips
+----------------------
+
+Flipping a coin for every update still means calling a random number
+function for every update. Instead, we can ask a different question
+once: "how many flips until the next heads?" The answer follows the
+so-called geometric distribution, and a single random number U
+between 0 and 1 is enough to produce it:
+
+        flips = floor(log(U) / log(1 - p)) + 1
+
+where p = 1 / 2^c is the chance of heads. Each thread keeps this
+number in a private countdown. Adding 1 now just means subtracting 1
+from the private countdown. Only when the countdown reaches zero does
+the thread add 1 to the shared counter and draw a new countdown.
+
+Most updates therefore touch neither the shared counter nor the
+random number generator.
+
+Each thread also needs its own random number seed, so we use rand_r()
+with a private seed instead of rand(), which shares one seed between
+all threads.
+
+
+-------------------------
+How Accurate Is It?
+-------------------------
+
+If the true count is N and each update reaches the shared counter
+with chance p, the estimate is off by about
+
+        relative error = sqrt((1 - p) / (p * N))
+
+on average (this is called the "relative standard error"). The
+larger the count, the smaller the relative error. Turning this around,
+if we expect to count about N events and can accept a relative error
+of e, we can use the largest c for which
+
+        2^c <= 1 + e * e * N
+
+For example, to count about 100 million events to within 1%, c can be
+as large as 13, so only one update in 8192 touches the shared counter.
+
+
+----------------
+Review Questions
+----------------
+
+1. Why are atomic counters slow when many threads update them?
+
+2. What is a cache?
+
+3. If c is 4, what is the chance that an update touches the shared
+counter?
+
+4. How do we turn the shared counter into an estimate of the true
+count?
+
+5. Why do we draw the number of flips until the next heads, instead of
+flipping a coin for every update?
+
+6. Why does each thread use rand_r() with its own seed?
+
+7. Does the relative error get bigger or smaller as the count grows?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand_r() function
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the log(), floor() and sqrt() functions
+
+#include <cmath>
+
+
+// access the atomic, thread and vector types
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+// constant used to control how many updates each thread makes
+
+const long long REPETITIONS = 50000000;
+
+
+// constant used to control how many threads make updates
+
+const int THREADS = 4;
+
+
+// a counter shared by all threads; hits counts only the updates that
+// reached it, and scale is 2^c
+
+struct SharedCounter {
+    atomic<long long> hits;
+    int c;
+    long long scale;
+};
+
+
+// one thread's private view of a shared counter
+
+struct LocalCounter {
+    SharedCounter* shared;
+    long long countdown;
+    unsigned int seed;
+};
+
+
+// prototype for a function to choose c from the expected count and the
+// relative error that can be accepted
+
+int choose_c(double expected_count, double relative_error);
+
+
+// prototype for a function to set up a thread's private view of a
+// shared counter
+
+void attach_counter(LocalCounter& local, SharedCounter* shared,
+                    unsigned int seed);
+
+
+// prototype for a function to draw the number of updates until the next
+// one that reaches the shared counter
+
+long long draw_countdown(LocalCounter& local);
+
+
+// prototype for a function to add 1 to a counter, approximately
+
+void increment(LocalCounter& local);
+
+
+// prototype for a function to estimate the true count
+
+double estimate(const SharedCounter& shared);
+
+
+// prototypes for functions run by each thread
+
+void exact_worker(atomic<long long>* counter, long long updates);
+void approximate_worker(SharedCounter* shared, unsigned int seed,
+                        long long updates);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    atomic<long long> exact;    // used to hold the exact counter
+    SharedCounter shared;       // used to hold the approximate counter
+    vector<thread> workers;     // used to hold the running threads
+    double start;               // used to hold the starting time
+    double exact_time;          // used to hold the exact counter's time
+    double approximate_time;    // used to hold the approximate time
+    double truth;               // used to hold the true count
+    double p;                   // used to hold the chance of a hit
+
+    truth = double(REPETITIONS) * THREADS;
+
+    // choose c so that the estimate is within about 1% of the truth
+    shared.hits = 0;
+    shared.c = choose_c(truth, 0.01);
+    shared.scale = 1LL << shared.c;
+    p = 1.0 / double(shared.scale);
+
+    // count with an exact atomic counter
+    exact = 0;
+    start = now();
+    for (int t = 0; t < THREADS; t++) {
+        workers.push_back(thread(exact_worker, &exact, REPETITIONS));
+    }
+    for (int t = 0; t < THREADS; t++) {
+        workers[t].join();
+    }
+    exact_time = now() - start;
+    workers.clear();
+
+    // count with the approximate counter; each thread gets its own seed,
+    // based on the number of seconds since the Unix Epoch
+    start = now();
+    for (int t = 0; t < THREADS; t++) {
+        workers.push_back(thread(approximate_worker, &shared,
+                                 (unsigned int) time(0) + 7919u * t,
+                                 REPETITIONS));
+    }
+    for (int t = 0; t < THREADS; t++) {
+        workers[t].join();
+    }
+    approximate_time = now() - start;
+
+    // display the results
+    cout << endl
+         << THREADS << " threads each adding 1, "
+         << REPETITIONS << " times" << endl
+         << endl
+         << "Exact counter:        " << exact.load()
+         << " in " << exact_time << " seconds, "
+         << exact.load() << " shared updates" << endl
+         << "Approximate counter:  " << estimate(shared)
+         << " in " << approximate_time << " seconds, "
+         << shared.hits.load() << " shared updates" << endl
+         << endl
+         << "c = " << shared.c
+         << ", expected relative error "
+         << 100.0 * sqrt((1.0 - p) / (p * truth)) << "%"
+         << ", actual relative error "
+         << 100.0 * fabs(estimate(shared) - truth) / truth << "%"
+         << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int choose_c(double expected_count, double relative_error) {
+
+    // PRE:  expected_count >= 1 and relative_error > 0
+    //
+    // POST: the largest c (at most 62) for which the relative standard
+    //       error of a count of expected_count is at most
+    //       relative_error has been returned
+
+    int c = 0;      // used to hold the chosen c
+
+    while (c < 62 && double(1LL << (c + 1))
+                     <= 1.0 + relative_error * relative_error * expected_count) {
+        c++;
+    }
+
+    return c;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void attach_counter(LocalCounter& local, SharedCounter* shared,
+                    unsigned int seed) {
+
+    // PRE:  shared->c and shared->scale have been set
+    //
+    // POST: local is ready to add to shared
+
+    local.shared = shared;
+    local.seed = seed;
+    local.countdown = draw_countdown(local);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+long long draw_countdown(LocalCounter& local) {
+
+    // PRE:  local.shared and local.seed have been set
+    //
+    // POST: a random number of updates, following the geometric
+    //       distribution with p = 1 / 2^c, has been returned
+
+    double u;       // used to hold a random number between 0 and 1
+
+    // with c = 0 every update is a hit
+    if (local.shared->c == 0) {
+        return 1;
+    }
+
+    // add 1 on top and bottom so that u is never exactly 0
+    u = (double(rand_r(&local.seed)) + 1.0) / (double(RAND_MAX) + 1.0);
+
+    return (long long) floor(log(u) / log1p(-1.0 / double(local.shared->scale)))
+           + 1;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void increment(LocalCounter& local) {
+
+    // PRE:  attach_counter() has been called on local
+    //
+    // POST: 1 has been added to the count, approximately
+
+    // almost every update ends here, touching only private memory
+    local.countdown--;
+    if (local.countdown > 0) {
+        return;
+    }
+
+    local.shared->hits.fetch_add(1, memory_order_relaxed);
+    local.countdown = draw_countdown(local);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double estimate(const SharedCounter& shared) {
+
+    // PRE:  none
+    //
+    // POST: an estimate of the true number of updates has been
+    //       returned
+
+    return double(shared.hits.load()) * double(shared.scale);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void exact_worker(atomic<long long>* counter, long long updates) {
+
+    // PRE:  none
+    //
+    // POST: 1 has been added to counter, updates times
+
+    for (long long i = 0; i < updates; i++) {
+        counter->fetch_add(1, memory_order_relaxed);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void approximate_worker(SharedCounter* shared, unsigned int seed,
+                        long long updates) {
+
+    // PRE:  shared->c and shared->scale have been set
+    //
+    // POST: 1 has been added to shared, approximately, updates times
+
+    LocalCounter local;     // used to hold this thread's private view
+
+    attach_counter(local, shared, seed);
+
+    for (long long i = 0; i < updates; i++) {
+        increment(local);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
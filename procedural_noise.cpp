@@ -0,0 +1,1478 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+make "noise" in C++: random values that change smoothly from place to
+place, as used to draw clouds, marble, or the hills of a game world.
+
+
+----------------------
+Random, But Smooth
+----------------------
+
+If we wanted the height of a landscape at every point on a grid, we
+could call rand_range() for every point. The result would be spiky
+nonsense, because neighbouring points would have nothing to do with
+each other. Real hills rise and fall gradually.
+
+Noise functions solve this by placing random values only at the
+corners of a coarse grid (called the "lattice"), and blending smoothly
+between them everywhere else.
+
+
+-----------------------------------
+Random Values Without Calling rand()
+-----------------------------------
+
+Each lattice corner needs its own random value, and it must be the
+SAME value every time we ask for it -- otherwise the landscape would
+change each time we looked at it. Calling rand() would give a new
+value each time.
+
+Older noise code solves this with a shuffled table of 256 numbers
+(a "permutation table"). We use a simpler idea: a hash function, which
+scrambles the corner's coordinates and a seed into a random looking
+number. The same corner and seed always give the same number, there
+is no table to set up, and the pattern never repeats every 256 steps
+the way a permutation table does.
+
+
+-------------------------------------
+Three Kinds of Noise
+-------------------------------------
+
+Value noise: each corner gets a random height between -1 and 1, and
+we blend the heights of the surrounding corners. It is simple, but
+looks a little "blocky".
+
+Gradient (Perlin) noise: each corner gets a random direction (called
+a "gradient") instead of a height. Each corner's contribution is how
+far the point is from the corner, measured along that direction. The
+result is 0 at every corner and has nicely rounded hills in between.
+Ken Perlin invented this in 1983 for the film Tron.
+
+Simplex noise: instead of squares (or cubes), the lattice is made of
+triangles (or their 3D and 4D cousins, called "simplices"). A square
+has 4 corners but a triangle has only 3; a 4D cube has 16 corners
+but a 4D simplex has only 5. So simplex noise does far less work in
+3D and 4D, and has fewer visible grid lines.
+
+For the blending, a straight-line mix shows creases at the lattice
+lines, so we use the "smootherstep" curve 6t^5 - 15t^4 + 10t^3,
+which eases in and out.
+
+
+--------------------------
+Octaves (fBm)
+--------------------------
+
+A single layer of noise looks like gentle rolling hills. Real
+landscapes have big mountains, smaller hills on the mountains, and
+rocks on the hills. We get this by adding several layers (called
+"octaves"). Each octave has twice the detail (frequency) and half the
+height (amplitude) of the one before. This is called fractional
+Brownian motion, or fBm.
+
+
+-----------------------
+Filling a Tile at Once
+-----------------------
+
+A game world needs billions of noise values, so we fill a whole
+tile of a 2D, 3D or 4D grid with one function call. The tile is
+filled a row at a time: along a row only x changes, so y, z and w,
+and anything that depends only on them, are worked out once per row.
+The x of every point of the row goes in an array, and each kind of
+noise has a "row" function that does one step -- hash, gradient,
+blend -- for the whole array before the next step (a "structure of
+arrays"). For value and gradient noise, the corners of the fixed
+dimensions are handled one at a time, each giving a line of values
+along x, and the lines are then blended together.
+
+Loops like these are what the compiler can turn into vector
+instructions that work on 4, 8 or 16 points at once, but only if
+every point does exactly the same work. So the row functions never
+skip a far-away simplex corner (it just adds 0), and never choose
+between two bits of arithmetic: GCC turns such a choice into a
+branch, and will not vectorize a loop with a branch in it. (That is
+also why 2D gradient noise looks its 8 directions up in a small table,
+instead of choosing between formulas.) The results are the same as
+the single-point functions give.
+
+We checked with g++ -fopt-info-vec: with -O3 every row loop is
+vectorized. With -O2, GCC 12 vectorizes only a few of them. Filling
+a million 2D points with 5 octaves (seconds, one core):
+
+                    one point at a time      a tile at a time
+                    -O2    -O3   native      -O2    -O3   native
+        value       0.11   0.11   0.06       0.11   0.05   0.01
+        gradient    0.15   0.14   0.08       0.09   0.06   0.04
+        simplex     0.23   0.19   0.13       0.18   0.06   0.01
+
+("native" is -O3 -march=native, here with AVX-512 instructions.
+There the tiles can differ from the single points in the last few
+bits, since the compiler fuses multiplies and adds differently.) So
+build with -O3 to get the speed-up.
+
+
+----------------
+Review Questions
+----------------
+
+1. Why is calling rand_range() for every point a poor way to make a
+landscape?
+
+2. What is the lattice?
+
+3. Why must a lattice corner always get the same random value?
+
+4. What does the hash function replace?
+
+5. What is stored at each corner in value noise? In gradient noise?
+
+6. Why is simplex noise faster than gradient noise in 4D?
+
+7. What changes from one octave to the next?
+
+8. Why is it faster to fill a whole tile with one call?
+
+9. Why must every point in a row do exactly the same work?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the floor() and sqrt() functions
+
+#include <cmath>
+
+
+// access the printf() function
+
+#include <cstdio>
+
+
+// access the vector and string types
+
+#include <vector>
+#include <string>
+
+
+// constants used to control the size of the sample tile
+
+const int TILE_WIDTH = 64;
+const int TILE_HEIGHT = 24;
+
+
+// constant used to control how many octaves are added together
+
+const int OCTAVES = 5;
+
+
+// constant used to control how many points each speed test fills
+
+const int SPEED_POINTS = 1 << 20;
+
+
+// the three kinds of noise
+
+enum NoiseKind { VALUE, GRADIENT, SIMPLEX };
+
+
+// the 8 directions of 2D gradient noise: 4 diagonal ones, and 4 along
+// an axis, scaled by sqrt(2) to the same length; they add up to 0, so
+// the noise has no lean in any direction
+
+const float GRADIENTS_2D[8][2] = {
+    { -1.0f, -1.0f }, { 1.0f, -1.0f }, { -1.0f, 1.0f }, { 1.0f, 1.0f },
+    { 0.0f, -1.4142135f }, { 1.4142135f, 0.0f },
+    { 0.0f, 1.4142135f }, { -1.4142135f, 0.0f }
+};
+
+
+// prototype for a function to hash lattice coordinates and a seed
+
+unsigned int hash_lattice(unsigned int seed, int x, int y, int z, int w);
+
+
+// prototype for a function to turn a hash into a number between -1
+// and 1
+
+float hash_to_float(unsigned int h);
+
+
+// prototype for the smootherstep blending curve
+
+float fade(float t);
+
+
+// prototypes for 2D, 3D and 4D value noise
+
+float value_noise_2d(unsigned int seed, float x, float y);
+float value_noise_3d(unsigned int seed, float x, float y, float z);
+float value_noise_4d(unsigned int seed, float x, float y, float z, float w);
+
+
+// prototypes for 2D, 3D and 4D gradient (Perlin) noise
+
+float gradient_noise_2d(unsigned int seed, float x, float y);
+float gradient_noise_3d(unsigned int seed, float x, float y, float z);
+float gradient_noise_4d(unsigned int seed, float x, float y, float z,
+                        float w);
+
+
+// prototypes for 2D, 3D and 4D simplex noise
+
+float simplex_noise_2d(unsigned int seed, float x, float y);
+float simplex_noise_3d(unsigned int seed, float x, float y, float z);
+float simplex_noise_4d(unsigned int seed, float x, float y, float z,
+                       float w);
+
+
+// prototype for a function to add octaves of 2D noise (fBm)
+
+float fbm_2d(NoiseKind kind, unsigned int seed, float x, float y,
+             int octaves);
+
+
+// prototype for a function to round down to a lattice coordinate
+// without calling floor(), so that loops using it can be vectorized
+
+int lattice_floor(float v);
+
+
+// prototypes for functions that add amplitude times the noise at
+// (x[i], y, z, w) to out[i] for a whole row of points; dims is 2, 3
+// or 4, and lines has room for 8 * count values
+
+void value_row(unsigned int seed, int dims, const float* x, float y,
+               float z, float w, float amplitude, int count, float* out,
+               float* lines);
+void gradient_row(unsigned int seed, int dims, const float* x, float y,
+                  float z, float w, float amplitude, int count, float* out,
+                  float* lines);
+void simplex_row_2d(unsigned int seed, const float* x, float y,
+                    float amplitude, int count, float* out);
+void simplex_row_3d(unsigned int seed, const float* x, float y, float z,
+                    float amplitude, int count, float* out);
+void simplex_row_4d(unsigned int seed, const float* x, float y, float z,
+                    float w, float amplitude, int count, float* out);
+
+
+// prototypes for functions to find one corner's part of 3D or 4D
+// simplex noise, for the row functions
+
+float simplex_corner_3d(unsigned int seed, const int* i, const float* p,
+                        const int* rank, int c);
+float simplex_corner_4d(unsigned int seed, const int* i, const float* p,
+                        const int* rank, int c);
+
+
+// prototype for a function to fill a row of points with fBm
+
+void fbm_row(NoiseKind kind, int dims, unsigned int seed, float x0,
+             float step, float y, float z, float w, int count, int octaves,
+             float* out, float* scratch);
+
+
+// prototypes for functions to fill a tile of a 2D, 3D or 4D grid with
+// fBm
+
+void fill_tile_2d(NoiseKind kind, unsigned int seed, float x0, float y0,
+                  float step, int width, int height, int octaves,
+                  float* out);
+void fill_tile_3d(NoiseKind kind, unsigned int seed, float x0, float y0,
+                  float z0, float step, int width, int height, int depth,
+                  int octaves, float* out);
+void fill_tile_4d(NoiseKind kind, unsigned int seed, float x0, float y0,
+                  float z0, float w0, float step, int width, int height,
+                  int depth, int frames, int octaves, float* out);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    unsigned int seed;          // used to hold the seed of the world
+    vector<float> tile;         // used to hold a tile of noise values
+    const string shades = " .:-=+*#%@";    // used to draw the heights
+    const char* names[] = { "value", "gradient (Perlin)", "simplex" };
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch, and use rand() to choose the
+    // world's seed
+    srand(int(time(0)));
+    seed = (unsigned int) rand();
+
+    tile.resize(TILE_WIDTH * TILE_HEIGHT);
+
+    // draw a tile of each kind of noise, as text
+    for (int kind = VALUE; kind <= SIMPLEX; kind++) {
+
+        fill_tile_2d(NoiseKind(kind), seed, 0.0f, 0.0f, 0.08f,
+                     TILE_WIDTH, TILE_HEIGHT, OCTAVES, &tile[0]);
+
+        cout << endl << names[kind] << " noise, " << OCTAVES
+             << " octaves" << endl;
+
+        for (int j = 0; j < TILE_HEIGHT; j++) {
+            for (int i = 0; i < TILE_WIDTH; i++) {
+
+                // fBm values stay roughly between -1 and 1
+                int shade = int((tile[j * TILE_WIDTH + i] + 1.0f) * 0.5f
+                                * float(shades.size()));
+
+                if (shade < 0) {
+                    shade = 0;
+                }
+                if (shade >= int(shades.size())) {
+                    shade = int(shades.size()) - 1;
+                }
+                cout << shades[shade];
+            }
+            cout << endl;
+        }
+    }
+
+    // show that 3D and 4D noise are available too
+    cout << endl
+         << "3D and 4D samples at (0.5, 1.25, 2.75, 3.5):" << endl
+         << "    value:    " << value_noise_3d(seed, 0.5f, 1.25f, 2.75f)
+         << "  " << value_noise_4d(seed, 0.5f, 1.25f, 2.75f, 3.5f) << endl
+         << "    gradient: " << gradient_noise_3d(seed, 0.5f, 1.25f, 2.75f)
+         << "  " << gradient_noise_4d(seed, 0.5f, 1.25f, 2.75f, 3.5f) << endl
+         << "    simplex:  " << simplex_noise_3d(seed, 0.5f, 1.25f, 2.75f)
+         << "  " << simplex_noise_4d(seed, 0.5f, 1.25f, 2.75f, 3.5f) << endl;
+
+    // check that the gradients add up to 0, and that the average of
+    // each kind of noise over a large tile is close to 0
+    float sum_x = 0, sum_y = 0;
+    for (int g = 0; g < 8; g++) {
+        sum_x += GRADIENTS_2D[g][0];
+        sum_y += GRADIENTS_2D[g][1];
+    }
+    cout << endl << "Sum of the 2D gradients: (" << sum_x << ", " << sum_y
+         << ")" << endl << "Average over a 1024 x 1024 tile (should be near 0):"
+         << endl;
+
+    tile.resize(1024 * 1024);
+    for (int kind = VALUE; kind <= SIMPLEX; kind++) {
+
+        double total = 0;
+
+        fill_tile_2d(NoiseKind(kind), seed, 0.0f, 0.0f, 0.1f, 1024, 1024,
+                     OCTAVES, &tile[0]);
+        for (int i = 0; i < 1024 * 1024; i++) {
+            total += tile[i];
+        }
+        cout << "    " << names[kind] << ": " << total / (1024 * 1024)
+             << endl;
+    }
+
+    // time filling SPEED_POINTS points: a 2D tile one point at a time
+    // with fbm_2d(), and 2D, 3D and 4D tiles a row at a time
+    tile.resize(SPEED_POINTS);
+    cout << endl << "Seconds to fill " << SPEED_POINTS << " points with "
+         << OCTAVES << " octaves:" << endl
+         << "                       2D points  2D tile  3D tile  4D tile"
+         << endl;
+
+    for (int kind = VALUE; kind <= SIMPLEX; kind++) {
+
+        double start = now();
+        double seconds[4];
+
+        for (int j = 0; j < 1024; j++) {
+            for (int i = 0; i < SPEED_POINTS / 1024; i++) {
+                tile[j * (SPEED_POINTS / 1024) + i]
+                    = fbm_2d(NoiseKind(kind), seed, float(i) * 0.01f,
+                             float(j) * 0.01f, OCTAVES);
+            }
+        }
+        seconds[0] = now() - start;
+
+        start = now();
+        fill_tile_2d(NoiseKind(kind), seed, 0.0f, 0.0f, 0.01f,
+                     SPEED_POINTS / 1024, 1024, OCTAVES, &tile[0]);
+        seconds[1] = now() - start;
+
+        start = now();
+        fill_tile_3d(NoiseKind(kind), seed, 0.0f, 0.0f, 0.0f, 0.01f,
+                     SPEED_POINTS / 4096, 256, 16, OCTAVES, &tile[0]);
+        seconds[2] = now() - start;
+
+        start = now();
+        fill_tile_4d(NoiseKind(kind), seed, 0.0f, 0.0f, 0.0f, 0.0f, 0.01f,
+                     SPEED_POINTS / 4096, 64, 8, 8, OCTAVES, &tile[0]);
+        seconds[3] = now() - start;
+
+        printf("    %-18s %9.3f %8.3f %8.3f %8.3f\n", names[kind], seconds[0],
+               seconds[1], seconds[2], seconds[3]);
+    }
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned int hash_lattice(unsigned int seed, int x, int y, int z, int w) {
+
+    // PRE:  none
+    //
+    // POST: a random looking number that depends on seed and all four
+    //       coordinates has been returned; the same inputs always give
+    //       the same result
+
+    unsigned int h;     // used to hold the value being mixed
+
+    // multiply each coordinate by a different large odd number, then
+    // mix the bits thoroughly (the finishing steps of MurmurHash3)
+    h = seed;
+    h ^= (unsigned int) x * 0x8DA6B343u;
+    h ^= (unsigned int) y * 0xD8163841u;
+    h ^= (unsigned int) z * 0xCB1AB31Fu;
+    h ^= (unsigned int) w * 0x165667B1u;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+
+    return h;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+float hash_to_float(unsigned int h) {
+
+    // PRE:  none
+    //
+    // POST: a number between -1 and 1, taken from the top 24 bits of
+    //       h, has been returned
+
+    return float(h >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+float fade(float t) {
+
+    // PRE:  0 <= t <= 1
+    //
+    // POST: 6t^5 - 15t^4 + 10t^3 has been returned
+
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+float value_noise_2d(unsigned int seed, float x, float y) {
+
+    // PRE:  none
+    //
+    // POST: the value noise at (x, y), between -1 and 1, has been
+    //       returned
+
+    float fx = floor(x), fy = floor(y);
+    int ix = int(fx), iy = int(fy);
+    float u = fade(x - fx), v = fade(y - fy);
+
+    float a = hash_to_float(hash_lattice(seed, ix, iy, 0, 0));
+    float b = hash_to_float(hash_lattice(seed, ix + 1, iy, 0, 0));
+    float c = hash_to_float(hash_lattice(seed, ix, iy + 1, 0, 0));
+    float d = hash_to_float(hash_lattice(seed, ix + 1, iy + 1, 0, 0));
+
+    // blend along x, then along y
+    float bottom = a + u * (b - a);
+    float top = c + u * (d - c);
+
+    return bottom + v * (top - bottom);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+float value_noise_3d(unsigned int seed, float x, float y, float z) {
+
+    // PRE:  none
+    //
+    // POST: the value noise at (x, y, z), between -1 and 1, has been
+    //       returned
+
+    float fz = floor(z);
+    int iz = int(fz);
+    float t = fade(z - fz);
+    float fx = floor(x), fy = floor(y);
+    int ix = int(fx), iy = int(fy);
+    float u = fade(x - fx), v = fade(y - fy);
+    float layer[2];
+
+    // blend each of the two layers of 4 corners, then blend along z
+    for (int k = 0; k < 2; k++) {
+        float a = hash_to_float(hash_lattice(seed, ix, iy, iz + k, 0));
+        float b = hash_to_float(hash_lattice(seed, ix + 1, iy, iz + k, 0));
+        float c = hash_to_float(hash_lattice(seed, ix, iy + 1, iz + k, 0));
+        float d = hash_to_float(hash_lattice(seed, ix + 1, iy + 1, iz + k, 0));
+        float bottom = a + u * (b - a);
+        float top = c + u * (d - c);
+        layer[k] = bottom + v * (top - bottom);
+    }
+
+    return layer[0] + t * (layer[1] - layer[0]);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+float value_noise_4d(unsigned int seed, float x, float y, float z, float w) {
+
+    // PRE:  none
+    //
+    // POST: the value noise at (x, y, z, w), between -1 and 1, has
+    //       been returned
+
+    float f[4] = { floor(x), floor(y), floor(z), floor(w) };
+    int i[4] = { int(f[0]), int(f[1]), int(f[2]), int(f[3]) };
+    float t[4] = { fade(x - f[0]), fade(y - f[1]), fade(z - f[2]),
+                   fade(w - f[3]) };
+    float corner[16];
+
+    // the 16 corners, numbered so that bit d of the number says
+    // whether to step along dimension d
+    for (int c = 0; c < 16; c++) {
+        corner[c] = hash_to_float(hash_lattice(seed, i[0] + (c & 1),
+                                               i[1] + ((c >> 1) & 1),
+                                               i[2] + ((c >> 2) & 1),
+                                               i[3] + ((c >> 3) & 1)));
+    }
+
+    // blend away one dimension at a time, halving the corners
+    for (int d = 0, n = 16; d < 4; d++, n /= 2) {
+        for (int c = 0; c < n / 2; c++) {
+            corner[c] = corner[2 * c] + t[d] * (corner[2 * c + 1] - corner[2 * c]);
+        }
+    }
+
+    return corner[0];
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+float gradient_noise_2d(unsigned int seed, float x, float y) {
+
+    // PRE:  none
+    //
+    // POST: the gradient noise at (x, y), roughly between -1 and 1,
+    //       has been returned
+
+    float fx = floor(x), fy = floor(y);
+    int ix = int(fx), iy = int(fy);
+    float dx = x - fx, dy = y - fy;
+    float u = fade(dx), v = fade(dy);
+    float dot[4];
+
+    // each corner's gradient is one of 8 directions, chosen by the
+    // hash; its contribution is the distance along that direction
+    for (int c = 0; c < 4; c++) {
+
+        int cx = c & 1, cy = c >> 1;
+        unsigned int h = hash_lattice(seed, ix + cx, iy + cy, 0, 0) & 7;
+        float px = dx - cx, py = dy - cy;
+
+        dot[c] = GRADIENTS_2D[h][0] * px + GRADIENTS_2D[h][1] * py;
+    }
+
+    float bottom = dot[0] + u * (dot[1] - dot[0]);
+    float top = dot[2] + u * (dot[3] - dot[2]);
+
+    return (bottom + v * (top - bottom)) * 0.7071068f;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+float gradient_noise_3d(unsigned int seed, float x, float y, float z) {
+
+    // PRE:  none
+    //
+    // POST: the gradient noise at (x, y, z), roughly between -1 and 1,
+    //       has been returned
+
+    float f[3] = { floor(x), floor(y), floor(z) };
+    int i[3] = { int(f[0]), int(f[1]), int(f[2]) };
+    float p[3] = { x - f[0], y - f[1], z - f[2] };
+    float dot[8];
+
+    // each corner's gradient is one of Perlin's 12 edge directions of
+    // a cube, such as (1, 1, 0) or (0, -1, 1)
+    for (int c = 0; c < 8; c++) {
+
+        int cx = c & 1, cy = (c >> 1) & 1, cz = c >> 2;
+        unsigned int h = hash_lattice(seed, i[0] + cx, i[1] + cy, i[2] + cz, 0)
+                         % 12;
+        float px = p[0] - cx, py = p[1] - cy, pz = p[2] - cz;
+        float a = (h < 8) ? px : py;
+        float b = (h < 4) ? py : pz;
+
+        dot[c] = ((h & 1) ? -a : a) + ((h & 2) ? -b : b);
+    }
+
+    for (int d = 0, n = 8; d < 3; d++, n /= 2) {
+        float t = fade(p[d]);
+        for (int c = 0; c < n / 2; c++) {
+            dot[c] = dot[2 * c] + t * (dot[2 * c + 1] - dot[2 * c]);
+        }
+    }
+
+    return dot[0];
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+float gradient_noise_4d(unsigned int seed, float x, float y, float z,
+                        float w) {
+
+    // PRE:  none
+    //
+    // POST: the gradient noise at (x, y, z, w), roughly between -1 and
+    //       1, has been returned
+
+    float f[4] = { floor(x), floor(y), floor(z), floor(w) };
+    int i[4] = { int(f[0]), int(f[1]), int(f[2]), int(f[3]) };
+    float p[4] = { x - f[0], y - f[1], z - f[2], w - f[3] };
+    float dot[16];
+
+    // each corner's gradient is one of the 32 directions that have
+    // one coordinate 0 and the other three +1 or -1
+    for (int c = 0; c < 16; c++) {
+
+        float q[4];
+        unsigned int h = hash_lattice(seed, i[0] + (c & 1), i[1] + ((c >> 1) & 1),
+                                      i[2] + ((c >> 2) & 1), i[3] + (c >> 3));
+        int zero = h & 3;
+        float sum = 0;
+
+        for (int d = 0; d < 4; d++) {
+            q[d] = p[d] - float((c >> d) & 1);
+        }
+        for (int d = 0; d < 4; d++) {
+            if (d != zero) {
+                sum += ((h >> (2 + d)) & 1) ? -q[d] : q[d];
+            }
+        }
+        dot[c] = sum;
+    }
+
+    for (int d = 0, n = 16; d < 4; d++, n /= 2) {
+        float t = fade(p[d]);
+        for (int c = 0; c < n / 2; c++) {
+            dot[c] = dot[2 * c] + t * (dot[2 * c + 1] - dot[2 * c]);
+        }
+    }
+
+    return dot[0] * 0.5f;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+float simplex_noise_2d(unsigned int seed, float x, float y) {
+
+    // PRE:  none
+    //
+    // POST: the simplex noise at (x, y), roughly between -1 and 1, has
+    //       been returned
+
+    // skewing turns the triangle grid into a square grid, so that the
+    // triangle holding (x, y) is easy to find
+    const float F2 = 0.36602540f;   // (sqrt(3) - 1) / 2
+    const float G2 = 0.21132487f;   // (3 - sqrt(3)) / 6
+
+    float s = (x + y) * F2;
+    int i = int(floor(x + s)), j = int(floor(y + s));
+    float t = float(i + j) * G2;
+    float x0 = x - (float(i) - t), y0 = y - (float(j) - t);
+
+    // the point is in the lower or upper triangle of its square
+    int i1 = (x0 > y0) ? 1 : 0, j1 = 1 - i1;
+
+    float cx[3] = { x0, x0 - i1 + G2, x0 - 1.0f + 2.0f * G2 };
+    float cy[3] = { y0, y0 - j1 + G2, y0 - 1.0f + 2.0f * G2 };
+    int ox[3] = { 0, i1, 1 }, oy[3] = { 0, j1, 1 };
+    float total = 0;
+
+    // each of the 3 corners adds a contribution that fades to 0 at a
+    // fixed distance, so there is nothing to blend
+    for (int c = 0; c < 3; c++) {
+
+        float falloff = 0.5f - cx[c] * cx[c] - cy[c] * cy[c];
+
+        if (falloff > 0) {
+            unsigned int h = hash_lattice(seed, i + ox[c], j + oy[c], 0, 0);
+            float gx = hash_to_float(h), gy = hash_to_float(h * 0x9E3779B1u);
+
+            falloff *= falloff;
+            total += falloff * falloff * (gx * cx[c] + gy * cy[c]);
+        }
+    }
+
+    return 70.0f * total;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+float simplex_noise_3d(unsigned int seed, float x, float y, float z) {
+
+    // PRE:  none
+    //
+    // POST: the simplex noise at (x, y, z), roughly between -1 and 1,
+    //       has been returned
+
+    const float F3 = 1.0f / 3.0f;
+    const float G3 = 1.0f / 6.0f;
+
+    float s = (x + y + z) * F3;
+    int i[3] = { int(floor(x + s)), int(floor(y + s)), int(floor(z + s)) };
+    float t = float(i[0] + i[1] + i[2]) * G3;
+    float p[3] = { x - (i[0] - t), y - (i[1] - t), z - (i[2] - t) };
+    int rank[3] = { 0, 0, 0 };
+    float total = 0;
+
+    // the simplex is found by ranking the coordinates from largest to
+    // smallest; the corners step along the largest first
+    for (int a = 0; a < 3; a++) {
+        for (int b = a + 1; b < 3; b++) {
+            if (p[a] >= p[b]) {
+                rank[a]++;
+            } else {
+                rank[b]++;
+            }
+        }
+    }
+
+    for (int c = 0; c < 4; c++) {
+
+        int o[3];
+        float q[3];
+        float falloff = 0.6f;
+
+        for (int d = 0; d < 3; d++) {
+            o[d] = (rank[d] >= 3 - c) ? 1 : 0;
+            q[d] = p[d] - o[d] + c * G3;
+            falloff -= q[d] * q[d];
+        }
+
+        if (falloff > 0) {
+            unsigned int h = hash_lattice(seed, i[0] + o[0], i[1] + o[1],
+                                          i[2] + o[2], 0);
+            float g = hash_to_float(h) * q[0]
+                      + hash_to_float(h * 0x9E3779B1u) * q[1]
+                      + hash_to_float(h * 0x85EBCA77u) * q[2];
+
+            falloff *= falloff;
+            total += falloff * falloff * g;
+        }
+    }
+
+    return 32.0f * total;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+float simplex_noise_4d(unsigned int seed, float x, float y, float z,
+                       float w) {
+
+    // PRE:  none
+    //
+    // POST: the simplex noise at (x, y, z, w), roughly between -1 and
+    //       1, has been returned
+
+    const float F4 = 0.30901699f;   // (sqrt(5) - 1) / 4
+    const float G4 = 0.13819660f;   // (5 - sqrt(5)) / 20
+
+    float s = (x + y + z + w) * F4;
+    int i[4] = { int(floor(x + s)), int(floor(y + s)), int(floor(z + s)),
+                 int(floor(w + s)) };
+    float t = float(i[0] + i[1] + i[2] + i[3]) * G4;
+    float p[4] = { x - (i[0] - t), y - (i[1] - t), z - (i[2] - t),
+                   w - (i[3] - t) };
+    int rank[4] = { 0, 0, 0, 0 };
+    float total = 0;
+
+    for (int a = 0; a < 4; a++) {
+        for (int b = a + 1; b < 4; b++) {
+            if (p[a] >= p[b]) {
+                rank[a]++;
+            } else {
+                rank[b]++;
+            }
+        }
+    }
+
+    for (int c = 0; c < 5; c++) {
+
+        int o[4];
+        float q[4];
+        float falloff = 0.6f;
+
+        for (int d = 0; d < 4; d++) {
+            o[d] = (rank[d] >= 4 - c) ? 1 : 0;
+            q[d] = p[d] - o[d] + c * G4;
+            falloff -= q[d] * q[d];
+        }
+
+        if (falloff > 0) {
+            unsigned int h = hash_lattice(seed, i[0] + o[0], i[1] + o[1],
+                                          i[2] + o[2], i[3] + o[3]);
+            float g = hash_to_float(h) * q[0]
+                      + hash_to_float(h * 0x9E3779B1u) * q[1]
+                      + hash_to_float(h * 0x85EBCA77u) * q[2]
+                      + hash_to_float(h * 0xC2B2AE3Du) * q[3];
+
+            falloff *= falloff;
+            total += falloff * falloff * g;
+        }
+    }
+
+    return 27.0f * total;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+float fbm_2d(NoiseKind kind, unsigned int seed, float x, float y,
+             int octaves) {
+
+    // PRE:  octaves >= 1
+    //
+    // POST: the sum of octaves layers of noise at (x, y), each with
+    //       twice the frequency and half the amplitude of the last,
+    //       scaled back to roughly between -1 and 1, has been returned
+
+    float total = 0;
+    float amplitude = 0.5f;
+    float frequency = 1.0f;
+
+    for (int o = 0; o < octaves; o++) {
+
+        // each octave gets its own seed, so the layers don't line up
+        unsigned int octave_seed = seed + 0x9E3779B9u * (unsigned int) o;
+        float n;
+
+        if (kind == VALUE) {
+            n = value_noise_2d(octave_seed, x * frequency, y * frequency);
+        } else if (kind == GRADIENT) {
+            n = gradient_noise_2d(octave_seed, x * frequency, y * frequency);
+        } else {
+            n = simplex_noise_2d(octave_seed, x * frequency, y * frequency);
+        }
+
+        total += amplitude * n;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+
+    return total * 2.0f;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int lattice_floor(float v) {
+
+    // PRE:  v is between -2^31 and 2^31
+    //
+    // POST: the largest whole number not above v has been returned
+
+    int i = int(v);     // rounds towards 0, so one too big below 0
+
+    return i - ((v < float(i)) ? 1 : 0);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void value_row(unsigned int seed, int dims, const float* x, float y,
+               float z, float w, float amplitude, int count, float* out,
+               float* lines) {
+
+    // PRE:  dims is 2, 3 or 4, and lines has room for 8 * count values
+    //
+    // POST: amplitude times value_noise_2d/3d/4d(seed, x[i], y, ...)
+    //       has been added to out[i], for every i below count
+
+    float fixed[3] = { y, z, w };
+    int cell[3] = { 0, 0, 0 };
+    float t[3] = { 0, 0, 0 };
+    int combos = 1 << (dims - 1);
+
+    // y, z and w are the same for the whole row, so their cell and
+    // blending weights are found once
+    for (int d = 0; d < dims - 1; d++) {
+        cell[d] = lattice_floor(fixed[d]);
+        t[d] = fade(fixed[d] - float(cell[d]));
+    }
+
+    // for each corner of the fixed dimensions, blend the two corners
+    // along x for every point; bit d of c steps along dimension d + 1
+    for (int c = 0; c < combos; c++) {
+
+        int cy = cell[0] + (c & 1);
+        int cz = (dims > 2) ? cell[1] + ((c >> 1) & 1) : 0;
+        int cw = (dims > 3) ? cell[2] + (c >> 2) : 0;
+        float* line = lines + (long long) c * count;
+
+        for (int i = 0; i < count; i++) {
+            int ix = lattice_floor(x[i]);
+            float u = fade(x[i] - float(ix));
+            float a = hash_to_float(hash_lattice(seed, ix, cy, cz, cw));
+            float b = hash_to_float(hash_lattice(seed, ix + 1, cy, cz, cw));
+            line[i] = a + u * (b - a);
+        }
+    }
+
+    // then blend away the fixed dimensions, halving the lines
+    for (int d = 0, n = combos; d < dims - 1; d++, n /= 2) {
+        for (int c = 0; c < n / 2; c++) {
+            float* low = lines + (long long) (2 * c) * count;
+            float* high = lines + (long long) (2 * c + 1) * count;
+            float* line = lines + (long long) c * count;
+            for (int i = 0; i < count; i++) {
+                line[i] = low[i] + t[d] * (high[i] - low[i]);
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        out[i] += amplitude * lines[i];
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void gradient_row(unsigned int seed, int dims, const float* x, float y,
+                  float z, float w, float amplitude, int count, float* out,
+                  float* lines) {
+
+    // PRE:  dims is 2, 3 or 4, and lines has room for 8 * count values
+    //
+    // POST: amplitude times gradient_noise_2d/3d/4d(seed, x[i], y, ...)
+    //       has been added to out[i], for every i below count
+
+    float fixed[3] = { y, z, w };
+    int cell[3] = { 0, 0, 0 };
+    float p[3] = { 0, 0, 0 };
+    float t[3] = { 0, 0, 0 };
+    int combos = 1 << (dims - 1);
+
+    for (int d = 0; d < dims - 1; d++) {
+        cell[d] = lattice_floor(fixed[d]);
+        p[d] = fixed[d] - float(cell[d]);
+        t[d] = fade(p[d]);
+    }
+
+    // for each corner of the fixed dimensions, find the two corners'
+    // contributions along x and blend them, for every point; the
+    // directions are chosen exactly as in gradient_noise_2d/3d/4d()
+    for (int c = 0; c < combos; c++) {
+
+        int oy = c & 1, oz = (c >> 1) & 1, ow = c >> 2;
+        int cy = cell[0] + oy;
+        float qy = p[0] - float(oy);
+        float* line = lines + (long long) c * count;
+
+        if (dims == 2) {
+            for (int i = 0; i < count; i++) {
+
+                int ix = lattice_floor(x[i]);
+                float dx = x[i] - float(ix);
+                float dot[2];
+
+                for (int cx = 0; cx < 2; cx++) {
+                    unsigned int h = hash_lattice(seed, ix + cx, cy, 0, 0) & 7;
+                    float px = dx - float(cx);
+
+                    dot[cx] = GRADIENTS_2D[h][0] * px + GRADIENTS_2D[h][1] * qy;
+                }
+                line[i] = dot[0] + fade(dx) * (dot[1] - dot[0]);
+            }
+        } else if (dims == 3) {
+            int cz = cell[1] + oz;
+            float qz = p[1] - float(oz);
+
+            for (int i = 0; i < count; i++) {
+
+                int ix = lattice_floor(x[i]);
+                float dx = x[i] - float(ix);
+                float dot[2];
+
+                for (int cx = 0; cx < 2; cx++) {
+                    unsigned int h = hash_lattice(seed, ix + cx, cy, cz, 0) % 12;
+                    float px = dx - float(cx);
+                    float a = (h < 8) ? px : qy;
+                    float b = (h < 4) ? qy : qz;
+                    dot[cx] = ((h & 1) ? -a : a) + ((h & 2) ? -b : b);
+                }
+                line[i] = dot[0] + fade(dx) * (dot[1] - dot[0]);
+            }
+        } else {
+            int cz = cell[1] + oz, cw = cell[2] + ow;
+            float qz = p[1] - float(oz), qw = p[2] - float(ow);
+
+            for (int i = 0; i < count; i++) {
+
+                int ix = lattice_floor(x[i]);
+                float dx = x[i] - float(ix);
+                float dot[2];
+
+                for (int cx = 0; cx < 2; cx++) {
+                    unsigned int h = hash_lattice(seed, ix + cx, cy, cz, cw);
+                    unsigned int zero = h & 3;
+                    float q[4] = { dx - float(cx), qy, qz, qw };
+                    float sum = 0;
+
+                    // one part of the gradient is 0, and the others are
+                    // +1 or -1, worked out with whole numbers so there
+                    // is nothing to choose between: (zero ^ d) + 3 is 3
+                    // for the zero part and 4 to 6 for the others
+                    for (unsigned int d = 0; d < 4; d++) {
+                        int sign = 1 - 2 * int((h >> (2 + d)) & 1);
+                        int keep = int(((zero ^ d) + 3) >> 2);
+                        sum += float(sign * keep) * q[d];
+                    }
+                    dot[cx] = sum;
+                }
+                line[i] = dot[0] + fade(dx) * (dot[1] - dot[0]);
+            }
+        }
+    }
+
+    for (int d = 0, n = combos; d < dims - 1; d++, n /= 2) {
+        for (int c = 0; c < n / 2; c++) {
+            float* low = lines + (long long) (2 * c) * count;
+            float* high = lines + (long long) (2 * c + 1) * count;
+            float* line = lines + (long long) c * count;
+            for (int i = 0; i < count; i++) {
+                line[i] = low[i] + t[d] * (high[i] - low[i]);
+            }
+        }
+    }
+
+    // the same scaling as the single-point functions
+    float scale = (dims == 2) ? 0.7071068f : (dims == 3) ? 1.0f : 0.5f;
+
+    for (int i = 0; i < count; i++) {
+        out[i] += amplitude * (lines[i] * scale);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void simplex_row_2d(unsigned int seed, const float* x, float y,
+                    float amplitude, int count, float* out) {
+
+    // PRE:  none
+    //
+    // POST: amplitude times simplex_noise_2d(seed, x[i], y) has been
+    //       added to out[i], for every i below count
+
+    const float F2 = 0.36602540f;   // (sqrt(3) - 1) / 2
+    const float G2 = 0.21132487f;   // (3 - sqrt(3)) / 6
+
+    // the same steps as simplex_noise_2d(), except that a corner too
+    // far away is given a falloff of 0 instead of being skipped, so
+    // every point does the same work
+    for (int k = 0; k < count; k++) {
+
+        float s = (x[k] + y) * F2;
+        int i = lattice_floor(x[k] + s), j = lattice_floor(y + s);
+        float t = float(i + j) * G2;
+        float x0 = x[k] - (float(i) - t), y0 = y - (float(j) - t);
+        int i1 = (x0 > y0) ? 1 : 0, j1 = 1 - i1;
+
+        float cx[3] = { x0, x0 - i1 + G2, x0 - 1.0f + 2.0f * G2 };
+        float cy[3] = { y0, y0 - j1 + G2, y0 - 1.0f + 2.0f * G2 };
+        int ox[3] = { 0, i1, 1 }, oy[3] = { 0, j1, 1 };
+        float total = 0;
+
+        for (int c = 0; c < 3; c++) {
+
+            float falloff = 0.5f - cx[c] * cx[c] - cy[c] * cy[c];
+            unsigned int h = hash_lattice(seed, i + ox[c], j + oy[c], 0, 0);
+            float gx = hash_to_float(h), gy = hash_to_float(h * 0x9E3779B1u);
+
+            falloff = (falloff + fabs(falloff)) * 0.5f;
+            falloff *= falloff;
+            total += falloff * falloff * (gx * cx[c] + gy * cy[c]);
+        }
+
+        out[k] += amplitude * (70.0f * total);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+inline float simplex_corner_3d(unsigned int seed, const int* i,
+                               const float* p, const int* rank, int c) {
+
+    // PRE:  i, p and rank are the cell, position and coordinate ranks
+    //       of a point, as found in simplex_noise_3d(), and 0 <= c < 4
+    //
+    // POST: corner c's contribution to the point's simplex noise has
+    //       been returned (0 if the corner is too far away)
+
+    const float G3 = 1.0f / 6.0f;
+
+    int o[3];
+    float q[3];
+    float falloff = 0.6f;
+
+    for (int d = 0; d < 3; d++) {
+        o[d] = (rank[d] >= 3 - c) ? 1 : 0;
+        q[d] = p[d] - o[d] + c * G3;
+        falloff -= q[d] * q[d];
+    }
+
+    unsigned int h = hash_lattice(seed, i[0] + o[0], i[1] + o[1],
+                                  i[2] + o[2], 0);
+    float g = hash_to_float(h) * q[0]
+              + hash_to_float(h * 0x9E3779B1u) * q[1]
+              + hash_to_float(h * 0x85EBCA77u) * q[2];
+
+    // (falloff + |falloff|) / 2 is falloff, or 0 if the corner is too
+    // far away; a choice between the two would become a branch, which
+    // stops the loop over the points from being vectorized
+    falloff = (falloff + fabs(falloff)) * 0.5f;
+    falloff *= falloff;
+
+    return falloff * falloff * g;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void simplex_row_3d(unsigned int seed, const float* x, float y, float z,
+                    float amplitude, int count, float* out) {
+
+    // PRE:  none
+    //
+    // POST: amplitude times simplex_noise_3d(seed, x[i], y, z) has been
+    //       added to out[i], for every i below count
+
+    const float F3 = 1.0f / 3.0f;
+    const float G3 = 1.0f / 6.0f;
+
+    for (int k = 0; k < count; k++) {
+
+        float s = (x[k] + y + z) * F3;
+        int i[3] = { lattice_floor(x[k] + s), lattice_floor(y + s),
+                     lattice_floor(z + s) };
+        float t = float(i[0] + i[1] + i[2]) * G3;
+        float p[3] = { x[k] - (i[0] - t), y - (i[1] - t), z - (i[2] - t) };
+        int rank[3];
+        float total = 0;
+
+        // the ranks of simplex_noise_3d(), without a loop that changes
+        // a different variable depending on the comparison
+        rank[0] = (p[0] >= p[1]) + (p[0] >= p[2]);
+        rank[1] = (p[0] < p[1]) + (p[1] >= p[2]);
+        rank[2] = (p[0] < p[2]) + (p[1] < p[2]);
+
+        // the corners are written out one by one; as a loop, they are
+        // too much for the compiler to unroll, and a loop inside the
+        // loop over the points stops it from being vectorized
+        total += simplex_corner_3d(seed, i, p, rank, 0);
+        total += simplex_corner_3d(seed, i, p, rank, 1);
+        total += simplex_corner_3d(seed, i, p, rank, 2);
+        total += simplex_corner_3d(seed, i, p, rank, 3);
+
+        out[k] += amplitude * (32.0f * total);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+inline float simplex_corner_4d(unsigned int seed, const int* i,
+                               const float* p, const int* rank, int c) {
+
+    // PRE:  i, p and rank are the cell, position and coordinate ranks
+    //       of a point, as found in simplex_noise_4d(), and 0 <= c < 5
+    //
+    // POST: corner c's contribution to the point's simplex noise has
+    //       been returned (0 if the corner is too far away)
+
+    const float G4 = 0.13819660f;   // (5 - sqrt(5)) / 20
+
+    int o[4];
+    float q[4];
+    float falloff = 0.6f;
+
+    for (int d = 0; d < 4; d++) {
+        o[d] = (rank[d] >= 4 - c) ? 1 : 0;
+        q[d] = p[d] - o[d] + c * G4;
+        falloff -= q[d] * q[d];
+    }
+
+    unsigned int h = hash_lattice(seed, i[0] + o[0], i[1] + o[1],
+                                  i[2] + o[2], i[3] + o[3]);
+    float g = hash_to_float(h) * q[0]
+              + hash_to_float(h * 0x9E3779B1u) * q[1]
+              + hash_to_float(h * 0x85EBCA77u) * q[2]
+              + hash_to_float(h * 0xC2B2AE3Du) * q[3];
+
+    falloff = (falloff + fabs(falloff)) * 0.5f;
+    falloff *= falloff;
+
+    return falloff * falloff * g;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void simplex_row_4d(unsigned int seed, const float* x, float y, float z,
+                    float w, float amplitude, int count, float* out) {
+
+    // PRE:  none
+    //
+    // POST: amplitude times simplex_noise_4d(seed, x[i], y, z, w) has
+    //       been added to out[i], for every i below count
+
+    const float F4 = 0.30901699f;   // (sqrt(5) - 1) / 4
+    const float G4 = 0.13819660f;   // (5 - sqrt(5)) / 20
+
+    for (int k = 0; k < count; k++) {
+
+        float s = (x[k] + y + z + w) * F4;
+        int i[4] = { lattice_floor(x[k] + s), lattice_floor(y + s),
+                     lattice_floor(z + s), lattice_floor(w + s) };
+        float t = float(i[0] + i[1] + i[2] + i[3]) * G4;
+        float p[4] = { x[k] - (i[0] - t), y - (i[1] - t), z - (i[2] - t),
+                       w - (i[3] - t) };
+        int rank[4];
+        float total = 0;
+
+        rank[0] = (p[0] >= p[1]) + (p[0] >= p[2]) + (p[0] >= p[3]);
+        rank[1] = (p[0] < p[1]) + (p[1] >= p[2]) + (p[1] >= p[3]);
+        rank[2] = (p[0] < p[2]) + (p[1] < p[2]) + (p[2] >= p[3]);
+        rank[3] = (p[0] < p[3]) + (p[1] < p[3]) + (p[2] < p[3]);
+
+        // the corners are written out one by one, as in 3D
+        total += simplex_corner_4d(seed, i, p, rank, 0);
+        total += simplex_corner_4d(seed, i, p, rank, 1);
+        total += simplex_corner_4d(seed, i, p, rank, 2);
+        total += simplex_corner_4d(seed, i, p, rank, 3);
+        total += simplex_corner_4d(seed, i, p, rank, 4);
+
+        out[k] += amplitude * (27.0f * total);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void fbm_row(NoiseKind kind, int dims, unsigned int seed, float x0,
+             float step, float y, float z, float w, int count, int octaves,
+             float* out, float* scratch) {
+
+    // PRE:  dims is 2, 3 or 4, octaves >= 1, and scratch has room for
+    //       9 * count values
+    //
+    // POST: out[i] holds the fBm at (x0 + i * step, y, z, w), the same
+    //       as fbm_2d() gives in 2D, for every i below count
+
+    float* x = scratch;             // the x of each point, this octave
+    float* lines = scratch + count; // room for value_row() and friends
+    float amplitude = 0.5f;
+    float frequency = 1.0f;
+
+    for (int i = 0; i < count; i++) {
+        out[i] = 0;
+    }
+
+    for (int o = 0; o < octaves; o++) {
+
+        unsigned int octave_seed = seed + 0x9E3779B9u * (unsigned int) o;
+        float fy = y * frequency, fz = z * frequency, fw = w * frequency;
+
+        for (int i = 0; i < count; i++) {
+            x[i] = (x0 + float(i) * step) * frequency;
+        }
+
+        // the kind of noise is chosen once per octave of the row, and
+        // each kernel then works along the whole row
+        if (kind == VALUE) {
+            value_row(octave_seed, dims, x, fy, fz, fw, amplitude, count,
+                      out, lines);
+        } else if (kind == GRADIENT) {
+            gradient_row(octave_seed, dims, x, fy, fz, fw, amplitude, count,
+                         out, lines);
+        } else if (dims == 2) {
+            simplex_row_2d(octave_seed, x, fy, amplitude, count, out);
+        } else if (dims == 3) {
+            simplex_row_3d(octave_seed, x, fy, fz, amplitude, count, out);
+        } else {
+            simplex_row_4d(octave_seed, x, fy, fz, fw, amplitude, count, out);
+        }
+
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+
+    for (int i = 0; i < count; i++) {
+        out[i] *= 2.0f;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void fill_tile_2d(NoiseKind kind, unsigned int seed, float x0, float y0,
+                  float step, int width, int height, int octaves,
+                  float* out) {
+
+    // PRE:  out has room for width * height values, and octaves >= 1
+    //
+    // POST: out holds the fBm at (x0 + i * step, y0 + j * step) for
+    //       every column i and row j of the tile, one row after
+    //       another
+
+    vector<float> scratch(9 * (size_t) width);
+
+    for (int j = 0; j < height; j++) {
+        fbm_row(kind, 2, seed, x0, step, y0 + float(j) * step, 0.0f, 0.0f,
+                width, octaves, out + (long long) j * width, &scratch[0]);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void fill_tile_3d(NoiseKind kind, unsigned int seed, float x0, float y0,
+                  float z0, float step, int width, int height, int depth,
+                  int octaves, float* out) {
+
+    // PRE:  out has room for width * height * depth values, and
+    //       octaves >= 1
+    //
+    // POST: out holds the fBm at (x0 + i * step, y0 + j * step, z0 +
+    //       k * step) for every column i, row j and layer k, one row
+    //       after another and one layer after another
+
+    vector<float> scratch(9 * (size_t) width);
+
+    for (int k = 0; k < depth; k++) {
+        for (int j = 0; j < height; j++) {
+            fbm_row(kind, 3, seed, x0, step, y0 + float(j) * step,
+                    z0 + float(k) * step, 0.0f, width, octaves,
+                    out + ((long long) k * height + j) * width, &scratch[0]);
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void fill_tile_4d(NoiseKind kind, unsigned int seed, float x0, float y0,
+                  float z0, float w0, float step, int width, int height,
+                  int depth, int frames, int octaves, float* out) {
+
+    // PRE:  out has room for width * height * depth * frames values,
+    //       and octaves >= 1
+    //
+    // POST: out holds the fBm at (x0 + i * step, y0 + j * step, z0 +
+    //       k * step, w0 + f * step) for every column i, row j, layer k
+    //       and frame f, one row after another, then one layer after
+    //       another, then one frame after another
+
+    vector<float> scratch(9 * (size_t) width);
+
+    for (int f = 0; f < frames; f++) {
+        for (int k = 0; k < depth; k++) {
+            for (int j = 0; j < height; j++) {
+                fbm_row(kind, 4, seed, x0, step, y0 + float(j) * step,
+                        z0 + float(k) * step, w0 + float(f) * step, width,
+                        octaves,
+                        out + (((long long) f * depth + k) * height + j) * width,
+                        &scratch[0]);
+            }
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
@@ -0,0 +1,538 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+check, at a large scale, that rand_range() really gives every value
+between low and high about equally often.
+
+The main tutorial printed 10 random numbers between 200 and 300. Ten
+numbers are enough to see that rand_range() works, but not enough to
+see whether it is fair. To check fairness, we would like to generate
+millions or even billions of numbers. Printing them all is not an
+option: printing is far slower than generating, and nobody can read
+a billion lines anyway.
+
+Instead of printing every value, we count how many times each value
+came up. This table of counts is called a histogram. From the
+histogram we can then work out a short summary:
+
+    - the smallest and largest value seen (min and max),
+    - the average value (the mean),
+    - how spread out the values are (the variance),
+    - and a test of how fair the counts look (the chi-square test).
+
+
+-----------------------------
+Dense and Sparse Histograms
+-----------------------------
+
+When the range is small, such as 200 to 300, the histogram is simply
+an array with one counter per value:
+
+        value:   200  201  202  ...  300
+        count:   991 1012  987  ... 1004
+
+Counting a value is a single array access, which is about as fast as
+a computer can do anything. We call this a "dense" histogram.
+
+When the range is huge, such as 0 to 2 billion, an array with one
+counter per value would need 16 gigabytes, most of which would stay
+at zero. Instead, we use a map that only stores the values that were
+actually seen. We call this a "sparse" histogram.
+
+
+------------------------------
+Counting on Several Processors
+------------------------------
+
+Modern computers have several processors (called "cores"), so we can
+generate several streams of numbers at the same time using threads.
+There are two things to be careful about:
+
+    1. rand() keeps a single hidden seed that all threads share, so
+       threads calling rand() at the same time get in each other's
+       way. Instead, each thread uses rand_r(), which works just like
+       rand() except that the seed is a variable we pass to it. Each
+       thread gets its own seed variable.
+
+    2. If all threads add to the same histogram, they get in each
+       other's way again. Instead, each thread counts into its own
+       private histogram, and we add the private histograms together
+       once all the threads have finished. This last step is called
+       "merging".
+
+
+--------------------
+The Chi-Square Test
+--------------------
+
+If rand_range() is fair and we generate N numbers in a range of R
+values, we expect each value to come up about E = N / R times. Of
+course, real counts wobble a little above and below E. The
+chi-square statistic adds up how far each count is from E:
+
+        chi-square = sum over all values of (count - E)^2 / E
+
+A fair generator gives a chi-square close to (R - 1). From the
+chi-square and (R - 1) (called the "degrees of freedom"), we can work
+out a p-value: the chance that a fair generator would give a
+chi-square at least this large. A p-value that is very close to 0
+(say below 0.001) means the counts are too uneven to be believable,
+so rand_range() is probably not fair. A p-value very close to 1 means
+the counts are suspiciously even.
+
+The test is only trustworthy when E is at least about 5. When the
+range is huge compared to the number of values made (say 0 to 2
+billion, with 2 million numbers), most values never come up at all,
+and the p-value means nothing. Then we group neighbouring values into
+bins, few enough that each bin expects at least 5 counts, and do the
+test on the bins instead. (If there is only one value, or too few
+numbers for two bins, there is nothing to test.)
+
+(Note that rand_range() uses the mod operator, which slightly favors
+smaller values whenever RAND_MAX + 1 is not a multiple of the range.
+With enough numbers, the chi-square test will notice this.)
+
+
+----------------
+Review Questions
+----------------
+
+1. Why don't we print every value when checking rand_range()?
+
+2. What is a histogram?
+
+3. When should a sparse histogram be used instead of a dense one?
+
+4. Why does each thread use rand_r() instead of rand()?
+
+5. Why does each thread count into its own private histogram?
+
+6. What does "merging" histograms mean?
+
+7. If we generate 1,000,000 numbers between 1 and 10, about how many
+times do we expect each value to come up?
+
+8. What does a p-value very close to 0 tell us?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand_r() and atoll() functions
+
+#include <cstdlib>
+
+
+// access the INT_MAX constant
+
+#include <climits>
+
+
+// access the time() function
+
+#include <ctime>
+
+
+// access the sqrt(), pow() and erfc() functions
+
+#include <cmath>
+
+
+// access the vector and map types
+
+#include <vector>
+#include <map>
+
+
+// access the thread type
+
+#include <thread>
+
+
+// constant used to control how many sample random numbers are
+// generated when no count is given
+
+const long long REPETITIONS = 10000000;
+
+
+// constant used to control the largest range that uses a dense
+// histogram
+
+const long long DENSE_LIMIT = 1 << 24;
+
+
+// constant used to control how many lines of the histogram are
+// displayed
+
+const int DISPLAY_ROWS = 20;
+
+
+// constant used to control the smallest expected count in each bin of
+// the chi-square test
+
+const double MIN_EXPECTED = 5;
+
+
+// a histogram of counts, either dense (one counter per value) or
+// sparse (one entry per value seen)
+
+struct Histogram {
+    vector<long long> dense;
+    map<int, long long> sparse;
+};
+
+
+// a running summary of a histogram, built up one value at a time
+
+struct Summary {
+    long long seen_min;
+    long long seen_max;
+    long long counted;
+    double mean;
+    double variance;
+    double chi_square;
+    vector<long long> rows;
+    vector<long long> bins;             // for the chi-square test
+};
+
+
+// prototype for a function to generate a random number within a
+// specified range, using a seed of its own
+
+int rand_range_r(unsigned int* seed, int low, int high);
+
+
+// prototype for a function to fill one thread's private histogram
+
+void count_values(Histogram* histogram, unsigned int seed, int low,
+                  int high, long long count);
+
+
+// prototype for a function to add one histogram into another
+
+void merge_histogram(Histogram& total, const Histogram& part);
+
+
+// prototype for a function to add one value of a histogram, and the
+// number of times it came up, to a summary
+
+void add_to_summary(Summary& summary, long long low, long long range,
+                    long long value, long long n);
+
+
+// prototype for a function to work out the chi-square statistic of
+// the bins of a summary
+
+double bins_chi_square(const Summary& summary, long long range, long long count);
+
+
+// prototype for a function to work out the p-value of a chi-square
+// statistic
+
+double chi_square_p_value(double chi_square, double degrees);
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main(int argc, char* argv[]) {
+
+    int low;                    // used to hold the low value
+    int high;                   // used to hold the high value
+    long long count;            // used to hold how many numbers to make
+    int threads;                // used to hold how many threads to use
+    long long range;            // used to hold the number of values
+    vector<Histogram> parts;    // used to hold each thread's histogram
+    vector<thread> workers;     // used to hold the running threads
+    Histogram total;            // used to hold the merged histogram
+    Summary summary;            // used to hold the summary
+
+    // read low, high, count and threads, using sample values when
+    // they are not given
+    low = (argc >= 3) ? atoi(argv[1]) : 200;
+    high = (argc >= 3) ? atoi(argv[2]) : 300;
+    count = (argc >= 4) ? atoll(argv[3]) : REPETITIONS;
+    threads = (argc >= 5) ? atoi(argv[4]) : int(thread::hardware_concurrency());
+
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    // ranges wider than INT_MAX would overflow high - low + 1
+    if (low > high || count < 1 || (long long) high - low + 1 > INT_MAX) {
+        cout << "Usage: " << argv[0] << " [LOW HIGH [COUNT [THREADS]]]"
+             << endl;
+        return 1;
+    }
+
+    range = (long long) high - low + 1;
+
+    // tell the user what is being counted
+    cout << endl
+         << "Counting "
+         << count
+         << " random numbers between "
+         << low
+         << " and "
+         << high
+         << " on "
+         << threads
+         << " threads"
+         << endl;
+
+    // start one thread per private histogram; each thread gets its own
+    // seed, based on the number of seconds since the Unix Epoch
+    parts.resize(threads);
+    for (int t = 0; t < threads; t++) {
+
+        long long share = count / threads + (t < count % threads ? 1 : 0);
+        unsigned int seed = (unsigned int) time(0) + 2654435761u * (t + 1);
+
+        if (range <= DENSE_LIMIT) {
+            parts[t].dense.assign(range, 0);
+        }
+
+        workers.push_back(thread(count_values, &parts[t], seed, low, high,
+                                 share));
+    }
+
+    // wait for every thread, then merge its private histogram
+    if (range <= DENSE_LIMIT) {
+        total.dense.assign(range, 0);
+    }
+
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+        merge_histogram(total, parts[t]);
+    }
+
+    // work out the summary, visiting each value that came up once
+    summary.seen_min = high;
+    summary.seen_max = low;
+    summary.counted = 0;
+    summary.mean = 0;
+    summary.variance = 0;
+    summary.chi_square = 0;
+    summary.rows.assign(range < DISPLAY_ROWS ? range : DISPLAY_ROWS, 0);
+
+    // one bin per value, unless that leaves fewer than MIN_EXPECTED
+    // counts per bin (or needs more than DENSE_LIMIT bins)
+    long long bins = range;
+    if (double(count) / double(range) < MIN_EXPECTED) {
+        bins = (long long) (double(count) / MIN_EXPECTED);
+    }
+    if (bins > DENSE_LIMIT) {
+        bins = DENSE_LIMIT;
+    }
+    summary.bins.assign(bins > 1 ? bins : 1, 0);
+
+    if (range <= DENSE_LIMIT) {
+        for (long long i = 0; i < range; i++) {
+            if (total.dense[i] != 0) {
+                add_to_summary(summary, low, range, low + i, total.dense[i]);
+            }
+        }
+    } else {
+        for (map<int, long long>::const_iterator it = total.sparse.begin();
+             it != total.sparse.end(); ++it) {
+            add_to_summary(summary, low, range, it->first, it->second);
+        }
+    }
+
+    summary.chi_square = bins_chi_square(summary, range, count);
+    summary.variance = summary.variance / double(count);
+
+    // display the histogram, grouping values when there are many
+    cout << endl << "Histogram" << endl;
+    for (long long r = 0; r < (long long) summary.rows.size(); r++) {
+
+        long long n = (long long) summary.rows.size();
+        long long first = low + (r * range + n - 1) / n;
+        long long last = low + ((r + 1) * range + n - 1) / n - 1;
+
+        cout << "    " << first << " to " << last << ": "
+             << summary.rows[r] << endl;
+    }
+
+    // display the summary
+    cout << endl
+         << "Min:        " << summary.seen_min << endl
+         << "Max:        " << summary.seen_max << endl
+         << "Mean:       " << summary.mean
+         << " (expected " << (double(low) + double(high)) / 2 << ")" << endl
+         << "Variance:   " << summary.variance
+         << " (expected " << (double(range) * double(range) - 1) / 12 << ")"
+         << endl;
+
+    if (bins < 2) {
+        cout << "Chi-square: not done (there is only one "
+             << (range == 1 ? "value" : "bin") << ")" << endl;
+    } else {
+        cout << "Chi-square: " << summary.chi_square
+             << " with " << bins - 1 << " degrees of freedom";
+        if (bins < range) {
+            cout << " (values grouped into " << bins << " bins of about "
+                 << double(range) / double(bins) << ")";
+        }
+        cout << endl
+             << "p-value:    " << chi_square_p_value(summary.chi_square,
+                                                  double(bins - 1))
+             << endl;
+    }
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int rand_range_r(unsigned int* seed, int low, int high) {
+
+    // PRE:  low and high are valid integers with low <= high, and
+    //       seed points to this thread's own seed
+    //
+    // POST: a random number between low and high (inclusive) has
+    //       been returned, and *seed has been updated
+
+    // just like rand_range() in the main tutorial, but with rand_r()
+    return (rand_r(seed) % (high - low + 1)) + low;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void count_values(Histogram* histogram, unsigned int seed, int low,
+                  int high, long long count) {
+
+    // PRE:  histogram->dense already holds one zero counter per value
+    //       when a dense histogram is used
+    //
+    // POST: count random numbers between low and high have been
+    //       generated and counted in histogram
+
+    if (!histogram->dense.empty()) {
+
+        // a local pointer lets the compiler keep the array in a
+        // register for the whole loop
+        long long* counts = &histogram->dense[0];
+
+        for (long long i = 0; i < count; i++) {
+            counts[rand_range_r(&seed, low, high) - low]++;
+        }
+    } else {
+        for (long long i = 0; i < count; i++) {
+            histogram->sparse[rand_range_r(&seed, low, high)]++;
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void merge_histogram(Histogram& total, const Histogram& part) {
+
+    // PRE:  total and part are both dense with the same number of
+    //       counters, or both sparse
+    //
+    // POST: every count in part has been added to total
+
+    for (long long i = 0; i < (long long) part.dense.size(); i++) {
+        total.dense[i] += part.dense[i];
+    }
+
+    for (map<int, long long>::const_iterator it = part.sparse.begin();
+         it != part.sparse.end(); ++it) {
+        total.sparse[it->first] += it->second;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void add_to_summary(Summary& summary, long long low, long long range,
+                    long long value, long long n) {
+
+    // PRE:  n >= 1, and summary.rows and summary.bins are not empty
+    //
+    // POST: value, which came up n times, has been added to the min,
+    //       max, mean, variance, displayed rows and chi-square bins
+
+    double difference = double(value) - summary.mean;
+
+    if (value < summary.seen_min) {
+        summary.seen_min = value;
+    }
+    if (value > summary.seen_max) {
+        summary.seen_max = value;
+    }
+
+    // update the mean and the sum of squared differences, using West's
+    // weighted version of Welford's method, which avoids adding up
+    // huge squares
+    summary.counted += n;
+    summary.mean += difference * double(n) / double(summary.counted);
+    summary.variance += double(n) * difference * (double(value) - summary.mean);
+
+    summary.rows[(value - low) * (long long) summary.rows.size() / range] += n;
+    summary.bins[(value - low) * (long long) summary.bins.size() / range] += n;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double bins_chi_square(const Summary& summary, long long range, long long count) {
+
+    // PRE:  every value has been added to summary
+    //
+    // POST: the chi-square statistic of the bins has been returned;
+    //       each bin expects count * (values in the bin) / range
+
+    long long n = (long long) summary.bins.size();
+    double chi_square = 0;
+
+    for (long long b = 0; b < n; b++) {
+
+        // the same grouping as the displayed rows
+        long long first = (b * range + n - 1) / n;
+        long long next = ((b + 1) * range + n - 1) / n;
+        double expected = double(count) * double(next - first) / double(range);
+        double off = double(summary.bins[b]) - expected;
+
+        chi_square += off * off / expected;
+    }
+
+    return chi_square;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double chi_square_p_value(double chi_square, double degrees) {
+
+    // PRE:  degrees >= 1
+    //
+    // POST: the approximate chance that a fair generator would give a
+    //       chi-square at least this large has been returned
+
+    // the Wilson-Hilferty approximation turns the chi-square into a
+    // value that is close to a standard normal value
+    double h = 2.0 / (9.0 * degrees);
+    double z = (pow(chi_square / degrees, 1.0 / 3.0) - (1.0 - h)) / sqrt(h);
+
+    // the chance of a standard normal value at least as large as z
+    return 0.5 * erfc(z / sqrt(2.0));
+}
@@ -0,0 +1,569 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+pick a random element out of a hash table in C++, fairly and quickly,
+and how to use that to decide what to throw out of a full cache.
+
+
+-------------
+Hash Tables
+-------------
+
+A hash table stores keys (and usually a value for each key) in an
+array of "slots". To find where a key belongs, a hash function turns
+the key into a slot number. If that slot is already taken by another
+key, we try the next slot, and the next, until we find a free one.
+This is called "open addressing" with "linear probing".
+
+Looking up, adding and removing keys all take about the same small
+amount of time, no matter how many keys the table holds. We say these
+operations take "O(1)" time.
+
+That is only true while enough slots are empty, and a completely full
+table would make the search for a free slot go on forever. So the
+table is kept at most half full: when adding a key would go past that,
+the number of slots is doubled and every key is placed again. Doubling
+costs time in proportion to the number of keys, but it happens so
+rarely that adding a key still takes O(1) time on average.
+
+
+-----------------------------------
+Picking a Random Key: Two Approaches
+-----------------------------------
+
+Suppose we want one key from the table, chosen at random, with every
+key equally likely.
+
+Approach 1, probing with rejection: pick a random slot with
+rand_range(0, slots - 1). If the slot holds a key, return it. If the
+slot is empty, throw the slot away and try again. If half of the
+slots hold keys, we need 2 tries on average; if only a quarter do, we
+need 4. Every key sits in exactly one slot, so every key is equally
+likely.
+
+(A tempting shortcut is to pick a random slot and, if it is empty,
+walk forward to the next key. This is NOT fair: a key that comes right
+after a long run of empty slots is picked far more often than a key
+that comes right after another key.)
+
+Approach 2, a dense side array: keep all the keys, packed together
+without gaps, in a second array, and let each slot of the hash table
+hold the position of its key in that array. A random key is then
+simply
+
+        keys[rand_range(0, count - 1)]
+
+which needs exactly one random number and no retries. To remove a key
+without leaving a gap, we move the last key of the array into the
+hole, and fix up the slot that points to it.
+
+
+---------------------------------
+Approximate LRU Eviction
+---------------------------------
+
+A cache holds a limited number of entries. When it is full and a new
+entry arrives, some old entry must be thrown out ("evicted"). A good
+choice is the entry that was Least Recently Used (LRU). Finding the
+true LRU entry means keeping every entry in order of use, which costs
+time on every access.
+
+The Redis database uses a cheap approximation: pick a handful of
+random keys (say 5), and evict whichever of them was used least
+recently. Each entry only needs to remember when it was last used. The
+random picks must be fair -- otherwise some entries would be checked
+far more often than others -- which is why the O(1) fair selection
+above matters.
+
+
+----------------
+Review Questions
+----------------
+
+1. What does a hash function do in a hash table?
+
+2. What is linear probing?
+
+3. Why is picking a random slot and rejecting empty slots fair?
+
+4. Why is walking forward to the next key after an empty slot unfair?
+
+5. How does the dense side array let us remove a key without leaving
+a gap?
+
+6. Why does doubling the number of slots leave the dense arrays
+untouched?
+
+7. What does LRU stand for?
+
+8. How does approximate LRU eviction choose which entry to evict?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() function
+
+#include <ctime>
+
+
+// access the vector type
+
+#include <vector>
+
+
+// constant used to mark an empty slot of the hash table
+
+const int EMPTY = -1;
+
+
+// constant used to control how many entries the sample cache holds
+
+const int CAPACITY = 1000;
+
+
+// constant used to control how many random keys are compared when an
+// entry is evicted
+
+const int EVICTION_SAMPLES = 5;
+
+
+// constant used to control how many accesses the demonstration makes
+
+const int REPETITIONS = 200000;
+
+
+// a hash map from keys to values; slots hold positions in the dense
+// keys, values and last_used arrays, or EMPTY
+
+struct RandomHashMap {
+    vector<int> slots;
+    vector<unsigned long long> keys;
+    vector<long long> values;
+    vector<long long> last_used;
+};
+
+
+// prototype for a function to generate a random number within a
+// specified range
+
+int rand_range(int low, int high);
+
+
+// prototypes for functions to set up an empty map, and to double its
+// number of slots
+
+void init_map(RandomHashMap& map, int capacity);
+void grow_map(RandomHashMap& map);
+
+
+// prototype for a function to find the slot number a key starts at
+
+int home_slot(const RandomHashMap& map, unsigned long long key);
+
+
+// prototype for a function to find the slot that holds a key, or the
+// empty slot where it would go
+
+int find_slot(const RandomHashMap& map, unsigned long long key);
+
+
+// prototypes for functions to look up, add and remove keys; lookup()
+// returns the position of the key in the dense arrays, or EMPTY
+
+int lookup(const RandomHashMap& map, unsigned long long key);
+void insert(RandomHashMap& map, unsigned long long key, long long value,
+            long long now);
+void erase(RandomHashMap& map, unsigned long long key);
+
+
+// prototypes for functions to pick random keys
+
+unsigned long long random_key(const RandomHashMap& map);
+unsigned long long random_key_by_probing(const RandomHashMap& map);
+void sample_keys(const RandomHashMap& map, int k,
+                 vector<unsigned long long>& out);
+
+
+// prototype for a function to evict one entry, using approximate LRU
+
+void evict_one(RandomHashMap& map);
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    RandomHashMap cache;        // used to hold the sample cache
+    long long hits = 0;         // used to count accesses found in cache
+    vector<int> picked;         // used to count picks of each key
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+
+    init_map(cache, CAPACITY);
+
+    // access random keys between 0 and 1999, where the keys below 200
+    // are asked for much more often than the others; on a miss, the
+    // entry is added, evicting another one if the cache is full
+    for (long long now = 0; now < REPETITIONS; now++) {
+
+        unsigned long long key = (rand_range(1, 10) <= 7)
+                                 ? rand_range(0, 199) : rand_range(0, 1999);
+        int position = lookup(cache, key);
+
+        if (position != EMPTY) {
+            cache.last_used[position] = now;
+            hits++;
+        } else {
+            if (int(cache.keys.size()) >= CAPACITY) {
+                evict_one(cache);
+            }
+            insert(cache, key, (long long) key * 10, now);
+        }
+    }
+
+    cout << endl
+         << "Cache of " << CAPACITY << " entries, " << REPETITIONS
+         << " accesses, approximate LRU with " << EVICTION_SAMPLES
+         << " samples" << endl
+         << "Hit rate: " << 100.0 * hits / REPETITIONS << "%" << endl;
+
+    // check that both ways of picking a random key are fair
+    cout << endl
+         << "Picking random keys from a map holding the keys 0 to 9"
+         << endl;
+
+    RandomHashMap small;
+    init_map(small, 10);
+    for (int k = 0; k < 10; k++) {
+        insert(small, (unsigned long long) k * 7919, k, 0);
+    }
+
+    picked.assign(10, 0);
+    for (int i = 0; i < 100000; i++) {
+        picked[random_key(small) / 7919]++;
+    }
+    cout << "dense side array: ";
+    for (int k = 0; k < 10; k++) {
+        cout << picked[k] << " ";
+    }
+    cout << endl;
+
+    picked.assign(10, 0);
+    for (int i = 0; i < 100000; i++) {
+        picked[random_key_by_probing(small) / 7919]++;
+    }
+    cout << "probing:          ";
+    for (int k = 0; k < 10; k++) {
+        cout << picked[k] << " ";
+    }
+    cout << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int rand_range(int low, int high) {
+
+    // PRE:  low and high are valid integers with low <= high, and
+    //       srand() has been called
+    //
+    // POST: a random number between low and high (inclusive) has
+    //       been returned
+
+    return (rand() % (high - low + 1)) + low;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void init_map(RandomHashMap& map, int capacity) {
+
+    // PRE:  capacity >= 1
+    //
+    // POST: map is empty, with at least twice as many slots as
+    //       capacity, so capacity keys fit without growing the table
+
+    int slots = 2;
+
+    while (slots < 2 * capacity) {
+        slots *= 2;
+    }
+
+    map.slots.assign(slots, EMPTY);
+    map.keys.clear();
+    map.values.clear();
+    map.last_used.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void grow_map(RandomHashMap& map) {
+
+    // PRE:  map has been set up with init_map()
+    //
+    // POST: map holds the same keys in twice as many slots; the dense
+    //       arrays have not changed
+
+    int mask = 2 * int(map.slots.size()) - 1;
+
+    map.slots.assign(mask + 1, EMPTY);
+
+    // home_slot() now uses one more bit of the hash, so every key is
+    // placed again; no key is stored twice, so no key needs comparing
+    for (int position = 0; position < int(map.keys.size()); position++) {
+        int slot = home_slot(map, map.keys[position]);
+        while (map.slots[slot] != EMPTY) {
+            slot = (slot + 1) & mask;
+        }
+        map.slots[slot] = position;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int home_slot(const RandomHashMap& map, unsigned long long key) {
+
+    // PRE:  map has been set up with init_map()
+    //
+    // POST: the slot where key would be stored if there were no other
+    //       keys has been returned
+
+    // multiply by a large odd number and keep the top bits, so that
+    // similar keys end up far apart; the number of slots is a power
+    // of 2, so "% slots" is the same as keeping the low bits
+    unsigned long long h = key * 0x9E3779B97F4A7C15ULL;
+
+    return int((h >> 32) & (map.slots.size() - 1));
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int find_slot(const RandomHashMap& map, unsigned long long key) {
+
+    // PRE:  map has at least one empty slot
+    //
+    // POST: the slot holding key has been returned, or if key is not
+    //       in map, the empty slot where it would be added
+
+    int mask = int(map.slots.size()) - 1;
+    int slot = home_slot(map, key);
+
+    while (map.slots[slot] != EMPTY && map.keys[map.slots[slot]] != key) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int lookup(const RandomHashMap& map, unsigned long long key) {
+
+    // PRE:  map has at least one empty slot
+    //
+    // POST: the position of key in the dense arrays has been returned,
+    //       or EMPTY if key is not in map
+
+    return map.slots[find_slot(map, key)];
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void insert(RandomHashMap& map, unsigned long long key, long long value,
+            long long now) {
+
+    // PRE:  map has been set up with init_map()
+    //
+    // POST: key is in map with the given value, last used at now; if
+    //       a new key would have made map more than half full, the
+    //       number of slots has been doubled first
+
+    int slot = find_slot(map, key);
+
+    if (map.slots[slot] == EMPTY) {
+        if (2 * (map.keys.size() + 1) > map.slots.size()) {
+            grow_map(map);
+            slot = find_slot(map, key);
+        }
+        map.slots[slot] = int(map.keys.size());
+        map.keys.push_back(key);
+        map.values.push_back(value);
+        map.last_used.push_back(now);
+    } else {
+        map.values[map.slots[slot]] = value;
+        map.last_used[map.slots[slot]] = now;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void erase(RandomHashMap& map, unsigned long long key) {
+
+    // PRE:  map has at least one empty slot
+    //
+    // POST: key is no longer in map, and the dense arrays still have
+    //       no gaps
+
+    int mask = int(map.slots.size()) - 1;
+    int slot = find_slot(map, key);
+    int position = map.slots[slot];
+    int last = int(map.keys.size()) - 1;
+
+    if (position == EMPTY) {
+        return;
+    }
+
+    // move the last key of the dense arrays into the hole, and point
+    // its slot at its new position; its slot is found by position
+    // rather than by key, since for a moment the key is stored twice
+    if (position != last) {
+        int moved = home_slot(map, map.keys[last]);
+        while (map.slots[moved] != last) {
+            moved = (moved + 1) & mask;
+        }
+        map.slots[moved] = position;
+        map.keys[position] = map.keys[last];
+        map.values[position] = map.values[last];
+        map.last_used[position] = map.last_used[last];
+    }
+    map.keys.pop_back();
+    map.values.pop_back();
+    map.last_used.pop_back();
+
+    // empty the slot, then shift back any following keys that would no
+    // longer be found because of the new gap ("backward shift")
+    map.slots[slot] = EMPTY;
+    int next = (slot + 1) & mask;
+    while (map.slots[next] != EMPTY) {
+
+        int home = home_slot(map, map.keys[map.slots[next]]);
+
+        // the key at next may move into the gap if its home slot is not
+        // between the gap and next (going around the end of the table)
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            map.slots[slot] = map.slots[next];
+            map.slots[next] = EMPTY;
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long random_key(const RandomHashMap& map) {
+
+    // PRE:  map is not empty, and srand() has been called
+    //
+    // POST: a key of map, with every key equally likely, has been
+    //       returned
+
+    return map.keys[rand_range(0, int(map.keys.size()) - 1)];
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long random_key_by_probing(const RandomHashMap& map) {
+
+    // PRE:  map is not empty, and srand() has been called
+    //
+    // POST: a key of map, with every key equally likely, has been
+    //       returned
+
+    int slot;
+
+    // empty slots are rejected, never walked past
+    do {
+        slot = rand_range(0, int(map.slots.size()) - 1);
+    } while (map.slots[slot] == EMPTY);
+
+    return map.keys[map.slots[slot]];
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void sample_keys(const RandomHashMap& map, int k,
+                 vector<unsigned long long>& out) {
+
+    // PRE:  map is not empty, k >= 1, and srand() has been called
+    //
+    // POST: out holds k keys of map, each chosen independently with
+    //       every key equally likely
+
+    int count = int(map.keys.size());
+
+    out.resize(k);
+
+    for (int i = 0; i < k; i++) {
+        out[i] = map.keys[rand_range(0, count - 1)];
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void evict_one(RandomHashMap& map) {
+
+    // PRE:  map is not empty, and srand() has been called
+    //
+    // POST: of EVICTION_SAMPLES random keys, the one used least
+    //       recently has been removed from map
+
+    vector<unsigned long long> candidates;
+    unsigned long long oldest;
+    long long oldest_time;
+
+    sample_keys(map, EVICTION_SAMPLES, candidates);
+
+    oldest = candidates[0];
+    oldest_time = map.last_used[lookup(map, oldest)];
+    for (int i = 1; i < EVICTION_SAMPLES; i++) {
+        long long t = map.last_used[lookup(map, candidates[i])];
+        if (t < oldest_time) {
+            oldest = candidates[i];
+            oldest_time = t;
+        }
+    }
+
+    erase(map, oldest);
+}
@@ -0,0 +1,633 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+pick random lines out of a very large text file in C++, without
+reading the whole file every time.
+
+Suppose we have a log file with a billion lines, and we want to look
+at 20 of them, chosen at random. The obvious approach is:
+
+    1. Read the whole file and count the lines.
+    2. Pick 20 random line numbers with rand_range().
+    3. Read the whole file again, and print the lines whose numbers
+       were picked.
+
+This works, but if the file is a terabyte, each sample costs us two
+complete passes over a terabyte of data, even though we only want a
+few kilobytes of it.
+
+
+-----------------
+An Index of Lines
+-----------------
+
+The trick is to do the expensive part only once. We read the file a
+single time and write down where each line starts, measured in bytes
+from the beginning of the file. This list of positions (called
+"offsets") is called an index:
+
+        file contents:  "cat\ndog\nbird\n"
+
+        line number:     0    1    2
+        offset:          0    4    8
+
+Once we have the index, line number i starts at offset[i] and ends
+just before offset[i + 1]. Jumping straight to a line is now a single
+lookup, no matter how big the file is.
+
+The index is much smaller than the file (8 bytes per line), so we
+save it in a second file next to the original. The next time we want
+a sample from the same file, we use the saved index instead of
+scanning the file again. To make sure the saved index still matches
+the file, we also save the size of the file and the time it was last
+changed, and rebuild the index if either is different. (The size
+alone is not enough: editing a line without changing its length
+keeps the size the same.)
+
+Even the index can be big -- 8 GB for a billion lines -- so we do not
+read it all in either. We map it into memory, just like the file
+itself (see below), and only the few offsets we look up are read from
+the disk. Since the index file could be cut short or damaged, we
+check that the number of offsets it claims to hold really fits in
+its length before using it.
+
+Building the index does not need much memory either. Rather than
+collecting every offset first, we write them to the index file in
+batches as the newlines are found, so only one batch is held at a
+time. The number of offsets is written into the header last, so an
+index that was only half written is never mistaken for a sound one.
+(If the index cannot be saved next to the file, we build it in a
+temporary file instead.)
+
+
+----------------------------
+Finding the Newlines Quickly
+----------------------------
+
+Building the index means finding every newline character ('\n') in
+the file. Looking at every byte in a loop of our own is slow. The
+memchr() function, found in the cstring library, searches a block of
+memory for one particular byte. Library writers have made memchr()
+very fast -- on modern processors it checks 16, 32 or even 64 bytes
+with a single instruction -- so we let it do the searching.
+
+
+-----------------------------
+Mapping the File Into Memory
+-----------------------------
+
+Instead of reading the file with cin or an ifstream, we ask the
+operating system to "map" the file into memory with mmap(). The file
+then looks like one huge array of characters, and the operating system
+loads only the parts of the file we actually touch. When we print 20
+random lines, only those 20 small parts of the file are read from the
+disk.
+
+
+------------------------------------------
+With and Without Replacement
+------------------------------------------
+
+Sampling "with replacement" means the same line may be picked more
+than once, just like rolling a die twice may give the same number
+twice. Each pick is simply a random line number between 0 and
+(number of lines - 1).
+
+Sampling "without replacement" means every line may be picked at most
+once, like dealing cards from a deck. A simple way to do this for k
+lines out of n is Robert Floyd's algorithm:
+
+        for j from (n - k) to (n - 1):
+            t = a random number between 0 and j
+            if t has already been picked:
+                pick j instead
+            otherwise:
+                pick t
+
+This needs exactly k random numbers, never has to try again, and
+does not need a list of all n line numbers.
+
+
+---------------------------------
+Random Numbers Bigger Than RAND_MAX
+---------------------------------
+
+A big file can have more lines than RAND_MAX, so one call to rand()
+cannot reach every line. We combine two calls to rand() into one big
+number: the first call gives the upper bits and the second call gives
+the lower bits.
+
+
+----------------
+Review Questions
+----------------
+
+1. Why is reading the whole file for every sample slow?
+
+2. What is stored in the index?
+
+3. How do we find where line number i ends?
+
+4. Why do we save the size and the change time of the file together
+with the index?
+
+5. What does memchr() do, and why is it faster than our own loop?
+
+6. What does mmap() do?
+
+7. What is the difference between sampling with and without
+replacement?
+
+8. How many random numbers does Floyd's algorithm need to pick k
+lines?
+
+9. Why do we combine two calls to rand()?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand(), srand() and strtoll() functions
+
+#include <cstdlib>
+
+
+// access the time() function
+
+#include <ctime>
+
+
+// access the memchr() function
+
+#include <cstring>
+
+
+// access the errno variable
+
+#include <cerrno>
+
+
+// access the fopen(), fwrite(), tmpfile() and fileno() functions
+
+#include <cstdio>
+
+
+// access the string, vector and set types
+
+#include <string>
+#include <vector>
+#include <set>
+
+
+// access the open(), fstat(), mmap() and close() functions
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// constant used to control how many lines are sampled when no count
+// is given
+
+const int REPETITIONS = 10;
+
+
+// constant used to control the most lines that can be asked for, since
+// every picked line number is held in memory
+
+const long long MAX_COUNT = 10000000;
+
+
+// constant used to control how many offsets are held before they are
+// written to the index file
+
+const int INDEX_BATCH = 1 << 16;
+
+
+// constant used to control the size of a saved index's header: the
+// file size, its change time (seconds and nanoseconds), and the
+// number of offsets
+
+const long long HEADER_VALUES = 4;
+
+
+// an index of line offsets, mapped from an index file
+
+struct LineIndex {
+    const long long* offsets;   // the line starts, then the file size
+    long long count;            // the number of offsets
+    void* mapped;               // the mapped index file
+    long long mapped_size;      // the size of the mapped index file
+};
+
+
+// prototype for a function to write the index of line offsets for a
+// file that has been mapped into memory, returning false if it could
+// not be written
+
+bool build_index(const char* data, const struct stat& info, FILE* out);
+
+
+// prototype for a function to map a saved index, returning false if
+// there is no sound saved index for a file of this size and change
+// time
+
+bool load_index(const string& index_name, const struct stat& info,
+                LineIndex& index);
+
+
+// prototype for a function to map an open index file, returning false
+// if it does not match a file of this size and change time
+
+bool map_index(int fd, const struct stat& info, LineIndex& index);
+
+
+// prototype for a function to read a line count given by the user,
+// returning false if it is not a whole number from 1 to MAX_COUNT
+
+bool read_count(const char* text, long long& count);
+
+
+// prototype for a function to generate a large random number within
+// a specified range
+
+long long big_rand_range(long long low, long long high);
+
+
+// prototype for a function to pick k line numbers out of n without
+// replacement
+
+vector<long long> sample_unique(long long n, long long k);
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main(int argc, char* argv[]) {
+
+    string file_name;           // used to hold the name of the file
+    string index_name;          // used to hold the name of the index
+    long long count;            // used to hold how many lines to pick
+    bool unique;                // used to hold whether lines may repeat
+    int fd;                     // used to hold the open file
+    FILE* index_file;           // used to hold a new index file
+    struct stat info;           // used to hold the size of the file
+    char* data;                 // used to hold the mapped file
+    long long size;             // used to hold the size of the file
+    LineIndex index;            // used to hold the index of lines
+    long long lines;            // used to hold the number of lines
+    vector<long long> picked;   // used to hold the picked line numbers
+
+    // make sure a file name was given, and that COUNT and "unique"
+    // make sense if given
+    count = REPETITIONS;
+    unique = (argc >= 4 && string(argv[3]) == "unique");
+    if (argc < 2 || argc > 4 || (argc >= 3 && !read_count(argv[2], count))
+            || (argc == 4 && !unique)) {
+        cout << "Usage: " << argv[0] << " FILE [COUNT] [unique]" << endl
+             << "    COUNT is a number of lines from 1 to " << MAX_COUNT
+             << " (" << REPETITIONS << " if not given)" << endl;
+        return 1;
+    }
+
+    file_name = argv[1];
+    index_name = file_name + ".idx";
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+
+    // map the whole file into memory
+    fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        cout << "Unable to open " << file_name << endl;
+        return 1;
+    }
+
+    size = info.st_size;
+    if (size == 0) {
+        cout << file_name << " is empty" << endl;
+        return 1;
+    }
+
+    data = (char*) mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        cout << "Unable to map " << file_name << endl;
+        return 1;
+    }
+
+    // the lines we pick are scattered all over the file, so tell the
+    // operating system not to read ahead
+    madvise(data, size, MADV_RANDOM);
+
+    // use the saved index when there is one, otherwise build and save
+    // a new one, in a temporary file if it cannot go next to the file
+    if (!load_index(index_name, info, index)) {
+        index_file = fopen(index_name.c_str(), "w+b");
+        if (index_file == 0) {
+            index_file = tmpfile();
+        }
+        if (index_file == 0 || !build_index(data, info, index_file)
+                || !map_index(fileno(index_file), info, index)) {
+            cout << "Unable to write the index for " << file_name << endl;
+            return 1;
+        }
+        fclose(index_file);
+    }
+
+    // the index holds one extra offset that marks the end of the last
+    // line
+    lines = index.count - 1;
+
+    // pick the line numbers
+    if (unique) {
+        if (count > lines) {
+            count = lines;
+        }
+        picked = sample_unique(lines, count);
+    } else {
+        for (long long i = 0; i < count; i++) {
+            picked.push_back(big_rand_range(0, lines - 1));
+        }
+    }
+
+    // tell the user that several random lines will be displayed
+    cout << endl
+         << "Displaying "
+         << count
+         << " random lines out of "
+         << lines
+         << (unique ? " without" : " with")
+         << " replacement"
+         << endl;
+
+    // display each picked line, without its newline
+    for (long long i = 0; i < (long long) picked.size(); i++) {
+
+        long long start = index.offsets[picked[i]];
+        long long end = index.offsets[picked[i] + 1];
+
+        // a damaged saved index could point outside the file
+        if (start < 0 || start > end || end > size) {
+            cout << index_name << " is damaged; delete it and try again"
+                 << endl;
+            return 1;
+        }
+
+        if (end > start && data[end - 1] == '\n') {
+            end--;
+        }
+
+        cout.write(data + start, end - start);
+        cout << endl;
+    }
+
+    munmap(index.mapped, index.mapped_size);
+    munmap(data, size);
+    close(fd);
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+bool build_index(const char* data, const struct stat& info, FILE* out) {
+
+    // PRE:  data points to the mapped bytes of a file whose fstat()
+    //       details are in info, info.st_size > 0, and out is an index
+    //       file open for writing
+    //
+    // POST: the file's size and change time, the number of offsets,
+    //       and the offset of the start of every line followed by the
+    //       file size have been written to out and flushed, and true
+    //       has been returned; false has been returned if a write
+    //       failed
+
+    long long size;             // used to hold the size of the file
+    vector<long long> batch(INDEX_BATCH); // used to hold unwritten offsets
+    int held;                   // used to hold how many are in batch
+    long long count;            // used to hold how many were found
+    const char* position;       // used to hold where to search next
+    const char* end;            // used to hold the end of the file
+    const char* newline;        // used to hold the newline found
+    bool written;               // used to hold whether every write worked
+
+    size = info.st_size;
+    long long header[HEADER_VALUES] = {
+        size,
+        (long long) info.st_mtim.tv_sec,
+        (long long) info.st_mtim.tv_nsec,
+        0
+    };
+
+    // the count stays 0 until every offset is written, so a half
+    // written index is never loaded
+    written = fwrite(header, sizeof(header), 1, out) == 1;
+
+    position = data;
+    end = data + size;
+    batch[0] = 0;
+    held = 1;
+    count = 1;
+
+    // let memchr() find each newline; the next line starts just after
+    // it
+    while (written
+            && (newline = (const char*) memchr(position, '\n', end - position))
+            != 0) {
+        position = newline + 1;
+        if (position < end) {
+            batch[held++] = position - data;
+            count++;
+            if (held == INDEX_BATCH) {
+                written = fwrite(&batch[0], sizeof(long long), held, out)
+                          == (size_t) held;
+                held = 0;
+            }
+        }
+    }
+
+    batch[held++] = size;
+    count++;
+
+    if (written) {
+        written = fwrite(&batch[0], sizeof(long long), held, out)
+                  == (size_t) held;
+    }
+
+    // now fill in the count
+    header[3] = count;
+    if (written) {
+        written = fseek(out, 3 * sizeof(long long), SEEK_SET) == 0
+                  && fwrite(&header[3], sizeof(long long), 1, out) == 1
+                  && fflush(out) == 0;
+    }
+
+    return written;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+bool load_index(const string& index_name, const struct stat& info,
+                LineIndex& index) {
+
+    // PRE:  info holds the fstat() details of the file being sampled
+    //
+    // POST: if index_name holds an index saved for a file of the same
+    //       size and change time, and its length matches the number of
+    //       offsets it claims to hold, it has been mapped into index
+    //       and true has been returned; otherwise false has been
+    //       returned
+
+    int fd;                     // used to hold the open index file
+    bool loaded;                // used to hold whether it was mapped
+
+    fd = open(index_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    loaded = map_index(fd, info, index);
+    close(fd);
+
+    return loaded;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+bool map_index(int fd, const struct stat& info, LineIndex& index) {
+
+    // PRE:  fd is an index file open for reading, and info holds the
+    //       fstat() details of the file being sampled
+    //
+    // POST: if the index was made for a file of the same size and
+    //       change time, and its length matches the number of offsets
+    //       it claims to hold, it has been mapped into index and true
+    //       has been returned; otherwise false has been returned
+
+    struct stat index_info;     // used to hold the size of the index
+    long long length;           // used to hold the size of the index
+    const long long* header;    // used to hold the mapped index
+
+    length = (fstat(fd, &index_info) == 0) ? index_info.st_size : 0;
+    if (length < (HEADER_VALUES + 2) * (long long) sizeof(long long)) {
+        return false;
+    }
+
+    header = (const long long*) mmap(0, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (header == MAP_FAILED) {
+        return false;
+    }
+
+    // the header must match the file, and the offsets must exactly fill
+    // the rest of the index file
+    long long room = length / (long long) sizeof(long long) - HEADER_VALUES;
+    if (length % (long long) sizeof(long long) != 0
+            || header[0] != (long long) info.st_size
+            || header[1] != (long long) info.st_mtim.tv_sec
+            || header[2] != (long long) info.st_mtim.tv_nsec
+            || header[3] < 2 || header[3] != room) {
+        munmap((void*) header, length);
+        return false;
+    }
+
+    // only the offsets of the picked lines will be read
+    madvise((void*) header, length, MADV_RANDOM);
+
+    index.mapped = (void*) header;
+    index.mapped_size = length;
+    index.offsets = header + HEADER_VALUES;
+    index.count = header[3];
+
+    return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+bool read_count(const char* text, long long& count) {
+
+    // PRE:  text is a C string
+    //
+    // POST: if text is a whole number from 1 to MAX_COUNT, count holds
+    //       it and true has been returned; otherwise false has been
+    //       returned
+
+    char* end;                  // used to hold where the number ended
+    long long value;            // used to hold the number read
+
+    errno = 0;
+    value = strtoll(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0 || value < 1
+            || value > MAX_COUNT) {
+        return false;
+    }
+
+    count = value;
+    return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+long long big_rand_range(long long low, long long high) {
+
+    // PRE:  low and high are valid numbers with low <= high, and
+    //       srand() has been called
+    //
+    // POST: a random number between low and high (inclusive) has
+    //       been returned
+
+    // combine two calls to rand() into one number of about 62 bits
+    long long random = ((long long) rand() << 31) | rand();
+
+    return (random % (high - low + 1)) + low;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+vector<long long> sample_unique(long long n, long long k) {
+
+    // PRE:  0 <= k <= n, and srand() has been called
+    //
+    // POST: k different random numbers between 0 and (n - 1)
+    //       (inclusive) have been returned
+
+    vector<long long> picked;   // used to hold the picked numbers
+    set<long long> seen;        // used to check for repeats
+    long long t;                // used to hold a candidate number
+
+    for (long long j = n - k; j < n; j++) {
+
+        t = big_rand_range(0, j);
+
+        // if t was already picked, j cannot have been, since every
+        // earlier pick was smaller than j
+        if (seen.count(t) != 0) {
+            t = j;
+        }
+
+        seen.insert(t);
+        picked.push_back(t);
+    }
+
+    return picked;
+}
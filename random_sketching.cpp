@@ -0,0 +1,556 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+use random numbers to shrink a tall matrix into a short one (called a
+"sketch") in C++, without ever storing the random numbers used.
+
+
+----------------
+What Is a Sketch?
+----------------
+
+Many calculations, such as fitting a line through a billion data
+points, work with a matrix A that has a huge number of rows n and a
+small number of columns d. If we could replace A by a much shorter
+matrix with only m rows (m much smaller than n) that "behaves like"
+A, the calculation would become far cheaper.
+
+A sketch does exactly that. We multiply A by a random m-by-n matrix
+S, giving the m-by-d matrix S*A. If S is chosen well, lengths are
+roughly preserved: for any vector x,
+
+        length of (S*A*x)  is close to  length of (A*x)
+
+so answers computed from S*A are close to answers computed from A.
+
+
+----------------------------------
+Random Numbers Without Storing Them
+----------------------------------
+
+S has m times n entries. For a billion rows that is far too many
+random numbers to store. Fortunately, the sketches below only need a
+few random numbers per row of A, and we can make these numbers up
+again whenever we need them with a "hash function".
+
+A hash function takes a few numbers (here, a seed and a row number)
+and scrambles them into a number that looks random. Unlike rand(), it
+has no hidden state: the same seed and row number always give the same
+result, in any order and on any thread. So instead of storing S, we
+store only its seed.
+
+
+-------------
+CountSketch
+-------------
+
+CountSketch is the simplest sketch. For every row i of A, the hash
+function chooses
+
+    - a bucket h(i) between 0 and (m - 1), and
+    - a sign s(i), either +1 or -1.
+
+Then row i of A, multiplied by s(i), is added into row h(i) of the
+sketch:
+
+        sketch row h(i)  +=  s(i) * (row i of A)
+
+Each row of A is read once and added to one place, so making the
+sketch costs no more than reading A.
+
+If A is stored as a "sparse" matrix, where only the nonzero entries
+are kept (the common "compressed sparse row", or CSR, format), we do
+the same thing but only add the nonzero entries.
+
+
+------------------------
+Sparse Sign Embeddings
+------------------------
+
+A sparse sign embedding is a CountSketch where each row of A is added
+to a few (say 4) different buckets instead of one, each time with its
+own random sign, and scaled by 1 / sqrt(4). It costs a few times more,
+but is more reliable when m is small.
+
+
+-------------------------------------------------
+Subsampled Randomized Hadamard Transform (SRHT)
+-------------------------------------------------
+
+The SRHT works in three steps:
+
+    1. Flip the sign of each row of A at random (D).
+    2. Mix all the rows together with the Walsh-Hadamard transform (H),
+       a relative of the Fast Fourier Transform that only needs
+       additions and subtractions.
+    3. Keep m randomly chosen rows (P), scaled by sqrt(n / m).
+
+Step 2 spreads the information in every row evenly over all the rows,
+so that keeping a random few rows in step 3 loses very little. The
+transform needs n to be a power of 2, so we pad A with rows of zeros.
+
+
+----------------
+Review Questions
+----------------
+
+1. What does a sketch do to the size of a matrix?
+
+2. What property of lengths should a good sketch keep?
+
+3. How is a hash function different from rand()?
+
+4. Why is it useful that S never has to be stored?
+
+5. In CountSketch, how many places of the sketch is each row of A
+added to?
+
+6. What is stored in the CSR format?
+
+7. What are the three steps of the SRHT?
+
+8. Why must A be padded for the Walsh-Hadamard transform?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() function
+
+#include <ctime>
+
+
+// access the sqrt() function
+
+#include <cmath>
+
+
+// access the vector type
+
+#include <vector>
+
+
+// constant used to control how many rows the sample matrix has
+
+const int ROWS = 100000;
+
+
+// constant used to control how many columns the sample matrix has
+
+const int COLUMNS = 8;
+
+
+// constant used to control how many rows each sketch has
+
+const int SKETCH_ROWS = 2000;
+
+
+// constant used to control how many buckets each row is added to in a
+// sparse sign embedding
+
+const int NONZEROS_PER_ROW = 4;
+
+
+// constant used as the hash salt when the SRHT chooses which rows to
+// keep
+
+const unsigned long long SRHT_ROW_SALT = 0xFFFFFFFFULL;
+
+
+// a sparse matrix in compressed sparse row (CSR) format: the nonzero
+// entries of row i are values[row_start[i]] up to
+// values[row_start[i + 1] - 1], in the columns held in column
+
+struct CsrMatrix {
+    int rows;
+    int columns;
+    vector<int> row_start;
+    vector<int> column;
+    vector<double> values;
+};
+
+
+// prototype for a function to scramble a seed, a row number and a
+// salt into a random looking number
+
+unsigned long long hash_row(unsigned long long seed, unsigned long long row,
+                            unsigned long long salt);
+
+
+// prototypes for functions to apply a CountSketch to a dense matrix
+// (rows stored one after another) and to a CSR matrix
+
+void count_sketch_dense(const vector<double>& a, int rows, int columns,
+                        unsigned long long seed, int m,
+                        vector<double>& sketch);
+void count_sketch_csr(const CsrMatrix& a, unsigned long long seed, int m,
+                      vector<double>& sketch);
+
+
+// prototypes for functions to apply a sparse sign embedding to a
+// dense matrix and to a CSR matrix
+
+void sparse_sign_dense(const vector<double>& a, int rows, int columns,
+                       unsigned long long seed, int m, int s,
+                       vector<double>& sketch);
+void sparse_sign_csr(const CsrMatrix& a, unsigned long long seed, int m,
+                     int s, vector<double>& sketch);
+
+
+// prototype for a function to apply an SRHT to a dense matrix
+
+void srht_dense(const vector<double>& a, int rows, int columns,
+                unsigned long long seed, int m, vector<double>& sketch);
+
+
+// prototype for a function to work out the length of A*x for a dense
+// matrix
+
+double product_length(const vector<double>& a, int rows, int columns,
+                      const vector<double>& x);
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    vector<double> a;           // used to hold the sample matrix
+    CsrMatrix sparse;           // used to hold a sparse sample matrix
+    vector<double> x;           // used to hold a sample vector
+    vector<double> sketch;      // used to hold a sketch
+    vector<double> sketch2;     // used to hold a second sketch
+    unsigned long long seed;    // used to hold the seed of the sketches
+    double difference;          // used to compare two sketches
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = (unsigned long long) rand();
+
+    // make a random dense matrix and a random vector
+    a.resize((long long) ROWS * COLUMNS);
+    for (long long i = 0; i < (long long) ROWS * COLUMNS; i++) {
+        a[i] = double(rand()) / RAND_MAX - 0.5;
+    }
+    for (int j = 0; j < COLUMNS; j++) {
+        x.push_back(double(rand()) / RAND_MAX - 0.5);
+    }
+
+    cout << endl
+         << "Sketching a " << ROWS << " by " << COLUMNS
+         << " matrix A down to " << SKETCH_ROWS << " rows" << endl
+         << endl
+         << "length of A*x:                  "
+         << product_length(a, ROWS, COLUMNS, x) << endl;
+
+    // apply each sketch, and compare lengths
+    count_sketch_dense(a, ROWS, COLUMNS, seed, SKETCH_ROWS, sketch);
+    cout << "length of S*A*x (CountSketch):  "
+         << product_length(sketch, SKETCH_ROWS, COLUMNS, x) << endl;
+
+    sparse_sign_dense(a, ROWS, COLUMNS, seed, SKETCH_ROWS, NONZEROS_PER_ROW,
+                      sketch);
+    cout << "length of S*A*x (sparse sign):  "
+         << product_length(sketch, SKETCH_ROWS, COLUMNS, x) << endl;
+
+    srht_dense(a, ROWS, COLUMNS, seed, SKETCH_ROWS, sketch);
+    cout << "length of S*A*x (SRHT):         "
+         << product_length(sketch, SKETCH_ROWS, COLUMNS, x) << endl;
+
+    // store A as a CSR matrix, keeping only entries bigger than 0.25
+    // in size, and check that both versions of each sketch agree
+    sparse.rows = ROWS;
+    sparse.columns = COLUMNS;
+    sparse.row_start.push_back(0);
+    for (int i = 0; i < ROWS; i++) {
+        for (int j = 0; j < COLUMNS; j++) {
+            if (fabs(a[(long long) i * COLUMNS + j]) > 0.25) {
+                sparse.column.push_back(j);
+                sparse.values.push_back(a[(long long) i * COLUMNS + j]);
+            } else {
+                a[(long long) i * COLUMNS + j] = 0;
+            }
+        }
+        sparse.row_start.push_back(int(sparse.values.size()));
+    }
+
+    count_sketch_dense(a, ROWS, COLUMNS, seed, SKETCH_ROWS, sketch);
+    count_sketch_csr(sparse, seed, SKETCH_ROWS, sketch2);
+    difference = 0;
+    for (int i = 0; i < int(sketch.size()); i++) {
+        difference += fabs(sketch[i] - sketch2[i]);
+    }
+    cout << endl
+         << "CSR and dense CountSketch differ by:  " << difference << endl;
+
+    sparse_sign_dense(a, ROWS, COLUMNS, seed, SKETCH_ROWS, NONZEROS_PER_ROW,
+                      sketch);
+    sparse_sign_csr(sparse, seed, SKETCH_ROWS, NONZEROS_PER_ROW, sketch2);
+    difference = 0;
+    for (int i = 0; i < int(sketch.size()); i++) {
+        difference += fabs(sketch[i] - sketch2[i]);
+    }
+    cout << "CSR and dense sparse sign differ by:  " << difference << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long hash_row(unsigned long long seed, unsigned long long row,
+                            unsigned long long salt) {
+
+    // PRE:  none
+    //
+    // POST: a random looking number that depends on every bit of seed,
+    //       row and salt has been returned; the same inputs always
+    //       give the same result
+
+    unsigned long long z;   // used to hold the value being mixed
+
+    // the "SplitMix64" finishing steps
+    z = seed ^ (row * 0x9E3779B97F4A7C15ULL) ^ (salt * 0xD1B54A32D192ED03ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+
+    return z;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void count_sketch_dense(const vector<double>& a, int rows, int columns,
+                        unsigned long long seed, int m,
+                        vector<double>& sketch) {
+
+    // PRE:  a holds rows * columns numbers, one row after another, and
+    //       m >= 1
+    //
+    // POST: sketch holds the m-by-columns CountSketch of a for seed
+
+    sketch.assign((long long) m * columns, 0.0);
+
+    for (int i = 0; i < rows; i++) {
+
+        // one hash gives both the bucket (high bits) and the sign
+        // (lowest bit)
+        unsigned long long h = hash_row(seed, i, 0);
+        double sign = (h & 1) ? 1.0 : -1.0;
+        double* out = &sketch[(long long) ((h >> 32) % m) * columns];
+        const double* in = &a[(long long) i * columns];
+
+        // the same operation on every column, which the compiler turns
+        // into vector instructions
+        for (int j = 0; j < columns; j++) {
+            out[j] += sign * in[j];
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void count_sketch_csr(const CsrMatrix& a, unsigned long long seed, int m,
+                      vector<double>& sketch) {
+
+    // PRE:  a is a valid CSR matrix, and m >= 1
+    //
+    // POST: sketch holds the m-by-a.columns CountSketch of a for seed,
+    //       the same as count_sketch_dense() gives for the dense
+    //       version of a
+
+    sketch.assign((long long) m * a.columns, 0.0);
+
+    for (int i = 0; i < a.rows; i++) {
+
+        unsigned long long h = hash_row(seed, i, 0);
+        double sign = (h & 1) ? 1.0 : -1.0;
+        double* out = &sketch[(long long) ((h >> 32) % m) * a.columns];
+
+        for (int k = a.row_start[i]; k < a.row_start[i + 1]; k++) {
+            out[a.column[k]] += sign * a.values[k];
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void sparse_sign_dense(const vector<double>& a, int rows, int columns,
+                       unsigned long long seed, int m, int s,
+                       vector<double>& sketch) {
+
+    // PRE:  a holds rows * columns numbers, one row after another,
+    //       m >= 1 and s >= 1
+    //
+    // POST: sketch holds the m-by-columns sparse sign embedding of a,
+    //       with s buckets per row, for seed
+
+    double scale = 1.0 / sqrt(double(s));
+
+    sketch.assign((long long) m * columns, 0.0);
+
+    for (int i = 0; i < rows; i++) {
+
+        const double* in = &a[(long long) i * columns];
+
+        // a different salt for each of the s buckets gives each its
+        // own hash
+        for (int k = 0; k < s; k++) {
+
+            unsigned long long h = hash_row(seed, i, k + 1);
+            double sign = (h & 1) ? scale : -scale;
+            double* out = &sketch[(long long) ((h >> 32) % m) * columns];
+
+            for (int j = 0; j < columns; j++) {
+                out[j] += sign * in[j];
+            }
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void sparse_sign_csr(const CsrMatrix& a, unsigned long long seed, int m,
+                     int s, vector<double>& sketch) {
+
+    // PRE:  a is a valid CSR matrix, m >= 1 and s >= 1
+    //
+    // POST: sketch holds the same sparse sign embedding that
+    //       sparse_sign_dense() gives for the dense version of a
+
+    double scale = 1.0 / sqrt(double(s));
+
+    sketch.assign((long long) m * a.columns, 0.0);
+
+    for (int i = 0; i < a.rows; i++) {
+        for (int k = 0; k < s; k++) {
+
+            unsigned long long h = hash_row(seed, i, k + 1);
+            double sign = (h & 1) ? scale : -scale;
+            double* out = &sketch[(long long) ((h >> 32) % m) * a.columns];
+
+            for (int e = a.row_start[i]; e < a.row_start[i + 1]; e++) {
+                out[a.column[e]] += sign * a.values[e];
+            }
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void srht_dense(const vector<double>& a, int rows, int columns,
+                unsigned long long seed, int m, vector<double>& sketch) {
+
+    // PRE:  a holds rows * columns numbers, one row after another, and
+    //       m >= 1
+    //
+    // POST: sketch holds the m-by-columns subsampled randomized
+    //       Hadamard transform of a for seed
+
+    long long padded = 1;       // used to hold rows rounded up to a
+                                // power of 2
+    vector<double> work;        // used to hold the transformed rows
+    double scale;               // used to hold the final scaling
+
+    while (padded < rows) {
+        padded *= 2;
+    }
+
+    // step 1: flip the sign of each row at random (D); the padding
+    // rows stay zero
+    work.assign(padded * columns, 0.0);
+    for (int i = 0; i < rows; i++) {
+        double sign = (hash_row(seed, i, 0) & 1) ? 1.0 : -1.0;
+        for (int j = 0; j < columns; j++) {
+            work[(long long) i * columns + j] = sign * a[(long long) i * columns + j];
+        }
+    }
+
+    // step 2: the fast Walsh-Hadamard transform (H); each pass combines
+    // pairs of rows that are "half" apart into their sum and difference
+    for (long long half = 1; half < padded; half *= 2) {
+        for (long long block = 0; block < padded; block += 2 * half) {
+            for (long long i = block; i < block + half; i++) {
+
+                double* top = &work[i * columns];
+                double* bottom = &work[(i + half) * columns];
+
+                for (int j = 0; j < columns; j++) {
+                    double sum = top[j] + bottom[j];
+                    double difference = top[j] - bottom[j];
+                    top[j] = sum;
+                    bottom[j] = difference;
+                }
+            }
+        }
+    }
+
+    // step 3: keep m rows chosen at random (P); the transform above
+    // made every row sqrt(padded) times too long, so
+    // sqrt(padded / m) / sqrt(padded) = 1 / sqrt(m); the row choices
+    // use a salt that the sign flips above do not use
+    scale = 1.0 / sqrt(double(m));
+    sketch.assign((long long) m * columns, 0.0);
+    for (int r = 0; r < m; r++) {
+
+        long long chosen = (long long) (hash_row(seed, r, SRHT_ROW_SALT)
+                                        % (unsigned long long) padded);
+
+        for (int j = 0; j < columns; j++) {
+            sketch[(long long) r * columns + j] = scale * work[chosen * columns + j];
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double product_length(const vector<double>& a, int rows, int columns,
+                      const vector<double>& x) {
+
+    // PRE:  a holds rows * columns numbers, one row after another, and
+    //       x holds columns numbers
+    //
+    // POST: the length of the vector a*x has been returned
+
+    double total = 0;
+
+    for (int i = 0; i < rows; i++) {
+
+        double entry = 0;
+
+        for (int j = 0; j < columns; j++) {
+            entry += a[(long long) i * columns + j] * x[j];
+        }
+
+        total += entry * entry;
+    }
+
+    return sqrt(total);
+}
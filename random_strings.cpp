@@ -0,0 +1,693 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+generate random strings that follow a pattern or a small grammar in
+C++, quickly enough to produce millions of them.
+
+The main tutorial showed how to get one random number between a low
+and a high value with rand_range(). Often what we really want is not
+a number but a piece of text: a fake user name, a fake order
+identifier, a fake line from a log file. Such text is not completely
+random -- it has a shape. An order identifier might always be three
+capital letters, a dash, and six digits. A log line might always
+start with a level (INFO, WARN, or ERROR) followed by a message.
+
+There are two common ways to describe such a shape:
+
+    1. A pattern, similar to a regular expression:
+
+            [A-Z]{3}-[0-9]{6}
+
+       which means "three characters from A to Z, a dash, then six
+       characters from 0 to 9".
+
+    2. A grammar, which is a set of named rules. Each rule lists a
+       few alternatives, and each alternative is a sequence of pieces
+       of text, patterns, or other rules:
+
+            line  ->  level " " message
+            level ->  "INFO"  (weight 7)
+                   |  "WARN"  (weight 2)
+                   |  "ERROR" (weight 1)
+
+       The weights say how often each alternative should be chosen.
+       Here INFO is chosen 7 times out of 10.
+
+
+-----------------------
+Compile Once, Use Often
+-----------------------
+
+A slow way to generate a string is to read the pattern text, character
+by character, every single time we want a new string. Reading and
+understanding the pattern (called "parsing" it) is much more work than
+actually producing the random characters.
+
+A faster way is to parse the pattern only once, and turn it into a
+table (called "compiling" it). For the pattern above, the table looks
+like this:
+
+        step   characters to choose from       how many
+        ----   -------------------------       --------
+          1    ABCDEFGHIJKLMNOPQRSTUVWXYZ        3 to 3
+          2    -                                 1 to 1
+          3    0123456789                        6 to 6
+
+Generating a string is now just a matter of walking down the table.
+
+The same idea works for the weights in a grammar. Instead of adding up
+the weights every time we want to pick an alternative, we build a
+small lookup table once. For the level rule, the table has 10 slots:
+
+        slot:         0 1 2 3 4 5 6 7 8 9
+        alternative:  0 0 0 0 0 0 0 1 1 2
+
+Picking an alternative is now a single random number between 0 and 9
+followed by a single table lookup.
+
+
+----------------------------------------
+Getting Several Small Numbers From rand()
+----------------------------------------
+
+Each step in the table needs a random number in a very small range --
+between 0 and 25 for a capital letter, between 0 and 9 for a digit.
+But each call to rand() gives us a number between 0 and RAND_MAX,
+which is more than 2 billion. Using a whole call to rand() to choose
+one digit throws most of that number away.
+
+Instead, we can treat the number from rand() as a "pool" and take
+several small numbers out of it. Suppose rand() gave us 8,273,541 and
+we need a digit (range 10):
+
+        digit    = 8273541 % 10   = 1
+        leftover = 8273541 / 10   = 827354
+
+The leftover is still random, just smaller, so the next digit comes
+from it:
+
+        digit    = 827354 % 10    = 4
+        leftover = 827354 / 10    = 82735
+
+We keep going until the leftover becomes too small for the range we
+need (see below), and only then call rand() again. With RAND_MAX at
+about 2 billion, one call to rand() gives us six digits or four
+capital letters instead of one.
+
+Taking the mod of a leftover that is not a whole number of ranges
+would favor smaller values (the same problem as rand() % n in the
+main tutorial), and the smaller the leftover, the worse it gets: with
+a leftover of 25 values and a range of 10, the digits 0 to 4 would
+come up 3 times for every 2 of the others. So we only use the
+leftovers below the largest multiple of the range, which are exactly
+fair, and call rand() again otherwise. We also call rand() again as
+soon as the leftover holds fewer than 256 values per value of the
+range, so that this is rare.
+
+
+---------------------------
+Printing Strings in a Batch
+---------------------------
+
+Writing each string to cout separately is also slow, because every
+write has a cost. Instead, we append many strings to one big string
+(called a "buffer") and write the whole buffer at once.
+
+
+----------------
+Review Questions
+----------------
+
+1. What does the pattern [0-9]{4} describe?
+
+2. What does it mean to "compile" a pattern?
+
+3. Why is it faster to compile a pattern once instead of reading the
+pattern text for every string?
+
+4. In a grammar, what do the weights of the alternatives control?
+
+5. How many slots would the lookup table have for three alternatives
+with weights 5, 3, and 2?
+
+6. How can one call to rand() give us several random digits?
+
+7. When does the pool need to be refilled with a new call to rand()?
+
+8. Why is it faster to write strings into a buffer first?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() function
+
+#include <ctime>
+
+
+// access the string and vector types
+
+#include <string>
+#include <vector>
+
+
+// constant used to control how many sample strings are generated
+
+const int REPETITIONS = 10;
+
+
+// constant used to control how many characters are collected before
+// the buffer is written to cout
+
+const int BUFFER_SIZE = 65536;
+
+
+// constant used to control the largest count a pattern may ask for,
+// such as the 8 in [a-z]{8}
+
+const int MAX_PATTERN_COUNT = 10000;
+
+
+// one step of a compiled pattern: choose between min_count and
+// max_count characters, each taken from chars
+
+struct PatternStep {
+    string chars;
+    int min_count;
+    int max_count;
+};
+
+
+// one piece of a grammar alternative: either literal text, a compiled
+// pattern, or a reference to another rule (by its index)
+
+struct Piece {
+    string text;
+    vector<PatternStep> pattern;
+    int rule;
+};
+
+
+// one alternative of a grammar rule, together with its weight
+
+struct Alternative {
+    int weight;
+    vector<Piece> pieces;
+};
+
+
+// a grammar rule, together with its compiled lookup table that maps
+// a random slot to an alternative
+
+struct Rule {
+    vector<Alternative> alternatives;
+    vector<int> choice_table;
+};
+
+
+// a pool of random bits taken from one call to rand(); value holds
+// the leftover random number and range holds its largest possible
+// value
+
+struct DrawPool {
+    int value;
+    int range;
+};
+
+
+// prototype for a function to compile a pattern into a table of steps,
+// returning false (and why) if the pattern is not valid
+
+bool compile_pattern(const string& pattern, vector<PatternStep>& steps,
+                     string& error);
+
+
+// prototype for a function to build the lookup table of a rule
+
+void compile_rule(Rule& rule);
+
+
+// prototype for a function to take a small random number out of a
+// pool
+
+int pool_draw(DrawPool& pool, int n);
+
+
+// prototype for a function to append a string matching a compiled
+// pattern to a buffer
+
+void emit_pattern(const vector<PatternStep>& steps, DrawPool& pool,
+                  string& buffer);
+
+
+// prototype for a function to append a string matching a grammar
+// rule to a buffer
+
+void emit_rule(const vector<Rule>& grammar, int rule, DrawPool& pool,
+               string& buffer);
+
+
+// prototypes for functions to create pieces of a grammar alternative
+
+Piece text_piece(const string& text);
+Piece pattern_piece(const string& pattern, string& error);
+Piece rule_piece(int rule);
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    DrawPool pool;          // used to hold the pool of random bits
+    string buffer;          // used to collect output before writing
+    string pattern;         // used to hold a sample pattern
+    vector<PatternStep> steps;  // used to hold the compiled pattern
+    vector<Rule> grammar;   // used to hold a sample grammar
+    string error;           // used to hold why a pattern is not valid
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+
+    // start with an empty pool, so the first draw calls rand()
+    pool.value = 0;
+    pool.range = 0;
+
+    // compile a sample pattern once
+    pattern = "[A-Z]{3}-[0-9]{6}";
+    if (!compile_pattern(pattern, steps, error)) {
+        cout << "The pattern " << pattern << " is not valid: " << error
+             << endl;
+        return 1;
+    }
+
+    // tell the user that several random strings will be displayed
+    cout << endl
+         << "Displaying "
+         << REPETITIONS
+         << " random strings matching "
+         << pattern
+         << endl;
+
+    // loop REPETITIONS times, collecting the strings in the buffer
+    for (int i = 1; i <= REPETITIONS; i++) {
+        emit_pattern(steps, pool, buffer);
+        buffer += '\n';
+    }
+
+    // display the whole buffer at once
+    cout << buffer;
+    buffer.clear();
+
+    // build a sample grammar for log lines:
+    //
+    //     0: line    -> "2024-01-" [0-2][0-9] " " level " " message
+    //     1: level   -> "INFO" (7) | "WARN" (2) | "ERROR" (1)
+    //     2: message -> "user " [a-z]{4,8} " logged in"      (3)
+    //                 | "request " [0-9a-f]{8} " took "
+    //                   [1-9][0-9]{0,2} "ms"                  (5)
+    //                 | "disk " [a-z] " at " [5-9][0-9] "%"   (1)
+    grammar.resize(3);
+
+    grammar[0].alternatives.resize(1);
+    grammar[0].alternatives[0].weight = 1;
+    grammar[0].alternatives[0].pieces.push_back(text_piece("2024-01-"));
+    grammar[0].alternatives[0].pieces.push_back(pattern_piece("[0-2][0-9]", error));
+    grammar[0].alternatives[0].pieces.push_back(text_piece(" "));
+    grammar[0].alternatives[0].pieces.push_back(rule_piece(1));
+    grammar[0].alternatives[0].pieces.push_back(text_piece(" "));
+    grammar[0].alternatives[0].pieces.push_back(rule_piece(2));
+
+    grammar[1].alternatives.resize(3);
+    grammar[1].alternatives[0].weight = 7;
+    grammar[1].alternatives[0].pieces.push_back(text_piece("INFO"));
+    grammar[1].alternatives[1].weight = 2;
+    grammar[1].alternatives[1].pieces.push_back(text_piece("WARN"));
+    grammar[1].alternatives[2].weight = 1;
+    grammar[1].alternatives[2].pieces.push_back(text_piece("ERROR"));
+
+    grammar[2].alternatives.resize(3);
+    grammar[2].alternatives[0].weight = 3;
+    grammar[2].alternatives[0].pieces.push_back(text_piece("user "));
+    grammar[2].alternatives[0].pieces.push_back(pattern_piece("[a-z]{4,8}", error));
+    grammar[2].alternatives[0].pieces.push_back(text_piece(" logged in"));
+    grammar[2].alternatives[1].weight = 5;
+    grammar[2].alternatives[1].pieces.push_back(text_piece("request "));
+    grammar[2].alternatives[1].pieces.push_back(pattern_piece("[0-9a-f]{8}", error));
+    grammar[2].alternatives[1].pieces.push_back(text_piece(" took "));
+    grammar[2].alternatives[1].pieces.push_back(pattern_piece("[1-9][0-9]{0,2}ms", error));
+    grammar[2].alternatives[2].weight = 1;
+    grammar[2].alternatives[2].pieces.push_back(text_piece("disk "));
+    grammar[2].alternatives[2].pieces.push_back(pattern_piece("[a-z]", error));
+    grammar[2].alternatives[2].pieces.push_back(text_piece(" at "));
+    grammar[2].alternatives[2].pieces.push_back(pattern_piece("[5-9][0-9]%", error));
+
+    // stop if any of the grammar's patterns was not valid
+    if (!error.empty()) {
+        cout << error << endl;
+        return 1;
+    }
+
+    // compile the lookup table of every rule once
+    for (int r = 0; r < int(grammar.size()); r++) {
+        compile_rule(grammar[r]);
+    }
+
+    // tell the user that several random log lines will be displayed
+    cout << endl
+         << "Displaying "
+         << REPETITIONS
+         << " random log lines generated from a grammar"
+         << endl;
+
+    // loop REPETITIONS times, writing the buffer whenever it is full
+    for (int i = 1; i <= REPETITIONS; i++) {
+        emit_rule(grammar, 0, pool, buffer);
+        buffer += '\n';
+
+        if (int(buffer.size()) >= BUFFER_SIZE) {
+            cout << buffer;
+            buffer.clear();
+        }
+    }
+
+    // display whatever is left in the buffer
+    cout << buffer;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+bool compile_pattern(const string& pattern, vector<PatternStep>& steps,
+                     string& error) {
+
+    // PRE:  pattern is made of literal characters, character classes
+    //       such as [a-z0-9_], and optional counts such as {3} or
+    //       {2,5} after a character or class
+    //
+    // POST: if pattern is valid, steps holds a table of steps that
+    //       produces strings matching it, and true has been returned;
+    //       otherwise error says what is wrong with it, and false has
+    //       been returned
+
+    PatternStep step;           // used to build one step
+    int size = int(pattern.size());
+    int i = 0;                  // used to walk through the pattern
+
+    steps.clear();
+
+    while (i < size) {
+
+        step.chars.clear();
+
+        // a character class lists characters and ranges of
+        // characters between square brackets
+        if (pattern[i] == '[') {
+            int open = i;
+            i++;
+            while (i < size && pattern[i] != ']') {
+                if (i + 2 < size && pattern[i + 1] == '-'
+                        && pattern[i + 2] != ']') {
+                    // an int counter, so a range ending at the largest
+                    // char does not wrap around forever
+                    int first = (unsigned char) pattern[i];
+                    int last = (unsigned char) pattern[i + 2];
+                    if (first > last) {
+                        error = "the range " + pattern.substr(i, 3)
+                                + " is backwards";
+                        return false;
+                    }
+                    for (int c = first; c <= last; c++) {
+                        step.chars += char(c);
+                    }
+                    i += 3;
+                } else {
+                    step.chars += pattern[i];
+                    i++;
+                }
+            }
+            if (i >= size) {
+                error = "the [ at position " + to_string(open)
+                        + " has no closing ]";
+                return false;
+            }
+            if (step.chars.empty()) {
+                error = "the character class at position "
+                        + to_string(open) + " is empty";
+                return false;
+            }
+            i++;
+        } else {
+            step.chars += pattern[i];
+            i++;
+        }
+
+        // an optional count follows the character or class: {n} or
+        // {n,m}, with n <= m
+        step.min_count = 1;
+        step.max_count = 1;
+        if (i < size && pattern[i] == '{') {
+            int open = i;
+            int digits = 0;
+            i++;
+            step.min_count = 0;
+            while (i < size && pattern[i] >= '0' && pattern[i] <= '9') {
+                // stop growing once too large, so it cannot overflow
+                if (step.min_count <= MAX_PATTERN_COUNT) {
+                    step.min_count = step.min_count * 10 + (pattern[i] - '0');
+                }
+                digits++;
+                i++;
+            }
+            step.max_count = step.min_count;
+            if (digits > 0 && i < size && pattern[i] == ',') {
+                i++;
+                step.max_count = 0;
+                digits = 0;
+                while (i < size && pattern[i] >= '0' && pattern[i] <= '9') {
+                    if (step.max_count <= MAX_PATTERN_COUNT) {
+                        step.max_count = step.max_count * 10 + (pattern[i] - '0');
+                    }
+                    digits++;
+                    i++;
+                }
+            }
+            if (digits == 0 || i >= size || pattern[i] != '}') {
+                error = "the count at position " + to_string(open)
+                        + " is not {n} or {n,m}";
+                return false;
+            }
+            if (step.min_count > step.max_count
+                    || step.max_count > MAX_PATTERN_COUNT) {
+                error = "the count at position " + to_string(open)
+                        + " must have n <= m <= "
+                        + to_string(MAX_PATTERN_COUNT);
+                return false;
+            }
+            i++;
+        }
+
+        steps.push_back(step);
+    }
+
+    return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void compile_rule(Rule& rule) {
+
+    // PRE:  every alternative of rule has a weight of at least 1
+    //
+    // POST: rule.choice_table has one slot per unit of weight, each
+    //       holding the index of the alternative that owns the slot
+
+    rule.choice_table.clear();
+
+    for (int a = 0; a < int(rule.alternatives.size()); a++) {
+        for (int w = 0; w < rule.alternatives[a].weight; w++) {
+            rule.choice_table.push_back(a);
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int pool_draw(DrawPool& pool, int n) {
+
+    // PRE:  1 <= n <= RAND_MAX, and srand() has been called
+    //
+    // POST: a random number between 0 and (n - 1) (inclusive), each
+    //       exactly equally likely, has been returned, and taken out of
+    //       the pool
+
+    int result;         // used to hold the random number being returned
+    long long count;    // used to hold how many values the pool can hold
+    long long limit;    // used to hold the largest multiple of n that fits
+
+    // refill the pool when the leftover is small for this range
+    count = (long long) pool.range + 1;
+    if (count < (long long) n * 256) {
+        pool.value = rand();
+        count = (long long) RAND_MAX + 1;
+    }
+
+    // values at or above the largest multiple of n would favor small
+    // results, so throw them away and call rand() again
+    limit = count - count % n;
+    while (pool.value >= limit) {
+        pool.value = rand();
+        count = (long long) RAND_MAX + 1;
+        limit = count - count % n;
+    }
+
+    result = pool.value % n;
+    pool.value = pool.value / n;
+    pool.range = int(limit / n - 1);
+
+    return result;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void emit_pattern(const vector<PatternStep>& steps, DrawPool& pool,
+                  string& buffer) {
+
+    // PRE:  steps was returned by compile_pattern()
+    //
+    // POST: a random string matching steps has been appended to buffer
+
+    int count;      // used to hold how many characters a step produces
+
+    for (int s = 0; s < int(steps.size()); s++) {
+
+        const PatternStep& step = steps[s];
+
+        count = step.min_count;
+        if (step.max_count > step.min_count) {
+            count += pool_draw(pool, step.max_count - step.min_count + 1);
+        }
+
+        // a single possible character needs no random number at all
+        if (step.chars.size() == 1) {
+            buffer.append(count, step.chars[0]);
+        } else {
+            for (int c = 0; c < count; c++) {
+                buffer += step.chars[pool_draw(pool, int(step.chars.size()))];
+            }
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void emit_rule(const vector<Rule>& grammar, int rule, DrawPool& pool,
+               string& buffer) {
+
+    // PRE:  compile_rule() has been called on every rule of grammar,
+    //       and rule is a valid index into grammar
+    //
+    // POST: a random string produced by rule has been appended to
+    //       buffer
+
+    const Rule& r = grammar[rule];
+    const Alternative& alternative =
+        r.alternatives[r.choice_table[pool_draw(pool, int(r.choice_table.size()))]];
+
+    for (int p = 0; p < int(alternative.pieces.size()); p++) {
+
+        const Piece& piece = alternative.pieces[p];
+
+        if (piece.rule >= 0) {
+            emit_rule(grammar, piece.rule, pool, buffer);
+        } else if (!piece.pattern.empty()) {
+            emit_pattern(piece.pattern, pool, buffer);
+        } else {
+            buffer += piece.text;
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+Piece text_piece(const string& text) {
+
+    // PRE:  none
+    //
+    // POST: a piece that copies text unchanged has been returned
+
+    Piece piece;
+
+    piece.text = text;
+    piece.rule = -1;
+
+    return piece;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+Piece pattern_piece(const string& pattern, string& error) {
+
+    // PRE:  pattern follows the rules described in compile_pattern()
+    //
+    // POST: a piece that produces a string matching the compiled
+    //       pattern has been returned; if the pattern is not valid,
+    //       and error is still empty, error says why
+
+    Piece piece;
+    string problem;             // used to hold why it is not valid
+
+    if (!compile_pattern(pattern, piece.pattern, problem)
+            && error.empty()) {
+        error = "The pattern " + pattern + " is not valid: " + problem;
+    }
+    piece.rule = -1;
+
+    return piece;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+Piece rule_piece(int rule) {
+
+    // PRE:  rule is the index of a rule in the grammar
+    //
+    // POST: a piece that expands the given rule has been returned
+
+    Piece piece;
+
+    piece.rule = rule;
+
+    return piece;
+}
@@ -0,0 +1,662 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+pick a sample of exactly n items from a very long list in one pass,
+either with every item equally likely, or with each item's chance in
+proportion to its size, in C++.
+
+
+-----------------------
+Systematic Sampling
+-----------------------
+
+To pick n of N items, each with the same chance n / N, the simplest
+method of all is "systematic sampling": pick one random starting
+point, then take every (N / n)-th item after it.
+
+        step  = N / n
+        start = a random number from 0 up to (but not including) step
+        pick items start, start + step, start + 2 * step, ...
+
+Only ONE random number is needed for the whole sample, and there is
+nothing to remember except where the next pick is. Each item is picked
+with chance exactly n / N, and exactly n items are always picked.
+
+The step need not be a whole number. To keep everything exact, we work
+in whole numbers scaled up by n: with a random start r from 0 to N - 1,
+pick k is item (r + k * N) / n, rounded down.
+
+One warning: if the list has a pattern that repeats every "step" items
+(every 7th entry is a Sunday), a systematic sample can pick the same
+part of the pattern every time. Lists like that should be shuffled, or
+sorted by something unrelated, first.
+
+
+---------------------------------------
+PPS: Probability Proportional to Size
+---------------------------------------
+
+Auditors checking payments want big payments to be more likely to be
+checked: a $10,000 payment should be 100 times as likely to be picked
+as a $100 one. This is "monetary unit sampling", or "PPS" sampling.
+
+Imagine laying all the payments end to end along a line, each as long
+as its amount in cents, so the line is W cents long in total. Now do
+systematic sampling of the CENTS: pick n points, W / n cents apart,
+starting at a random point. Each point lands inside some payment, and
+that payment is picked. A payment of w cents is hit with chance
+exactly n * w / W.
+
+In one pass over the payments, we only need a running total:
+
+        total = 0
+        for each payment w:
+            total = total + w
+            while the next point is below total:
+                pick this payment
+                move the next point on by W / n
+
+Again, exactly n points, one random number, and nothing to remember.
+
+
+---------------------
+Certain Items
+---------------------
+
+A payment bigger than W / n would be hit by more than one point -- its
+"chance" n * w / W is over 1. Such payments are simply taken for
+certain, and the rest of the sample (n minus the number taken) is
+spread over the other payments, whose total is smaller. That can make
+more payments too big, so we repeat until none are.
+
+Only the n biggest payments could ever be certain, so one pass keeping
+the n biggest (in a small heap) is enough to find them. Together with
+the grand total, which a ledger usually has anyway, this is a "plan";
+the sampling itself is then one pass.
+
+
+---------------------------------
+Many Cores: Prefix Sums
+---------------------------------
+
+To split the pass over threads, each thread needs to know where its
+part of the list starts on the line of cents. So:
+
+    1. Each thread adds up its own chunk of the list.
+    2. One thread adds up the chunk totals in order (a "prefix sum"),
+       giving each chunk's starting point on the line.
+    3. Each thread works out the first point in its chunk, and picks
+       its items exactly as the one-pass version would.
+
+The points are the same as in the one-thread version, so the sample
+is exactly the same, whatever the number of threads.
+
+
+----------------
+Review Questions
+----------------
+
+1. How many random numbers does systematic sampling need?
+
+2. Why does a repeating pattern in the list cause problems for
+   systematic sampling?
+
+3. What is the chance that a payment of w cents is picked, if no
+   payment is certain?
+
+4. Why can only the n biggest payments be certain?
+
+5. What must each thread know before it can pick items in its chunk?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand(), srand() and time() functions
+
+#include <cstdlib>
+#include <ctime>
+
+
+// access the log(), exp(), sqrt() and cos() functions
+
+#include <cmath>
+
+
+// access the vector and thread types
+
+#include <vector>
+#include <thread>
+
+
+// access the sort() and push_heap() functions
+
+#include <algorithm>
+
+
+// constants used to control the size of the demonstration
+
+const long long PAYMENTS = 20000000;
+const long long SAMPLE = 1000;
+
+
+// a plan for PPS sampling: which items are certain, and how the rest
+// of the sample is spread
+
+struct PpsPlan {
+    unsigned long long threshold;   // weights this big are certain
+    long long certain;              // how many items are certain
+    unsigned __int128 total;        // total of the other weights
+    long long count;                // how many of the others to pick
+    unsigned __int128 start;        // random start, from 0 to total - 1
+};
+
+
+// a one-pass PPS sampler part way through a list
+
+struct PpsStream {
+    PpsPlan plan;
+    unsigned __int128 reached;      // count * (running total so far)
+    unsigned __int128 next;         // start + k * total, the next point
+};
+
+
+// prototypes for functions to make random numbers
+
+unsigned long long next64(unsigned long long& state);
+unsigned __int128 below(unsigned long long& state, unsigned __int128 limit);
+
+
+// prototype for a function to pick count of population items, each
+// equally likely, by systematic sampling
+
+void systematic_sample(long long population, long long count,
+                       unsigned long long seed, vector<long long>& picks);
+
+
+// prototype for a function to make a PPS plan in one pass
+
+PpsPlan plan_pps(const unsigned long long* weights, long long length,
+                 long long count, unsigned long long seed);
+
+
+// prototypes for functions to offer items to a one-pass PPS sampler
+
+void pps_begin(PpsStream& stream, const PpsPlan& plan);
+bool pps_offer(PpsStream& stream, unsigned long long weight);
+
+
+// prototypes for functions to PPS sample a whole list, with one thread
+// and with several
+
+void pps_sample(const unsigned long long* weights, long long length,
+                const PpsPlan& plan, vector<long long>& picks);
+void pps_sample_parallel(const unsigned long long* weights, long long length,
+                         const PpsPlan& plan, int threads,
+                         vector<long long>& picks);
+
+
+// prototype for a function to pick a weighted sample with a reservoir,
+// for comparison
+
+void reservoir_sample(const unsigned long long* weights, long long length,
+                      long long count, unsigned long long seed,
+                      vector<long long>& picks);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    vector<unsigned long long> weights; // used to hold the payments
+    vector<long long> picks;            // used to hold a sample
+    vector<long long> others;           // used to hold another sample
+    unsigned long long seed;            // used to hold the main seed
+    unsigned long long state;           // used to make the payments
+    PpsPlan plan;                       // used to hold a PPS plan
+    double start;                       // used to hold the starting time
+    int threads;                        // used to hold the thread count
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = ((unsigned long long) rand() << 31) | rand();
+
+    threads = int(thread::hardware_concurrency());
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    // equal chances: 5 of 17 items, many times over
+    vector<long long> hits(17, 0);
+    for (int s = 0; s < 170000; s++) {
+        systematic_sample(17, 5, seed + s, picks);
+        for (size_t k = 0; k < picks.size(); k++) {
+            hits[picks[k]]++;
+        }
+    }
+    cout << endl << "Systematic sampling, 5 of 17: share of samples "
+         << "including each item (expected " << 5.0 / 17 << ")" << endl
+         << "   ";
+    for (int i = 0; i < 17; i++) {
+        cout << " " << hits[i] / 170000.0;
+    }
+    cout << endl;
+
+    // PPS chances: 3 of 8 items, two of which are certain
+    unsigned long long small[8] = { 1, 2, 3, 4, 10, 30, 50, 100 };
+    vector<long long> included(8, 0);
+    for (int s = 0; s < 200000; s++) {
+        plan = plan_pps(small, 8, 3, seed + s);
+        pps_sample(small, 8, plan, picks);
+        for (size_t k = 0; k < picks.size(); k++) {
+            included[picks[k]]++;
+        }
+    }
+    cout << endl << "PPS sampling, 3 of weights 1 2 3 4 10 30 50 100:" << endl
+         << "    share including each: ";
+    for (int i = 0; i < 8; i++) {
+        cout << " " << included[i] / 200000.0;
+    }
+    cout << endl << "    expected:             ";
+    for (int i = 0; i < 8; i++) {
+        cout << " " << (i >= 6 ? 1.0 : small[i] / 50.0);
+    }
+    cout << endl;
+
+    // a big ledger of payments in cents, mostly small with a few huge
+    weights.resize(PAYMENTS);
+    state = seed;
+    for (long long i = 0; i < PAYMENTS; i++) {
+        double u = (next64(state) >> 11) * (1.0 / 9007199254740992.0);
+        double v = (next64(state) >> 11) * (1.0 / 9007199254740992.0);
+        double normal = sqrt(-2.0 * log(1.0 - u)) * cos(6.283185307179586 * v);
+        weights[i] = 1 + (unsigned long long) exp(8.0 + 2.5 * normal);
+    }
+
+    cout << endl << "Sampling " << SAMPLE << " of " << PAYMENTS
+         << " payments, " << threads << " threads:" << endl;
+
+    start = now();
+    plan = plan_pps(&weights[0], PAYMENTS, SAMPLE, seed);
+    cout << "    plan (total and biggest): " << now() - start << " seconds, "
+         << plan.certain << " certain payments" << endl;
+
+    start = now();
+    pps_sample(&weights[0], PAYMENTS, plan, picks);
+    cout << "    one pass:                 " << now() - start << " seconds, "
+         << picks.size() << " picked" << endl;
+
+    start = now();
+    pps_sample_parallel(&weights[0], PAYMENTS, plan, threads, others);
+    cout << "    threads:                  " << now() - start << " seconds, "
+         << others.size() << " picked, "
+         << (others == picks ? "the same sample" : "A DIFFERENT SAMPLE")
+         << endl;
+
+    start = now();
+    reservoir_sample(&weights[0], PAYMENTS, SAMPLE, seed, others);
+    cout << "    weighted reservoir:       " << now() - start << " seconds, "
+         << others.size() << " picked" << endl;
+
+    // the picked payments should be much bigger than average
+    double average = 0;
+    double picked_average = 0;
+    for (long long i = 0; i < PAYMENTS; i++) {
+        average += weights[i];
+    }
+    for (size_t k = 0; k < picks.size(); k++) {
+        picked_average += weights[picks[k]];
+    }
+    cout << "    average payment " << average / PAYMENTS / 100
+         << " dollars, average picked " << picked_average / picks.size() / 100
+         << " dollars" << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long next64(unsigned long long& state) {
+
+    // PRE:  none
+    //
+    // POST: state has moved on, and a random 64-bit number has been
+    //       returned (SplitMix64)
+
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned __int128 below(unsigned long long& state, unsigned __int128 limit) {
+
+    // PRE:  limit >= 1
+    //
+    // POST: a random number from 0 to limit - 1 has been returned, each
+    //       exactly equally likely
+
+    unsigned __int128 mask = limit - 1;
+    unsigned __int128 value;
+
+    // all ones at and below the top bit of limit - 1
+    for (int shift = 1; shift < 128; shift *= 2) {
+        mask |= mask >> shift;
+    }
+
+    // draw under the mask until below limit: at most 2 tries on average
+    do {
+        value = ((unsigned __int128) next64(state) << 64) | next64(state);
+        value &= mask;
+    } while (value >= limit);
+
+    return value;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void systematic_sample(long long population, long long count,
+                       unsigned long long seed, vector<long long>& picks) {
+
+    // PRE:  0 < count <= population
+    //
+    // POST: picks holds count different item numbers from 0 to
+    //       population - 1, in order, each item picked with chance
+    //       exactly count / population
+
+    unsigned long long state = seed;
+    unsigned __int128 r = below(state, population);
+
+    picks.resize(count);
+
+    // pick k is (r + k * population) / count: the step population /
+    // count, scaled up by count so it is a whole number
+    for (long long k = 0; k < count; k++) {
+        picks[k] = (long long) ((r + (unsigned __int128) k * population) / count);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+PpsPlan plan_pps(const unsigned long long* weights, long long length,
+                 long long count, unsigned long long seed) {
+
+    // PRE:  weights holds length weights, each below 2^63, and at
+    //       least count of them are above 0
+    //
+    // POST: a plan has been returned that picks count items, each with
+    //       chance in proportion to its weight, except that items which
+    //       would be picked for certain are taken once each
+
+    vector<unsigned long long> biggest; // a min-heap of the biggest
+    unsigned __int128 total = 0;
+    PpsPlan plan;
+
+    biggest.reserve(count + 1);
+
+    for (long long i = 0; i < length; i++) {
+
+        total += weights[i];
+
+        if ((long long) biggest.size() < count) {
+            biggest.push_back(weights[i]);
+            push_heap(biggest.begin(), biggest.end(), greater<unsigned long long>());
+        } else if (weights[i] > biggest[0]) {
+            pop_heap(biggest.begin(), biggest.end(), greater<unsigned long long>());
+            biggest.back() = weights[i];
+            push_heap(biggest.begin(), biggest.end(), greater<unsigned long long>());
+        }
+    }
+
+    sort(biggest.begin(), biggest.end(), greater<unsigned long long>());
+
+    // take the biggest for certain while their chance would be 1 or
+    // more; taking one never makes the next one's chance smaller
+    plan.certain = 0;
+    plan.threshold = ~0ULL;
+    while (plan.certain < count &&
+           (unsigned __int128) biggest[plan.certain] * (count - plan.certain) >= total) {
+        plan.threshold = biggest[plan.certain];
+        total -= biggest[plan.certain];
+        plan.certain++;
+    }
+
+    plan.total = total;
+    plan.count = count - plan.certain;
+
+    unsigned long long state = seed;
+    plan.start = (total > 0) ? below(state, total) : 0;
+
+    return plan;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void pps_begin(PpsStream& stream, const PpsPlan& plan) {
+
+    // PRE:  plan was made by plan_pps()
+    //
+    // POST: stream is ready to be offered the items in order
+
+    stream.plan = plan;
+    stream.reached = 0;
+    stream.next = plan.start;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+bool pps_offer(PpsStream& stream, unsigned long long weight) {
+
+    // PRE:  pps_begin() has been called, and the items before this one
+    //       have been offered in order
+    //
+    // POST: true has been returned if this item is picked
+
+    if (weight >= stream.plan.threshold) {
+        return true;
+    }
+
+    // this item covers the points from count * (total before it) up to
+    // count * (total including it); at most one, as it isn't certain
+    stream.reached += (unsigned __int128) weight * stream.plan.count;
+    if (stream.next < stream.reached) {
+        stream.next += stream.plan.total;
+        return true;
+    }
+
+    return false;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void pps_sample(const unsigned long long* weights, long long length,
+                const PpsPlan& plan, vector<long long>& picks) {
+
+    // PRE:  plan was made by plan_pps() for these weights
+    //
+    // POST: picks holds the picked item numbers, in order
+
+    PpsStream stream;
+
+    pps_begin(stream, plan);
+    picks.clear();
+
+    for (long long i = 0; i < length; i++) {
+        if (pps_offer(stream, weights[i])) {
+            picks.push_back(i);
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void pps_sample_parallel(const unsigned long long* weights, long long length,
+                         const PpsPlan& plan, int threads,
+                         vector<long long>& picks) {
+
+    // PRE:  plan was made by plan_pps() for these weights, and
+    //       threads >= 1
+    //
+    // POST: picks holds the picked item numbers, in order: the same
+    //       sample as pps_sample() picks
+
+    vector<unsigned __int128> offset(threads + 1, 0);
+    vector<vector<long long> > found(threads);
+    vector<thread> workers;
+    long long chunk = (length + threads - 1) / threads;
+
+    // 1. each thread adds up its chunk's uncertain weights
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&, t]() {
+            long long first = t * chunk;
+            long long last = (first + chunk < length) ? first + chunk : length;
+            unsigned __int128 sum = 0;
+            for (long long i = first; i < last; i++) {
+                if (weights[i] < plan.threshold) {
+                    sum += weights[i];
+                }
+            }
+            offset[t + 1] = sum;
+        }));
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+    workers.clear();
+
+    // 2. a prefix sum gives each chunk's starting total
+    for (int t = 0; t < threads; t++) {
+        offset[t + 1] += offset[t];
+    }
+
+    // 3. each thread starts at its first point, and picks as usual
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&, t]() {
+            long long first = t * chunk;
+            long long last = (first + chunk < length) ? first + chunk : length;
+            PpsStream stream;
+            unsigned __int128 reached = offset[t] * plan.count;
+
+            pps_begin(stream, plan);
+            stream.reached = reached;
+
+            // the first point start + k * total at or past reached
+            if (reached > plan.start && plan.total > 0) {
+                unsigned __int128 k = (reached - plan.start + plan.total - 1) / plan.total;
+                stream.next = plan.start + k * plan.total;
+            }
+
+            for (long long i = first; i < last; i++) {
+                if (pps_offer(stream, weights[i])) {
+                    found[t].push_back(i);
+                }
+            }
+        }));
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+
+    picks.clear();
+    for (int t = 0; t < threads; t++) {
+        picks.insert(picks.end(), found[t].begin(), found[t].end());
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void reservoir_sample(const unsigned long long* weights, long long length,
+                      long long count, unsigned long long seed,
+                      vector<long long>& picks) {
+
+    // PRE:  weights holds length weights, at least count above 0
+    //
+    // POST: picks holds count item numbers, in order, picked by the
+    //       Efraimidis-Spirakis weighted reservoir: each item gets the
+    //       key -log(u) / weight, and the count smallest keys are kept
+
+    vector<pair<double, long long> > heap;  // a max-heap of keys
+    unsigned long long state = seed;
+
+    heap.reserve(count + 1);
+
+    for (long long i = 0; i < length; i++) {
+
+        if (weights[i] == 0) {
+            continue;
+        }
+
+        double u = ((next64(state) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+        double key = -log(u) / weights[i];
+
+        if ((long long) heap.size() < count) {
+            heap.push_back(make_pair(key, i));
+            push_heap(heap.begin(), heap.end());
+        } else if (key < heap[0].first) {
+            pop_heap(heap.begin(), heap.end());
+            heap.back() = make_pair(key, i);
+            push_heap(heap.begin(), heap.end());
+        }
+    }
+
+    picks.clear();
+    for (size_t k = 0; k < heap.size(); k++) {
+        picks.push_back(heap[k].second);
+    }
+    sort(picks.begin(), picks.end());
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
@@ -0,0 +1,967 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+generate large amounts of made-up text that looks a little like real
+writing, quickly, reproducibly, and with a chosen amount of
+randomness, in C++.
+
+
+-----------------------------
+Why Make Up Text?
+-----------------------------
+
+Compressors, tokenizers and search indexes are tested on text. Real
+text is not always available in the amounts (or with the licence) we
+need, and "lorem ipsum" tools are slow and produce the same few words
+over and over, which makes every compressor look wonderful. We want
+text that:
+
+    - has a realistic mix of common and rare words,
+    - follows some of the word order of real writing,
+    - has a known amount of randomness (entropy) per byte, and
+    - comes out the same every time for the same seed.
+
+
+-----------------------------
+Markov Models of Words
+-----------------------------
+
+We read a sample of real writing (the introduction of main.cpp) and
+count, for every run of ORDER - 1 words (the "state"), how often each
+word follows it. To generate text, we start in some state, choose the
+next word with the chance it had in the sample, write it out, and
+move to the state made by the last ORDER - 1 words. This is an n-gram
+Markov model. With ORDER = 2, each word depends only on the one
+before it, so the text makes local sense but wanders; with larger
+ORDER, it copies longer pieces of the sample.
+
+Each state gets its own alias table (see compact_alias_table.cpp), so
+choosing a word takes one random number and two table lookups,
+however many words can follow. The next state of every choice is
+worked out ahead of time, so the generator never has to look anything
+up by name.
+
+
+-----------------------------
+A Zipf Vocabulary
+-----------------------------
+
+A small sample only knows a few hundred words. Real text keeps using
+new, rare words, and the chance of the r-th most common word is close
+to 1 / r ("Zipf's law"). So, with chance p, the next word comes instead
+from a made-up vocabulary of VOCABULARY words with Zipf chances. The
+made-up words are built from syllables, with the most common words
+the shortest, as in real languages. After a made-up word, the model
+starts again from the chance of each sample word on its own.
+
+
+-----------------------------
+Choosing the Entropy
+-----------------------------
+
+The "information" in one choice made with chance q is -log2(q) bits.
+Adding this up over the words we generate, and dividing by the bytes
+written, tells us how many random bits per byte the text really
+holds -- the best that any compressor could ever do on it. Spaces and
+line breaks cost nothing: they are decided by the words.
+
+Text from the sample model alone (p = 0) is quite predictable; made-up
+Zipf words (p = 1) are much less so. Between the two, the bits per
+byte rise with p, so we find the p that gives a target number of bits
+per byte by bisection: try the middle of a range, and keep the half
+that holds the target.
+
+(A made-up word could happen to be spelt like a sample word; then the
+text holds slightly less information than we counted.)
+
+
+-----------------------------
+Speed and Reproducibility
+-----------------------------
+
+Each word is kept in a fixed-size slot, together with the space after
+it, so writing one out is a single fixed-size copy; then we move on
+by the word's real length.
+
+Each choice needs the one before it (to know the state), so one run of
+words can't go faster than the time to look up one table after
+another. Each chunk is therefore made as LANES separate runs of words,
+one after the other, which the processor can work on side by side.
+The coin of each alias table is used as an index (0 or 1) rather than
+tested with an "if", since the processor would guess wrong about half
+the time.
+
+The text is made in CHUNK-sized pieces, each lane with its own random
+number generator set up from the seed, the chunk number and the lane
+number. Any chunk can be made again on its own, and the chunks can be
+shared among threads without changing the text.
+
+
+----------------
+Review Questions
+----------------
+
+1. What is the state of an n-gram Markov model?
+
+2. Why does every state get its own alias table?
+
+3. Why do the made-up words follow Zipf's law?
+
+4. How do we measure the entropy per byte of the text we generate?
+
+5. Why does each chunk get its own random number generator?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the pow() and log2() functions
+
+#include <cmath>
+
+
+// access the memcpy() and memcmp() functions
+
+#include <cstring>
+
+
+// access the ifstream type
+
+#include <fstream>
+
+
+// access the string, vector, map and thread types
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+
+
+// constants used to control the Markov model: states are the last
+// ORDER - 1 words
+
+const int ORDER = 2;
+const char SAMPLE_FILE[] = "main.cpp";
+
+
+// constants used to control the made-up Zipf vocabulary
+
+const int VOCABULARY = 32768;           // at most 65536
+const double ZIPF_S = 1.0;
+
+
+// constants used to control the room for one word (and its space), and
+// the length of a line
+
+const int SLOT = 32;
+const int LINE = 72;
+
+
+// constants used to control how many independent runs of words are
+// made side by side in each chunk, and how many words of each are
+// chosen at a time
+
+const int LANES = 4;
+const int BATCH = 64;
+
+
+// constants used to control the size of the chunks, the corpus made by
+// the demonstration, and its target entropy
+
+const long long CHUNK = 1 << 20;
+const long long CORPUS = 512LL << 20;
+const double TARGET_BITS = 1.5;
+
+
+// constant used to control how many words are used to measure entropy
+
+const long long MEASURE_WORDS = 400000;
+
+
+// a few words of sample text, used if SAMPLE_FILE can't be read
+
+const char BUILT_IN_SAMPLE[] =
+    "To be random means to be unpredictable. Therefore, a random number "
+    "should be an unpredictable number. However, since computers are "
+    "among the most predictable devices ever invented by humans, it will "
+    "be difficult to get a computer to create a truly random number. For "
+    "this reason, we will satisfy ourselves with getting the computer to "
+    "create so-called pseudo random numbers.";
+
+
+// one column of an alias table, while it is being built: choose keep
+// if the coin is below cut, otherwise other
+
+struct AliasEntry {
+    unsigned long long cut;             // out of 2^32
+    int keep;
+    int other;
+};
+
+
+// one word that can follow a state, and the state it leads to
+
+struct Choice {
+    int word;
+    int next;
+};
+
+
+// one column of a finished alias table, holding its choices, so one
+// lookup finds both the word and the next state: pick[0] if the coin is
+// below cut, otherwise pick[1]
+
+struct Column {
+    unsigned int cut;                   // out of 2^32; full columns have both the same
+    Choice pick[2];
+};
+
+
+// one column of the made-up words' alias table, kept small (ranks
+// below 65536) so that it stays in the cache
+
+struct RankColumn {
+    unsigned int cut;                   // out of 2^32; full columns have both the same
+    unsigned short rank[2];
+};
+
+
+// one of the independent streams of words that make up a chunk
+
+struct Lane {
+    char* at;
+    char* end;
+    int state;
+    int column;                         // where the line has got to
+    unsigned long long rng;
+};
+
+
+// everything needed to make text
+
+struct TextModel {
+    vector<char> spelling;              // SLOT bytes per word
+    vector<unsigned char> length;       // with the space after it
+    int sample_words;                   // made-up words come after these
+
+    vector<int> first;                  // each state's first column
+    vector<Column> columns;
+    vector<Choice> choices;             // each state's choices, in order
+    vector<float> bits;                 // information of each choice
+
+    vector<RankColumn> zipf;            // made-up words lead to state 0
+    vector<float> zipf_bits;
+
+    unsigned long long novelty;         // chance of a made-up word, out of 2^32
+    double p;
+};
+
+
+// prototypes for functions to build a model
+
+void read_sample(const char* file_name, vector<string>& words);
+void build_model(TextModel& model, const vector<string>& words);
+void add_word(TextModel& model, const string& word);
+string made_up_word(int rank);
+void build_alias(const vector<double>& weights, AliasEntry* out, int base);
+Column finish_column(const AliasEntry& entry, const Choice* choices);
+
+
+// prototypes for functions to choose and measure the entropy
+
+void set_novelty(TextModel& model, double p);
+double measure_bits(TextModel& model, double p, unsigned long long seed);
+double find_novelty(TextModel& model, double target, unsigned long long seed);
+
+
+// prototypes for functions to make text
+
+int pick_word(const TextModel& model, int& state, unsigned long long& rng);
+void put_word(const TextModel& model, Lane& lane, int word, int copy);
+void make_chunk(const TextModel& model, unsigned long long seed, long long chunk,
+                char* out, long long bytes);
+void make_corpus(const TextModel& model, unsigned long long seed, char* out,
+                 long long bytes, int threads);
+
+
+// prototypes for the SplitMix64 generator
+
+unsigned long long next64(unsigned long long& state);
+unsigned long long mix64(unsigned long long z);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    TextModel model;                    // used to hold the text model
+    vector<string> words;               // used to hold the sample
+    vector<char> corpus;                // used to hold the made-up text
+    vector<char> again;                 // used to hold a chunk made again
+    unsigned long long seed;            // used to hold the main seed
+    int threads;                        // used to hold the number of threads
+    double start;                       // used to hold the starting time
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = ((unsigned long long) rand() << 31) | rand();
+
+    threads = int(thread::hardware_concurrency());
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    read_sample(SAMPLE_FILE, words);
+    start = now();
+    build_model(model, words);
+    cout << endl << "Model of order " << ORDER << " from " << words.size()
+         << " sample words (" << model.sample_words << " different), "
+         << model.first.size() - 1 << " states, " << model.choices.size()
+         << " choices, " << VOCABULARY << " made-up words; built in "
+         << (now() - start) * 1000 << " ms" << endl;
+
+    double low = measure_bits(model, 0.0, seed);
+    double high = measure_bits(model, 1.0, seed);
+    cout << "    bits per byte: " << low << " (sample words only) to "
+         << high << " (made-up words only)" << endl;
+
+    start = now();
+    double p = find_novelty(model, TARGET_BITS, seed);
+    set_novelty(model, p);
+    cout << "    for " << TARGET_BITS << " bits per byte, made-up words "
+         << "have chance " << p << " (found in " << now() - start
+         << " seconds); measured again: "
+         << measure_bits(model, p, seed + 1) << " bits per byte" << endl;
+
+    // make the corpus
+    corpus.resize(CORPUS);
+    start = now();
+    make_corpus(model, seed, corpus.data(), CORPUS, threads);
+    double seconds = now() - start;
+
+    cout << endl << "The first lines:" << endl << endl;
+    int lines = 0;
+    for (long long j = 0; j < CORPUS && lines < 6; j++) {
+        cout << corpus[j];
+        lines += (corpus[j] == '\n');
+    }
+
+    cout << endl << CORPUS / (1 << 20) << " MB in " << CORPUS / CHUNK
+         << " chunks, " << threads << " thread(s): " << CORPUS / seconds / 1e9
+         << " GB per second (" << CORPUS / seconds / 1e9 / threads
+         << " per thread)" << endl;
+
+    // any chunk can be made again on its own
+    again.resize(CHUNK);
+    long long chunk = CORPUS / CHUNK / 2;
+    make_chunk(model, seed, chunk, again.data(), CHUNK);
+    bool same = memcmp(again.data(), corpus.data() + chunk * CHUNK, CHUNK) == 0;
+    cout << "    chunk " << chunk << " made again on its own is "
+         << (same ? "the same" : "DIFFERENT") << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void read_sample(const char* file_name, vector<string>& words) {
+
+    // PRE:  none
+    //
+    // POST: words holds the words of the introduction (up to the first
+    //       line holding only */) of the file, or of the built-in sample
+    //       if the file can't be read; punctuation stays with its word
+
+    ifstream file(file_name);
+    string line;
+    string text;
+
+    while (file && getline(file, line) && line != "*/") {
+        text += line;
+        text += ' ';
+    }
+    if (text.size() < 1000) {
+        text = BUILT_IN_SAMPLE;
+    }
+
+    words.clear();
+    string word;
+    for (size_t j = 0; j <= text.size(); j++) {
+        char c = (j < text.size()) ? text[j] : ' ';
+
+        // only words made of letters and punctuation, so the diagrams
+        // and ruled lines are left out
+        if (c == ' ' || c == '\t') {
+            if (!word.empty() && isalpha((unsigned char) word[0])
+                && (int) word.size() < SLOT) {
+                words.push_back(word);
+            }
+            word.clear();
+        } else {
+            word += c;
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void build_model(TextModel& model, const vector<string>& words) {
+
+    // PRE:  words holds at least ORDER words
+    //
+    // POST: the model has the sample's words, a state for each run of
+    //       ORDER - 1 words in the sample (plus state 0, which ignores
+    //       the words before), an alias table for each state, and the
+    //       made-up Zipf vocabulary; made-up words are not used yet
+
+    map<string, int> ids;
+    long long n = (long long) words.size();
+    vector<int> token(n);
+
+    model.spelling.clear();
+    model.length.clear();
+    for (long long j = 0; j < n; j++) {
+        map<string, int>::iterator found = ids.find(words[j]);
+        if (found == ids.end()) {
+            found = ids.insert(make_pair(words[j], (int) ids.size())).first;
+            add_word(model, words[j]);
+        }
+        token[j] = found->second;
+    }
+    model.sample_words = (int) ids.size();
+
+    // the state before word j is the ORDER - 1 words before it (going
+    // round to the end of the sample, so every state has a next word)
+    map<vector<int>, int> states;
+    vector<int> before(n);
+    states[vector<int>(1, -1)] = 0;
+    for (long long j = 0; j < n; j++) {
+        vector<int> key;
+        for (int back = ORDER - 1; back >= 1; back--) {
+            key.push_back(token[((j - back) % n + n) % n]);
+        }
+        map<vector<int>, int>::iterator found = states.find(key);
+        if (found == states.end()) {
+            found = states.insert(make_pair(key, (int) states.size())).first;
+        }
+        before[j] = found->second;
+    }
+
+    // count each (state, word) pair, and where it leads; state 0 counts
+    // every word, and leads to the state after its first appearance
+    int count = (int) states.size();
+    vector<map<int, pair<long long, int> > > follow(count);
+    for (long long j = 0; j < n; j++) {
+        int next = before[(j + 1) % n];
+        pair<long long, int>& seen = follow[before[j]][token[j]];
+        seen.first++;
+        seen.second = next;
+        pair<long long, int>& any = follow[0][token[j]];
+        if (any.first++ == 0) {
+            any.second = next;
+        }
+    }
+
+    // an alias table for each state
+    model.first.assign(1, 0);
+    model.columns.clear();
+    model.choices.clear();
+    model.bits.clear();
+    for (int s = 0; s < count; s++) {
+        vector<double> weights;
+        long long total = 0;
+        int base = (int) model.choices.size();
+
+        for (map<int, pair<long long, int> >::iterator it = follow[s].begin();
+             it != follow[s].end(); it++) {
+            total += it->second.first;
+        }
+        for (map<int, pair<long long, int> >::iterator it = follow[s].begin();
+             it != follow[s].end(); it++) {
+            Choice choice = { it->first, it->second.second };
+            model.choices.push_back(choice);
+            model.bits.push_back(float(-log2(double(it->second.first) / total)));
+            weights.push_back(double(it->second.first));
+        }
+
+        vector<AliasEntry> table(weights.size());
+        build_alias(weights, table.data(), base);
+        for (size_t i = 0; i < table.size(); i++) {
+            model.columns.push_back(finish_column(table[i], model.choices.data()));
+        }
+        model.first.push_back((int) model.columns.size());
+    }
+
+    // the made-up words, most common first
+    vector<double> weights(VOCABULARY);
+    vector<AliasEntry> table(VOCABULARY);
+    double total = 0;
+    for (int r = 0; r < VOCABULARY; r++) {
+        add_word(model, made_up_word(r));
+        weights[r] = pow(r + 1.0, -ZIPF_S);
+        total += weights[r];
+    }
+    build_alias(weights, table.data(), 0);
+    model.zipf.resize(VOCABULARY);
+    model.zipf_bits.resize(VOCABULARY);
+    for (int r = 0; r < VOCABULARY; r++) {
+        bool full = table[r].cut > 0xFFFFFFFFULL;
+        model.zipf[r].cut = full ? 0xFFFFFFFFU : (unsigned int) table[r].cut;
+        model.zipf[r].rank[0] = (unsigned short) r;
+        model.zipf[r].rank[1] = (unsigned short) (full ? r : table[r].other);
+        model.zipf_bits[r] = float(-log2(weights[r] / total));
+    }
+
+    set_novelty(model, 0.0);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void add_word(TextModel& model, const string& word) {
+
+    // PRE:  word is shorter than SLOT
+    //
+    // POST: the word and a space have been added in a new slot
+
+    size_t at = model.spelling.size();
+
+    model.spelling.resize(at + SLOT, ' ');
+    memcpy(&model.spelling[at], word.data(), word.size());
+    model.length.push_back((unsigned char) (word.size() + 1));
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+string made_up_word(int rank) {
+
+    // PRE:  rank >= 0
+    //
+    // POST: a pronounceable made-up word has been returned; each rank
+    //       gets a different word, and lower ranks get shorter words
+
+    static const char CONSONANTS[] = "bdfgklmnprstvz";
+    static const char VOWELS[] = "aeiou";
+    const int SYLLABLES = 14 * 5;
+
+    // the first 70 words have one syllable, the next 70^2 two, and so on
+    string word;
+    int syllables = 1;
+    long long block = SYLLABLES;
+    while (rank >= block) {
+        rank -= (int) block;
+        block *= SYLLABLES;
+        syllables++;
+    }
+    for (int j = 0; j < syllables; j++) {
+        word += CONSONANTS[(rank % SYLLABLES) / 5];
+        word += VOWELS[rank % 5];
+        rank /= SYLLABLES;
+    }
+
+    // a closing consonant, so the short words don't look like "la la"
+    word += 'n';
+
+    return word;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void build_alias(const vector<double>& weights, AliasEntry* out, int base) {
+
+    // PRE:  weights holds at least one weight, all >= 0, not all 0; out
+    //       has room for one column per weight
+    //
+    // POST: out is an alias table that chooses base + i with chance
+    //       weights[i] / (sum of weights), using Vose's method
+
+    int n = int(weights.size());
+    double total = 0;
+    vector<double> scaled(n);
+    vector<int> small;
+    vector<int> large;
+
+    for (int i = 0; i < n; i++) {
+        total += weights[i];
+    }
+
+    for (int i = 0; i < n; i++) {
+        scaled[i] = weights[i] * n / total;
+        out[i].cut = 1ULL << 32;
+        out[i].keep = base + i;
+        out[i].other = base + i;
+        if (scaled[i] < 1.0) {
+            small.push_back(i);
+        } else {
+            large.push_back(i);
+        }
+    }
+
+    while (!small.empty() && !large.empty()) {
+        int s = small.back();
+        int l = large.back();
+
+        small.pop_back();
+        out[s].cut = (unsigned long long) (scaled[s] * 4294967296.0);
+        out[s].other = base + l;
+
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+Column finish_column(const AliasEntry& entry, const Choice* choices) {
+
+    // PRE:  entry was made by build_alias(), and its keep and other are
+    //       places in choices
+    //
+    // POST: the column, holding the choices themselves, has been
+    //       returned
+
+    Column column;
+
+    column.pick[0] = choices[entry.keep];
+    column.pick[1] = choices[entry.other];
+    column.cut = (unsigned int) ((entry.cut > 0xFFFFFFFFULL) ? 0xFFFFFFFFULL : entry.cut);
+    if (entry.cut > 0xFFFFFFFFULL) {
+        column.pick[1] = column.pick[0];
+    }
+
+    return column;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void set_novelty(TextModel& model, double p) {
+
+    // PRE:  0 <= p <= 1
+    //
+    // POST: made-up words will be chosen with chance p
+
+    model.p = p;
+    model.novelty = (unsigned long long) (p * 4294967296.0);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double measure_bits(TextModel& model, double p, unsigned long long seed) {
+
+    // PRE:  the model has been built
+    //
+    // POST: the information per byte of text made with chance p of
+    //       made-up words has been returned (the model still uses its
+    //       old chance afterwards)
+
+    double old = model.p;
+    double bits = 0;
+    long long bytes = 0;
+    int state = 0;
+    unsigned long long rng = mix64(seed);
+
+    // the information of choosing "sample word" or "made-up word"
+    double sample_bits = (p < 1) ? -log2(1 - p) : 0;
+    double made_up_bits = (p > 0) ? -log2(p) : 0;
+
+    set_novelty(model, p);
+
+    for (long long j = 0; j < MEASURE_WORDS; j++) {
+        int from = state;
+        int word = pick_word(model, state, rng);
+
+        if (word >= model.sample_words) {
+            bits += made_up_bits + model.zipf_bits[word - model.sample_words];
+        } else {
+            // find which of the state's choices it was
+            int c = model.first[from];
+            while (model.choices[c].word != word) {
+                c++;
+            }
+            bits += sample_bits + model.bits[c];
+        }
+        bytes += model.length[word];
+    }
+
+    set_novelty(model, old);
+
+    return bits / bytes;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double find_novelty(TextModel& model, double target, unsigned long long seed) {
+
+    // PRE:  the model has been built
+    //
+    // POST: the chance of made-up words that gives (about) target bits
+    //       per byte has been returned, or 0 or 1 if target is out of
+    //       reach
+
+    double low = 0;
+    double high = 1;
+
+    if (target <= measure_bits(model, low, seed)) {
+        return low;
+    }
+    if (target >= measure_bits(model, high, seed)) {
+        return high;
+    }
+
+    // the same seed each time, so the measurements rise smoothly with p
+    for (int step = 0; step < 20; step++) {
+        double middle = (low + high) / 2;
+        if (measure_bits(model, middle, seed) < target) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return (low + high) / 2;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+inline int pick_word(const TextModel& model, int& state, unsigned long long& rng) {
+
+    // PRE:  state is a state of the model
+    //
+    // POST: the next word has been returned, and state has moved on
+
+    unsigned long long r = next64(rng);
+    int first = model.first[state];
+    unsigned long long size = (unsigned long long) (model.first[state + 1] - first);
+
+    // the high 32 bits choose the column, the low 32 bits the coin;
+    // the coin is used as an index rather than a test, as a branch
+    // would be guessed wrong about half the time
+    const Column& column = model.columns[first + (((r >> 32) * size) >> 32)];
+    Choice choice = column.pick[(unsigned int) r >= column.cut];
+
+    // a made-up word instead, chosen the same way
+    if (model.novelty != 0) {
+        unsigned long long z = next64(rng);
+        const RankColumn& made_up = model.zipf[((z >> 32) * VOCABULARY) >> 32];
+        int word = model.sample_words + made_up.rank[(unsigned int) z >= made_up.cut];
+        int use = -int((next64(rng) & 0xFFFFFFFFULL) < model.novelty);
+        choice.word = (word & use) | (choice.word & ~use);
+        choice.next &= ~use;
+    }
+
+    state = choice.next;
+
+    return choice.word;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void make_chunk(const TextModel& model, unsigned long long seed, long long chunk,
+                char* out, long long bytes) {
+
+    // PRE:  out has room for bytes characters
+    //
+    // POST: out holds the text of the given chunk: LANES runs of words
+    //       one after the other, each in lines of at most LINE
+    //       characters and cut off at its end
+
+    Lane lanes[LANES];
+    int words[LANES][BATCH];
+
+    for (int l = 0; l < LANES; l++) {
+        lanes[l].at = out + bytes * l / LANES;
+        lanes[l].end = out + bytes * (l + 1) / LANES;
+        lanes[l].state = 0;
+        lanes[l].column = 0;
+        lanes[l].rng = mix64(seed ^ mix64((unsigned long long) (chunk * LANES + l)));
+    }
+
+    // the lanes don't depend on each other, so the processor can work
+    // on all of them at once. Words are chosen BATCH at a time and then
+    // copied out as whole slots, so the copying (which, as far as the
+    // compiler knows, could change the tables) doesn't hold up the
+    // choosing
+    while (true) {
+        bool room = true;
+        for (int l = 0; l < LANES; l++) {
+            room = room && (lanes[l].end - lanes[l].at >= BATCH * SLOT);
+        }
+        if (!room) {
+            break;
+        }
+
+        for (int b = 0; b < BATCH; b++) {
+            for (int l = 0; l < LANES; l++) {
+                words[l][b] = pick_word(model, lanes[l].state, lanes[l].rng);
+            }
+        }
+        for (int l = 0; l < LANES; l++) {
+            for (int b = 0; b < BATCH; b++) {
+                put_word(model, lanes[l], words[l][b], SLOT);
+            }
+        }
+    }
+
+    // the last few words of each lane, cut off at its end
+    for (int l = 0; l < LANES; l++) {
+        Lane& lane = lanes[l];
+        while (lane.at < lane.end) {
+            int word = pick_word(model, lane.state, lane.rng);
+            int length = model.length[word];
+            put_word(model, lane, word, (length < lane.end - lane.at)
+                                        ? length : int(lane.end - lane.at));
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+inline void put_word(const TextModel& model, Lane& lane, int word, int copy) {
+
+    // PRE:  lane.at has room for copy characters
+    //
+    // POST: copy characters of the word's slot have been written, and
+    //       the lane has moved on by the word's length (or copy, if less)
+
+    int length = model.length[word];
+
+    // the space before a word that won't fit becomes a line break (a
+    // word is shorter than a line, so there is always one before it)
+    if (lane.column + length - 1 > LINE) {
+        lane.at[-1] = '\n';
+        lane.column = 0;
+    }
+
+    memcpy(lane.at, &model.spelling[(size_t) word * SLOT], copy);
+    lane.at += (length < copy) ? length : copy;
+    lane.column += length;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void make_corpus(const TextModel& model, unsigned long long seed, char* out,
+                 long long bytes, int threads) {
+
+    // PRE:  out has room for bytes characters
+    //
+    // POST: out holds the first bytes characters of the corpus for this
+    //       seed; the text is the same for any number of threads
+
+    long long chunks = (bytes + CHUNK - 1) / CHUNK;
+    vector<thread> workers;
+
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&, t]() {
+            for (long long c = t; c < chunks; c += threads) {
+                long long size = (bytes - c * CHUNK < CHUNK) ? bytes - c * CHUNK : CHUNK;
+                make_chunk(model, seed, c, out + c * CHUNK, size);
+            }
+        }));
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long next64(unsigned long long& state) {
+
+    // PRE:  none
+    //
+    // POST: a random 64-bit number (SplitMix64) has been returned, and
+    //       state has moved on
+
+    return mix64(state += 0x9E3779B97F4A7C15ULL);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long mix64(unsigned long long z) {
+
+    // PRE:  none
+    //
+    // POST: z has been scrambled with the SplitMix64 mixing function
+    //       and the result returned
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
@@ -0,0 +1,592 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+generate very long random time series -- autoregressive (AR), ARMA,
+and Ornstein-Uhlenbeck processes -- on several cores at once, in C++.
+
+
+-----------------------
+Random Time Series
+-----------------------
+
+A time series is a list of numbers, one per time step: a price each
+day, a temperature each hour. In real series, each value tends to be
+close to the ones just before it. The simplest random model with this
+property is the autoregressive model of order p, or AR(p):
+
+        x[t] = phi[1] * x[t-1] + ... + phi[p] * x[t-p] + e[t]
+
+Each value is a weighted sum of the previous p values, plus a fresh
+random "innovation" e[t], usually a normal random number.
+
+An ARMA model adds a "moving average" of the last q innovations:
+
+        x[t] = (AR part) + e[t] + theta[1] * e[t-1] + ... + theta[q] * e[t-q]
+
+The Ornstein-Uhlenbeck (OU) process is a random value that is always
+pulled back towards an average mu, like a ball on a spring being
+shaken. Looked at every dt seconds, it is exactly an AR(1) series:
+
+        x[t] - mu = exp(-theta * dt) * (x[t-1] - mu) + e[t]
+
+
+-------------------------
+The Sequential Problem
+-------------------------
+
+Written as a loop, each x[t] needs x[t-1], which needs x[t-2], and so
+on: the obvious way can only ever use one core. To generate ten
+billion steps quickly, we need to split the work.
+
+
+--------------------------------
+Step 1: Innovations in Parallel
+--------------------------------
+
+The innovations don't depend on each other at all. We make innovation
+number t directly from the seed and t, by scrambling them together
+with the SplitMix64 mixing function and turning the result into a
+normal random number. Any thread can make any innovation, in any
+order, and always gets the same value -- so the result doesn't depend
+on how many threads are used.
+
+
+-----------------------------------
+Step 2: A Blocked Parallel Scan
+-----------------------------------
+
+The AR recurrence is "linear", which means two solutions can simply be
+added together. We cut the series into blocks, and use that fact in
+three phases:
+
+    1. (parallel)   Each block runs the recurrence as if the p values
+                    before it were all 0. Call its result y.
+
+    2. (sequential) The real p values before each block are carried
+                    from block to block. Each block's real ending
+                    values are its y ending values, plus the effect of
+                    its real starting values. This takes only a few
+                    multiplications per block.
+
+    3. (parallel)   Each block adds the effect of its real starting
+                    values to every y value.
+
+The "effect of the starting values" in phases 2 and 3 is found by
+running the recurrence once with no innovations, starting from a 1 in
+one of the p places. These p "impulse responses" are the same for
+every block, so they are worked out just once. Phase 3 is then a few
+multiply-adds per value, with no dependence from one value to the
+next, which the compiler can turn into vector instructions. For a
+stable model the impulse responses die away quickly, so phase 3 only
+needs to touch the beginning of each block.
+
+This pattern -- local work, a quick sequential pass over block
+summaries, then a local fix-up -- is called a "scan" (or "prefix
+sum"), and it works for any linear recurrence.
+
+
+----------------
+Review Questions
+----------------
+
+1. What is an innovation?
+
+2. What does the moving-average part of an ARMA model add?
+
+3. Why is the Ornstein-Uhlenbeck process an AR(1) series when looked
+at every dt seconds?
+
+4. Why can't the simple loop use more than one core?
+
+5. Why is each innovation made directly from the seed and t?
+
+6. What does "linear" let us do in the blocked scan?
+
+7. Which phase of the scan is sequential, and why is it cheap?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the exp(), log(), sqrt(), cos() and sin() functions
+
+#include <cmath>
+
+
+// access the vector and thread types
+
+#include <vector>
+#include <thread>
+
+
+// constant used to control how many steps each series has
+
+const long long STEPS = 1LL << 23;
+
+
+// constant used to control how many steps are in each block of the
+// scan
+
+const int BLOCK_SIZE = 1 << 16;
+
+
+// constant used to control how small an impulse response must get
+// before phase 3 of the scan stops adding it
+
+const double RESPONSE_CUTOFF = 1e-30;
+
+
+// constant used to control the largest AR and MA orders
+
+const int MAX_ORDER = 16;
+
+
+// an ARMA model: x[t] = sum phi[i] x[t-1-i] + sigma * (z[t] + sum
+// theta[j] z[t-1-j]), with z[t] standard normal
+
+struct ArmaModel {
+    int p;
+    double phi[MAX_ORDER];
+    int q;
+    double theta[MAX_ORDER];
+    double sigma;
+};
+
+
+// prototype for a function to scramble a 64-bit number
+
+unsigned long long mix64(unsigned long long z);
+
+
+// prototype for a function to make innovations number first, first +
+// 1, ... directly from the seed
+
+void innovations(unsigned long long seed, long long first, int count,
+                 double* out);
+
+
+// prototype for a function to generate an ARMA series on several
+// threads with a blocked scan
+
+void generate_arma(const ArmaModel& model, const double* start,
+                   unsigned long long seed, long long n, int threads,
+                   double* out);
+
+
+// prototype for a function to generate an Ornstein-Uhlenbeck series
+
+void generate_ou(double theta, double mu, double sigma, double dt,
+                 double x0, unsigned long long seed, long long n,
+                 int threads, double* out);
+
+
+// prototype for a function to generate an ARMA series with the simple
+// one-step-at-a-time loop, for checking
+
+void generate_arma_simple(const ArmaModel& model, unsigned long long seed,
+                          long long n, double* out);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    vector<double> series;      // used to hold the scanned series
+    vector<double> simple;      // used to hold the simple loop's series
+    ArmaModel model;            // used to hold the ARMA model
+    unsigned long long seed;    // used to hold the main seed
+    int threads;                // used to hold how many threads to use
+    double start;               // used to hold the starting time
+    double simple_time;         // used to hold the simple loop's time
+    double worst = 0;           // used to hold the largest difference
+    double mean = 0;            // used to hold the OU series' average
+    double variance = 0;        // used to hold the OU series' variance
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = ((unsigned long long) rand() << 31) | rand();
+
+    threads = int(thread::hardware_concurrency());
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    // an ARMA(2, 1) model
+    model.p = 2;
+    model.phi[0] = 0.6;
+    model.phi[1] = 0.3;
+    model.q = 1;
+    model.theta[0] = 0.4;
+    model.sigma = 1.0;
+
+    series.resize(STEPS);
+    simple.resize(STEPS);
+
+    cout << endl
+         << "ARMA(2, 1) series of " << STEPS << " steps, " << threads
+         << " threads" << endl;
+
+    start = now();
+    generate_arma_simple(model, seed, STEPS, &simple[0]);
+    simple_time = now() - start;
+
+    start = now();
+    generate_arma(model, NULL, seed, STEPS, threads, &series[0]);
+    cout << "    simple loop:  " << STEPS / simple_time / 1e6
+         << " million steps per second" << endl
+         << "    blocked scan: " << STEPS / (now() - start) / 1e6
+         << " million steps per second" << endl;
+
+    for (long long t = 0; t < STEPS; t++) {
+        double difference = fabs(series[t] - simple[t]);
+        worst = (difference > worst) ? difference : worst;
+    }
+    cout << "    largest difference between the two: " << worst << endl;
+
+    // an OU process pulled towards 5, which should settle to an
+    // average of 5 and a variance of sigma^2 / (2 theta) = 1
+    generate_ou(2.0, 5.0, 2.0, 0.01, 0.0, seed, STEPS, threads, &series[0]);
+
+    for (long long t = STEPS / 2; t < STEPS; t++) {
+        mean += series[t];
+    }
+    mean /= STEPS - STEPS / 2;
+    for (long long t = STEPS / 2; t < STEPS; t++) {
+        variance += (series[t] - mean) * (series[t] - mean);
+    }
+    variance /= STEPS - STEPS / 2;
+
+    cout << endl
+         << "OU process, theta = 2, mu = 5, sigma = 2, dt = 0.01, from 0:"
+         << endl
+         << "    first steps: " << series[0] << " " << series[1] << " "
+         << series[2] << " ..." << endl
+         << "    second half average " << mean << " (expected 5), variance "
+         << variance << " (expected 1)" << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long mix64(unsigned long long z) {
+
+    // PRE:  none
+    //
+    // POST: z has been scrambled with the SplitMix64 mixing function
+    //       and returned
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void innovations(unsigned long long seed, long long first, int count,
+                 double* out) {
+
+    // PRE:  out has room for count numbers
+    //
+    // POST: out[i] holds standard normal innovation number first + i,
+    //       which depends only on the seed and first + i; innovations
+    //       numbered below 0 are 0
+
+    for (int i = 0; i < count; i++) {
+
+        long long t = first + i;
+
+        if (t < 0) {
+            out[i] = 0;
+            continue;
+        }
+
+        // innovations 2k and 2k + 1 are the cosine and sine halves of
+        // one Box-Muller pair made from the seed and k
+        unsigned long long k = (unsigned long long) t >> 1;
+        unsigned long long a = mix64(seed + (2 * k + 1) * 0x9E3779B97F4A7C15ULL);
+        unsigned long long b = mix64(seed + (2 * k + 2) * 0x9E3779B97F4A7C15ULL);
+        double u = (double(a >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+        double v = double(b >> 11) * (6.283185307179586 / 9007199254740992.0);
+        double r = sqrt(-2.0 * log(u));
+
+        if ((t & 1) == 0) {
+            out[i] = r * cos(v);
+            if (i + 1 < count) {
+                out[i + 1] = r * sin(v);
+                i++;
+            }
+        } else {
+            out[i] = r * sin(v);
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void generate_arma(const ArmaModel& model, const double* start,
+                   unsigned long long seed, long long n, int threads,
+                   double* out) {
+
+    // PRE:  1 <= model.p <= MAX_ORDER, 0 <= model.q <= MAX_ORDER,
+    //       start is NULL or holds the p values before the series
+    //       (start[0] is the one just before), out has room for n
+    //       values, and threads >= 1
+    //
+    // POST: out holds n steps of the ARMA series driven by the
+    //       innovations made from seed (nothing, if n <= 0); the values
+    //       are the same for any number of threads
+
+    if (n <= 0) {
+        return;
+    }
+
+    int p = model.p;
+    int q = model.q;
+    long long blocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    vector<double> response((long long) p * BLOCK_SIZE);    // used to hold
+                                                            // the impulse
+                                                            // responses
+    vector<double> carried(blocks * p);     // used to hold the real values
+                                            // before each block
+    int reach = 0;                          // used to hold how far the
+                                            // responses matter
+    vector<thread> workers;
+
+    // response[j * BLOCK_SIZE + t] is x[t] when x[-1 - j] = 1, every
+    // other starting value is 0, and there are no innovations
+    for (int j = 0; j < p; j++) {
+        double* h = &response[(long long) j * BLOCK_SIZE];
+        for (int t = 0; t < BLOCK_SIZE; t++) {
+            double sum = 0;
+            for (int i = 0; i < p; i++) {
+                long long back = t - 1 - i;
+                if (back >= 0) {
+                    sum += model.phi[i] * h[back];
+                } else if (back == -1 - j) {
+                    sum += model.phi[i];
+                }
+            }
+            h[t] = sum;
+            if (fabs(sum) >= RESPONSE_CUTOFF && t >= reach) {
+                reach = t + 1;
+            }
+        }
+    }
+
+    // phase 1: each block runs from all-zero starting values
+    for (int w = 0; w < threads; w++) {
+        workers.push_back(thread([&, w]() {
+            vector<double> e(BLOCK_SIZE + q);
+
+            for (long long b = w; b < blocks; b += threads) {
+
+                long long first = b * BLOCK_SIZE;
+                int length = int((n - first < BLOCK_SIZE) ? n - first
+                                                          : BLOCK_SIZE);
+                double* x = out + first;
+
+                // e[q + t] is innovation first + t, and e[0..q) are the
+                // q before it, for the moving average
+                innovations(seed, first - q, length + q, &e[0]);
+
+                for (int t = 0; t < length; t++) {
+                    double sum = e[q + t];
+                    for (int j = 0; j < q; j++) {
+                        sum += model.theta[j] * e[q + t - 1 - j];
+                    }
+                    sum *= model.sigma;
+                    for (int i = 0; i < p && i < t; i++) {
+                        sum += model.phi[i] * x[t - 1 - i];
+                    }
+                    x[t] = sum;
+                }
+            }
+        }));
+    }
+    for (int w = 0; w < threads; w++) {
+        workers[w].join();
+    }
+    workers.clear();
+
+    // phase 2: carry the real starting values from block to block
+    for (int j = 0; j < p; j++) {
+        carried[j] = (start != NULL) ? start[j] : 0.0;
+    }
+    for (long long b = 0; b + 1 < blocks; b++) {
+
+        const double* s = &carried[b * p];
+        const double* x = out + b * BLOCK_SIZE;
+
+        for (int k = 0; k < p; k++) {
+            int t = BLOCK_SIZE - 1 - k;
+            double value = x[t];
+            for (int j = 0; j < p; j++) {
+                value += response[(long long) j * BLOCK_SIZE + t] * s[j];
+            }
+            carried[(b + 1) * p + k] = value;
+        }
+    }
+
+    // phase 3: add the effect of each block's real starting values
+    for (int w = 0; w < threads; w++) {
+        workers.push_back(thread([&, w]() {
+            for (long long b = w; b < blocks; b += threads) {
+
+                long long first = b * BLOCK_SIZE;
+                int length = int((n - first < BLOCK_SIZE) ? n - first
+                                                          : BLOCK_SIZE);
+                double* x = out + first;
+
+                for (int j = 0; j < p; j++) {
+                    const double* h = &response[(long long) j * BLOCK_SIZE];
+                    double s = carried[b * p + j];
+                    if (s == 0) {
+                        continue;
+                    }
+                    // for a stable model the responses die away, and
+                    // multiplying by the tiny leftovers (which can be
+                    // "denormal" numbers) is very slow, so stop once
+                    // they no longer matter
+                    int last = (length < reach) ? length : reach;
+                    for (int t = 0; t < last; t++) {
+                        x[t] += h[t] * s;
+                    }
+                }
+            }
+        }));
+    }
+    for (int w = 0; w < threads; w++) {
+        workers[w].join();
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void generate_ou(double theta, double mu, double sigma, double dt,
+                 double x0, unsigned long long seed, long long n,
+                 int threads, double* out) {
+
+    // PRE:  theta > 0, dt > 0, out has room for n values, and
+    //       threads >= 1
+    //
+    // POST: out holds the Ornstein-Uhlenbeck process dx = theta (mu -
+    //       x) dt + sigma dW at times dt, 2 dt, ..., n dt, starting
+    //       from x0 at time 0, sampled exactly (not by small steps)
+
+    ArmaModel model;
+    double shifted = x0 - mu;
+
+    model.p = 1;
+    model.phi[0] = exp(-theta * dt);
+    model.q = 0;
+    model.sigma = sigma * sqrt((1.0 - exp(-2.0 * theta * dt)) / (2.0 * theta));
+
+    generate_arma(model, &shifted, seed, n, threads, out);
+
+    for (long long t = 0; t < n; t++) {
+        out[t] += mu;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void generate_arma_simple(const ArmaModel& model, unsigned long long seed,
+                          long long n, double* out) {
+
+    // PRE:  1 <= model.p <= MAX_ORDER, 0 <= model.q <= MAX_ORDER, and
+    //       out has room for n values
+    //
+    // POST: out holds the same series generate_arma() makes from all-
+    //       zero starting values, computed one step at a time
+
+    int p = model.p;
+    int q = model.q;
+    double ring[MAX_ORDER + 1] = { 0 };     // used to hold the last q + 1
+                                            // innovations, z[t] in slot
+                                            // t % (q + 1)
+    double pair[2];                         // used to hold a Box-Muller
+                                            // pair of innovations
+
+    for (long long t = 0; t < n; t++) {
+
+        double sum;
+        int slot = int(t % (q + 1));
+
+        // each innovation is made once, a Box-Muller pair at a time,
+        // and kept in the ring until the moving average is done with
+        // it; slots not yet written hold the 0s before the series
+        if ((t & 1) == 0) {
+            innovations(seed, t, 2, pair);
+        }
+        ring[slot] = pair[t & 1];
+
+        sum = ring[slot];
+        for (int j = 0; j < q; j++) {
+            int back = slot - 1 - j;
+            if (back < 0) {
+                back += q + 1;
+            }
+            sum += model.theta[j] * ring[back];
+        }
+        sum *= model.sigma;
+        for (int i = 0; i < p && i < t; i++) {
+            sum += model.phi[i] * out[t - 1 - i];
+        }
+        out[t] = sum;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
@@ -0,0 +1,576 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how a
+text-generating program picks its next word at random, using the
+temperature, top-k and top-p (nucleus) rules, in C++.
+
+
+-----------------------
+Scores, Not Chances
+-----------------------
+
+A program that writes text one word (or "token") at a time works out,
+for every token it knows, a score called a "logit". A vocabulary can
+easily have 100,000 tokens or more. Higher logits mean more likely
+tokens, but logits are not chances: they can be negative, and they
+don't add up to 1.
+
+The usual way to turn logits into chances is the "softmax":
+
+        chance of token i = exp(logit[i]) / (sum over all j of exp(logit[j]))
+
+We could compute all the chances, add them up, and use a running total
+to choose a token, like the weighted selection used for k-means++.
+That takes several passes over 100,000 numbers for every token we
+generate.
+
+
+---------------------
+The Gumbel-Max Trick
+---------------------
+
+There is a neater way. For each token, draw a uniform random number u
+between 0 and 1 and add
+
+        g = -log(-log(u))
+
+to its logit. This g is called "Gumbel noise". Then simply choose the
+token with the largest total. Remarkably, this picks token i with
+exactly the softmax chance above -- and it needs only one pass, no
+exp(), and no adding up.
+
+The "exactly" depends on u being fine-grained enough. A float holds
+only 24 bits, so with a float u the noise comes in coarse steps and
+is cut off at both ends, which is enough to move the chances by as
+much as about one percent. So we make u from 53 random bits, as a
+double, and take both logs in double too.
+
+
+-------------
+Temperature
+-------------
+
+Dividing every logit by a number T, the "temperature", before
+choosing, changes how adventurous the choice is. With T below 1, the
+high-scoring tokens become even more likely; with T above 1, the
+chances become more even.
+
+
+------------
+Top-k
+------------
+
+Top-k sampling only considers the k tokens with the highest logits
+(say k = 40), and ignores the rest. Finding the k largest of n numbers
+does not need a full sort: the "selection" algorithm (nth_element()
+in C++) rearranges the numbers so that the k-th largest is in its
+place, with larger ones on one side, in time proportional to n. We
+then apply the Gumbel-max trick to the k survivors only.
+
+
+----------------------
+Top-p (Nucleus)
+----------------------
+
+Top-p sampling keeps the smallest set of highest-chance tokens whose
+chances add up to at least p (say p = 0.9). Usually this set is much
+smaller than the vocabulary. We find it, again without sorting, like
+this:
+
+    1. Pick a "pivot" chance, and split the tokens into those above
+       and below it.
+    2. If the tokens above add up to at least p, the nucleus is
+       among them: repeat on just those.
+    3. Otherwise, all of the tokens above are in the nucleus; repeat
+       on the tokens below, looking for the rest of p.
+
+Each round throws away a good part of the tokens, so the total work is
+about proportional to n.
+
+
+----------------------
+Many Rows at Once
+----------------------
+
+A server generating text for many users at once needs one token for
+each of them, so it has many rows of logits. Each row is independent,
+so the rows are shared out among threads. Each row gets its own
+random number stream, made from a seed and the row number, so the
+results don't depend on which thread handled which row.
+
+
+----------------
+Review Questions
+----------------
+
+1. What is a logit?
+
+2. What does the softmax do?
+
+3. How is Gumbel noise made from a uniform random number?
+
+4. After adding Gumbel noise, which token is chosen?
+
+5. What happens to the choice when the temperature is below 1?
+
+6. Why doesn't top-k need a full sort?
+
+7. In top-p sampling, what happens when the tokens above the pivot
+add up to less than p?
+
+8. Why does each row get its own random number stream?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand() and srand() functions
+
+#include <cstdlib>
+
+
+// access the time() and clock_gettime() functions
+
+#include <ctime>
+
+
+// access the exp() and log() functions
+
+#include <cmath>
+
+
+// access the vector and thread types, and the nth_element() function
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+
+// constant used to control how many tokens the sample vocabulary has
+
+const int VOCABULARY = 100000;
+
+
+// constant used to control how many rows of logits are sampled at once
+
+const int ROWS = 64;
+
+
+// constant used to control how many random numbers are made at once
+
+const int NOISE_BLOCK = 1024;
+
+
+// the sampling rule for a batch of rows
+
+struct SamplingRule {
+    float temperature;
+    int top_k;          // 0 means "no top-k"
+    float top_p;        // 1 means "no top-p"
+};
+
+
+// prototype for a function to make a random 64-bit number from a
+// stream's state
+
+unsigned long long next64(unsigned long long& state);
+
+
+// prototype for a function to fill a block with Gumbel noise
+
+void gumbel_noise(unsigned long long& state, double* out, int n);
+
+
+// prototypes for functions to choose a token from one row of logits
+
+int sample_gumbel(const float* logits, int n, float temperature,
+                  unsigned long long& state);
+int sample_top_k(const float* logits, int n, float temperature, int k,
+                 unsigned long long& state);
+int sample_top_p(const float* logits, int n, float temperature, float p,
+                 unsigned long long& state);
+
+
+// prototype for a function to choose one token for each of many rows,
+// on several threads
+
+void sample_rows(const vector<float>& logits, int rows, int n,
+                 const SamplingRule& rule, unsigned long long seed,
+                 int threads, vector<int>& out);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    vector<float> logits;       // used to hold the sample logits
+    vector<int> chosen;         // used to hold the chosen tokens
+    vector<long long> counts;   // used to count each choice
+    unsigned long long seed;    // used to hold the main seed
+    unsigned long long state;   // used to hold a random number stream
+    int threads;                // used to hold how many threads to use
+    double start;               // used to hold the starting time
+    SamplingRule rules[3] = { { 1.0f, 0, 1.0f },
+                              { 0.8f, 40, 1.0f },
+                              { 0.8f, 0, 0.9f } };
+    const char* names[3] = { "Gumbel-max, T = 1.0", "top-k, k = 40, T = 0.8",
+                             "top-p, p = 0.9, T = 0.8" };
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = ((unsigned long long) rand() << 31) | rand();
+    state = seed;
+
+    threads = int(thread::hardware_concurrency());
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    // check the Gumbel-max trick on a tiny vocabulary, whose softmax
+    // chances are easy to work out: logits 0, 1, 2 give chances of
+    // about 0.090, 0.245 and 0.665
+    float tiny[3] = { 0.0f, 1.0f, 2.0f };
+    counts.assign(3, 0);
+    for (int i = 0; i < 100000; i++) {
+        counts[sample_gumbel(tiny, 3, 1.0f, state)]++;
+    }
+    cout << endl
+         << "Gumbel-max on logits 0, 1, 2:  " << counts[0] / 100000.0 << " "
+         << counts[1] / 100000.0 << " " << counts[2] / 100000.0
+         << "  (softmax: 0.090 0.245 0.665)" << endl;
+
+    // make ROWS rows of random logits, between -10 and 10
+    logits.resize((long long) ROWS * VOCABULARY);
+    for (long long i = 0; i < (long long) ROWS * VOCABULARY; i++) {
+        logits[i] = 20.0f * float(rand()) / float(RAND_MAX) - 10.0f;
+    }
+
+    cout << endl
+         << "Sampling one token for each of " << ROWS << " rows of "
+         << VOCABULARY << " logits, on " << threads << " threads" << endl;
+
+    for (int r = 0; r < 3; r++) {
+        start = now();
+        sample_rows(logits, ROWS, VOCABULARY, rules[r], seed, threads, chosen);
+        cout << "    " << names[r] << ": " << (now() - start) * 1e6 / ROWS
+             << " microseconds per row, first row chose token " << chosen[0]
+             << endl;
+    }
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long next64(unsigned long long& state) {
+
+    // PRE:  none
+    //
+    // POST: a random 64-bit number (SplitMix64) has been returned, and
+    //       state has moved on
+
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void gumbel_noise(unsigned long long& state, double* out, int n) {
+
+    // PRE:  out has room for n numbers
+    //
+    // POST: out holds n independent Gumbel noise values
+
+    // first make all the uniform numbers, then take the logs in a
+    // separate loop, which the compiler can vectorize
+    for (int i = 0; i < n; i++) {
+
+        // 53 random bits, so u is below 1 and a multiple of 2^-53;
+        // u = 0 would make the noise -infinity, so it is drawn again
+        unsigned long long r;
+        do {
+            r = next64(state) >> 11;
+        } while (r == 0);
+        out[i] = double(r) * (1.0 / 9007199254740992.0);
+    }
+
+    for (int i = 0; i < n; i++) {
+        out[i] = -log(-log(out[i]));
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int sample_gumbel(const float* logits, int n, float temperature,
+                  unsigned long long& state) {
+
+    // PRE:  n >= 1 and temperature > 0
+    //
+    // POST: a token has been returned, chosen with its softmax chance
+    //       at the given temperature
+
+    double noise[NOISE_BLOCK];
+    double inverse = 1.0 / temperature;
+    double best_score = -1e300;
+    int best = 0;
+
+    // one pass, a block at a time
+    for (int start = 0; start < n; start += NOISE_BLOCK) {
+
+        int count = (n - start < NOISE_BLOCK) ? n - start : NOISE_BLOCK;
+
+        gumbel_noise(state, noise, count);
+
+        for (int i = 0; i < count; i++) {
+            double score = logits[start + i] * inverse + noise[i];
+            if (score > best_score) {
+                best_score = score;
+                best = start + i;
+            }
+        }
+    }
+
+    return best;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int sample_top_k(const float* logits, int n, float temperature, int k,
+                 unsigned long long& state) {
+
+    // PRE:  n >= 1, 1 <= k, and temperature > 0
+    //
+    // POST: a token has been returned, chosen among the k highest
+    //       logits with its softmax chance at the given temperature
+
+    vector<float> copy;         // used to find the k-th largest logit
+    vector<int> survivors;      // used to hold the top k tokens
+    vector<double> noise;       // used to hold their Gumbel noise
+    float threshold;            // used to hold the k-th largest logit
+    int best = 0;
+    double best_score = -1e300;
+
+    if (k >= n) {
+        return sample_gumbel(logits, n, temperature, state);
+    }
+
+    // selection puts the k-th largest logit in place, without sorting
+    copy.assign(logits, logits + n);
+    nth_element(copy.begin(), copy.begin() + (k - 1), copy.end(),
+                greater<float>());
+    threshold = copy[k - 1];
+
+    // one pass collects the tokens above the threshold, then as many
+    // ties as are needed to make k
+    for (int i = 0; i < n; i++) {
+        if (logits[i] > threshold) {
+            survivors.push_back(i);
+        }
+    }
+    for (int i = 0; i < n && int(survivors.size()) < k; i++) {
+        if (logits[i] == threshold) {
+            survivors.push_back(i);
+        }
+    }
+
+    noise.resize(survivors.size());
+    gumbel_noise(state, &noise[0], int(noise.size()));
+
+    for (int i = 0; i < int(survivors.size()); i++) {
+        double score = logits[survivors[i]] / double(temperature) + noise[i];
+        if (score > best_score) {
+            best_score = score;
+            best = survivors[i];
+        }
+    }
+
+    return best;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+int sample_top_p(const float* logits, int n, float temperature, float p,
+                 unsigned long long& state) {
+
+    // PRE:  n >= 1, 0 < p <= 1, and temperature > 0
+    //
+    // POST: a token has been returned, chosen within the nucleus (the
+    //       smallest set of highest-chance tokens whose chances add up
+    //       to at least p) with its softmax chance
+
+    vector<float> chance(n);    // used to hold each token's chance
+    vector<int> order(n);       // used to hold the tokens being split
+    float largest = logits[0];
+    float inverse = 1.0f / temperature;
+    double total = 0;
+    int lo = 0;                 // the tokens order[lo..hi) are still
+    int hi = n;                 // undecided; order[0..lo) are in
+    double needed;              // used to hold what is left of p
+    double kept = 0;            // used to hold the nucleus' chance
+
+    for (int i = 1; i < n; i++) {
+        largest = (logits[i] > largest) ? logits[i] : largest;
+    }
+
+    // subtracting the largest logit keeps exp() from overflowing
+    for (int i = 0; i < n; i++) {
+        chance[i] = expf((logits[i] - largest) * inverse);
+        total += chance[i];
+        order[i] = i;
+    }
+
+    needed = p * total;
+
+    while (hi - lo > 1) {
+
+        // split around the chance of a random undecided token
+        float pivot = chance[order[lo + int(next64(state) % (unsigned long long)
+                                            (hi - lo))]];
+        int mid = int(partition(order.begin() + lo, order.begin() + hi,
+                                [&](int t) { return chance[t] > pivot; })
+                      - order.begin());
+        double above = 0;
+
+        for (int i = lo; i < mid; i++) {
+            above += chance[order[i]];
+        }
+
+        if (above >= needed) {
+            // the nucleus ends among the tokens above the pivot
+            hi = mid;
+        } else {
+            // all tokens above the pivot are in; the ones equal to the
+            // pivot come next
+            kept += above;
+            needed -= above;
+            lo = mid;
+
+            int equal = int(partition(order.begin() + lo, order.begin() + hi,
+                                      [&](int t) { return chance[t] == pivot; })
+                            - order.begin());
+
+            while (lo < equal && needed > 0) {
+                kept += chance[order[lo]];
+                needed -= chance[order[lo]];
+                lo++;
+            }
+
+            if (needed <= 0) {
+                hi = lo;
+            }
+        }
+    }
+
+    // a single undecided token left over is the last one needed
+    if (hi - lo == 1 && needed > 0) {
+        kept += chance[order[lo]];
+        lo++;
+    }
+
+    // choose within the nucleus order[0..lo) with a running total
+    double r = double(next64(state) >> 11) * (1.0 / 9007199254740992.0) * kept;
+    double running = 0;
+
+    for (int i = 0; i < lo; i++) {
+        running += chance[order[i]];
+        if (r < running) {
+            return order[i];
+        }
+    }
+
+    return order[lo > 0 ? lo - 1 : 0];
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void sample_rows(const vector<float>& logits, int rows, int n,
+                 const SamplingRule& rule, unsigned long long seed,
+                 int threads, vector<int>& out) {
+
+    // PRE:  logits holds rows * n logits, one row after another, and
+    //       threads >= 1
+    //
+    // POST: out[r] holds the token chosen for row r under rule; the
+    //       same seed always gives the same tokens
+
+    vector<thread> workers;
+
+    out.resize(rows);
+
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&, t]() {
+            for (int r = t; r < rows; r += threads) {
+
+                // each row's stream starts from the seed and the row
+                // number, scrambled
+                unsigned long long state = seed ^ ((unsigned long long) r << 32);
+                const float* row = &logits[(long long) r * n];
+
+                next64(state);
+
+                if (rule.top_p < 1.0f) {
+                    out[r] = sample_top_p(row, n, rule.temperature, rule.top_p,
+                                          state);
+                } else if (rule.top_k > 0) {
+                    out[r] = sample_top_k(row, n, rule.temperature, rule.top_k,
+                                          state);
+                } else {
+                    out[r] = sample_gumbel(row, n, rule.temperature, state);
+                }
+            }
+        }));
+    }
+
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
@@ -0,0 +1,726 @@
+/*
+--------------------------------------------------------------------
+                            Introduction
+--------------------------------------------------------------------
+
+This is a tutorial, implementation, and demonstration showing how to
+keep a random sample of only the RECENT part of a stream -- the last W
+items, the last T seconds, or a sample that favours newer items -- in
+a small amount of memory, in C++.
+
+
+-----------------------
+Why Not a Reservoir?
+-----------------------
+
+A reservoir sample is a fair sample of everything seen so far. A
+dashboard showing "some recent events" wants a fair sample of the
+last W items, or of the last T seconds. Keeping all of those items and
+sampling them again and again takes memory and time in proportion to
+the window. The methods here keep only a few items, and make very few
+random numbers.
+
+
+-----------------------------------
+Chain Sampling: the Last W Items
+-----------------------------------
+
+Babcock, Datar and Motwani's "chain sampling" keeps one sample of the
+last W items:
+
+    - Item i becomes the sample with chance 1 / min(i, W).
+    - When an item joins the chain, we pick at random which of the next
+      W items will be its "successor", and add that one to the chain
+      when it arrives.
+    - When the sample leaves the window, the next item in the chain
+      takes over. It arrived less than W items after the old one, so
+      it is still in the window. (At that moment the newest item does
+      not also get its 1 / W chance, or it would be a little more
+      likely than the others.)
+
+The chain is usually only a couple of items long. Rather than flipping
+a coin for every item, we draw how many items to skip before the next
+one that becomes the sample, so a stream of n items needs only about
+4n / W random numbers. For a sample of k items, we run k chains (the
+same item can then be picked more than once).
+
+
+-------------------------------------
+Priority Sampling: the Last T Seconds
+-------------------------------------
+
+For a window of time, the number of items in it changes all the time.
+"Priority sampling" gives every item a random priority when it arrives.
+The sample is the k items in the window with the highest priorities:
+a fair sample of k different items from the window.
+
+We only have to keep an item while fewer than k newer items have
+beaten its priority: once k newer items beat it, they will still be in
+the window after it has gone, so it can never be in the top k again.
+Each item counts how often it has been beaten. On average only about
+k * ln(W / k) items are kept, where W is the number of items in the
+window.
+
+
+-----------------------------------
+Time Decay: Favouring New Items
+-----------------------------------
+
+Sometimes we want all items, but with newer ones more likely: an item
+of weight w that arrived at time t counts as w * exp(lambda * t) ("forward
+decay"), so every 1 / lambda seconds, new items become e times more
+important.
+
+A fair weighted sample of k items without replacement is the k items
+with the biggest keys
+
+        key = log(w) + lambda * t - log(E)
+
+where E is a random exponential number (Efraimidis and Spirakis, in
+log form so the huge weights don't overflow). We keep the k biggest
+keys in a heap. Once the heap is full, most items can't beat its
+smallest key, so, like skip counting, we draw how much weight to pass
+over before the next item that does ("exponential jumps"), using only
+a few random numbers per change to the sample.
+
+
+----------------
+Review Questions
+----------------
+
+1. Why is the next item in the chain always inside the window when
+   the sample leaves it?
+
+2. How many random numbers does chain sampling need for n items?
+
+3. Why can an item be forgotten once k newer items have beaten its
+   priority?
+
+4. What does lambda control in a time-decayed sample?
+
+5. Why are the keys kept as logarithms?
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+
+using namespace std;
+
+
+// access the rand(), srand() and time() functions
+
+#include <cstdlib>
+#include <ctime>
+
+
+// access the log(), log1p(), expm1(), exp() and floor() functions
+
+#include <cmath>
+
+
+// access the vector and deque types
+
+#include <vector>
+#include <deque>
+
+
+// access the push_heap(), pop_heap() and sort() functions
+
+#include <algorithm>
+
+
+// constants used to control the demonstration
+
+const int SAMPLE = 8;
+const long long WINDOW = 1000000;
+const long long ITEMS = 20000000;
+
+
+// an item kept by a sampler: when it arrived and what it is
+
+struct Item {
+    long long index;
+    unsigned long long value;
+};
+
+
+// one chain of chain sampling: the chain, and when the next item
+// joins it
+
+struct Chain {
+    deque<Item> items;      // the sample is at the front
+    long long next_pick;    // index of the next item to become the sample
+    long long successor;    // index of the next item to join the chain
+};
+
+
+// k chains over the last W items
+
+struct ChainSampler {
+    long long window;
+    long long count;        // items seen so far
+    vector<Chain> chains;
+    unsigned long long state;
+    long long draws;        // random numbers drawn so far
+};
+
+
+// an item kept by priority sampling
+
+struct PriorityItem {
+    double time;
+    double priority;
+    int beaten;             // newer items with a higher priority
+    unsigned long long value;
+};
+
+
+// the top k priorities over the last span seconds
+
+struct PriorityWindow {
+    int k;
+    double span;
+    vector<PriorityItem> items;
+    unsigned long long state;
+    long long draws;
+};
+
+
+// a time-decayed weighted sample of k items: a min-heap of keys
+
+struct DecayedSampler {
+    int k;
+    double lambda;
+    vector<pair<double, unsigned long long> > heap;
+    double budget;          // weight to pass over before the next change
+    unsigned long long state;
+    long long draws;
+};
+
+
+// prototypes for functions to make random numbers
+
+unsigned long long next64(unsigned long long& state);
+double uniform(unsigned long long& state);
+
+
+// prototypes for functions for chain sampling
+
+void init_chains(ChainSampler& sampler, long long window, int k,
+                 unsigned long long seed);
+void chain_offer(ChainSampler& sampler, unsigned long long value);
+long long pick_after(ChainSampler& sampler, long long seen);
+void chain_sample(const ChainSampler& sampler, vector<unsigned long long>& out);
+
+
+// prototypes for functions for priority sampling over time
+
+void init_priority(PriorityWindow& sampler, double span, int k,
+                   unsigned long long seed);
+void priority_offer(PriorityWindow& sampler, double time,
+                    unsigned long long value);
+void priority_sample(PriorityWindow& sampler, double time,
+                     vector<unsigned long long>& out);
+
+
+// prototypes for functions for time-decayed sampling
+
+void init_decayed(DecayedSampler& sampler, double lambda, int k,
+                  unsigned long long seed);
+void decayed_offer(DecayedSampler& sampler, double time, double weight,
+                   unsigned long long value);
+void decayed_sample(const DecayedSampler& sampler, vector<unsigned long long>& out);
+
+
+// prototype for a function to get the current time in seconds
+
+double now();
+
+//////////////////////////////////////////////////////////////////////
+
+
+int main() {
+
+    ChainSampler chains;                // used to hold chain sampling
+    PriorityWindow priority;            // used to hold priority sampling
+    DecayedSampler decayed;             // used to hold decayed sampling
+    vector<unsigned long long> sample;  // used to hold a sample
+    unsigned long long seed;            // used to hold the main seed
+    double start;                       // used to hold the starting time
+    const int TRIALS = 100000;
+
+    // set the random number generator seed by using the number of
+    // seconds since the Unix Epoch
+    srand(int(time(0)));
+    seed = ((unsigned long long) rand() << 31) | rand();
+
+    // fairness of chain sampling: after 1000 items, each of the last 10
+    // should be the sample with chance 1 / 10
+    vector<long long> hits(10, 0);
+    for (int s = 0; s < TRIALS; s++) {
+        init_chains(chains, 10, 1, seed + s);
+        for (int i = 0; i < 1000; i++) {
+            chain_offer(chains, i);
+        }
+        chain_sample(chains, sample);
+        hits[sample[0] - 990]++;
+    }
+    cout << endl << "Chain sampling, window 10: share for each of the last "
+         << "10 items (expected 0.1)" << endl << "   ";
+    for (int i = 0; i < 10; i++) {
+        cout << " " << hits[i] / double(TRIALS);
+    }
+    cout << endl;
+
+    // fairness of priority sampling: 3 of the items in the last 10
+    // seconds, with items arriving at uneven times
+    vector<long long> in_window(40, 0);
+    vector<long long> picked(40, 0);
+    for (int s = 0; s < TRIALS; s++) {
+        unsigned long long times = 12345;
+        double t = 0;
+        init_priority(priority, 10.0, 3, seed + s);
+        for (int i = 0; i < 40; i++) {
+            t += (i % 4 == 0) ? 2.0 : 0.25 + (next64(times) % 4) * 0.125;
+            priority_offer(priority, t, i);
+            if (s == 0) {
+                in_window[i] = (long long) (t * 1000);
+            }
+        }
+        priority_sample(priority, t, sample);
+        for (size_t k = 0; k < sample.size(); k++) {
+            picked[sample[k]]++;
+        }
+    }
+    int inside = 0;
+    for (int i = 0; i < 40; i++) {
+        inside += (in_window[i] > in_window[39] - 10000);
+    }
+    cout << endl << "Priority sampling, 3 from the last 10 seconds ("
+         << inside << " items, expected " << 3.0 / inside << " each):"
+         << endl << "   ";
+    for (int i = 40 - inside - 2; i < 40; i++) {
+        cout << " " << picked[i] / double(TRIALS);
+    }
+    cout << endl;
+
+    // fairness of decayed sampling: 1 of 5 items with weight 1 at
+    // times 0 to 4, lambda = ln 2, so each is twice as likely as the
+    // one before
+    vector<long long> chosen(5, 0);
+    for (int s = 0; s < TRIALS; s++) {
+        init_decayed(decayed, log(2.0), 1, seed + s);
+        for (int i = 0; i < 5; i++) {
+            decayed_offer(decayed, i, 1.0, i);
+        }
+        decayed_sample(decayed, sample);
+        chosen[sample[0]]++;
+    }
+    cout << endl << "Decayed sampling, halving each second, 1 of 5 items:"
+         << endl << "    shares:  ";
+    for (int i = 0; i < 5; i++) {
+        cout << " " << chosen[i] / double(TRIALS);
+    }
+    cout << endl << "    expected:";
+    for (int i = 0; i < 5; i++) {
+        cout << " " << (1 << i) / 31.0;
+    }
+    cout << endl;
+
+    // speed over a long stream, one item per microsecond
+    cout << endl << ITEMS << " items, samples of " << SAMPLE
+         << ", window of " << WINDOW << " items (" << WINDOW / 1e6
+         << " seconds):" << endl;
+
+    init_chains(chains, WINDOW, SAMPLE, seed);
+    start = now();
+    for (long long i = 0; i < ITEMS; i++) {
+        chain_offer(chains, i);
+    }
+    size_t longest = 0;
+    for (int c = 0; c < SAMPLE; c++) {
+        longest = (chains.chains[c].items.size() > longest)
+                  ? chains.chains[c].items.size() : longest;
+    }
+    cout << "    chain sampling:    " << ITEMS / (now() - start) / 1e6
+         << " million items per second, " << double(chains.draws) / ITEMS
+         << " draws per item, longest chain " << longest << endl;
+
+    init_priority(priority, WINDOW / 1e6, SAMPLE, seed);
+    start = now();
+    for (long long i = 0; i < ITEMS; i++) {
+        priority_offer(priority, i / 1e6, i);
+    }
+    cout << "    priority sampling: " << ITEMS / (now() - start) / 1e6
+         << " million items per second, " << double(priority.draws) / ITEMS
+         << " draws per item, " << priority.items.size() << " items kept"
+         << endl;
+
+    init_decayed(decayed, 1.0, SAMPLE, seed);
+    start = now();
+    for (long long i = 0; i < ITEMS; i++) {
+        decayed_offer(decayed, i / 1e6, 1.0, i);
+    }
+    cout << "    decayed sampling:  " << ITEMS / (now() - start) / 1e6
+         << " million items per second, " << double(decayed.draws) / ITEMS
+         << " draws per item" << endl;
+
+    priority_sample(priority, (ITEMS - 1) / 1e6, sample);
+    cout << "    priority sample (seconds ago):";
+    for (size_t k = 0; k < sample.size(); k++) {
+        cout << " " << (ITEMS - 1 - (long long) sample[k]) / 1e6;
+    }
+    cout << endl;
+
+    decayed_sample(decayed, sample);
+    cout << "    decayed sample (seconds ago): ";
+    for (size_t k = 0; k < sample.size(); k++) {
+        cout << " " << (ITEMS - 1 - (long long) sample[k]) / 1e6;
+    }
+    cout << endl;
+
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+unsigned long long next64(unsigned long long& state) {
+
+    // PRE:  none
+    //
+    // POST: state has moved on, and a random 64-bit number has been
+    //       returned (SplitMix64)
+
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double uniform(unsigned long long& state) {
+
+    // PRE:  none
+    //
+    // POST: a random number strictly between 0 and 1 has been returned
+
+    return ((next64(state) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void init_chains(ChainSampler& sampler, long long window, int k,
+                 unsigned long long seed) {
+
+    // PRE:  window >= 1 and k >= 1
+    //
+    // POST: sampler holds k empty chains over the last window items
+
+    sampler.window = window;
+    sampler.count = 0;
+    sampler.chains.assign(k, Chain());
+    sampler.state = seed;
+    sampler.draws = 0;
+
+    // item 0 is always the first sample
+    for (int c = 0; c < k; c++) {
+        sampler.chains[c].next_pick = 0;
+        sampler.chains[c].successor = -1;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void chain_offer(ChainSampler& sampler, unsigned long long value) {
+
+    // PRE:  init_chains() has been called
+    //
+    // POST: the item has been offered to every chain, and items that
+    //       have left the window have been dropped
+
+    long long i = sampler.count++;
+    long long w = sampler.window;
+    Item item = { i, value };
+
+    for (size_t c = 0; c < sampler.chains.size(); c++) {
+
+        Chain& chain = sampler.chains[c];
+        bool expiring = !chain.items.empty() && chain.items.front().index <= i - w;
+
+        // the usual case: nothing to do
+        if (i != chain.next_pick && i != chain.successor && !expiring) {
+            continue;
+        }
+
+        if (i == chain.next_pick) {
+            chain.next_pick = pick_after(sampler, i + 1);
+
+            // a new sample, unless the old one is leaving right now: then
+            // its successor takes over instead, which keeps every item
+            // in the window exactly equally likely
+            if (!expiring) {
+                chain.items.clear();
+                chain.items.push_back(item);
+                chain.successor = i + 1 + (long long) (uniform(sampler.state) * w);
+                sampler.draws++;
+                continue;
+            }
+        }
+
+        if (i == chain.successor) {
+            chain.items.push_back(item);
+            chain.successor = i + 1 + (long long) (uniform(sampler.state) * w);
+            sampler.draws++;
+        }
+
+        if (expiring) {
+            chain.items.pop_front();
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+long long pick_after(ChainSampler& sampler, long long seen) {
+
+    // PRE:  seen items have been offered
+    //
+    // POST: the index of the next item to become a new sample has been
+    //       returned
+
+    long long w = sampler.window;
+
+    // while filling the window, item j is picked with chance 1 / (j + 1),
+    // so the next one after seen items is past j with chance
+    // seen / (j + 1)
+    sampler.draws++;
+    if (seen < w) {
+        double after = floor(seen / uniform(sampler.state));
+        if (after < w) {
+            return (long long) after;
+        }
+        seen = w;
+        sampler.draws++;
+    }
+
+    // then chance 1 / w per item: a geometric skip
+    return seen + (long long) floor(log(uniform(sampler.state)) / log1p(-1.0 / w));
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void chain_sample(const ChainSampler& sampler, vector<unsigned long long>& out) {
+
+    // PRE:  at least one item has been offered
+    //
+    // POST: out holds one sample item from each chain
+
+    out.clear();
+    for (size_t c = 0; c < sampler.chains.size(); c++) {
+        out.push_back(sampler.chains[c].items.front().value);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void init_priority(PriorityWindow& sampler, double span, int k,
+                   unsigned long long seed) {
+
+    // PRE:  span > 0 and k >= 1
+    //
+    // POST: sampler is empty, ready to sample k items from the last
+    //       span seconds
+
+    sampler.k = k;
+    sampler.span = span;
+    sampler.items.clear();
+    sampler.state = seed;
+    sampler.draws = 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void priority_offer(PriorityWindow& sampler, double time,
+                    unsigned long long value) {
+
+    // PRE:  items are offered in order of time
+    //
+    // POST: the item has been kept with a random priority, items it
+    //       beats have counted it, and items that can no longer be in
+    //       the sample have been dropped
+
+    PriorityItem item = { time, uniform(sampler.state), 0, value };
+    double oldest = time - sampler.span;
+    size_t kept = 0;
+
+    sampler.draws++;
+
+    // count the new item against every kept item, keeping (in order)
+    // those still in the window that haven't yet been beaten k times
+    for (size_t j = 0; j < sampler.items.size(); j++) {
+        PriorityItem& old = sampler.items[j];
+        if (old.time <= oldest) {
+            continue;
+        }
+        if (old.priority < item.priority && ++old.beaten >= sampler.k) {
+            continue;
+        }
+        sampler.items[kept++] = old;
+    }
+    sampler.items.resize(kept);
+    sampler.items.push_back(item);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void priority_sample(PriorityWindow& sampler, double time,
+                     vector<unsigned long long>& out) {
+
+    // PRE:  items have been offered up to this time
+    //
+    // POST: out holds the (up to) k items of the last span seconds with
+    //       the highest priorities
+
+    vector<pair<double, unsigned long long> > best;
+
+    for (size_t j = 0; j < sampler.items.size(); j++) {
+        if (sampler.items[j].time <= time - sampler.span) {
+            continue;
+        }
+        best.push_back(make_pair(sampler.items[j].priority, sampler.items[j].value));
+    }
+    sort(best.begin(), best.end());
+
+    out.clear();
+    for (size_t j = best.size(); j > 0 && out.size() < (size_t) sampler.k; j--) {
+        out.push_back(best[j - 1].second);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void init_decayed(DecayedSampler& sampler, double lambda, int k,
+                  unsigned long long seed) {
+
+    // PRE:  lambda >= 0 and k >= 1
+    //
+    // POST: sampler is empty, ready to keep k items, with weights that
+    //       grow by exp(lambda) every second
+
+    sampler.k = k;
+    sampler.lambda = lambda;
+    sampler.heap.clear();
+    sampler.budget = 0;
+    sampler.state = seed;
+    sampler.draws = 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void decayed_offer(DecayedSampler& sampler, double time, double weight,
+                   unsigned long long value) {
+
+    // PRE:  weight > 0
+    //
+    // POST: the item has been offered to the sample, counting as
+    //       weight * exp(lambda * time)
+
+    typedef pair<double, unsigned long long> Key;
+
+    double log_weight = log(weight) + sampler.lambda * time;
+
+    if ((int) sampler.heap.size() < sampler.k) {
+
+        // still filling: every item gets in, with key log w - log E
+        double e = -log(uniform(sampler.state));
+        sampler.heap.push_back(Key(log_weight - log(e), value));
+        push_heap(sampler.heap.begin(), sampler.heap.end(), greater<Key>());
+        sampler.draws++;
+
+        if ((int) sampler.heap.size() == sampler.k) {
+            sampler.budget = -log(uniform(sampler.state));
+            sampler.draws++;
+        }
+        return;
+    }
+
+    // the item beats the smallest key with chance 1 - exp(-x): pass over
+    // items, spending x from the budget, until the budget runs out
+    double x = exp(log_weight - sampler.heap[0].first);
+
+    sampler.budget -= x;
+    if (sampler.budget > 0) {
+        return;
+    }
+
+    // this item gets in: E, given that it is below x, makes its key
+    double e = -log1p(-uniform(sampler.state) * -expm1(-x));
+    pop_heap(sampler.heap.begin(), sampler.heap.end(), greater<Key>());
+    sampler.heap.back() = Key(log_weight - log(e), value);
+    push_heap(sampler.heap.begin(), sampler.heap.end(), greater<Key>());
+
+    sampler.budget = -log(uniform(sampler.state));
+    sampler.draws += 2;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+void decayed_sample(const DecayedSampler& sampler, vector<unsigned long long>& out) {
+
+    // PRE:  none
+    //
+    // POST: out holds the items in the sample
+
+    out.clear();
+    for (size_t j = 0; j < sampler.heap.size(); j++) {
+        out.push_back(sampler.heap[j].second);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+
+
+double now() {
+
+    // PRE:  none
+    //
+    // POST: the number of seconds on a clock that only moves forward
+    //       has been returned
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}